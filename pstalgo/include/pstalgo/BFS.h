@@ -21,12 +21,15 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <cmath>
+#include <cstring>
+#include <queue>
 #include <vector>
 
 #include "Limits.h"
 #include "Vec2.h"
-
-class CAxialGraph;
+#include "graph/AxialGraph.h"
+#include "utils/StampedBitVector.h"
 
 class CPSTBFS {
 
@@ -46,6 +49,17 @@ public:
 	inline void       cancel() { m_bCancel = true; }
 	inline const bool getCancel() const { return m_bCancel; }
 
+	// Several radii can share one traversal if they and the distance type need
+	// no other distance than either walking or steps. Every target is then
+	// visited with its shortest such distance, and belongs to each radius it is
+	// within. Straight line limits restrict the whole path rather than the
+	// distance, and angles are compared per direction along lines at line
+	// crossings, so neither gives the same result when shared. Returns false if
+	// the radii can't share a traversal, otherwise the limits to traverse with
+	// and the distance (LIMITS::MASK_*) to compare with each radius.
+	static bool getSharedRadiusLimits(const LIMITS* limits, unsigned int count, DistanceType distType, LIMITS& ret_limits, unsigned int& ret_metric);
+	static float getMetricLimit(const LIMITS& limits, unsigned int metric);  // Infinity if not limited
+
 protected:
 	struct DIST {
 		float walking;
@@ -70,16 +84,40 @@ protected:
 		float lastAngle;
 	};
 
+	typedef void (CPSTBFS::*BFSKernel)(int iStartLine, float startPos, const DIST& startDist);
+
 	void         doBFSFromPoint(const float2& pt);
 	void		 doBFSFromLine(int iLine);
-	void         doBFS(int iStartLine, float startPos, const DIST& startDist);
+	inline void  doBFS(int iStartLine, float startPos, const DIST& startDist) { (this->*m_bfsKernel)(iStartLine, startPos, startDist); }
 	virtual void visitBFS(int iTarget, const DIST& dist) = 0;
-	bool         testLimit(const DIST& dist);
-	virtual bool testStraightLineLimit(const float2& pt);
-	bool         updateCheckPoint(CHECKPOINT& c, const DIST& d, float fwAngle, float bkAngle);
-	inline void  clrVisitedLineCrossings()       { if (!m_lcVisitedBits.empty()) memset(&m_lcVisitedBits.front(), 0, m_lcVisitedBits.size() * sizeof(m_lcVisitedBits.front())); }
-	inline bool  hasVisitedLineCrossing(int iLC) { return (m_lcVisitedBits[iLC >> 5] & (1 << (iLC & 31))) != 0; }
-	inline void  setVisitedLineCrossing(int iLC) { m_lcVisitedBits[iLC >> 5] |= (1 << (iLC & 31)); }
+	inline bool  testStraightLineLimit(const float2& pt) const
+	{
+		if (!(LIMITS::MASK_STRAIGHT & m_lim.mask))
+			return true;
+		float dx = pt.x - m_origin.x;
+		float dy = pt.y - m_origin.y;
+		return (dx*dx + dy*dy <= m_lim.straightSqr);
+	}
+
+	// Selects the BFS kernel for the distances that are needed by the distance type and
+	// limits (see init), and the class whose visitBFS it should call. If TVisitor::visitBFS 
+	// is 'final' it is called directly rather than through the vtable.
+	template <class TVisitor> void selectBFSKernel();
+
+	// METRICS is the mask (LIMITS::MASK_*) of distances that are compared at line 
+	// crossings and tested against limits. Other distances are never calculated.
+	template <class TVisitor, unsigned int METRICS> void TDoBFS(int iStartLine, float startPos, const DIST& startDist);
+	// Kernel for when steps is the only distance needed (METRICS == LIMITS::MASK_TURNS).
+	// Every step costs the same, so line crossings are processed one level at a time from
+	// flat frontier arrays, and the first visit of a line crossing is always the shortest.
+	template <class TVisitor> void TDoStepsBFS(int iStartLine, float startPos, const DIST& startDist);
+	template <class TVisitor> void TStepsBFSVisitLine(int iLine, float linePos, int iEntryLineCrossing, const DIST& dist);
+	template <unsigned int METRICS> bool TTestLimit(const DIST& dist) const;
+	static float getMetricDistance(const DIST& dist, unsigned int metric);
+	template <unsigned int METRICS> bool TUpdateCheckPoint(CHECKPOINT& c, const DIST& d, float fwAngle, float bkAngle) const;
+	inline void  clrVisitedLineCrossings()       { m_lcVisitedBits.clearAll(); }
+	inline bool  hasVisitedLineCrossing(int iLC) { return m_lcVisitedBits.get(iLC); }
+	inline void  setVisitedLineCrossing(int iLC) { m_lcVisitedBits.set(iLC); }
 
 	CAxialGraph*      m_pGraph;
 	const float2*   m_pDest;
@@ -88,8 +126,438 @@ protected:
 	Target          m_target;
 	DistanceType    m_distType;
 	std::vector<CHECKPOINT> m_lcCheckPoints;
-	std::vector<unsigned int> m_lcVisitedBits;
+	CStampedBitVector m_lcVisitedBits;
+	std::vector<int> m_lcFrontier;      // Line crossings to enter at current level (steps BFS)
+	std::vector<int> m_lcNextFrontier;  // Line crossings to enter at next level (steps BFS)
 	float2          m_origin;
 	bool            m_bCancel;
+	BFSKernel       m_bfsKernel;
+
+};
+
+// CPSTBFS with a BFS kernel that calls TDerived::visitBFS directly
+template <class TDerived>
+class TPSTBFS : public CPSTBFS {
+public:
+	void init(CAxialGraph* pGraph, Target target, DistanceType distType, const LIMITS& limits)
+	{
+		CPSTBFS::init(pGraph, target, distType, limits);
+		selectBFSKernel<TDerived>();
+	}
+};
+
+template <class TVisitor>
+void CPSTBFS::selectBFSKernel()
+{
+	const unsigned int W = LIMITS::MASK_WALKING;
+	const unsigned int T = LIMITS::MASK_TURNS;
+	const unsigned int A = LIMITS::MASK_ANGLE;
+	const unsigned int X = LIMITS::MASK_AXMETER;
+
+	// Distances used by distance type (for results and comparison at line crossings) or limits
+	unsigned int metrics = m_lim.mask & (W | T | A | X);
+	switch (m_distType) {
+	case DIST_WALKING: metrics |= W;         break;
+	case DIST_LINES:   metrics |= T;         break;
+	case DIST_ANGULAR: metrics |= A;         break;
+	case DIST_AXMETER: metrics |= W | T | X; break;
+	default: break;
+	}
+
+	switch (metrics) {
+	case 0:                 m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, 0>;                 break;
+	case W:                 m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, W>;                 break;
+	case T:                 m_bfsKernel = &CPSTBFS::TDoStepsBFS<TVisitor>;               break;
+	case A:                 m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, A>;                 break;
+	case X:                 m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, X>;                 break;
+	case W | T:             m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, W | T>;             break;
+	case W | A:             m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, W | A>;             break;
+	case W | X:             m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, W | X>;             break;
+	case T | A:             m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, T | A>;             break;
+	case T | X:             m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, T | X>;             break;
+	case A | X:             m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, A | X>;             break;
+	case W | T | A:         m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, W | T | A>;         break;
+	case W | T | X:         m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, W | T | X>;         break;
+	case W | A | X:         m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, W | A | X>;         break;
+	case T | A | X:         m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, T | A | X>;         break;
+	default:                m_bfsKernel = &CPSTBFS::TDoBFS<TVisitor, W | T | A | X>;     break;
+	}
+}
+
+template <class TVisitor, unsigned int METRICS>
+void CPSTBFS::TDoBFS(int iStartLine, float startPos, const DIST& startDist)
+{
+	const bool WALKING = (METRICS & LIMITS::MASK_WALKING) != 0;
+	const bool ANGLE   = (METRICS & LIMITS::MASK_ANGLE) != 0;
+	const bool AXMETER = (METRICS & LIMITS::MASK_AXMETER) != 0;
+
+	using namespace std;
+
+	std::queue<STATE> queue;  // TODO: Move out to avoid reallocation on every call!
+
+	{
+		STATE initial_state;
+		initial_state.iLineCrossing = -1;
+		initial_state.dist = startDist;
+		initial_state.lastAngle = -1.0f;
+		queue.push(initial_state);
+	}
+
+	while (!queue.empty() && !getCancel())
+	{
+		// Get next state from queue
+		const STATE s = queue.front();
+		queue.pop();
+
+		const auto* from_lc = (s.iLineCrossing >= 0) ? &m_pGraph->getLineCrossing(s.iLineCrossing) : nullptr;
+
+		const int   iLine = from_lc ? from_lc->iLine : iStartLine;
+		const float linePos = from_lc ? from_lc->linePos : startPos;
+		const int   iCrossing = from_lc ? from_lc->iCrossing : -1;  // IMPORTANT: Crossing is not the same as "line crossing"!
+
+		// Calculate angle 
+		float fowdAccAngle, backAccAngle;
+		fowdAccAngle = backAccAngle = s.dist.angle;
+		if (ANGLE && s.lastAngle >= 0.0f) {
+			float angdiff = angleDiff(m_pGraph->getLine(iLine).angle, s.lastAngle);
+			fowdAccAngle += angdiff;
+			backAccAngle += 180.0f - angdiff;
+		}
+
+		if (s.iLineCrossing >= 0) {
+			// We came in through a "line crossing" (i.e. this is not the first time we entered the graph).
+			// NOTE: A "line crossing" is unique for this particular line, it is an "entry/exit on this line".
+			CHECKPOINT& c = m_lcCheckPoints[s.iLineCrossing];
+			if (hasVisitedLineCrossing(s.iLineCrossing)) {
+				// We have come in through this crossing before, check if we have any better metrics this time.
+				if (!TUpdateCheckPoint<METRICS>(c, s.dist, fowdAccAngle, backAccAngle))
+					continue; // We had better values last time we visited this line crossing
+			}
+			else {
+				// This is the first time we've come in through this line crossing. Mark it
+				// as visited and note our metrics.
+				setVisitedLineCrossing(s.iLineCrossing);
+				c.walking = s.dist.walking;
+				c.turns = s.dist.turns;
+				c.fwAngle = fowdAccAngle;
+				c.bkAngle = backAccAngle;
+				c.axmeter = s.dist.axmeter;
+			}
+		}
+
+		const CAxialGraph::NETWORKLINE& line = m_pGraph->getLine(iLine);
+
+		// Perform result update if we have lines as target
+		if (TARGET_LINES == m_target) {
+			CPSTBFS::DIST dist = s.dist;
+			dist.angle = (linePos < (line.length * 0.5f)) ? fowdAccAngle : backAccAngle;
+			if (WALKING)
+				dist.walking += abs(line.length * 0.5f - linePos);  // Add distance to mid point of line
+			if (TTestLimit<METRICS>(dist)) {
+				static_cast<TVisitor*>(this)->visitBFS(iLine, dist);
+			}
+		}
+
+		// Loop through all line crossings along this line, update their checkpoints
+		// and queue them for further traversal.
+		for (int i = 0; i<line.nCrossings; ++i)
+		{
+			const int iLC = line.iFirstCrossing + i;
+
+			// We don't need to update checkpoint of line crossing we just came through,
+			// and there is no point in queueing that line crossing for traversal either.
+			if (iLC == s.iLineCrossing)
+				continue;
+
+			const CAxialGraph::LINECROSSING& lc = m_pGraph->getLineCrossing(iLC);
+
+			// Test straight line limit
+			if ((LIMITS::MASK_STRAIGHT & m_lim.mask) && !testStraightLineLimit(m_pGraph->getCrossing(lc.iCrossing).pt))
+				continue;
+
+			STATE sNext;
+
+			// Calculate distance metrics for this line crossing
+			sNext.dist = s.dist;
+			if (lc.linePos > linePos) {
+				// Forewards
+				float distAlongThisLine = lc.linePos - linePos;
+				if (WALKING)
+					sNext.dist.walking = s.dist.walking + distAlongThisLine;
+				sNext.dist.angle = fowdAccAngle;
+				if (AXMETER)
+					sNext.dist.axmeter = s.dist.axmeter + (distAlongThisLine * (s.dist.turns + 1));
+				sNext.lastAngle = line.angle;
+			}
+			else if (lc.linePos < linePos) {
+				// Backwards
+				float distAlongThisLine = linePos - lc.linePos;
+				if (WALKING)
+					sNext.dist.walking = s.dist.walking + distAlongThisLine;
+				sNext.dist.angle = backAccAngle;
+				if (AXMETER)
+					sNext.dist.axmeter = s.dist.axmeter + (distAlongThisLine * (s.dist.turns + 1));
+				sNext.lastAngle = reverseAngle(line.angle);
+			}
+			else {
+				// Leaving line at same point as we entered
+				sNext.lastAngle = s.lastAngle;
+			}
+
+			// Test if we can reach this line crossing within our radius limit
+			if (!TTestLimit<METRICS>(sNext.dist))
+				continue;
+
+			// Update the checkpoint of this line crossing with our current distance metrics
+			// NOTE: A "line crossing" is unique for this particular line, it is an "entry/exit on this line".
+			CHECKPOINT& c = m_lcCheckPoints[iLC];
+			if (hasVisitedLineCrossing(iLC)) {
+				// We've visited this line crossing before
+				if (!TUpdateCheckPoint<METRICS>(c, sNext.dist, fowdAccAngle, backAccAngle))
+					continue; // We had better values last time we visited this line crossing
+			}
+			else {
+				// First time this line crossing is visited
+				setVisitedLineCrossing(iLC);
+				c.walking = sNext.dist.walking;
+				c.turns = sNext.dist.turns;
+				c.fwAngle = fowdAccAngle;
+				c.bkAngle = backAccAngle;
+				c.axmeter = sNext.dist.axmeter;
+			}
+
+			// Perform result update if we have crossings as target
+			if (TARGET_CROSSINGS == m_target)
+				static_cast<TVisitor*>(this)->visitBFS(lc.iCrossing, sNext.dist);
+
+			// --- From this point we handle queueing for further traversal ---
+
+			// Do not allow leaving at same crossing (NOTE: Not 'line crossing'!) we came from
+			if (lc.iCrossing == iCrossing)
+				continue;
+
+			// Do not allow leaving at same exact position as we entered this line
+			// (unless this is entry line for search). This SHOULD be a redundant
+			// check, since it should be handled with checks for same CROSSING and 
+			// LINE CROSSING above, but we do it here as an extra safety check.
+			if (s.iLineCrossing >= 0 && lc.linePos == linePos)
+				continue;
+
+			// Lookup opposite line crossing to queue the traversal towwards.
+			sNext.iLineCrossing = lc.iOpposite;
+
+			// Add this step we're about to take
+			++sNext.dist.turns;
+
+			if (!TTestLimit<METRICS>(sNext.dist))
+				continue;
+
+			// Ok, we passed all tests. Queue for further traversal.
+			queue.push(sNext);
+		}
+
+		if (TARGET_POINTS == m_target) {
+
+			for (int i = 0; i<line.nPoints; ++i) {
+
+				int iPoint = m_pGraph->getLinePoint(line.iFirstPoint + i);
+				const CAxialGraph::POINT& p = m_pGraph->getPoint(iPoint);
+
+				// Test straight line limit
+				if ((LIMITS::MASK_STRAIGHT & m_lim.mask) && !testStraightLineLimit(p.coords))
+					continue;
+
+				DIST d = s.dist;
+				if ((m_origin.x == p.coords.x) && (m_origin.y == p.coords.y)) {
+					// Back to Origin Point, no distance
+					memset(&d, 0, sizeof(d));
+				}
+				else {
+					if (WALKING)
+						d.walking += p.distFromLine;
+					if (p.linePos > linePos) {
+						// Forewards
+						float distAlongThisLine = p.linePos - linePos;
+						if (WALKING)
+							d.walking += distAlongThisLine;
+						d.angle = fowdAccAngle;
+						if (AXMETER)
+							d.axmeter += (distAlongThisLine + p.distFromLine) * (d.turns + 1);
+					}
+					else if (p.linePos < linePos) {
+						// Backwards
+						float distAlongThisLine = linePos - p.linePos;
+						if (WALKING)
+							d.walking += distAlongThisLine;
+						d.angle = backAccAngle;
+						if (AXMETER)
+							d.axmeter += (distAlongThisLine + p.distFromLine) * (d.turns + 1);
+					}
+				}
+
+				if (TTestLimit<METRICS>(d)) {
+					static_cast<TVisitor*>(this)->visitBFS(iPoint, d);
+				}
+
+			}
+
+		}
+
+	}
+
+}
+
+template <class TVisitor>
+void CPSTBFS::TDoStepsBFS(int iStartLine, float startPos, const DIST& startDist)
+{
+	DIST dist = startDist;
+
+	m_lcNextFrontier.clear();
+	TStepsBFSVisitLine<TVisitor>(iStartLine, startPos, -1, dist);
+
+	while (!m_lcNextFrontier.empty() && !getCancel())
+	{
+		++dist.turns;
+		m_lcFrontier.swap(m_lcNextFrontier);
+		m_lcNextFrontier.clear();
+
+		for (const int iLC : m_lcFrontier)
+		{
+			if (getCancel())
+				break;
+
+			// Line crossing has already been reached (as entry or exit) at a lower or same level
+			if (hasVisitedLineCrossing(iLC))
+				continue;
+			setVisitedLineCrossing(iLC);
+
+			const CAxialGraph::LINECROSSING& lc = m_pGraph->getLineCrossing(iLC);
+			TStepsBFSVisitLine<TVisitor>(lc.iLine, lc.linePos, iLC, dist);
+		}
+	}
+}
+
+template <class TVisitor>
+void CPSTBFS::TStepsBFSVisitLine(int iLine, float linePos, int iEntryLineCrossing, const DIST& dist)
+{
+	const unsigned int T = LIMITS::MASK_TURNS;
+
+	const int iCrossing = (iEntryLineCrossing >= 0) ? m_pGraph->getLineCrossing(iEntryLineCrossing).iCrossing : -1;
+
+	const CAxialGraph::NETWORKLINE& line = m_pGraph->getLine(iLine);
+
+	if (TARGET_LINES == m_target && TTestLimit<T>(dist))
+		static_cast<TVisitor*>(this)->visitBFS(iLine, dist);
+
+	DIST nextDist = dist;
+	++nextDist.turns;
+	const bool queueNext = TTestLimit<T>(nextDist);
+
+	for (int i = 0; i < line.nCrossings; ++i)
+	{
+		const int iLC = line.iFirstCrossing + i;
+
+		if (iLC == iEntryLineCrossing)
+			continue;
+
+		const CAxialGraph::LINECROSSING& lc = m_pGraph->getLineCrossing(iLC);
+
+		if ((LIMITS::MASK_STRAIGHT & m_lim.mask) && !testStraightLineLimit(m_pGraph->getCrossing(lc.iCrossing).pt))
+			continue;
+
+		if (hasVisitedLineCrossing(iLC))
+			continue;
+		setVisitedLineCrossing(iLC);
+
+		if (TARGET_CROSSINGS == m_target)
+			static_cast<TVisitor*>(this)->visitBFS(lc.iCrossing, dist);
+
+		// Do not allow leaving at same crossing, or same position, as we entered
+		if (lc.iCrossing == iCrossing)
+			continue;
+		if (iEntryLineCrossing >= 0 && lc.linePos == linePos)
+			continue;
+
+		if (queueNext)
+			m_lcNextFrontier.push_back(lc.iOpposite);
+	}
+
+	if (TARGET_POINTS == m_target) {
+		for (int i = 0; i < line.nPoints; ++i) {
+			int iPoint = m_pGraph->getLinePoint(line.iFirstPoint + i);
+			const CAxialGraph::POINT& p = m_pGraph->getPoint(iPoint);
+			if ((LIMITS::MASK_STRAIGHT & m_lim.mask) && !testStraightLineLimit(p.coords))
+				continue;
+			DIST d = dist;
+			if ((m_origin.x == p.coords.x) && (m_origin.y == p.coords.y)) {
+				// Back to Origin Point, no distance
+				memset(&d, 0, sizeof(d));
+			}
+			if (TTestLimit<T>(d))
+				static_cast<TVisitor*>(this)->visitBFS(iPoint, d);
+		}
+	}
+}
+
+template <unsigned int METRICS>
+bool CPSTBFS::TTestLimit(const DIST& dist) const
+{
+	if ((METRICS & LIMITS::MASK_WALKING) && (LIMITS::MASK_WALKING & m_lim.mask) && (dist.walking > m_lim.walking))
+		return false;
+	if ((METRICS & LIMITS::MASK_TURNS) && (LIMITS::MASK_TURNS & m_lim.mask) && (dist.turns > m_lim.turns))
+		return false;
+	if ((METRICS & LIMITS::MASK_ANGLE) && (LIMITS::MASK_ANGLE & m_lim.mask) && (dist.angle > m_lim.angle))
+		return false;
+	if ((METRICS & LIMITS::MASK_AXMETER) && (LIMITS::MASK_AXMETER & m_lim.mask) && (dist.axmeter > m_lim.axmeter))
+		return false;
+	return true;
+}
+
+template <unsigned int METRICS>
+bool CPSTBFS::TUpdateCheckPoint(CHECKPOINT& c, const DIST& d, float fwAngle, float bkAngle) const
+{
+	bool bHasImprovements = false;
+	bool bHasWorse = false;
+
+	if (METRICS & LIMITS::MASK_WALKING) {
+		if (d.walking < c.walking)
+			bHasImprovements = true;
+		else if (d.walking > c.walking)
+			bHasWorse = true;
+	}
+
+	if (METRICS & LIMITS::MASK_TURNS) {
+		if (d.turns < c.turns)
+			bHasImprovements = true;
+		else if (d.turns > c.turns)
+			bHasWorse = true;
+	}
+
+	if (METRICS & LIMITS::MASK_ANGLE) {
+		if ((fwAngle < c.fwAngle) || (bkAngle < c.bkAngle))
+			bHasImprovements = true;
+		if ((fwAngle > c.fwAngle) || (bkAngle > c.bkAngle))
+			bHasWorse = true;
+	}
+
+	if (METRICS & LIMITS::MASK_AXMETER) {
+		if (d.axmeter < c.axmeter)
+			bHasImprovements = true;
+		else if (d.axmeter > c.axmeter)
+			bHasWorse = true;
+	}
+
+	if (!bHasImprovements)
+		return false;
+
+	// Update Values
+	if (!bHasWorse) {
+		c.walking = d.walking;
+		c.turns = d.turns;
+		c.fwAngle = fwAngle;
+		c.bkAngle = bkAngle;
+		c.axmeter = d.axmeter;
+	}
 
-};
\ No newline at end of file
+	return true;
+}
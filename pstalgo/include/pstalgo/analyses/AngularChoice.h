@@ -30,7 +30,7 @@ struct SPSTAAngularChoiceDesc
 	SPSTAAngularChoiceDesc();
 
 	// Version
-	static const unsigned int VERSION = 2;
+	static const unsigned int VERSION = 4;
 	unsigned int m_Version;
 
 	// Graph
@@ -39,17 +39,32 @@ struct SPSTAAngularChoiceDesc
 	// Radius
 	SPSTARadii m_Radius;
 
+	// Multiple radii, as alternative to m_Radius. If m_RadiusCount > 0 all
+	// radii are calculated in one pass, with same results as separate runs,
+	// and output arrays hold one block of one element per line for each
+	// radius, in order of m_Radii.
+	const SPSTARadii* m_Radii;
+	unsigned int      m_RadiusCount;
+
 	// Settings
 	bool m_WeighByLength;
 	float m_AngleThreshold;
 	unsigned int m_AnglePrecision;
 
+	// Multiple weightings, as alternative to m_WeighByLength. If m_WeightCount
+	// > 0 all weightings are calculated in one pass, and m_OutChoice and
+	// m_OutTotalDepthWeight hold one set of radius blocks for each weighting,
+	// in order of m_Weights. Each weighting is either an array of one weight
+	// per line, or NULL for unweighted choice.
+	const float* const* m_Weights;
+	unsigned int        m_WeightCount;
+
 	// Progress Callback
 	FPSTAProgressCallback m_ProgressCallback;
 	void*                 m_ProgressCallbackUser;
 
 	// Output
-	// These can either be NULL or pointer to arrays of one element per line
+	// These can either be NULL or pointer to arrays of one element per line (and radius and weighting)
 	float*        m_OutChoice;
 	unsigned int* m_OutNodeCount;        // Number of reached lines, INCLUDING origin line
 	float*        m_OutTotalDepth;       // SUM(depth) for reached nodes
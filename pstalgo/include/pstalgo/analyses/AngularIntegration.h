@@ -28,7 +28,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 struct SPSTAAngularIntegrationDesc
 {
 	// Version
-	static const unsigned int VERSION = 2;
+	static const unsigned int VERSION = 4;
 	unsigned int m_Version = VERSION;
 
 	// Graph
@@ -37,21 +37,45 @@ struct SPSTAAngularIntegrationDesc
 	// Radius
 	SPSTARadii m_Radius;
 
+	// Multiple radii, as alternative to m_Radius. If m_RadiusCount > 0 all
+	// radii are calculated in one pass, with same results as separate runs,
+	// and output arrays hold one block of one element per line for each
+	// radius, in order of m_Radii.
+	const SPSTARadii* m_Radii = nullptr;
+	unsigned int      m_RadiusCount = 0;
+
 	// Settings
 	bool  m_WeighByLength = false;
 	float m_AngleThreshold = 0;
 	unsigned int m_AnglePrecision = 1;
 
+	// Pivot sampling (optional)
+	// If m_PivotCount or m_PivotTargetError is set, outputs are estimated from
+	// searches from a sample of pivot segments only, scaled by segment count
+	// over pivot count. This relies on depth from A to B being the same as from
+	// B to A, which only holds for no radius and angular radius, and the
+	// analysis fails for other radii. Pivots are spread over the map by
+	// drawing them from a grid of cells in proportion to the number of segments
+	// in each. m_PivotTargetError is the largest allowed relative standard
+	// error of any total depth, and is only used if m_PivotCount is 0.
+	unsigned int m_PivotCount = 0;
+	float        m_PivotTargetError = 0;
+	unsigned int m_PivotSeed = 0;
+
 	// Progress Callback
 	FPSTAProgressCallback m_ProgressCallback = nullptr;
 	void*                 m_ProgressCallbackUser = nullptr;
 
 	// Output
-	// These can either be NULL or pointer to arrays of one element per line
+	// These can either be NULL or pointer to arrays of one element per line (and radius)
 	unsigned int* m_OutNodeCounts        = nullptr;  // Number of reached lines, INCLUDING origin line
 	float*        m_OutTotalDepths       = nullptr;  // SUM(depth) for each reached lines
 	float*        m_OutTotalWeights      = nullptr;  // SUM(weight) for each reached lines
 	float*        m_OutTotalDepthWeights = nullptr;  // SUM(depth*weight) for each reached lines
+
+	// Pivot sampling output
+	float*        m_OutTotalDepthVariances = nullptr;  // Variance of m_OutTotalDepths, per line (and radius)
+	unsigned int* m_OutPivotCount = nullptr;           // Number of pivots sampled (single value)
 };
 
 PSTADllExport bool PSTAAngularIntegration(const SPSTAAngularIntegrationDesc* desc);
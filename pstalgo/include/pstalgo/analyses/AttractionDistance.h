@@ -30,7 +30,7 @@ struct SPSTAAttractionDistanceDesc
 	PSTA_DECL_STRUCT_NAME(SPSTAAttractionDistanceDesc)
 
 	// Version
-	static const unsigned int VERSION = 3;
+	static const unsigned int VERSION = 5;
 	const unsigned int m_Version = VERSION;
 
 	// Graph
@@ -51,16 +51,24 @@ struct SPSTAAttractionDistanceDesc
 	// Attraction Polygons (optional)
 	// If not NULL this means m_AttractionPoints should be treated as polygon 
 	// corners, and the actual attraction points will be generated at every
-	// 'm_AttractionPolygonPointInterval' interval along polygon edges.
+	// 'm_AttractionPolygonPointInterval' interval along polygon edges, or at
+	// the polygon's entry points into the network if
+	// 'm_AttractionPolygonPointMode' is EPSTAPolygonPointMode_EntryPoints.
 	unsigned int* m_PointsPerAttractionPolygon = nullptr;  // Polygons will be closed automatically, start/end point should NOT be repeated
 	unsigned int  m_AttractionPolygonCount = 0;
 	float         m_AttractionPolygonPointInterval = 0;
+	unsigned char m_AttractionPolygonPointMode = EPSTAPolygonPointMode_Interval;  // enum EPSTAPolygonPointMode
 
 	// Line weights (custom distance values)
 	const float* m_LineWeights = nullptr;
 	unsigned int m_LineWeightCount = 0;
 	float m_WeightPerMeterForPointEdges = 0;
 
+	// Search queue
+	// Radix heap instead of binary heap for the shortest path searches. Gives
+	// the same distances.
+	bool m_UseRadixHeap = false;
+
 	// Progress Callback
 	FPSTAProgressCallback m_ProgressCallback = nullptr;
 	void*                 m_ProgressCallbackUser = nullptr;
@@ -57,7 +57,7 @@ struct SPSTAAttractionReachDesc
 	};
 
 	// Version
-	static const unsigned int VERSION = 1;
+	static const unsigned int VERSION = 3;
 	unsigned int m_Version = VERSION;
 
 	// Graph
@@ -71,6 +71,12 @@ struct SPSTAAttractionReachDesc
 	// Radius
 	SPSTARadii m_Radius;
 
+	// Multiple radii, as alternative to m_Radius. If m_RadiusCount > 0
+	// m_OutScores holds one block of one element per input object for each
+	// radius, in order of m_Radii.
+	const SPSTARadii* m_Radii = nullptr;
+	unsigned int      m_RadiusCount = 0;
+
 	// Weight Function
 	unsigned char m_WeightFunc = EWeightFunc_Constant;  // enum EWeightFunc
 	float m_WeightFuncConstant = 0;
@@ -85,10 +91,13 @@ struct SPSTAAttractionReachDesc
 	// Attraction Polygons (optional)
 	// If not NULL this means m_AttractionPoints should be treated as polygon 
 	// corners, and the actual attraction points will be generated at every
-	// 'm_AttractionPolygonPointInterval' interval along polygon edges.
+	// 'm_AttractionPolygonPointInterval' interval along polygon edges, or at
+	// the polygon's entry points into the network if
+	// 'm_AttractionPolygonPointMode' is EPSTAPolygonPointMode_EntryPoints.
 	unsigned int* m_PointsPerAttractionPolygon = nullptr;  // Polygons will be closed automatically, start/end point should NOT be repeated
 	unsigned int  m_AttractionPolygonCount = 0;
 	float         m_AttractionPolygonPointInterval = 0;
+	unsigned char m_AttractionPolygonPointMode = EPSTAPolygonPointMode_Interval;  // enum EPSTAPolygonPointMode
 
 	// Attraction Values (per polygon if polygons area available, otherwise per point)
 	// If NULL then score 1 is assumed for all.
@@ -105,7 +114,7 @@ struct SPSTAAttractionReachDesc
 	void*                 m_ProgressCallbackUser = nullptr;
 
 	// Output
-	// Pointer to array of one element per input object (specified by m_OriginType)
+	// Pointer to array of one element per input object (specified by m_OriginType) and radius
 	float* m_OutScores = nullptr;
 	unsigned int m_OutputCount = 0;  // For m_OutScores array size verification only
 };
@@ -41,6 +41,12 @@ enum EPSTAOriginType
 	EPSTAOriginType_PointGroups,
 };
 
+enum EPSTAPolygonPointMode
+{
+	EPSTAPolygonPointMode_Interval,     // Points at regular intervals along polygon edges
+	EPSTAPolygonPointMode_EntryPoints,  // Points on polygon edges closest to the network (see CAxialGraph::getRegionEntryPoints)
+};
+
 enum EPSTADistanceType
 {
 	EPSTADistanceType_Straight = 0,
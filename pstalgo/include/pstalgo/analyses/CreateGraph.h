@@ -25,6 +25,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 #include <pstalgo/pstalgo.h>
 #include <pstalgo/Vec2.h>
+#include "Common.h"
 
 
 bool GeneratePointGroupsFromRegions(
@@ -35,6 +36,17 @@ bool GeneratePointGroupsFromRegions(
 	std::vector<unsigned int>& ret_point_group_sizes,
 	std::vector<float2>& ret_points);
 
+class CAxialGraph;
+
+// Same as above but generates the entry points of every region into the
+// network instead of points at regular intervals (see CAxialGraph::getRegionEntryPoints).
+bool GeneratePointGroupsFromRegions(
+	const unsigned int* points_per_region, unsigned int region_count,
+	const double2* region_points, unsigned int point_count,
+	const CAxialGraph& graph,
+	std::vector<unsigned int>& ret_point_group_sizes,
+	std::vector<float2>& ret_points);
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // Axial Graph
@@ -44,7 +56,7 @@ typedef void* HPSTAGraph;
 struct SPSTACreateGraphDesc
 {
 	// Version
-	static const unsigned int VERSION = 1;
+	static const unsigned int VERSION = 2;
 	unsigned int m_Version = VERSION;
 
 	// Lines
@@ -64,10 +76,13 @@ struct SPSTACreateGraphDesc
 	// Polygons (optional)
 	// If not NULL this means m_PointCoords should be treated as polygon 
 	// corners, and the actual points for the graph will be generated at 
-	// every 'm_PolygonPointInterval' interval along polygon edges.
+	// every 'm_PolygonPointInterval' interval along polygon edges, or at
+	// the polygon's entry points into the network if
+	// 'm_PolygonPointMode' is EPSTAPolygonPointMode_EntryPoints.
 	unsigned int* m_PointsPerPolygon = nullptr;  // Polygons will be closed automatically, start/end point should NOT be repeated
 	unsigned int  m_PolygonCount = 0;
 	float         m_PolygonPointInterval = 0;
+	unsigned char m_PolygonPointMode = EPSTAPolygonPointMode_Interval;  // enum EPSTAPolygonPointMode
 
 	// Progress Callback
 	FPSTAProgressCallback m_ProgressCallback = nullptr;
@@ -98,6 +113,13 @@ PSTADllExport int PSTAGetGraphLineLengths(HPSTAGraph handle, float* out_lengths,
 
 PSTADllExport int PSTAGetGraphCrossingCoords(HPSTAGraph handle, double2* out_coords, unsigned int count);
 
+// Creates a contraction hierarchy of walking distances that is kept with the 
+// graph, and used by analyses to speed up walking distance searches without 
+// radius. Takes longer than a single such search, so it only pays off if the 
+// graph is used for several analyses (e.g. attraction distance to several 
+// sets of attractions).
+PSTADllExport bool PSTACreateGraphWalkingHierarchy(HPSTAGraph handle);
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // Segment Graph
@@ -125,6 +147,8 @@ PSTADllExport HPSTASegmentGraph PSTACreateSegmentGraph(const SPSTACreateSegmentG
 
 PSTADllExport void PSTAFreeSegmentGraph(HPSTASegmentGraph handle);
 
+PSTADllExport int PSTAGetSegmentGraphLengths(HPSTASegmentGraph handle, float* out_lengths, unsigned int count);
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // Segment Group Graph
@@ -30,7 +30,7 @@ struct SPSTANetworkIntegrationDesc
 	SPSTANetworkIntegrationDesc();
 
 	// Version
-	static const unsigned int VERSION = 1;
+	static const unsigned int VERSION = 3;
 	unsigned int m_Version;
 
 	// Graph
@@ -39,6 +39,25 @@ struct SPSTANetworkIntegrationDesc
 	// Radius
 	SPSTARadii m_Radius;
 
+	// Multiple radii, as alternative to m_Radius. If m_RadiusCount > 0 the
+	// junction scores and outputs per line hold one block per radius, in
+	// order of m_Radii.
+	const SPSTARadii* m_Radii;
+	unsigned int      m_RadiusCount;
+
+	// Pivot sampling (optional)
+	// If m_PivotCount or m_PivotTargetError is set, line outputs are estimated
+	// from searches from a sample of pivot lines only, scaled by line count
+	// over pivot count. This relies on depth from A to B being the same as from
+	// B to A, which only holds for no radius and angular radius, and the
+	// analysis fails for other radii. Pivots are spread over the map by
+	// drawing them from a grid of cells in proportion to the number of lines
+	// in each. m_PivotTargetError is the largest allowed relative standard
+	// error of any total depth, and is only used if m_PivotCount is 0.
+	unsigned int m_PivotCount;
+	float        m_PivotTargetError;
+	unsigned int m_PivotSeed;
+
 	// Progress Callback
 	FPSTAProgressCallback m_ProgressCallback;
 	void*                 m_ProgressCallbackUser;
@@ -46,12 +65,16 @@ struct SPSTANetworkIntegrationDesc
 	// Output per Junction (optional)
 	double2*     m_OutJunctionCoords;
 	float*       m_OutJunctionScores;
-	unsigned int m_OutJunctionCount;
+	unsigned int m_OutJunctionCount;  // Per radius
 
 	// Output per Line (optional)
 	float*        m_OutLineIntegration;
 	unsigned int* m_OutLineNodeCount;    // Number of reached lines, INCLUDING origin line
 	float*        m_OutLineTotalDepth;
+
+	// Pivot sampling output (optional)
+	float*        m_OutLineTotalDepthVariance;  // Variance of m_OutLineTotalDepth
+	unsigned int* m_OutPivotCount;              // Number of pivots sampled (single value)
 };
 
 float CalculateIntegrationScore(unsigned int N, float TD);
@@ -28,7 +28,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 struct SPSTAODBetweenness
 {
 	// Version
-	static const unsigned int VERSION = 1;
+	static const unsigned int VERSION = 2;
 	unsigned int m_Version = VERSION;
 
 	// Graph
@@ -56,6 +56,12 @@ struct SPSTAODBetweenness
 	// Radius
 	SPSTARadii m_Radius;
 
+	// Search queue
+	// Radix heap instead of binary heap for the shortest path searches. Equally
+	// short paths are settled in the same order with both, so results are the
+	// same.
+	bool m_UseRadixHeap = false;
+
 	// Progress Callback
 	FPSTAProgressCallback m_ProgressCallback = nullptr;
 	void*                 m_ProgressCallbackUser = nullptr;
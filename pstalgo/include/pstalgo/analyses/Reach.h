@@ -28,7 +28,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 struct SPSTAReachDesc
 {
 	// Version
-	static const unsigned int VERSION = 1;
+	static const unsigned int VERSION = 2;
 	unsigned int m_Version = VERSION;
 
 	// Graph
@@ -37,6 +37,12 @@ struct SPSTAReachDesc
 	// Radius
 	SPSTARadii m_Radius;
 
+	// Multiple radii, as alternative to m_Radius. If m_RadiusCount > 0 output
+	// arrays hold one block of one element per origin for each radius, in
+	// order of m_Radii.
+	const SPSTARadii* m_Radii = nullptr;
+	unsigned int      m_RadiusCount = 0;
+
 	// Origin points (optional)
 	double2*     m_OriginCoords = nullptr;
 	unsigned int m_OriginCount = 0;
@@ -46,7 +52,7 @@ struct SPSTAReachDesc
 	void*                 m_ProgressCallbackUser = nullptr;
 
 	// Output
-	// These can either be NULL or pointer to arrays of one element per origin (point or line)
+	// These can either be NULL or pointer to arrays of one element per origin (point or line) and radius
 	unsigned int* m_OutReachedCount  = nullptr;  // Number of reached lines, INCLUDING origin line
 	float*        m_OutReachedLength = nullptr;
 	float*        m_OutReachedArea   = nullptr;  // Square meters
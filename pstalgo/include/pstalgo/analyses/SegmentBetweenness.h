@@ -28,7 +28,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 struct SPSTASegmentBetweennessDesc
 {
 	// Version
-	static const unsigned int VERSION = 1;
+	static const unsigned int VERSION = 3;
 	unsigned int m_Version = VERSION;
 
 	// Graph
@@ -47,6 +47,27 @@ struct SPSTASegmentBetweennessDesc
 	double*      m_AttractionPoints = nullptr;
 	unsigned int m_AttractionPointCount = 0;
 
+	// Approximation (optional)
+	// Betweenness is estimated from origin lines sampled in a random order,
+	// spread over the map in the same way as pivots of angular integration,
+	// scaled by the number of origins (lines with weight, if weights are given)
+	// over the number sampled. Sampling stops when the confidence interval of
+	// every line is within m_TargetError times the highest betweenness, when
+	// m_TimeBudget seconds have passed, or when all origins have been sampled,
+	// which gives the exact result. Without a time budget results are
+	// reproducible for the same seed and number of cores.
+	bool         m_Approximate = false;
+	float        m_TargetError = 0.01f;  // Relative to highest betweenness, 0 for none
+	float        m_TimeBudget = 0;       // Seconds, 0 for none
+	float        m_Confidence = 0.95f;   // Confidence level of m_OutBetweennessError
+	unsigned int m_Seed = 0;
+
+	// Search queue
+	// Radix heap instead of binary heap for the shortest path searches. Equally
+	// short paths are settled in the same order with both, so results are the
+	// same.
+	bool m_UseRadixHeap = false;
+
 	// Progress Callback
 	FPSTAProgressCallback m_ProgressCallback = nullptr;
 	void*                 m_ProgressCallbackUser = nullptr;
@@ -56,6 +77,14 @@ struct SPSTASegmentBetweennessDesc
 	float*        m_OutBetweenness = nullptr;
 	unsigned int* m_OutNodeCount = nullptr;    // Number of reached lines, INCLUDING origin line
 	float*        m_OutTotalDepth = nullptr;
+
+	// Approximation output. Node count and total depth above are only calculated
+	// for lines sampled as origin, and are 0 for others. The confidence interval
+	// is empirical: a normal approximation from the sample variance, with the
+	// variance of lines that few sampled origins contribute to raised to a floor.
+	// It is not a guaranteed bound.
+	float*        m_OutBetweennessError = nullptr;  // Half width of confidence interval of m_OutBetweenness, per line
+	unsigned int* m_OutSampleCount = nullptr;       // Number of origins sampled (single value)
 };
 
 // N = number of nodes, INCLUDING origin node
@@ -0,0 +1,71 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <pstalgo/pstalgo.h>
+#include "Common.h"
+#include "CreateGraph.h"
+
+struct SPSTAShortestPathDesc
+{
+	// Version
+	static const unsigned int VERSION = 1;
+	unsigned int m_Version = VERSION;
+
+	// Graph
+	HPSTAGraph m_Graph = nullptr;  // Created with a call to PSTACreateGraph
+
+	// End points, connected to their closest lines
+	double2 m_Origin;
+	double2 m_Destination;
+
+	// Distance measurement to minimize (walking, steps or angular)
+	unsigned char m_DistanceType = EPSTADistanceType_Walking;  // enum EPSTADistanceType
+};
+
+struct SPSTAShortestPathRes
+{
+	// Version
+	static const unsigned int VERSION = 1;
+	unsigned int m_Version = VERSION;
+
+	// Lines of path, from origin to destination. Zero if no path was found.
+	unsigned int  m_LineCount = 0;
+	unsigned int* m_Lines = nullptr;
+
+	// Points of path in world coordinates: origin, its closest point on first
+	// line, the crossings between lines, closest point on last line to
+	// destination and destination, i.e. m_LineCount + 3 points.
+	unsigned int  m_PointCount = 0;
+	double*       m_PointCoords = nullptr;
+
+	// Distance from origin to each point of path, in all distance types
+	float*        m_WalkingDistances = nullptr;
+	float*        m_AngularDistances = nullptr;
+	unsigned int* m_StepDistances = nullptr;
+};
+
+// Shortest path between two points. Walking distance paths are searched for
+// with A*, using straight line distance to the destination as lower bound.
+// NOTE: The returned handle must be freed with call to PSTAFree(). Output
+// arrays of 'res' point into it.
+PSTADllExport IPSTAlgo* PSTAShortestPath(const SPSTAShortestPathDesc* desc, SPSTAShortestPathRes* res);
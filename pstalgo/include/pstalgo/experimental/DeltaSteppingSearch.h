@@ -0,0 +1,117 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "ShortestPathTraversal.h"
+
+namespace psta
+{
+	// Shortest path search over the primary distance type of a
+	// CDirectedMultiDistanceGraph, where the relaxation of a single search is
+	// shared by all threads (Meyer & Sanders, "Delta-stepping: a parallelizable
+	// shortest path algorithm"). Nodes are kept in buckets of width delta by
+	// tentative distance. All nodes of the lowest non-empty bucket are relaxed in
+	// parallel, again and again until no node of that bucket improves, and then
+	// the search moves on to the next bucket.
+	//
+	// Gives the same distances as TShortestPathTraversal<1>. Meant for analyses
+	// with fewer origins than threads, which can't keep all threads busy by
+	// running one search per thread, but searches without a limit are faster
+	// than TShortestPathTraversal<1> on a single thread too. Every search visits
+	// all nodes on setup though. Threads are started per relaxation round, so
+	// only rounds with large frontiers (millions of graph nodes) are relaxed in
+	// parallel; smaller ones are relaxed on the calling thread.
+	class CDeltaSteppingSearch : public CShortestPathTraversalBase
+	{
+	public:
+		CDeltaSteppingSearch(const graph_t& graph);
+
+		CDeltaSteppingSearch(const CDeltaSteppingSearch&) = delete;
+
+		// visit(destination_index, distance) is called for every reached
+		// destination, in order of destination index, once search is done
+		template <class TVisitor>
+		void Search(size_t origin_index, TVisitor&& visit, const float* limits, float straight_line_distance_limit = std::numeric_limits<float>::infinity())
+		{
+			BeginSearch(origin_index, straight_line_distance_limit);
+			Run(&origin_index, 1, limits[0]);
+			VisitDestinations(visit);
+		}
+
+		// Single search from all origins at once, with distance to the closest
+		// origin (see TShortestPathTraversal<1>::SearchMultiSource)
+		template <class TVisitor>
+		void SearchMultiSource(TVisitor&& visit, const float* limits)
+		{
+			m_StraightLineDistanceLimitSqrd = std::numeric_limits<float>::infinity();
+			Run(nullptr, m_Graph.OriginNodeCount(), limits[0]);
+			VisitDestinations(visit);
+		}
+
+	private:
+		// 'origin_indices' null means all origins
+		void Run(const size_t* origin_indices, size_t origin_count, float limit);
+
+		// Relaxes edges of nodes [begin, end) of m_Frontier, and appends
+		// network nodes that got a shorter distance to 'ret_improved'
+		void RelaxFrontier(size_t begin, size_t end, std::vector<unsigned int>& ret_improved);
+
+		void RelaxEdges(graph_t::HNode node_handle, float distance, std::vector<unsigned int>& ret_improved);
+
+		// Queues improved nodes in their buckets, or in m_Frontier if in current bucket
+		void QueueImproved(const std::vector<unsigned int>& improved);
+
+		inline size_t BucketIndex(float distance) const { return (size_t)(distance / m_Delta); }
+
+		template <class TVisitor>
+		void VisitDestinations(TVisitor& visit)
+		{
+			const size_t network_node_count = m_Graph.NetworkNodeCount();
+			for (size_t i = 0; i < m_Graph.DestinationCount(); ++i)
+			{
+				const float distance = m_Distances[network_node_count + i].load(std::memory_order_relaxed);
+				if (!std::isinf(distance))
+					visit(i, distance);
+			}
+		}
+
+		float m_Delta;
+		float m_Limit;
+
+		// Network nodes first, followed by destinations
+		std::unique_ptr<std::atomic<float>[]> m_Distances;
+
+		// Buckets are reused cyclically, since tentative distances are never more
+		// than the longest edge beyond the current bucket
+		std::vector<std::vector<unsigned int>> m_Buckets;
+		size_t m_CurrentBucket;
+
+		std::vector<unsigned int> m_Frontier;  // Nodes of current bucket to relax
+		std::vector<char> m_InFrontier;
+		std::vector<std::vector<unsigned int>> m_BlockImproved;  // Per block of m_Frontier
+	};
+}
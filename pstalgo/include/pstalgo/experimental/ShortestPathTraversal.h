@@ -21,8 +21,16 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <algorithm>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <queue>
+#include <tuple>
+#include <vector>
+#include <pstalgo/utils/BitVector.h>
+#include <pstalgo/utils/RadixHeap.h>
+#include <pstalgo/utils/RefHeap.h>
 #include "DirectedMultiDistanceGraph.h"
 
 namespace psta
@@ -39,4 +47,430 @@ namespace psta
 	};
 
 	std::unique_ptr<IShortestPathTraversal> CreateShortestPathTraversal(const CDirectedMultiDistanceGraph& graph);
-}
\ No newline at end of file
+
+	// TODO: Move
+	class CVistedFlags
+	{
+	public:
+		CVistedFlags(size_t size)
+			: m_MaxIndexCount(size / 16)
+		{
+			m_Bits.resize(size);
+			m_Bits.clearAll();
+			m_Indices.reserve(m_MaxIndexCount);
+		}
+
+		void clear()
+		{
+			if (m_Indices.size() >= m_MaxIndexCount)
+				m_Bits.clearAll();
+			else for (auto index : m_Indices)
+				m_Bits.clear(index);
+			m_Indices.clear();
+		}
+
+		bool hasVisited(size_t index) const
+		{
+			return m_Bits.get(index);
+		}
+
+		void setVisited(size_t index)
+		{
+			if (m_Indices.size() < m_MaxIndexCount)
+				m_Indices.push_back((unsigned int)index);
+			m_Bits.set(index);
+		}
+
+	private:
+		const size_t m_MaxIndexCount;
+		CBitVector m_Bits;
+		std::vector<unsigned int> m_Indices;
+	};
+
+	class CShortestPathTraversalBase
+	{
+	public:
+		typedef CDirectedMultiDistanceGraph graph_t;
+
+	protected:
+		CShortestPathTraversalBase(const graph_t& graph) : m_Graph(graph) {}
+
+		void BeginSearch(size_t origin_index, float straight_line_distance_limit)
+		{
+			m_StraightLineDistanceLimitSqrd = straight_line_distance_limit;
+			if (m_Graph.NodePositionsEnabled())
+				m_OriginPosition = m_Graph.NodePosition(m_Graph.OriginNode(origin_index));
+		}
+
+		bool HasStraightLineLimit() const
+		{
+			return m_StraightLineDistanceLimitSqrd > 0 && m_StraightLineDistanceLimitSqrd < std::numeric_limits<float>::infinity();
+		}
+
+		bool TestStraightLineLimit(const float2& pos) const
+		{
+			return (pos - m_OriginPosition).getLengthSqr() <= m_StraightLineDistanceLimitSqrd;
+		}
+
+		const CDirectedMultiDistanceGraph& m_Graph;
+		float m_StraightLineDistanceLimitSqrd;
+		float2 m_OriginPosition;
+	};
+
+	// Shortest path search from an origin to all destinations within limits.
+	// 'visit' is called as visit(destination_index, distance) for every reached
+	// destination, with distance of the primary distance type. SearchAccumulative
+	// keeps node distances from previous searches, which means destinations are
+	// only visited if they are closer to this origin than to the previous ones.
+	// If 'use_radix_heap' is set states are queued in a radix heap instead of a
+	// binary heap. Equally short states are settled in the same order with
+	// both, so destinations are visited with the same distances.
+	template <size_t TDistCount>
+	class TShortestPathTraversal : public CShortestPathTraversalBase
+	{
+	public:
+		TShortestPathTraversal(const graph_t& graph, bool use_radix_heap = false)
+			: CShortestPathTraversalBase(graph)
+			, m_UseRadixHeap(use_radix_heap)
+			, m_VisitedNodes(graph.NetworkNodeCount())
+			, m_NodeStates(graph.NetworkNodeCount())
+			, m_VisitedDestinations(graph.DestinationCount())
+		{
+			ASSERT(graph.DistanceTypeCount() == TDistCount);
+		}
+
+		template <class TVisitor>
+		void Search(size_t origin_index, TVisitor&& visit, const float* limits, float straight_line_distance_limit = std::numeric_limits<float>::infinity())
+		{
+			m_VisitedNodes.clear();
+			SearchInternal(origin_index, visit, limits, straight_line_distance_limit);
+		}
+
+		template <class TVisitor>
+		void SearchAccumulative(size_t origin_index, TVisitor&& visit, const float* limits, float straight_line_distance_limit = std::numeric_limits<float>::infinity())
+		{
+			SearchInternal(origin_index, visit, limits, straight_line_distance_limit);
+		}
+
+	private:
+		struct SState
+		{
+			unsigned int   m_NodeIndex;
+			graph_t::HNode m_NodeHandle;
+			float m_Distances[TDistCount];
+
+			inline bool IsDestination() const { return graph_t::INVALID_HANDLE == m_NodeHandle; }
+
+			// Ties of the primary distance are ordered by node and then by the
+			// other distances, which decide what is within their limits
+			inline bool operator<(const SState& rhs) const
+			{
+				if (std::tie(m_Distances[0], m_NodeIndex, m_NodeHandle) != std::tie(rhs.m_Distances[0], rhs.m_NodeIndex, rhs.m_NodeHandle))
+					return std::tie(rhs.m_Distances[0], rhs.m_NodeIndex, rhs.m_NodeHandle) < std::tie(m_Distances[0], m_NodeIndex, m_NodeHandle);
+				return std::lexicographical_compare(rhs.m_Distances + 1, rhs.m_Distances + TDistCount, m_Distances + 1, m_Distances + TDistCount);
+			}
+
+			struct GetKey { inline float operator()(const SState& s) const { return s.m_Distances[0]; } };
+		};
+
+		typedef std::priority_queue<SState> BinaryHeapStateQueue;
+		typedef radix_heap<SState, typename SState::GetKey> RadixHeapStateQueue;
+
+		struct SNodeState
+		{
+			float m_ShortestDistances[TDistCount];
+
+			void Init(const float(&distances)[TDistCount])
+			{
+				for (size_t i = 0; i < TDistCount; ++i)
+					m_ShortestDistances[i] = distances[i];
+			}
+
+			bool HasImprovement(const float(&distances)[TDistCount]) const
+			{
+				for (size_t i = 0; i < TDistCount; ++i)
+					if (distances[i] < m_ShortestDistances[i])
+						return true;
+				return false;
+			}
+
+			bool Update(const float (&distances)[TDistCount])
+			{
+				bool updated = false;
+				for (size_t i = 0; i < TDistCount; ++i)
+				{
+					if (distances[i] >= m_ShortestDistances[i])
+						continue;
+					m_ShortestDistances[i] = distances[i];
+					updated = true;
+				}
+				return updated;
+			}
+		};
+
+		template <class TVisitor>
+		void SearchInternal(size_t origin_index, TVisitor& visit, const float* limits, float straight_line_distance_limit)
+		{
+			m_VisitedDestinations.clear();
+
+			for (size_t i = 0; i < TDistCount; ++i)
+				m_Limits[i] = limits[i];
+			BeginSearch(origin_index, straight_line_distance_limit);
+
+			SState s;
+			s.m_NodeIndex = (unsigned int)m_Graph.OriginNodeIndex(origin_index);
+			s.m_NodeHandle = m_Graph.NodeHandleFromIndex(s.m_NodeIndex);
+			for (auto& d : s.m_Distances)
+				d = 0;
+			TraverseEdges(s);
+
+			while (!IsQueueEmpty())
+			{
+				const auto s = PopState();
+				if (!s.IsDestination())
+					VisitNetworkNode(s);
+				else if (!m_VisitedDestinations.hasVisited(s.m_NodeIndex))
+				{
+					m_VisitedDestinations.setVisited(s.m_NodeIndex);
+					visit((size_t)s.m_NodeIndex, s.m_Distances[0]);
+				}
+			}
+		}
+
+		void TraverseEdges(const SState& s)
+		{
+			auto& node = m_Graph.Node(s.m_NodeHandle);
+			m_Graph.ForEachEdge(node, [&](const graph_t::SEdge& e)
+			{
+				SState new_state;
+				size_t i;
+				for (i = 0; i < TDistCount; ++i)
+				{
+					new_state.m_Distances[i] = s.m_Distances[i] + m_Graph.EdgeDistance(e, (unsigned int)i);
+					if (new_state.m_Distances[i] > m_Limits[i])
+						break;
+				}
+				if (i < TDistCount)
+					return;
+				if (m_Graph.EdgePointsToDestination(e))
+				{
+					if (m_VisitedDestinations.hasVisited(e.TargetIndex()))
+						return;
+				}
+				else if (m_VisitedNodes.hasVisited(e.TargetIndex()) && !m_NodeStates[e.TargetIndex()].HasImprovement(s.m_Distances))
+					return;
+				if (HasStraightLineLimit() && !TestStraightLineLimit(m_Graph.TargetPosition(e)))
+					return;
+				new_state.m_NodeIndex  = e.TargetIndex();
+				new_state.m_NodeHandle = e.TargetHandle();
+				if (m_UseRadixHeap)
+					m_RadixHeapQueue.push(new_state);
+				else
+					m_BinaryHeapQueue.push(new_state);
+			});
+		}
+
+		bool IsQueueEmpty() const
+		{
+			return m_UseRadixHeap ? m_RadixHeapQueue.empty() : m_BinaryHeapQueue.empty();
+		}
+
+		SState PopState()
+		{
+			if (m_UseRadixHeap)
+			{
+				const SState s = m_RadixHeapQueue.top();
+				m_RadixHeapQueue.pop();
+				return s;
+			}
+			const SState s = m_BinaryHeapQueue.top();
+			m_BinaryHeapQueue.pop();
+			return s;
+		}
+
+		void VisitNetworkNode(const SState& s)
+		{
+			if (!m_VisitedNodes.hasVisited(s.m_NodeIndex))
+			{
+				m_VisitedNodes.setVisited(s.m_NodeIndex);
+				m_NodeStates[s.m_NodeIndex].Init(s.m_Distances);
+			}
+			else if (!m_NodeStates[s.m_NodeIndex].Update(s.m_Distances))
+				return;
+			TraverseEdges(s);
+		}
+
+		float m_Limits[TDistCount];
+		const bool m_UseRadixHeap;
+		BinaryHeapStateQueue m_BinaryHeapQueue;
+		RadixHeapStateQueue m_RadixHeapQueue;
+		std::vector<SNodeState> m_NodeStates;
+		CVistedFlags m_VisitedNodes;
+		CVistedFlags m_VisitedDestinations;
+	};
+
+	// With a single distance type every node and destination has one tentative
+	// distance, so instead of queueing a new state for every improvement we keep
+	// one heap item per node and decrease its key in place (plain Dijkstra).
+	// The radix heap can't decrease keys, so with it a new item is queued for
+	// every improvement instead, and outdated items are skipped when popped.
+	template <>
+	class TShortestPathTraversal<1> : public CShortestPathTraversalBase
+	{
+	public:
+		TShortestPathTraversal(const graph_t& graph, bool use_radix_heap = false)
+			: CShortestPathTraversalBase(graph)
+			, m_UseRadixHeap(use_radix_heap)
+			, m_NetworkNodeCount((unsigned int)graph.NetworkNodeCount())
+			, m_Distances(graph.NetworkNodeCount() + graph.DestinationCount())
+			, m_HeapIndices(graph.NetworkNodeCount() + graph.DestinationCount(), INVALID_HEAP_INDEX)
+			, m_Heap(SUpdateHeapIndex{ m_HeapIndices.data() })
+			, m_VisitedNodes(graph.NetworkNodeCount())
+			, m_VisitedDestinations(graph.DestinationCount())
+		{
+			ASSERT(graph.DistanceTypeCount() == 1);
+		}
+
+		TShortestPathTraversal(const TShortestPathTraversal&) = delete;
+
+		template <class TVisitor>
+		void Search(size_t origin_index, TVisitor&& visit, const float* limits, float straight_line_distance_limit = std::numeric_limits<float>::infinity())
+		{
+			m_VisitedNodes.clear();
+			SearchInternal(origin_index, visit, limits, straight_line_distance_limit);
+		}
+
+		template <class TVisitor>
+		void SearchAccumulative(size_t origin_index, TVisitor&& visit, const float* limits, float straight_line_distance_limit = std::numeric_limits<float>::infinity())
+		{
+			SearchInternal(origin_index, visit, limits, straight_line_distance_limit);
+		}
+
+		// Single search from all origins at once. Gives the same distances as
+		// SearchAccumulative from every origin in turn, but every node and
+		// destination is settled only once, with its distance to the closest
+		// origin.
+		template <class TVisitor>
+		void SearchMultiSource(TVisitor&& visit, const float* limits)
+		{
+			m_VisitedNodes.clear();
+			m_VisitedDestinations.clear();
+
+			m_Limit = limits[0];
+			m_StraightLineDistanceLimitSqrd = std::numeric_limits<float>::infinity();
+
+			for (size_t origin_index = 0; origin_index < m_Graph.OriginNodeCount(); ++origin_index)
+				TraverseEdges(m_Graph.NodeHandleFromIndex(m_Graph.OriginNodeIndex(origin_index)), 0);
+
+			Traverse(visit);
+		}
+
+	private:
+		static const unsigned int INVALID_HEAP_INDEX = (unsigned int)-1;
+
+		// Items are indexed with network nodes first, followed by destinations.
+		// Ties are settled in order of index.
+		struct SHeapItem
+		{
+			float        m_Distance;
+			unsigned int m_Index;
+
+			inline bool operator<(const SHeapItem& rhs) const { return std::tie(m_Distance, m_Index) < std::tie(rhs.m_Distance, rhs.m_Index); }
+
+			// Order of std::priority_queue, which pops the greatest item first
+			struct Greater { inline bool operator()(const SHeapItem& a, const SHeapItem& b) const { return b < a; } };
+			struct GetKey { inline float operator()(const SHeapItem& item) const { return item.m_Distance; } };
+		};
+
+		struct SUpdateHeapIndex
+		{
+			unsigned int* m_HeapIndices;
+			inline void operator()(const SHeapItem& item, size_t heap_index) const { m_HeapIndices[item.m_Index] = (unsigned int)heap_index; }
+		};
+
+		template <class TVisitor>
+		void SearchInternal(size_t origin_index, TVisitor& visit, const float* limits, float straight_line_distance_limit)
+		{
+			m_VisitedDestinations.clear();
+
+			m_Limit = limits[0];
+			BeginSearch(origin_index, straight_line_distance_limit);
+
+			TraverseEdges(m_Graph.NodeHandleFromIndex(m_Graph.OriginNodeIndex(origin_index)), 0);
+
+			Traverse(visit);
+		}
+
+		template <class TVisitor>
+		void Traverse(TVisitor& visit)
+		{
+			SHeapItem item;
+			while (PopItem(item))
+			{
+				if (item.m_Index < m_NetworkNodeCount)
+					TraverseEdges(m_Graph.NodeHandleFromIndex(item.m_Index), item.m_Distance);
+				else
+					visit((size_t)(item.m_Index - m_NetworkNodeCount), item.m_Distance);
+			}
+		}
+
+		void TraverseEdges(graph_t::HNode node_handle, float distance)
+		{
+			auto& node = m_Graph.Node(node_handle);
+			m_Graph.ForEachEdge(node, [&](const graph_t::SEdge& e)
+			{
+				const float new_distance = distance + m_Graph.EdgePrimaryDistance(e);
+				if (new_distance > m_Limit)
+					return;
+				const bool to_destination = m_Graph.EdgePointsToDestination(e);
+				auto& visited = to_destination ? m_VisitedDestinations : m_VisitedNodes;
+				const unsigned int index = to_destination ? m_NetworkNodeCount + e.TargetIndex() : e.TargetIndex();
+				const bool has_visited = visited.hasVisited(e.TargetIndex());
+				if (has_visited && !(new_distance < m_Distances[index]))
+					return;
+				if (HasStraightLineLimit() && !TestStraightLineLimit(m_Graph.TargetPosition(e)))
+					return;
+				if (!has_visited)
+					visited.setVisited(e.TargetIndex());
+				m_Distances[index] = new_distance;
+				const SHeapItem item = { new_distance, index };
+				if (m_UseRadixHeap)
+					m_RadixHeap.push(item);
+				else if (INVALID_HEAP_INDEX == m_HeapIndices[index])
+					m_Heap.push(item);
+				else
+					m_Heap.decrease(m_HeapIndices[index], item);
+			});
+		}
+
+		bool PopItem(SHeapItem& ret_item)
+		{
+			if (!m_UseRadixHeap)
+			{
+				if (m_Heap.empty())
+					return false;
+				ret_item = m_Heap.top();
+				m_Heap.pop();
+				return true;
+			}
+			while (!m_RadixHeap.empty())
+			{
+				ret_item = m_RadixHeap.top();
+				m_RadixHeap.pop();
+				if (!(ret_item.m_Distance > m_Distances[ret_item.m_Index]))
+					return true;
+			}
+			return false;
+		}
+
+		const bool m_UseRadixHeap;
+		const unsigned int m_NetworkNodeCount;
+		float m_Limit;
+		std::vector<float> m_Distances;
+		std::vector<unsigned int> m_HeapIndices;
+		CRefHeap<SHeapItem, SUpdateHeapIndex, 4> m_Heap;
+		radix_heap<SHeapItem, SHeapItem::GetKey, SHeapItem::Greater> m_RadixHeap;
+		CVistedFlags m_VisitedNodes;
+		CVistedFlags m_VisitedDestinations;
+	};
+}
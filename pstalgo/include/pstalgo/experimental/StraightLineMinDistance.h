@@ -33,27 +33,26 @@ namespace psta
 		const auto radius_sqrd = radius * radius;
 		if (radius < std::numeric_limits<float>::infinity())
 		{
-			// Create origin point tree
-			std::vector<unsigned int> origin_tree_order(ret_min_dist_per_origin.size());
-			auto origin_tree = CPointAABSPTree::Create(origin_pts, origin_tree_order);
+			// Create destination point tree
+			std::vector<unsigned int> dest_tree_order(dest_pts.size());
+			auto dest_tree = CPointAABSPTree::Create(dest_pts, dest_tree_order);
+			std::vector<float2> ordered_dest_pts(dest_pts.size());
+			enumerate(dest_pts, [&](size_t dest_idx, const float2& dest_pt)
+			{
+				ordered_dest_pts[dest_tree_order[dest_idx]] = dest_pt;
+			});
 			// Clear results
 			std::fill(ret_min_dist_per_origin.begin(), ret_min_dist_per_origin.end(), std::numeric_limits<float>::infinity());
-			// Find minimum squared distance for each origin
-			std::vector<CAABSPTree::SObjectSet> origin_point_sets;
-			enumerate(dest_pts, [&](size_t dest_idx, const float2& dest_pt)
+			// Find minimum squared distance for each origin (origins are processed concurrently)
+			dest_tree.TBatchForEachCellInSphere(origin_pts, radius, [&](unsigned int origin_idx, unsigned int first_dest, unsigned int dest_count)
 			{
-				origin_tree.TestSphere(dest_pt, radius, origin_point_sets);
-				for (const auto& point_set : origin_point_sets)
+				const float2 origin_pt = origin_pts[origin_idx];
+				auto& result = ret_min_dist_per_origin[origin_idx];
+				for (unsigned int i = first_dest; i < first_dest + dest_count; ++i)
 				{
-					for (size_t pt_idx = 0; pt_idx < point_set.m_Count; ++pt_idx)
-					{
-						const auto origin_idx = origin_tree_order[point_set.m_FirstObject + pt_idx];
-						const auto& origin_pt = origin_pts[origin_idx];
-						const auto dist_sqrd = (dest_pt - origin_pt).getLengthSqr();
-						auto& result = ret_min_dist_per_origin[origin_idx];
-						if (dist_sqrd <= radius_sqrd)
-							result = std::min(result, dist_sqrd);
-					}
+					const auto dist_sqrd = (ordered_dest_pts[i] - origin_pt).getLengthSqr();
+					if (dist_sqrd <= radius_sqrd)
+						result = std::min(result, dist_sqrd);
 				}
 			});
 			// Square root results
@@ -21,8 +21,13 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <vector>
+#include <pstalgo/geometry/Geometry.h>
 #include <pstalgo/geometry/Rect.h>
+#include <pstalgo/utils/Concurrency.h>
 #include <pstalgo/utils/Macros.h>
 #include <pstalgo/Vec2.h>
 #include <pstalgo/experimental/ArrayView.h>
@@ -45,14 +50,52 @@ public:
 
 	const CRectf& GetBB() const { return m_BB; }
 
-	void TestSphere(const float2& center, float radius, std::vector<SObjectSet>& ret_sets);
+	void TestSphere(const float2& center, float radius, std::vector<SObjectSet>& ret_sets) const;
 
-	void TestCapsule(const float2& p0, const float2 p1, float radius, std::vector<SObjectSet>& ret_sets);
+	void TestCapsule(const float2& p0, const float2 p1, float radius, std::vector<SObjectSet>& ret_sets) const;
+
+	// Calls fn(first_object, object_count) for every cell overlapping the
+	// sphere/capsule, as the cells are found.
+	template <class TFunc>
+	void TForEachCellInSphere(const float2& center, float radius, TFunc&& fn) const;
+
+	template <class TFunc>
+	void TForEachCellInCapsule(const float2& p0, const float2& p1, float radius, TFunc&& fn) const;
+
+	// Batched queries. Calls fn(query_index, first_object, object_count) for
+	// every cell overlapping each query. Queries are processed concurrently,
+	// in Z-order of their position so that consecutive queries touch the same
+	// parts of the tree. All cells of a query are visited by the same thread,
+	// but 'fn' must be safe to call concurrently for different queries.
+	template <class TPointCollection, class TFunc>
+	void TBatchForEachCellInSphere(const TPointCollection& centers, float radius, TFunc&& fn) const;
+
+	template <class TFunc>
+	void TBatchForEachCellInCapsule(const float2* line_points, unsigned int count, float radius, TFunc&& fn) const;
+
+	// Best-first traversal. Calls fn(first_object, object_count, cell_dist_sq)
+	// for cells in order of increasing squared distance from 'pt' to the cell.
+	// 'fn' returns the squared distance beyond which no more cells are wanted
+	// (e.g. distance to the k:th closest object found so far), and the
+	// traversal stops as soon as the next cell is farther away than that.
+	template <class TFunc>
+	void TForEachCellNearestFirst(const float2& pt, TFunc&& fn) const;
 
 protected:
-	void TestSphere(const CRectf& bb, const float2& center, float radius, unsigned int node_index, std::vector<SObjectSet>& ret_sets);
+	template <class TFunc>
+	void TForEachCellInSphere(const CRectf& bb, const float2& center, float radius, unsigned int node_index, TFunc& fn) const;
+
+	template <class TFunc>
+	void TForEachCellInCapsule(const CRectf& bb, const float2& p0, const float2& p1, float radius, unsigned int node_index, TFunc& fn) const;
+
+	template <class TGetPoint>
+	void ZOrder(unsigned int count, TGetPoint&& get_point, std::vector<unsigned int>& ret_order) const;
+
+	// Number of tree levels to build concurrently for 'count' objects
+	static unsigned int ParallelBuildDepth(size_t count);
 
-	void TestCapsule(const CRectf& bb, const float2& p0, const float2 p1, float radius, unsigned int node_index, std::vector<SObjectSet>& ret_sets);
+	// Sub trees with fewer objects than this are built on a single thread
+	static const unsigned int MIN_PARALLEL_BUILD_COUNT = 0x1000;
 
 	struct SNode
 	{
@@ -80,6 +123,15 @@ protected:
 		
 		inline unsigned int GetFirstObject() const { return m_FirstObject; }
 		inline unsigned int GetObjectCount() const { return m_ObjectCount & 0x3FFFFFFF; }
+
+		// Used when moving a sub tree that was built separately into place
+		void Offset(unsigned int node_offset, unsigned int object_offset)
+		{
+			if (IsCell())
+				m_FirstObject += object_offset;
+			else
+				m_RightNode += node_offset;
+		}
 		
 	private:
 		ALLOW_NAMELESS_STRUCT_BEGIN
@@ -99,10 +151,295 @@ protected:
 		ALLOW_NAMELESS_STRUCT_END
 	};
 
+	// Appends the nodes of a separately built sub tree
+	void AppendSubTree(const std::vector<SNode>& nodes, unsigned int object_offset);
+
 	CRectf m_BB;
 	std::vector<SNode> m_Nodes;
 };
 
+template <class TFunc>
+void CAABSPTree::TForEachCellInSphere(const float2& center, float radius, TFunc&& fn) const
+{
+	const float2 bb_center(m_BB.CenterX(), m_BB.CenterY());
+	const float2 bb_half_size(.5f * m_BB.Width(), .5f * m_BB.Height());
+
+	if (m_Nodes.empty() || !TestAABBCircleOverlap(bb_half_size, center - bb_center, radius))
+		return;
+
+	TForEachCellInSphere(m_BB, center, radius, 0, fn);
+}
+
+template <class TFunc>
+void CAABSPTree::TForEachCellInCapsule(const float2& p0, const float2& p1, float radius, TFunc&& fn) const
+{
+	if (m_Nodes.empty() || !TestAABBCapsuleOverlap(m_BB, p0, p1, radius))
+		return;
+
+	TForEachCellInCapsule(m_BB, p0, p1, radius, 0, fn);
+}
+
+template <class TPointCollection, class TFunc>
+void CAABSPTree::TBatchForEachCellInSphere(const TPointCollection& centers, float radius, TFunc&& fn) const
+{
+	const unsigned int BLOCK_SIZE = 64;
+
+	std::vector<unsigned int> order;
+	ZOrder((unsigned int)centers.size(), [&](unsigned int i) { return centers[i]; }, order);
+
+	psta::parallel_for_blocks((unsigned int)order.size(), BLOCK_SIZE, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			const unsigned int query_index = order[i];
+			TForEachCellInSphere(centers[query_index], radius, [&](unsigned int first_object, unsigned int object_count)
+			{
+				fn(query_index, first_object, object_count);
+			});
+		}
+	});
+}
+
+template <class TFunc>
+void CAABSPTree::TBatchForEachCellInCapsule(const float2* line_points, unsigned int count, float radius, TFunc&& fn) const
+{
+	const unsigned int BLOCK_SIZE = 64;
+
+	std::vector<unsigned int> order;
+	ZOrder(count, [&](unsigned int i) { return (line_points[i * 2] + line_points[i * 2 + 1]) * .5f; }, order);
+
+	psta::parallel_for_blocks(count, BLOCK_SIZE, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			const unsigned int query_index = order[i];
+			TForEachCellInCapsule(line_points[query_index * 2], line_points[query_index * 2 + 1], radius, [&](unsigned int first_object, unsigned int object_count)
+			{
+				fn(query_index, first_object, object_count);
+			});
+		}
+	});
+}
+
+template <class TFunc>
+void CAABSPTree::TForEachCellNearestFirst(const float2& pt, TFunc&& fn) const
+{
+	struct SQueueItem
+	{
+		float        m_DistSq;
+		unsigned int m_NodeIndex;
+		CRectf       m_BB;
+		inline bool operator<(const SQueueItem& rhs) const { return m_DistSq > rhs.m_DistSq; }  // Closest on top of heap
+	};
+
+	if (m_Nodes.empty())
+		return;
+
+	auto dist_sq_to_bb = [&](const CRectf& bb) -> float
+	{
+		const float dx = std::max(std::max(bb.m_Left - pt.x, pt.x - bb.m_Right), 0.f);
+		const float dy = std::max(std::max(bb.m_Top - pt.y, pt.y - bb.m_Bottom), 0.f);
+		return dx * dx + dy * dy;
+	};
+
+	float max_dist_sq = std::numeric_limits<float>::infinity();
+
+	std::vector<SQueueItem> queue;
+	queue.reserve(32);
+	queue.push_back({ dist_sq_to_bb(m_BB), 0, m_BB });
+
+	while (!queue.empty())
+	{
+		std::pop_heap(queue.begin(), queue.end());
+		SQueueItem item = queue.back();
+		queue.pop_back();
+
+		if (item.m_DistSq > max_dist_sq)
+			break;
+
+		// Descend into the closest child and queue the other one. Distance to a
+		// node equals distance to its closest child, so the order is preserved.
+		for (;;)
+		{
+			const auto& node = m_Nodes[item.m_NodeIndex];
+
+			if (node.IsCell())
+			{
+				max_dist_sq = fn(node.GetFirstObject(), node.GetObjectCount(), item.m_DistSq);
+				break;
+			}
+
+			const unsigned char split_axis = node.GetSplitAxis();
+			SQueueItem children[2] = { { 0, item.m_NodeIndex + 1, item.m_BB }, { 0, node.GetRightNode(), item.m_BB } };
+			(&children[0].m_BB.m_Right)[split_axis] = node.GetSplitAt();
+			(&children[1].m_BB.m_Left)[split_axis] = node.GetSplitAt();
+			children[0].m_DistSq = dist_sq_to_bb(children[0].m_BB);
+			children[1].m_DistSq = dist_sq_to_bb(children[1].m_BB);
+
+			const unsigned char closest = (children[1].m_DistSq < children[0].m_DistSq) ? 1 : 0;
+			const auto& other = children[closest ^ 1];
+			if (other.m_DistSq <= max_dist_sq)
+			{
+				queue.push_back(other);
+				std::push_heap(queue.begin(), queue.end());
+			}
+
+			item = children[closest];
+		}
+	}
+}
+
+template <class TFunc>
+void CAABSPTree::TForEachCellInSphere(const CRectf& bb, const float2& center, float radius, unsigned int node_index, TFunc& fn) const
+{
+	using namespace std;
+
+	const auto& node = m_Nodes[node_index];
+
+	if (node.IsCell())
+	{
+		fn(node.GetFirstObject(), node.GetObjectCount());
+		return;
+	}
+
+	const unsigned char split_axis = node.GetSplitAxis();
+	const float2* bb_pts = (const float2*)&bb;
+	const float split_pos = node.GetSplitAt();
+
+	const float d = center[split_axis] - split_pos;
+
+	unsigned char child_bits = (d < 0) ? 1 : 2;
+
+	if (abs(d) < radius)
+	{
+		const unsigned char non_split_axis = split_axis ^ 1;
+		const float bb_half_size = .5f * (bb_pts[1][non_split_axis] - bb_pts[0][non_split_axis]);
+		const float d2 = abs(center[non_split_axis] - bb_pts[0][non_split_axis] - bb_half_size);
+		if (d2 <= bb_half_size || sqr(d2 - bb_half_size) + sqr(d) <= sqr(radius))
+			child_bits = 3;
+	}
+
+	if (child_bits & 1)
+	{
+		CRectf bb_child(bb);
+		(&bb_child.m_Right)[split_axis] = split_pos;
+		TForEachCellInSphere(bb_child, center, radius, node_index + 1, fn);
+	}
+
+	if (child_bits & 2)
+	{
+		CRectf bb_child(bb);
+		(&bb_child.m_Left)[split_axis] = split_pos;
+		TForEachCellInSphere(bb_child, center, radius, node.GetRightNode(), fn);
+	}
+}
+
+template <class TFunc>
+void CAABSPTree::TForEachCellInCapsule(const CRectf& bb, const float2& p0, const float2& p1, float radius, unsigned int node_index, TFunc& fn) const
+{
+	using namespace std;
+
+	const auto& node = m_Nodes[node_index];
+
+	if (node.IsCell())
+	{
+		fn(node.GetFirstObject(), node.GetObjectCount());
+		return;
+	}
+
+	const unsigned char split_axis = node.GetSplitAxis();
+	const float split_pos = node.GetSplitAt();
+
+	const float d0 = p0[split_axis] - split_pos;
+	const float d1 = p1[split_axis] - split_pos;
+	const float ad0 = abs(d0);
+	const float ad1 = abs(d1);
+
+	unsigned char child_bits = 0;
+
+	if (d0*d1 >= 0)
+	{
+		// End-points are on same side of splitter
+		child_bits = (d0 < 0) ? 1 : 2;
+
+		if (ad0 > radius && ad1 > radius)
+			goto done; // The whole capsule is on one side of the splitter
+
+		if (ad0 <= radius && ad1 <= radius)
+		{
+			child_bits = 3;
+			goto done;
+		}
+	}
+
+	if (!(child_bits & 1))
+	{
+		CRectf bb_child(bb);
+		(&bb_child.m_Right)[split_axis] = split_pos;
+		if (TestAABBCapsuleOverlap(bb_child, p0, p1, radius))
+			child_bits |= 1;
+	}
+
+	if (!(child_bits & 2))
+	{
+		CRectf bb_child(bb);
+		(&bb_child.m_Left)[split_axis] = split_pos;
+		if (TestAABBCapsuleOverlap(bb_child, p0, p1, radius))
+			child_bits |= 2;
+	}
+
+done:
+
+	if (child_bits & 1)
+	{
+		CRectf bb_child(bb);
+		(&bb_child.m_Right)[split_axis] = split_pos;
+		TForEachCellInCapsule(bb_child, p0, p1, radius, node_index + 1, fn);
+	}
+
+	if (child_bits & 2)
+	{
+		CRectf bb_child(bb);
+		(&bb_child.m_Left)[split_axis] = split_pos;
+		TForEachCellInCapsule(bb_child, p0, p1, radius, node.GetRightNode(), fn);
+	}
+}
+
+template <class TGetPoint>
+void CAABSPTree::ZOrder(unsigned int count, TGetPoint&& get_point, std::vector<unsigned int>& ret_order) const
+{
+	// Spreads the lower 16 bits of 'v' out to the even bits
+	auto spread_bits = [](uint32_t v) -> uint32_t
+	{
+		v &= 0xFFFF;
+		v = (v | (v << 8)) & 0x00FF00FF;
+		v = (v | (v << 4)) & 0x0F0F0F0F;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	};
+
+	const float scale_x = (m_BB.Width()  > 0) ? 0xFFFF / m_BB.Width()  : 0;
+	const float scale_y = (m_BB.Height() > 0) ? 0xFFFF / m_BB.Height() : 0;
+
+	std::vector<uint64_t> keys(count);
+	psta::parallel_for_blocks(count, 0x1000u, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			const float2 pt = get_point(i);
+			const uint32_t x = (uint32_t)clamp((pt.x - m_BB.m_Left) * scale_x, 0.f, (float)0xFFFF);
+			const uint32_t y = (uint32_t)clamp((pt.y - m_BB.m_Top) * scale_y, 0.f, (float)0xFFFF);
+			keys[i] = ((uint64_t)(spread_bits(x) | (spread_bits(y) << 1)) << 32) | i;
+		}
+	});
+	psta::parallel_sort(keys.data(), keys.data() + keys.size(), std::less<uint64_t>());
+
+	ret_order.resize(count);
+	for (unsigned int i = 0; i < count; ++i)
+		ret_order[i] = (unsigned int)keys[i];
+}
+
 
 class CPointAABSPTree : public CAABSPTree
 {
@@ -117,6 +454,18 @@ public:
 	template <class TPointCollection, class TOrderCollection>
 	inline static CPointAABSPTree Create(const TPointCollection& points, TOrderCollection& ret_order, unsigned int max_points_per_cell = 16);
 
+	// Calls fn(object_index) for every point in cells overlapping the sphere.
+	// 'object_index' is the index of the point in tree order (see Create).
+	template <class TFunc>
+	void TForEachPointInSphere(const float2& center, float radius, TFunc&& fn) const
+	{
+		TForEachCellInSphere(center, radius, [&](unsigned int first_object, unsigned int object_count)
+		{
+			for (unsigned int o = first_object; o < first_object + object_count; ++o)
+				fn(o);
+		});
+	}
+
 protected:
 	struct SPointAndIndex
 	{
@@ -124,7 +473,7 @@ protected:
 		unsigned int m_Index;
 	};
 
-	void CreateSubTree(const CRectf& bb, SPointAndIndex* points_by_x, SPointAndIndex* points_by_y, SPointAndIndex* points_tmp, unsigned int count, unsigned int max_points_per_cell, unsigned int start_index, unsigned int* ret_order);
+	void CreateSubTree(const CRectf& bb, SPointAndIndex* points_by_x, SPointAndIndex* points_by_y, SPointAndIndex* points_tmp, unsigned int count, unsigned int max_points_per_cell, unsigned int start_index, unsigned int* ret_order, unsigned int parallel_depth);
 
 	void MakeCell(const SPointAndIndex* points_by_x, unsigned int count, unsigned int start_index, unsigned int* ret_order);
 };
@@ -156,7 +505,7 @@ inline CPointAABSPTree CPointAABSPTree::Create(const TPointCollection& points, T
 	std::sort(points_by_y.begin(), points_by_y.end(), [&](const SPointAndIndex& a, const SPointAndIndex& b) -> bool { return a.m_Point.y < b.m_Point.y; });
 
 	std::vector<SPointAndIndex> points_tmp(points.size());
-	tree.CreateSubTree(tree.m_BB, points_by_x.data(), points_by_y.data(), points_tmp.data(), points.size(), max_points_per_cell, 0, ret_order.data());
+	tree.CreateSubTree(tree.m_BB, points_by_x.data(), points_by_y.data(), points_tmp.data(), points.size(), max_points_per_cell, 0, ret_order.data(), ParallelBuildDepth(points.size()));
 
 	return tree;
 }
@@ -183,8 +532,36 @@ public:
 
 	const unsigned int GetLineIndex(unsigned int index) const { return m_Lines[index]; }
 
+	// Number of line references in cells (lines spanning several cells are referenced once per cell)
+	unsigned int GetObjectCount() const { return (unsigned int)m_Lines.size(); }
+
+	// Calls fn(line_index) for every line in cells overlapping the sphere/capsule.
+	// NOTE: fn might be called multiple times for the same line, if it spans several cells.
+	template <class TFunc>
+	void TForEachLineInSphere(const float2& center, float radius, TFunc&& fn) const
+	{
+		TForEachCellInSphere(center, radius, [&](unsigned int first_object, unsigned int object_count)
+		{
+			for (unsigned int o = first_object; o < first_object + object_count; ++o)
+				fn(m_Lines[o]);
+		});
+	}
+
+	template <class TFunc>
+	void TForEachLineInCapsule(const float2& p0, const float2& p1, float radius, TFunc&& fn) const
+	{
+		TForEachCellInCapsule(p0, p1, radius, [&](unsigned int first_object, unsigned int object_count)
+		{
+			for (unsigned int o = first_object; o < first_object + object_count; ++o)
+				fn(m_Lines[o]);
+		});
+	}
+
 protected:
-	void CreateSubTree(const CRectf& bb, std::vector<SLineAndIndex>& lines_tmp, unsigned int count, unsigned int max_lines_per_cell, unsigned int max_depth);
+	void CreateSubTree(const CRectf& bb, std::vector<SLineAndIndex>& lines_tmp, unsigned int count, unsigned int max_lines_per_cell, unsigned int max_depth, unsigned int parallel_depth);
+
+	// Appends the pieces of lines_tmp[first, first + count) that are on 'child' side of the split to 'ret_lines' (which can be 'lines_tmp')
+	static void SplitLines(std::vector<SLineAndIndex>& lines_tmp, unsigned int first, unsigned int count, unsigned char split_axis, float split_pos, unsigned char child, std::vector<SLineAndIndex>& ret_lines);
 
 	void MakeCell(const SLineAndIndex* lines, unsigned int count);
 
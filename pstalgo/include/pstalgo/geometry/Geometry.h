@@ -91,4 +91,49 @@ inline bool TestLineSegmentsIntersection(const TVec2<T>& a0, const TVec2<T>& a1,
 		return false;
 	const auto bV = b1 - b0;
 	return crp(bV, a0 - b0) * crp(bV, a1 - b0) <= 0;
-}
\ No newline at end of file
+}
+template <class T>
+inline TVec2<T> ClosestPointOnLineSegment(const TVec2<T>& pt, const TVec2<T>& l0, const TVec2<T>& l1)
+{
+	const auto v = l1 - l0;
+	const T len_sqrd = v.getLengthSqr();
+	if (len_sqrd <= 0)
+		return l0;
+	const T t = dot(pt - l0, v) / len_sqrd;
+	if (t <= 0)
+		return l0;
+	if (t >= 1)
+		return l1;
+	return l0 + v * t;
+}
+
+// Returns the point on line segment a0-a1 that is closest to line segment b0-b1
+template <class T>
+inline TVec2<T> ClosestPointOnLineSegmentToLineSegment(const TVec2<T>& a0, const TVec2<T>& a1, const TVec2<T>& b0, const TVec2<T>& b1)
+{
+	const auto aV = a1 - a0;
+	const auto bV = b1 - b0;
+	const T denom = crp(aV, bV);
+	if (denom != 0 && TestLineSegmentsIntersection(a0, a1, b0, b1))
+	{
+		const T t = crp(b0 - a0, bV) / denom;
+		return a0 + aV * clamp(t, (T)0, (T)1);
+	}
+
+	// Segments don't cross (or are parallel), closest distance is at one of the end points
+	TVec2<T> best_pt = a0;
+	T best_dist_sqrd = (ClosestPointOnLineSegment(a0, b0, b1) - a0).getLengthSqr();
+	auto test = [&](const TVec2<T>& pt_on_a, const TVec2<T>& pt_on_b)
+	{
+		const T dist_sqrd = (pt_on_b - pt_on_a).getLengthSqr();
+		if (dist_sqrd < best_dist_sqrd)
+		{
+			best_dist_sqrd = dist_sqrd;
+			best_pt = pt_on_a;
+		}
+	};
+	test(a1, ClosestPointOnLineSegment(a1, b0, b1));
+	test(ClosestPointOnLineSegment(b0, a0, a1), b0);
+	test(ClosestPointOnLineSegment(b1, a0, a1), b1);
+	return best_pt;
+}
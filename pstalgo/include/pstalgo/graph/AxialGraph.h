@@ -24,8 +24,9 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 #include <memory>
 #include <vector>
 #include <pstalgo/maths.h>
+#include <pstalgo/geometry/AABSPTree.h>
 
-class SphereTree;
+class CContractionHierarchy;
 
 class CAxialGraph {
 
@@ -74,6 +75,16 @@ public:
 		REAL  linePos;
 	};
 
+	// Line segments in line tree order, one array per component so that
+	// distances to all lines of a tree cell can be computed in one go
+	struct LINETREESEGMENTS {
+		std::vector<float> x0;
+		std::vector<float> y0;
+		std::vector<float> dx;
+		std::vector<float> dy;
+		std::vector<float> invLenSq;
+	};
+
 
 // Typedefs
 protected:
@@ -90,12 +101,13 @@ protected:
 	CrossingArray    m_crossings;
 	LineCrossArray   m_lineCrossings;
 	BBOX             m_bbox;
-	REAL             m_maxDist;
-	std::unique_ptr<SphereTree> m_sphereTree;
+	CLineAABSPTree   m_lineTree;  // For all line queries
+	LINETREESEGMENTS m_lineTreeSegments;
 	STAT             m_stat;
 	std::vector<int> m_tmpLineIdx;  // TODO: Get rid of this, since it is not thread safe
 	double2          m_WorldOrigin;
 	std::vector<unsigned int> m_PointGroups;  // Number of points per group
+	std::unique_ptr<CContractionHierarchy> m_WalkingHierarchy;
 
 // Construction / Destruction
 public:
@@ -113,6 +125,15 @@ public:
 
 	void setPointGroups(std::vector<unsigned int>&& points_per_group);
 
+	// Connects points to the network after the graph has been created,
+	// replacing any previously connected points.
+	void setPoints(const COORDS* pPoints, int nPoints);
+
+	// Optional contraction hierarchy of walking distances between line crossings,
+	// where node N is line crossing N (see PSTACreateGraphWalkingHierarchy).
+	void setWalkingHierarchy(std::unique_ptr<CContractionHierarchy>&& hierarchy);
+	const CContractionHierarchy* getWalkingHierarchy() const { return m_WalkingHierarchy.get(); }
+
 	void setWorldOrigin(const double2& origin) { m_WorldOrigin = origin; }
 	const double2& getWorldOrigin() const { return m_WorldOrigin; }
 	const float2 worldToLocal(const double2& pt) const { return float2((float)(pt.x - m_WorldOrigin.x), (float)(pt.y - m_WorldOrigin.y)); }
@@ -123,6 +144,7 @@ public:
 	inline int getPointCount()        const { return (int)m_points.size(); }
 	inline int getCrossingCount()     const { return (int)m_crossings.size(); }
 	inline size_t getPointGroupCount() const { return m_PointGroups.size(); }
+	inline const BBOX& getBBox()      const { return m_bbox; }
 
 	inline NETWORKLINE&        getLine(int index)               { return m_lines[index]; }
 	inline const NETWORKLINE&  getLine(int index) const         { return m_lines[index]; }
@@ -135,16 +157,38 @@ public:
 	inline const CROSSING&     getCrossing(int index) const     { return m_crossings[index]; }
 	inline unsigned int        getPointGroupSize(unsigned int group_index) const { return m_PointGroups[group_index]; }
 
+	// Among several equally close lines, returns the one with lowest index.
 	int getClosestLine(const COORDS& pt, REAL* pRetDist, REAL* pRetPos) const;
+
+	// Finds the (at most) k closest lines to a point, ordered by increasing
+	// distance (ties by line index). Returns number of lines found.
+	// pRetDists and pRetPos are optional.
+	int getClosestLines(const COORDS& pt, int k, int* pRetLines, REAL* pRetDists, REAL* pRetPos) const;
+
 	int getLinesFromPoint(const COORDS& ptCenter, float radius, int** ppRetLinesIdx);
 
 	int getCloseLines(int* pRetIdx, REAL x1, REAL y1, REAL x2, REAL y2);
 
+	// Generates the points where a region (NaN-separated polygon rings) is
+	// attached to the network. A point on a region edge is attached to its
+	// closest line, and reaches a crossing, a point attached to the line or
+	// the line center by its distance to the line plus the distance along
+	// the line. For each of these, and each side of it, the region point
+	// with the smallest such distance is generated. Walking distances from
+	// the region are thus exact, except to points attached to the network
+	// after this call. The number of points depends on nearby lines, not
+	// perimeter length.
+	void getRegionEntryPoints(const COORDS* pPoints, int nPoints, std::vector<COORDS>& ret_points) const;
+
 // Implementation
 protected:
 	void findCrossings(const COORDS* pUnlinks, int nUnlinks);
 	void updateLinesPerCrossingCount();
 	void connectPointsToNetwork(const COORDS* pPoints, int nPoints);
+	void getRingEntryPoints(const COORDS* pPoints, int nPoints, std::vector<COORDS>& ret_points) const;
+
+	// Lines whose bounding cells touch the line segment p1-p2, by increasing index
+	void getLinesNearSegment(const COORDS& p1, const COORDS& p2, std::vector<int>& ret_lines) const;
 
 public:
 	static REAL getNearestPoint(const COORDS& pt, const COORDS& l1, const COORDS& l2, REAL* pRetDist);
@@ -0,0 +1,83 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include <pstalgo/Types.h>
+
+class CAxialGraph;
+
+// Line to line adjacency of an axial graph, for CAxialMultiSourceBFS. Read only
+// once created, so it can be shared by several threads.
+class CAxialLineAdjacency
+{
+public:
+	// Returns false if step depths from a breadth first search over this adjacency
+	// might not be identical to those of CPSTBFS for 'graph'. This can be the case
+	// if two lines that are linked to a third line at the same position are not
+	// linked to each other (e.g. unlinks at a junction of more than two lines).
+	bool Create(const CAxialGraph& graph);
+
+	uint32 LineCount() const { return (uint32)m_FirstNeighbour.size() - 1; }
+
+	const uint32* NeighboursBegin(uint32 line_index) const { return m_Neighbours.data() + m_FirstNeighbour[line_index]; }
+	const uint32* NeighboursEnd(uint32 line_index) const { return m_Neighbours.data() + m_FirstNeighbour[line_index + 1]; }
+
+private:
+	std::vector<uint32> m_FirstNeighbour;
+	std::vector<uint32> m_Neighbours;
+};
+
+// Breadth first search (steps distance) over the lines of an axial graph from up
+// to 64 origin lines at a time, as in MS-BFS (Then et al., "The More the Merrier:
+// Efficient Multi-Source Graph Traversal"). Every line has one bit per origin for
+// "seen" and "frontier", so the neighbours of a line are read once per level for
+// all origins whose frontier it is part of.
+class CAxialMultiSourceBFS
+{
+public:
+	static const uint32 MAX_ORIGIN_COUNT = 64;
+
+	CAxialMultiSourceBFS(const CAxialLineAdjacency& adjacency);
+
+	// For every origin line returns number of other lines reached within
+	// 'max_steps' and the sum of their step depths.
+	void Search(const uint32* origin_lines, uint32 origin_count, uint32 max_steps, uint32* ret_reached_counts, uint64* ret_total_depths)
+	{
+		Search(origin_lines, origin_count, &max_steps, 1, ret_reached_counts, ret_total_depths);
+	}
+
+	// Same as above for several step limits from one search. Results are
+	// returned in one block of 'origin_count' elements per limit.
+	void Search(const uint32* origin_lines, uint32 origin_count, const uint32* max_steps, uint32 limit_count, uint32* ret_reached_counts, uint64* ret_total_depths);
+
+private:
+	const CAxialLineAdjacency& m_Adjacency;
+	std::vector<uint64> m_Seen;
+	std::vector<uint64> m_Frontier;
+	std::vector<uint64> m_Next;
+	std::vector<uint32> m_FrontierLines;
+	std::vector<uint32> m_NextLines;
+	uint32 m_ReachedCounts[MAX_ORIGIN_COUNT];
+	uint64 m_TotalDepths[MAX_ORIGIN_COUNT];
+};
@@ -0,0 +1,170 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include <pstalgo/utils/StampedBitVector.h>
+#include <pstalgo/Debug.h>
+
+// Single origin shortest path search for Brandes style betweenness (Brandes,
+// "A Faster Algorithm for Betweenness Centrality"). Nodes are settled in order of
+// distance. Every queue entry that reaches a settled node at the same distance as
+// it was settled with adds a predecessor, and the number of shortest paths of
+// that predecessor to the node. Dependencies are accumulated afterwards by visiting
+// the settled nodes in reverse order, along with their predecessors.
+//
+// Only the distance, path count and head of the predecessor list of a node are
+// kept per node of the graph. Predecessors are linked lists in one arena, and
+// the settle order only holds the nodes reached. All of it is kept between
+// searches, so memory use is 14 bytes per node plus 4 bytes per settled node
+// and 8 bytes per predecessor of the largest search.
+//
+// The graph and metric are defined by the view passed to Run(), which has to
+// implement the following for the queue entry type TEntry:
+//
+//   unsigned int Node(const TEntry& entry) const;
+//   unsigned int Pred(const TEntry& entry) const;  // INVALID_NODE if none
+//   float        Key(const TEntry& entry) const;   // Distance used for ordering
+//   void         OnSettle(const TEntry& entry, TQueue& queue);  // Push entries for neighbours
+//
+class CBrandesSearch
+{
+public:
+	static const unsigned int INVALID_NODE = (unsigned int)-1;
+
+	void Init(unsigned int node_count)
+	{
+		m_Settled.resize(node_count);
+		m_Nodes.resize(node_count);
+	}
+
+	// Clears state of previous search
+	void Clear()
+	{
+		m_Settled.clearAll();
+		m_SettleOrder.clear();
+		m_PredArena.clear();
+	}
+
+	// Settles 'node' at distance 0 with one path. It is not expanded (neighbours
+	// have to be pushed by the caller), and is not part of the settle order.
+	void SetOrigin(unsigned int node)
+	{
+		m_Settled.set(node);
+		m_Nodes[node] = SNode{ 0, 1, INVALID_NODE };
+	}
+
+	inline bool         IsSettled(unsigned int node) const { return m_Settled.get(node); }
+	inline float        Distance(unsigned int node) const  { ASSERT(IsSettled(node)); return m_Nodes[node].m_Distance; }
+	inline int          PathCount(unsigned int node) const { ASSERT(IsSettled(node)); return m_Nodes[node].m_PathCount; }
+
+	// Makes IsSettled() return false for 'node', for accumulation steps that need
+	// to know which nodes have been visited already
+	inline void Unsettle(unsigned int node) { m_Settled.clear(node); }
+
+	template <class TQueue, class TGraphView>
+	void Run(TQueue& queue, TGraphView& view)
+	{
+		while (!queue.empty())
+		{
+			const auto entry = queue.top();
+			queue.pop();
+
+			const unsigned int node = view.Node(entry);
+			const float key = view.Key(entry);
+
+			if (!m_Settled.get(node))
+			{
+				m_Settled.set(node);
+				m_Nodes[node] = SNode{ key, 0, INVALID_NODE };
+				m_SettleOrder.push_back(node);
+				view.OnSettle(entry, queue);
+			}
+			else if (key > m_Nodes[node].m_Distance)
+				continue;  // A shorter path has already been found to this node
+
+			const unsigned int pred = view.Pred(entry);
+			if (INVALID_NODE == pred)
+				continue;
+			SNode& state = m_Nodes[node];
+			state.m_PathCount += m_Nodes[pred].m_PathCount;
+			m_PredArena.push_back(SPredLink{ pred, state.m_LastPred });
+			state.m_LastPred = (unsigned int)m_PredArena.size() - 1;
+		}
+	}
+
+	// Calls lmbd(node) for every settled node (except origins set with SetOrigin),
+	// in order of settling
+	template <class TLambda>
+	void ForEachSettled(TLambda&& lmbd) const
+	{
+		for (const unsigned int node : m_SettleOrder)
+			lmbd(node);
+	}
+
+	// Calls lmbd(node, preds, pred_count) for every settled node (except origins
+	// set with SetOrigin), in reverse order of settling
+	template <class TLambda>
+	void ForEachSettledReverse(TLambda&& lmbd)
+	{
+		for (size_t i = m_SettleOrder.size(); i-- > 0; )
+		{
+			const unsigned int node = m_SettleOrder[i];
+
+			// Lists are linked from last predecessor to first, so fill backwards
+			// to pass them in the order they were found
+			unsigned int pred_count = 0;
+			for (unsigned int link = m_Nodes[node].m_LastPred; INVALID_NODE != link; link = m_PredArena[link].m_Next)
+				++pred_count;
+			if (m_Preds.size() < pred_count)
+				m_Preds.resize(pred_count);
+			unsigned int pred_index = pred_count;
+			for (unsigned int link = m_Nodes[node].m_LastPred; INVALID_NODE != link; link = m_PredArena[link].m_Next)
+				m_Preds[--pred_index] = m_PredArena[link].m_Pred;
+
+			lmbd(node, m_Preds.data(), pred_count);
+		}
+	}
+
+private:
+	// Only valid for settled nodes
+	struct SNode
+	{
+		float        m_Distance;
+		int          m_PathCount;
+		unsigned int m_LastPred;  // Index in m_PredArena, INVALID_NODE if none
+	};
+
+	struct SPredLink
+	{
+		unsigned int m_Pred;
+		unsigned int m_Next;  // Link of previously found predecessor of same node, INVALID_NODE if none
+	};
+
+	CStampedBitVector         m_Settled;
+	std::vector<SNode>        m_Nodes;
+	std::vector<unsigned int> m_SettleOrder;
+	std::vector<SPredLink>    m_PredArena;
+	std::vector<unsigned int> m_Preds;  // Predecessors of one node at a time, for ForEachSettledReverse()
+};
@@ -0,0 +1,108 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include <pstalgo/Types.h>
+#include <pstalgo/utils/RadixHeap.h>
+
+// Contraction hierarchy (Geisberger et al., "Contraction Hierarchies: Faster and
+// Simpler Hierarchical Routing in Road Networks") of a directed graph with
+// non-negative edge weights. Nodes are contracted one at a time in order of
+// increasing importance, adding shortcut edges wherever a contracted node was on
+// the only shortest path between two of its neighbours. Contraction stops when
+// the remaining graph gets dense, and the remaining nodes are then kept as a
+// core of highest rank with all their edges as both up and down edges. Read
+// only once created, so it can be shared by several threads.
+class CContractionHierarchy
+{
+public:
+	struct SEdge
+	{
+		uint32 m_From;
+		uint32 m_To;
+		float  m_Weight;
+	};
+
+	// Parallel edges and self loops are allowed.
+	void Create(uint32 node_count, const SEdge* edges, size_t edge_count);
+
+	uint32 NodeCount() const { return (uint32)m_RankFromNode.size(); }
+
+	// Edges of the hierarchy. Nodes are referred to by rank (order of contraction).
+	struct SRankEdge
+	{
+		uint32 m_Rank;
+		float  m_Weight;
+	};
+
+	// Edges from node of 'rank' to nodes of higher rank (or to other core nodes)
+	const SRankEdge* UpEdgesBegin(uint32 rank) const { return m_UpEdges.data() + m_FirstUpEdge[rank]; }
+	const SRankEdge* UpEdgesEnd(uint32 rank) const { return m_UpEdges.data() + m_FirstUpEdge[rank + 1]; }
+
+	// Edges to node of 'rank' from nodes of higher rank (or from other core nodes)
+	const SRankEdge* DownEdgesBegin(uint32 rank) const { return m_DownEdges.data() + m_FirstDownEdge[rank]; }
+	const SRankEdge* DownEdgesEnd(uint32 rank) const { return m_DownEdges.data() + m_FirstDownEdge[rank + 1]; }
+
+	uint32 RankFromNode(uint32 node_index) const { return m_RankFromNode[node_index]; }
+	uint32 NodeFromRank(uint32 rank) const { return m_NodeFromRank[rank]; }
+
+private:
+	std::vector<uint32> m_RankFromNode;
+	std::vector<uint32> m_NodeFromRank;
+	std::vector<uint32> m_FirstUpEdge;
+	std::vector<SRankEdge> m_UpEdges;
+	std::vector<uint32> m_FirstDownEdge;
+	std::vector<SRankEdge> m_DownEdges;
+};
+
+// One-to-all shortest path distances over a CContractionHierarchy, as in PHAST
+// (Delling et al., "PHAST: Hardware-Accelerated Shortest Path Trees"): a
+// Dijkstra search over upward edges only (which includes all edges of the
+// core), followed by a single sweep over all nodes in order of decreasing rank
+// relaxing their downward edges.
+class CContractionHierarchySearch
+{
+public:
+	CContractionHierarchySearch(const CContractionHierarchy& hierarchy);
+
+	// Distance from the closest of the source nodes to every node, where each
+	// source node starts at its given distance. Unreachable nodes get infinity.
+	void Search(const uint32* source_nodes, const float* source_distances, uint32 source_count, float* ret_distance_per_node);
+
+private:
+	struct SQueueItem
+	{
+		float  m_Distance;
+		uint32 m_Rank;
+		inline bool operator<(const SQueueItem& rhs) const { return m_Distance > rhs.m_Distance; }
+	};
+	struct SGetQueueItemKey
+	{
+		float operator()(const SQueueItem& item) const { return item.m_Distance; }
+	};
+
+	const CContractionHierarchy& m_Hierarchy;
+	std::vector<float> m_DistanceFromRank;
+	psta::radix_heap<SQueueItem, SGetQueueItemKey> m_Queue;
+};
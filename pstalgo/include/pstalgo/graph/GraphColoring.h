@@ -23,5 +23,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 class CSimpleGraph;
 
-// Greedy algorithm that colors nodes in order of decreasing valency
+// Greedy algorithm that colors nodes in order of decreasing valency (ties in
+// pseudo-random but fixed order).
+// Independent nodes are colored in parallel (Jones-Plassmann).
 unsigned int ColorGraph(const CSimpleGraph& graph, unsigned int* out_colors);
\ No newline at end of file
@@ -22,7 +22,6 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <vector>
-#include <pstalgo/utils/SimpleAlignedAllocator.h>
 #include <pstalgo/Vec2.h>
 
 class CSegmentGraph
@@ -56,9 +55,7 @@ public:
 	const SSegment& GetSegment(unsigned int index) const { return m_Segments[index]; }
 
 private:
-	SIntersection* NewIntersection(unsigned int num_segments);
-
 	std::vector<SSegment> m_Segments;
-	CSimpleAlignedAllocator m_IntersectionAllocator;
+	std::vector<unsigned int> m_IntersectionData;  // Variable sized SIntersection objects, packed
 	double2 m_WorldOrigin;
 };
\ No newline at end of file
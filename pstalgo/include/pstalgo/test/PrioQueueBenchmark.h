@@ -0,0 +1,58 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <pstalgo/pstalgo.h>
+
+// Runs the same shortest path searches on a synthetic grid network with
+// std::priority_queue and with psta::radix_heap, for comparing the two.
+// Only built if PSTA_BENCHMARKS is defined (CMake option PSTA_BENCHMARKS),
+// so it isn't part of release builds of the library.
+struct SPrioQueueBenchmarkDesc
+{
+	SPrioQueueBenchmarkDesc() : m_Version(VERSION) {}
+
+	// Version
+	static const unsigned int VERSION = 2;
+	unsigned int m_Version;
+
+	unsigned int m_GridSize;     // Network is a grid of m_GridSize x m_GridSize nodes with random edge lengths
+	unsigned int m_OriginCount;  // Number of searches, each one from a different origin
+	unsigned int m_LengthCount;  // If > 0 edge lengths are integers 1..m_LengthCount, which gives lots of equal distances
+};
+
+struct SPrioQueueBenchmarkRes
+{
+	SPrioQueueBenchmarkRes() : m_Version(VERSION) {}
+
+	// Version
+	static const unsigned int VERSION = 1;
+	unsigned int m_Version;
+
+	float m_BinaryHeapSeconds;
+	float m_RadixHeapSeconds;
+};
+
+// Returns 1 if both queues gave identical distances and shortest path trees
+// (which nodes were settled from, which depends on the order of ties), 0 if
+// they didn't and -1 on error
+PSTADllExport int PSTAPrioQueueBenchmark(const SPrioQueueBenchmarkDesc* desc, SPrioQueueBenchmarkRes* res);
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <future>
 #include <vector>
 
 namespace psta
 {
+	inline unsigned int max_thread_count()
+	{
+		return std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
 	template <class TLambda, typename TIndex>
 	void parallel_for(TIndex end_index, TLambda&& lmbd)
 	{
@@ -25,8 +31,9 @@ namespace psta
 			}
 		};
 
+		// No more threads than indices, so that small ranges are run on this thread only
 		std::vector<std::future<void>> workers;
-		for (uint32_t i = 0; i < std::thread::hardware_concurrency() - 1; ++i)
+		for (TIndex i = 1; i < std::min((TIndex)max_thread_count(), end_index); ++i)
 		{
 			workers.push_back(std::async(std::launch::async, worker));
 		}
@@ -38,4 +45,59 @@ namespace psta
 			w.wait();
 		}
 	}
-}
\ No newline at end of file
+
+	// Calls lmbd(begin, end) for consecutive ranges of at most 'block_size'
+	// indices, covering [0, end_index).
+	template <class TLambda, typename TIndex>
+	void parallel_for_blocks(TIndex end_index, TIndex block_size, TLambda&& lmbd)
+	{
+		parallel_for((end_index + block_size - 1) / block_size, [&](TIndex block_index)
+		{
+			const TIndex begin = block_index * block_size;
+			lmbd(begin, std::min(begin + block_size, end_index));
+		});
+	}
+
+	// Merge sort where chunks are sorted concurrently and then merged
+	// pairwise, also concurrently. Result is only deterministic (same as
+	// std::sort) if 'comp' defines a strict total order.
+	template <class T, class TCompare>
+	void parallel_sort(T* first, T* last, TCompare comp)
+	{
+		const size_t MIN_CHUNK_SIZE = 0x4000;
+
+		const size_t count = last - first;
+		size_t chunk_count = 1;
+		while (chunk_count * 2 <= max_thread_count() && count / (chunk_count * 2) >= MIN_CHUNK_SIZE)
+			chunk_count *= 2;
+		if (chunk_count <= 1)
+		{
+			std::sort(first, last, comp);
+			return;
+		}
+
+		auto chunk_begin = [&](size_t chunk_index) { return (count * chunk_index) / chunk_count; };
+
+		parallel_for(chunk_count, [&](size_t chunk_index)
+		{
+			std::sort(first + chunk_begin(chunk_index), first + chunk_begin(chunk_index + 1), comp);
+		});
+
+		std::vector<T> tmp(count);
+		T* src = first;
+		T* dst = tmp.data();
+		for (size_t width = 1; width < chunk_count; width *= 2)
+		{
+			parallel_for(chunk_count / (width * 2), [&](size_t merge_index)
+			{
+				const size_t beg = chunk_begin(merge_index * width * 2);
+				const size_t mid = chunk_begin(merge_index * width * 2 + width);
+				const size_t end = chunk_begin(merge_index * width * 2 + width * 2);
+				std::merge(src + beg, src + mid, src + mid, src + end, dst + beg, comp);
+			});
+			std::swap(src, dst);
+		}
+		if (src != first)
+			std::copy(src, src + count, first);
+	}
+}
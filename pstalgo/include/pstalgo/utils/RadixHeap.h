@@ -0,0 +1,170 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include <pstalgo/Debug.h>
+#include <pstalgo/utils/Bit.h>
+
+namespace psta
+{
+	// Monotone min-priority queue for non-negative float keys, with the same
+	// interface as std::priority_queue. Pushed keys must not be smaller than
+	// the key of the most recently popped element while the heap is non-empty,
+	// which holds for Dijkstra style searches without negative edges, and
+	// push() throws std::logic_error if they are. TGetKey is a functor
+	// returning the key of an element.
+	//
+	// Keys are bucketed by the highest bit in which they differ from the last
+	// popped key, so each element is moved at most 32 times in total and no
+	// resolution is lost. Elements with the minimum key are kept in a binary
+	// heap ordered by TCompare, so elements are popped in the same order as
+	// from std::priority_queue<T, std::vector<T>, TCompare>, provided that
+	// TCompare orders elements by key first and that elements it can't tell
+	// apart are equal. Otherwise the order of ties is unspecified.
+	template <class T, class TGetKey, class TCompare = std::less<T>>
+	class radix_heap
+	{
+	public:
+		bool empty() const;
+
+		size_t size() const;
+
+		const T& top();
+
+		void push(const T& data);
+
+		void pop();
+
+		void clear();
+
+	private:
+		enum { BUCKET_COUNT = 33 };
+
+		static uint32_t key_bits(float key);
+
+		static unsigned int bucket_index(uint32_t key, uint32_t last);
+
+		// Moves elements of the first non-empty bucket down to lower
+		// buckets, so that bucket 0 holds the elements with minimum key
+		void refill();
+
+		uint32_t m_Last = 0;
+		size_t m_Size = 0;
+		std::vector<T> m_Buckets[BUCKET_COUNT];  // Bucket 0 is a heap ordered by TCompare
+	};
+
+	template <class T, class TGetKey, class TCompare> bool radix_heap<T, TGetKey, TCompare>::empty() const
+	{
+		return 0 == m_Size;
+	}
+
+	template <class T, class TGetKey, class TCompare> size_t radix_heap<T, TGetKey, TCompare>::size() const
+	{
+		return m_Size;
+	}
+
+	template <class T, class TGetKey, class TCompare> const T& radix_heap<T, TGetKey, TCompare>::top()
+	{
+		ASSERT(!empty());
+		if (m_Buckets[0].empty())
+			refill();
+		return m_Buckets[0].front();
+	}
+
+	template <class T, class TGetKey, class TCompare> void radix_heap<T, TGetKey, TCompare>::push(const T& data)
+	{
+		const uint32_t key = key_bits(TGetKey()(data));
+		if (key < m_Last)
+			throw std::logic_error("Non-monotone key pushed to radix_heap");
+		const unsigned int bucket = bucket_index(key, m_Last);
+		m_Buckets[bucket].push_back(data);
+		if (0 == bucket)
+			std::push_heap(m_Buckets[0].begin(), m_Buckets[0].end(), TCompare());
+		++m_Size;
+	}
+
+	template <class T, class TGetKey, class TCompare> void radix_heap<T, TGetKey, TCompare>::pop()
+	{
+		ASSERT(!empty());
+		if (m_Buckets[0].empty())
+			refill();
+		std::pop_heap(m_Buckets[0].begin(), m_Buckets[0].end(), TCompare());
+		m_Buckets[0].pop_back();
+		--m_Size;
+		// Any key can be pushed to an empty heap, which lets the same instance
+		// be reused for the next search
+		if (0 == m_Size)
+			m_Last = 0;
+	}
+
+	template <class T, class TGetKey, class TCompare> void radix_heap<T, TGetKey, TCompare>::clear()
+	{
+		for (auto& bucket : m_Buckets)
+			bucket.clear();
+		m_Last = 0;
+		m_Size = 0;
+	}
+
+	template <class T, class TGetKey, class TCompare> uint32_t radix_heap<T, TGetKey, TCompare>::key_bits(float key)
+	{
+		// Bit patterns of non-negative floats sort like the floats themselves.
+		// Sign bit is masked away so that -0 is treated as 0.
+		uint32_t bits;
+		memcpy(&bits, &key, sizeof(bits));
+		ASSERT(key >= 0);
+		return bits & 0x7FFFFFFF;
+	}
+
+	template <class T, class TGetKey, class TCompare> unsigned int radix_heap<T, TGetKey, TCompare>::bucket_index(uint32_t key, uint32_t last)
+	{
+		const uint32_t diff = key ^ last;
+		return diff ? bit_scan_reverse(diff) + 1 : 0;
+	}
+
+	template <class T, class TGetKey, class TCompare> void radix_heap<T, TGetKey, TCompare>::refill()
+	{
+		ASSERT(m_Buckets[0].empty());
+		unsigned int i = 1;
+		while (m_Buckets[i].empty())
+			++i;
+		auto& bucket = m_Buckets[i];
+		uint32_t new_last = key_bits(TGetKey()(bucket.front()));
+		for (const auto& data : bucket)
+		{
+			const uint32_t key = key_bits(TGetKey()(data));
+			if (key < new_last)
+				new_last = key;
+		}
+		m_Last = new_last;
+		for (const auto& data : bucket)
+			m_Buckets[bucket_index(key_bits(TGetKey()(data)), m_Last)].push_back(data);
+		bucket.clear();
+		std::make_heap(m_Buckets[0].begin(), m_Buckets[0].end(), TCompare());
+	}
+}
@@ -21,6 +21,8 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 #include <vector>
 #include <pstalgo/Debug.h>
@@ -28,8 +30,10 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 /**
  * A heap that keeps track of indices of its items, and supports
  * removal of items at any give index in O(log(N)) time.
+ * TArity is the number of children per node. A higher arity gives
+ * a shallower heap, which makes push() and decrease() cheaper.
  */
-template <class T, class TUpdateHeapIndex>
+template <class T, class TUpdateHeapIndex, unsigned int TArity = 2>
 class CRefHeap
 {
 public:
@@ -85,6 +89,14 @@ public:
 		m_Items.pop_back();
 	}
 
+	// Replaces the item at 'index' with 'item', which must not be greater
+	void decrease(index_t index, const T& item)
+	{
+		ASSERT(index < (index_t)size());
+		ASSERT(!(m_Items[index] < item));
+		set(swim(item, index), T(item));
+	}
+
 	void removeAt(index_t index)
 	{
 		ASSERT(index < (index_t)size());
@@ -131,8 +143,15 @@ private:
 			{
 				break;
 			}
-			const auto second_child_index = first_child_index + 1;
-			const auto smallest_child_index = (second_child_index >= item_count || m_Items[first_child_index] < m_Items[second_child_index]) ? first_child_index : second_child_index;
+			const auto end_child_index = std::min(first_child_index + TArity, item_count);
+			auto smallest_child_index = first_child_index;
+			for (auto child_index = first_child_index + 1; child_index < end_child_index; ++child_index)
+			{
+				if (!(m_Items[smallest_child_index] < m_Items[child_index]))
+				{
+					smallest_child_index = child_index;
+				}
+			}
 			auto& smallest_child = m_Items[smallest_child_index];
 			if (!(smallest_child < item))
 			{
@@ -154,12 +173,12 @@ private:
 	inline static index_t parent_from_child(index_t index)
 	{
 		ASSERT(index > 0);
-		return (index - 1) / 2; 
+		return (index - 1) / TArity;
 	}
 
 	inline static index_t first_child_from_parent(index_t index)
 	{
-		return index * 2 + 1;
+		return index * TArity + 1;
 	}
 };
 
@@ -0,0 +1,68 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  stamped_bit_vector
+//
+//  Same interface as bit_vector, but clearAll() is O(1). Every index holds
+//  the generation (stamp) it was last set in, and an index is set if its
+//  stamp equals the current generation. Clearing all bits just starts a new
+//  generation, so a search that reaches only a small part of a big graph
+//  doesn't need to pay for clearing the whole graph before the next search.
+//  Stamps are only reset when the generation counter wraps around.
+//
+
+template <typename TStamp = uint16_t>
+class stamped_bit_vector {
+
+// Data Members
+protected:
+	std::vector<TStamp> m_stamps;
+	TStamp m_generation = 1;
+
+// Operations
+public:
+	inline bool   empty() const       { return m_stamps.empty(); }
+	inline size_t size() const        { return m_stamps.size(); }
+	inline void   resize(size_t size) { m_stamps.resize(size, 0); }
+	inline void   clearAll()
+	{
+		if (0 == ++m_generation)
+		{
+			std::fill(m_stamps.begin(), m_stamps.end(), (TStamp)0);
+			m_generation = 1;
+		}
+	}
+	inline bool   get(size_t index) const { return m_generation == m_stamps[index]; }
+	inline void   set(size_t index)   { m_stamps[index] = m_generation; }
+	inline void   clear(size_t index) { m_stamps[index] = 0; }
+};
+
+typedef stamped_bit_vector<> CStampedBitVector;
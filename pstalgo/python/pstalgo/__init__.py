@@ -25,20 +25,22 @@ from .attractionreach import AttractionReach, AttractionScoreAccumulationMode, A
 from .calculateisovists import CreateIsovistContext, CalculateIsovist, IsovistContextGeometry
 from .callbacktest import CallbackTest
 from .createbufferpolygons import CompareResults, CompareResultsMode, RasterToPolygons
-from .creategraph import CreateGraph, FreeGraph, GetGraphInfo, GetGraphLineLengths, GetGraphCrossingCoords, CreateSegmentGraph, FreeSegmentGraph, CreateSegmentGroupGraph, FreeSegmentGroupGraph
+from .creategraph import CreateGraph, FreeGraph, GetGraphInfo, GetGraphLineLengths, GetGraphCrossingCoords, CreateGraphWalkingHierarchy, CreateSegmentGraph, FreeSegmentGraph, GetSegmentGraphLengths, CreateSegmentGroupGraph, FreeSegmentGroupGraph
 from .createjunctions import CreateJunctions
 from .createsegmentmap import CreateSegmentMap
 from .log import ErrorLevel, FormatLogMessage, RegisterLogCallback, UnregisterLogCallback
 from .networkintegration import NetworkIntegration
 from .angularchoice import AngularChoice, AngularChoiceNormalize, AngularChoiceSyntaxNormalize
 from .odbetweenness import ODBetweenness, ODBDestinationMode
+from .prioqueuebenchmark import PrioQueueBenchmark, PrioQueueBenchmarkAvailable
 from .raster import RasterFormat, GetRasterData
 from .reach import Reach
 from .segmentbetweenness import SegmentBetweenness, BetweennessNormalize, BetweennessSyntaxNormalize
 from .fastsegmentbetweenness import FastSegmentBetweenness
 from .segmentgrouping import SegmentGrouping
 from .segmentgroupintegration import SegmentGroupIntegration
-from .common import Free, DistanceType, Radii, StandardNormalize, OriginType, RoadNetworkType
+from .shortestpath import ShortestPath
+from .common import Free, DistanceType, Radii, StandardNormalize, OriginType, PolygonPointMode, RoadNetworkType
 from .vector import Vector
 
 # TODO: Possibly move out of pstalgo module? This should probably be in an analysis module instead.
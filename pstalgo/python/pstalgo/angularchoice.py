@@ -35,11 +35,19 @@ class SPSTAAngularChoiceDesc(Structure) :
 		# Radius
 		("m_Radius", Radii),
 
+		# Multiple radii (optional, overrides m_Radius)
+		("m_Radii", POINTER(Radii)),
+		("m_RadiusCount", c_uint),
+
 		# Settings (optional)
 		("m_WeighByLength", c_bool),
 		("m_AngleThreshold", c_float),
 		("m_AnglePrecision", c_uint),
 
+		# Multiple weightings (optional, overrides m_WeighByLength)
+		("m_Weights", POINTER(POINTER(c_float))),
+		("m_WeightCount", c_uint),
+
 		# Progress Callback
 		("m_ProgressCallback", PSTALGO_PROGRESS_CALLBACK),
 		("m_ProgressCallbackUser", c_void_p),
@@ -52,17 +60,28 @@ class SPSTAAngularChoiceDesc(Structure) :
 	]
 	def __init__(self, *args):
 		Structure.__init__(self, *args)
-		self.m_Version = 2
+		self.m_Version = 4
 
 
-def AngularChoice(graph_handle, radius, weigh_by_length = False, angle_threshold = 0, angle_precision = 1, progress_callback = None, out_choice = None, out_node_count = None, out_total_depth = None, out_total_depth_weight = None):
+def AngularChoice(graph_handle, radius, weigh_by_length = False, weights = None, angle_threshold = 0, angle_precision = 1, progress_callback = None, out_choice = None, out_node_count = None, out_total_depth = None, out_total_depth_weight = None):
 	desc = SPSTAAngularChoiceDesc()
 	# Graph
 	desc.m_Graph = graph_handle
-	# Radius
-	desc.m_Radius = radius
+	# Radius, or list of radii to calculate in one pass. Outputs then hold one
+	# block of one element per line for each radius.
+	if isinstance(radius, Radii):
+		desc.m_Radius = radius
+	else:
+		desc.m_Radii = (Radii * len(radius))(*radius)
+		desc.m_RadiusCount = len(radius)
 	# Settings
 	desc.m_WeighByLength = weigh_by_length
+	# List of weightings to calculate in one pass, each either None for
+	# unweighted or an array of one weight per line. Choice and total depth
+	# weight outputs then hold one block of radius blocks for each weighting.
+	if weights is not None:
+		desc.m_Weights = (POINTER(c_float) * len(weights))(*[UnpackArray(w, 'f')[0] for w in weights])
+		desc.m_WeightCount = len(weights)
 	desc.m_AngleThreshold = angle_threshold
 	desc.m_AnglePrecision = int(angle_precision)
 	# Progress Callback
@@ -35,11 +35,20 @@ class SPSTAAngularIntegrationDesc(Structure) :
 		# Radius
 		("m_Radius", Radii),
 
+		# Multiple radii (optional, overrides m_Radius)
+		("m_Radii", POINTER(Radii)),
+		("m_RadiusCount", c_uint),
+
 		# Settings (optional)
 		("m_WeighByLength", c_bool),
 		("m_AngleThreshold", c_float),
 		("m_AnglePrecision", c_uint),
 
+		# Pivot sampling (optional)
+		("m_PivotCount", c_uint),
+		("m_PivotTargetError", c_float),
+		("m_PivotSeed", c_uint),
+
 		# Progress Callback
 		("m_ProgressCallback", PSTALGO_PROGRESS_CALLBACK),
 		("m_ProgressCallbackUser", c_void_p),
@@ -49,22 +58,37 @@ class SPSTAAngularIntegrationDesc(Structure) :
 		("m_OutTotalDepths", POINTER(c_float)),
 		("m_OutTotalWeights", POINTER(c_float)),
 		("m_OutTotalDepthWeights", POINTER(c_float)),
+
+		# Pivot sampling outputs (optional)
+		("m_OutTotalDepthVariances", POINTER(c_float)),
+		("m_OutPivotCount", POINTER(c_uint)),
 	]
 	def __init__(self, *args):
 		Structure.__init__(self, *args)
-		self.m_Version = 2
+		self.m_Version = 4
 
 
-def AngularIntegration(graph_handle, radius, weigh_by_length = False, angle_threshold = 0, angle_precision = 1, progress_callback = None, out_node_counts = None, out_total_depths = None, out_total_weights = None, out_total_depth_weights = None):
+def AngularIntegration(graph_handle, radius, weigh_by_length = False, angle_threshold = 0, angle_precision = 1, progress_callback = None, out_node_counts = None, out_total_depths = None, out_total_weights = None, out_total_depth_weights = None, pivot_count = 0, pivot_target_error = 0, pivot_seed = 0, out_total_depth_variances = None):
 	desc = SPSTAAngularIntegrationDesc()
 	# Graph
 	desc.m_Graph = graph_handle
-	# Radius
-	desc.m_Radius = radius
+	# Radius, or list of radii to calculate in one pass. Outputs then hold one
+	# block of one element per line for each radius.
+	if isinstance(radius, Radii):
+		desc.m_Radius = radius
+	else:
+		desc.m_Radii = (Radii * len(radius))(*radius)
+		desc.m_RadiusCount = len(radius)
 	# Settings
 	desc.m_WeighByLength = weigh_by_length
 	desc.m_AngleThreshold = angle_threshold
 	desc.m_AnglePrecision = int(angle_precision)
+	# Pivot sampling
+	desc.m_PivotCount = pivot_count
+	desc.m_PivotTargetError = pivot_target_error
+	desc.m_PivotSeed = pivot_seed
+	out_pivot_count = c_uint(0)
+	desc.m_OutPivotCount = ctypes.pointer(out_pivot_count)
 	# Progress Callback
 	desc.m_ProgressCallback = CreateCallbackWrapper(progress_callback)
 	desc.m_ProgressCallbackUser = c_void_p() 
@@ -74,12 +98,14 @@ def AngularIntegration(graph_handle, radius, weigh_by_length = False, angle_thre
 	desc.m_OutTotalDepths = UnpackArray(out_total_depths, 'f')[0]
 	desc.m_OutTotalWeights = UnpackArray(out_total_weights, 'f')[0]  
 	desc.m_OutTotalDepthWeights = UnpackArray(out_total_depth_weights, 'f')[0]  
+	desc.m_OutTotalDepthVariances = UnpackArray(out_total_depth_variances, 'f')[0]
 	# Make the call
 	fn = _DLL.PSTAAngularIntegration
 	fn.restype = ctypes.c_bool
 	if not fn(byref(desc)):
 		raise Exception("PSTAAngularIntegration failed.")
-	return True
+	# Number of pivots sampled if pivot sampling
+	return out_pivot_count.value if (pivot_count or pivot_target_error) else True
 
 def AngularIntegrationNormalize(node_counts, total_depth, count, out_scores):
 	_DLL.PSTAAngularIntegrationNormalize(
@@ -21,7 +21,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 import ctypes
 from ctypes import byref, cdll, POINTER, Structure, c_double, c_float, c_int, c_uint, c_void_p, c_bool
-from .common import _DLL, PSTALGO_PROGRESS_CALLBACK, CreateCallbackWrapper, UnpackArray, DumpStructure, Radii, DistanceType, OriginType
+from .common import _DLL, PSTALGO_PROGRESS_CALLBACK, CreateCallbackWrapper, UnpackArray, DumpStructure, Radii, DistanceType, OriginType, PolygonPointMode
 
 
 class SPSTAAttractionDistanceDesc(Structure) :
@@ -48,16 +48,22 @@ class SPSTAAttractionDistanceDesc(Structure) :
 		# Attraction Polygons (optional)
 		# If not NULL this means m_AttractionPoints should be treated as polygon 
 		# corners, and the actual attraction points will be generated at every
-		# 'm_AttractionPolygonPointInterval' interval along polygon edges.
+		# 'm_AttractionPolygonPointInterval' interval along polygon edges, or at
+		# the polygon's entry points into the network if
+		# 'm_AttractionPolygonPointMode' is PolygonPointMode.ENTRY_POINTS.
 		("m_PointsPerAttractionPolygon", POINTER(c_uint)),
 		("m_AttractionPolygonCount", c_uint),
 		("m_AttractionPolygonPointInterval", c_float),
+		("m_AttractionPolygonPointMode", ctypes.c_ubyte),  # (PolygonPointMode enum)
 
 		# Line weights (custom distance values)
 		("m_LineWeights", POINTER(c_float)),
 		("m_LineWeightCount", c_uint),
 		("m_WeightPerMeterForPointEdges", c_float),
 
+		# Search queue
+		("m_UseRadixHeap", c_bool),
+
 		# Progress Callback
 		("m_ProgressCallback", PSTALGO_PROGRESS_CALLBACK),
 		("m_ProgressCallbackUser", c_void_p),
@@ -69,10 +75,10 @@ class SPSTAAttractionDistanceDesc(Structure) :
 	]
 	def __init__(self, *args):
 		Structure.__init__(self, *args)
-		self.m_Version = 3
+		self.m_Version = 5
 
 
-def AttractionDistance(graph_handle, origin_type=OriginType.LINES, distance_type=DistanceType.STEPS, radius=Radii(), attraction_points=None, points_per_polygon=None, polygon_point_interval=0, line_weights=None, weight_per_meter_for_point_edges=0, progress_callback = None, out_min_distances=None):
+def AttractionDistance(graph_handle, origin_type=OriginType.LINES, distance_type=DistanceType.STEPS, radius=Radii(), attraction_points=None, points_per_polygon=None, polygon_point_interval=0, polygon_point_mode=PolygonPointMode.INTERVAL, line_weights=None, weight_per_meter_for_point_edges=0, progress_callback = None, out_min_distances=None, use_radix_heap=False):
 	desc = SPSTAAttractionDistanceDesc()
 	# Graph
 	desc.m_Graph = graph_handle
@@ -91,9 +97,12 @@ def AttractionDistance(graph_handle, origin_type=OriginType.LINES, distance_type
 	else:
 		desc.m_AttractionPolygonCount = 0
 	desc.m_AttractionPolygonPointInterval = polygon_point_interval
+	desc.m_AttractionPolygonPointMode = polygon_point_mode
 	# Line Weights
 	(desc.m_LineWeights, desc.m_LineWeightCount) = UnpackArray(line_weights, 'f')
 	desc.m_WeightPerMeterForPointEdges = weight_per_meter_for_point_edges
+	# Search queue
+	desc.m_UseRadixHeap = use_radix_heap
 	# Progress Callback
 	desc.m_ProgressCallback = CreateCallbackWrapper(progress_callback)
 	desc.m_ProgressCallbackUser = c_void_p() 
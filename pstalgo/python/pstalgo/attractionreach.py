@@ -21,7 +21,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 import ctypes
 from ctypes import byref, cdll, POINTER, Structure, c_double, c_float, c_int, c_uint, c_void_p, c_bool
-from .common import _DLL, PSTALGO_PROGRESS_CALLBACK, CreateCallbackWrapper, UnpackArray, DumpStructure, Radii, DistanceType, OriginType
+from .common import _DLL, PSTALGO_PROGRESS_CALLBACK, CreateCallbackWrapper, UnpackArray, DumpStructure, Radii, DistanceType, OriginType, PolygonPointMode
 
 
 class AttractionWeightFunction:
@@ -62,6 +62,10 @@ class SPSTAAttractionReachDesc(Structure) :
 		# Radius
 		("m_Radius", Radii),
 
+		# Multiple radii (optional, overrides m_Radius)
+		("m_Radii", POINTER(Radii)),
+		("m_RadiusCount", c_uint),
+
 		# Weight function
 		("m_WeightFunc", ctypes.c_ubyte),  # (AttractionWeightFunction enum)
 		("m_WeightFuncConstant", ctypes.c_float),
@@ -77,10 +81,13 @@ class SPSTAAttractionReachDesc(Structure) :
 		# Attraction Polygons (optional)
 		# If not NULL this means m_AttractionPoints should be treated as polygon 
 		# corners, and the actual attraction points will be generated at every
-		# 'm_AttractionPolygonPointInterval' interval along polygon edges.
+		# 'm_AttractionPolygonPointInterval' interval along polygon edges, or at
+		# the polygon's entry points into the network if
+		# 'm_AttractionPolygonPointMode' is PolygonPointMode.ENTRY_POINTS.
 		("m_PointsPerAttractionPolygon", POINTER(c_uint)),
 		("m_AttractionPolygonCount", c_uint),
 		("m_AttractionPolygonPointInterval", c_float),
+		("m_AttractionPolygonPointMode", ctypes.c_ubyte),  # (PolygonPointMode enum)
 
 		# Attraction values (per polygon if polygons area available, otherwise per point)
 		("m_AttractionValues", POINTER(c_float)),
@@ -101,7 +108,7 @@ class SPSTAAttractionReachDesc(Structure) :
 	]
 	def __init__(self, *args):
 		Structure.__init__(self, *args)
-		self.m_Version = 1
+		self.m_Version = 3
 
 
 def AttractionReach(
@@ -114,6 +121,7 @@ def AttractionReach(
 		attraction_points=None,
 		points_per_attraction_polygon=None, 
 		attraction_polygon_point_interval=0,
+		attraction_polygon_point_mode=PolygonPointMode.INTERVAL,
 		attraction_values=None, 
 		attraction_distribution_func=AttractionDistributionFunc.DIVIDE,
 		attraction_collection_func=AttractionCollectionFunc.AVARAGE,
@@ -126,8 +134,13 @@ def AttractionReach(
 	desc.m_OriginType = origin_type
 	# Distance Type
 	desc.m_DistanceType = distance_type
-	# Radius
-	desc.m_Radius = radius
+	# Radius, or list of radii to calculate in one call. Outputs then hold one
+	# block of one element per origin object for each radius.
+	if isinstance(radius, Radii):
+		desc.m_Radius = radius
+	else:
+		desc.m_Radii = (Radii * len(radius))(*radius)
+		desc.m_RadiusCount = len(radius)
 	# Weight function
 	desc.m_WeightFunc = weight_func
 	desc.m_WeightFuncConstant = weight_func_constant
@@ -142,6 +155,7 @@ def AttractionReach(
 	else:
 		desc.m_AttractionPolygonCount = 0
 	desc.m_AttractionPolygonPointInterval = attraction_polygon_point_interval
+	desc.m_AttractionPolygonPointMode = attraction_polygon_point_mode
 	# Attraction values	
 	if attraction_values is not None:
 		(desc.m_AttractionValues, n) = UnpackArray(attraction_values, 'f')
@@ -67,6 +67,11 @@ class OriginType:
 	LINES = 2
 	POINT_GROUPS = 3
 
+class PolygonPointMode:
+	""" NOTE: Has to match EPSTAPolygonPointMode """
+	INTERVAL = 0
+	ENTRY_POINTS = 1
+
 class RoadNetworkType:
 	UNKNOWN           = 0
 	AXIAL_OR_SEGMENT  = 1
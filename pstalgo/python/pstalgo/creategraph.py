@@ -21,7 +21,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 import ctypes
 from ctypes import byref, cdll, POINTER, Structure, c_double, c_float, c_int, c_uint, c_void_p
-from .common import _DLL, PSTALGO_PROGRESS_CALLBACK, CreateCallbackWrapper, UnpackArray, DumpStructure
+from .common import _DLL, PSTALGO_PROGRESS_CALLBACK, CreateCallbackWrapper, UnpackArray, DumpStructure, PolygonPointMode
 
 
 ###############################################################################
@@ -49,10 +49,13 @@ class SPSTACreateGraphDesc(Structure) :
 		# Polygons (optional)
 		# If not None this means m_PointCoords should be treated as polygon 
 		# corners, and the actual points for the graph will be generated at 
-		# every 'm_PolygonPointInterval' interval along polygon edges.
+		# every 'm_PolygonPointInterval' interval along polygon edges, or at
+		# the polygon's entry points into the network if
+		# 'm_PolygonPointMode' is PolygonPointMode.ENTRY_POINTS.
 		("m_PointsPerPolygon", POINTER(c_uint)),
 		("m_PolygonCount", c_uint),
 		("m_PolygonPointInterval", c_float),
+		("m_PolygonPointMode", ctypes.c_ubyte),  # (PolygonPointMode enum)
 
 		# Progress Callback
 		("m_ProgressCallback", PSTALGO_PROGRESS_CALLBACK),
@@ -60,7 +63,7 @@ class SPSTACreateGraphDesc(Structure) :
 	]
 	def __init__(self, *args):
 		Structure.__init__(self, *args)
-		self.m_Version = 1
+		self.m_Version = 2
 
 
 class SPSTAGraphInfo(Structure) :
@@ -79,7 +82,7 @@ class SPSTAGraphInfo(Structure) :
 		self.m_Version = 1
 
 
-def CreateGraph(line_coords, line_indices=None, unlinks=None, points=None, points_per_polygon=None, polygon_point_interval=0, progress_callback=None):
+def CreateGraph(line_coords, line_indices=None, unlinks=None, points=None, points_per_polygon=None, polygon_point_interval=0, polygon_point_mode=PolygonPointMode.INTERVAL, progress_callback=None):
 	desc = SPSTACreateGraphDesc()
 	# Lines
 	(desc.m_LineCoords, n) = UnpackArray(line_coords, 'd')
@@ -107,6 +110,7 @@ def CreateGraph(line_coords, line_indices=None, unlinks=None, points=None, point
 	else:
 		desc.m_PolygonCount = 0
 	desc.m_PolygonPointInterval = polygon_point_interval
+	desc.m_PolygonPointMode = polygon_point_mode
 	# Progress Callback
 	desc.m_ProgressCallback = CreateCallbackWrapper(progress_callback)
 	desc.m_ProgressCallbackUser = c_void_p() 
@@ -149,6 +153,12 @@ def GetGraphCrossingCoords(graph_handle, out_coords):
 	if count != n:
 		raise Exception("PSTAGetGraphCrossingCoords failed.")
 
+def CreateGraphWalkingHierarchy(graph_handle):
+	fn = _DLL.PSTACreateGraphWalkingHierarchy
+	fn.restype = ctypes.c_bool
+	if not fn(c_void_p(graph_handle)):
+		raise Exception("PSTACreateGraphWalkingHierarchy failed.")
+
 ###############################################################################
 # Segment Graph
 
@@ -197,6 +207,14 @@ def CreateSegmentGraph(line_coords, line_indices, progress_callback):
 def FreeSegmentGraph(segment_graph_handle):
 	_DLL.PSTAFreeSegmentGraph(c_void_p(segment_graph_handle))
 
+def GetSegmentGraphLengths(segment_graph_handle, out_lengths):
+	if out_lengths is None:
+		return _DLL.PSTAGetSegmentGraphLengths(c_void_p(segment_graph_handle), c_void_p(), c_uint(0))
+	(ptr, n) = UnpackArray(out_lengths, 'f')
+	count = _DLL.PSTAGetSegmentGraphLengths(c_void_p(segment_graph_handle), ptr, c_uint(n))
+	if count != n:
+		raise Exception("PSTAGetSegmentGraphLengths failed.")
+
 ###############################################################################
 # Segment Group Graph
 
@@ -35,6 +35,15 @@ class SPSTANetworkIntegration(Structure) :
 		# Radius
 		("m_Radius", Radii),
 
+		# Multiple radii (optional, overrides m_Radius)
+		("m_Radii", POINTER(Radii)),
+		("m_RadiusCount", c_uint),
+
+		# Pivot sampling (optional)
+		("m_PivotCount", c_uint),
+		("m_PivotTargetError", c_float),
+		("m_PivotSeed", c_uint),
+
 		# Progress Callback
 		("m_ProgressCallback", PSTALGO_PROGRESS_CALLBACK),
 		("m_ProgressCallbackUser", c_void_p),
@@ -48,18 +57,33 @@ class SPSTANetworkIntegration(Structure) :
 		("m_OutLineIntegration", POINTER(c_float)),
 		("m_OutLineNodeCount", POINTER(c_uint)),
 		("m_OutLineTotalDepth", POINTER(c_float)),
+
+		# Pivot sampling output (optional)
+		("m_OutLineTotalDepthVariance", POINTER(c_float)),
+		("m_OutPivotCount", POINTER(c_uint)),
 	]
 	def __init__(self, *args):
 		Structure.__init__(self, *args)
-		self.m_Version = 1
+		self.m_Version = 3
 
 
-def NetworkIntegration(graph_handle, radius, progress_callback = None, out_junction_coords = None, out_junction_scores = None, out_line_integration = None, out_line_node_count = None, out_line_total_depth = None):
+def NetworkIntegration(graph_handle, radius, progress_callback = None, out_junction_coords = None, out_junction_scores = None, out_line_integration = None, out_line_node_count = None, out_line_total_depth = None, pivot_count = 0, pivot_target_error = 0, pivot_seed = 0, out_line_total_depth_variance = None):
 	desc = SPSTANetworkIntegration()
 	# Graph
 	desc.m_Graph = graph_handle
-		# Radius
-	desc.m_Radius = radius
+	# Radius, or list of radii to calculate in one call. Outputs then hold one
+	# block of one element per line (or junction) for each radius.
+	if isinstance(radius, Radii):
+		desc.m_Radius = radius
+	else:
+		desc.m_Radii = (Radii * len(radius))(*radius)
+		desc.m_RadiusCount = len(radius)
+	# Pivot sampling
+	desc.m_PivotCount = pivot_count
+	desc.m_PivotTargetError = pivot_target_error
+	desc.m_PivotSeed = pivot_seed
+	out_pivot_count = c_uint(0)
+	desc.m_OutPivotCount = ctypes.pointer(out_pivot_count)
 	# Progress Callback
 	desc.m_ProgressCallback = CreateCallbackWrapper(progress_callback)
 	desc.m_ProgressCallbackUser = c_void_p() 
@@ -68,18 +92,22 @@ def NetworkIntegration(graph_handle, radius, progress_callback = None, out_junct
 	desc.m_OutJunctionCount  = int(n / 2); assert((n % 2) == 0)
 	(desc.m_OutJunctionScores, n) = UnpackArray(out_junction_scores, 'f')
 	if out_junction_scores:
+		radius_count = max(desc.m_RadiusCount, 1)
+		assert((n % radius_count) == 0)
 		if out_junction_coords is not None:
-			assert(n == desc.m_OutJunctionCount)
+			assert(n == desc.m_OutJunctionCount * radius_count)
 		else:
-			desc.m_OutJunctionCount = n
+			desc.m_OutJunctionCount = n // radius_count
 	# Outputs per Line 
 	# TODO: Verify length of these
 	desc.m_OutLineIntegration = UnpackArray(out_line_integration, 'f')[0]  
 	desc.m_OutLineNodeCount = UnpackArray(out_line_node_count, 'I')[0]
 	desc.m_OutLineTotalDepth = UnpackArray(out_line_total_depth, 'f')[0]
+	desc.m_OutLineTotalDepthVariance = UnpackArray(out_line_total_depth_variance, 'f')[0]
 	# Make the call
 	fn = _DLL.PSTANetworkIntegration
 	fn.restype = ctypes.c_bool
 	if not fn(byref(desc)):
 		raise Exception("PSTANetworkIntegration failed.")
-	return True
\ No newline at end of file
+	# Number of pivots sampled if pivot sampling
+	return out_pivot_count.value if (pivot_count or pivot_target_error) else True
\ No newline at end of file
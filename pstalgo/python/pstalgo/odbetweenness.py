@@ -54,6 +54,9 @@ class SPSTAODBetweenness(Structure) :
 		# Radius
 		("m_Radius", Radii),
 
+		# Search queue
+		("m_UseRadixHeap", c_bool),
+
 		# Progress Callback
 		("m_ProgressCallback", PSTALGO_PROGRESS_CALLBACK),
 		("m_ProgressCallbackUser", c_void_p),
@@ -64,7 +67,7 @@ class SPSTAODBetweenness(Structure) :
 	]
 	def __init__(self, *args):
 		Structure.__init__(self, *args)
-		self.m_Version = 1
+		self.m_Version = 2
 
 
 def ODBetweenness(
@@ -76,7 +79,8 @@ def ODBetweenness(
 		distance_type = DistanceType.WALKING, 
 		radius=Radii(), 
 		progress_callback = None, 
-		out_scores=None):
+		out_scores=None,
+		use_radix_heap=False):
 
 	desc = SPSTAODBetweenness()
 	desc.m_Graph = graph_handle
@@ -88,6 +92,7 @@ def ODBetweenness(
 	desc.m_DestinationMode = destination_mode
 	desc.m_DistanceType = distance_type
 	desc.m_Radius = radius
+	desc.m_UseRadixHeap = use_radix_heap
 	desc.m_ProgressCallback = CreateCallbackWrapper(progress_callback)
 	desc.m_ProgressCallbackUser = c_void_p() 
 	(desc.m_OutScores, desc.m_OutputCount) = UnpackArray(out_scores, 'f')
@@ -0,0 +1,67 @@
+"""
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+"""
+
+import ctypes
+from .common import _DLL
+
+class SPrioQueueBenchmarkDesc(ctypes.Structure) :
+	_fields_ = [
+		("m_Version", ctypes.c_uint),
+		("m_GridSize", ctypes.c_uint),
+		("m_OriginCount", ctypes.c_uint),
+		("m_LengthCount", ctypes.c_uint),
+	]
+	def __init__(self, *args):
+		ctypes.Structure.__init__(self, *args)
+		self.m_Version = 2
+
+class SPrioQueueBenchmarkRes(ctypes.Structure) :
+	_fields_ = [
+		("m_Version", ctypes.c_uint),
+		("m_BinaryHeapSeconds", ctypes.c_float),
+		("m_RadixHeapSeconds", ctypes.c_float),
+	]
+	def __init__(self, *args):
+		ctypes.Structure.__init__(self, *args)
+		self.m_Version = 1
+
+def PSTAPrioQueueBenchmark(psta, desc, res):
+	fn = psta.PSTAPrioQueueBenchmark
+	fn.argtypes = [ctypes.POINTER(SPrioQueueBenchmarkDesc), ctypes.POINTER(SPrioQueueBenchmarkRes)]
+	fn.restype = ctypes.c_int
+	return fn(ctypes.byref(desc), ctypes.byref(res))
+
+# Only available if the library was built with PSTA_BENCHMARKS
+def PrioQueueBenchmarkAvailable():
+	return hasattr(_DLL, 'PSTAPrioQueueBenchmark')
+
+# Returns (identical, binary_heap_seconds, radix_heap_seconds). Edge lengths
+# are integers 1..length_count if length_count > 0.
+def PrioQueueBenchmark(grid_size=100, origin_count=100, length_count=0):
+	desc = SPrioQueueBenchmarkDesc()
+	desc.m_GridSize = grid_size
+	desc.m_OriginCount = origin_count
+	desc.m_LengthCount = length_count
+	res = SPrioQueueBenchmarkRes()
+	r = PSTAPrioQueueBenchmark(_DLL, desc, res)
+	if r < 0:
+		raise Exception("PrioQueueBenchmark failed.")
+	return (r == 1, res.m_BinaryHeapSeconds, res.m_RadixHeapSeconds)
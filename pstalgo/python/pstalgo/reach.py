@@ -35,6 +35,10 @@ class SPSTAReachDesc(Structure) :
 		# Radius
 		("m_Radius", Radii),
 
+		# Multiple radii (optional, overrides m_Radius)
+		("m_Radii", POINTER(Radii)),
+		("m_RadiusCount", c_uint),
+
 		# Origin Points (optional)
 		("m_OriginPointCoords", POINTER(c_double)),
 		("m_OriginPointCount", c_uint),
@@ -50,15 +54,20 @@ class SPSTAReachDesc(Structure) :
 	]
 	def __init__(self, *args):
 		Structure.__init__(self, *args)
-		self.m_Version = 1
+		self.m_Version = 2
 
 
 def Reach(graph_handle, radius, origin_points = None, progress_callback = None, out_reached_count = None, out_reached_length = None, out_reached_area = None):
 	desc = SPSTAReachDesc()
 	# Graph
 	desc.m_Graph = graph_handle
-		# Radius
-	desc.m_Radius = radius
+	# Radius, or list of radii to calculate in one call. Outputs then hold one
+	# block of one element per origin for each radius.
+	if isinstance(radius, Radii):
+		desc.m_Radius = radius
+	else:
+		desc.m_Radii = (Radii * len(radius))(*radius)
+		desc.m_RadiusCount = len(radius)
 	# Origin Poiints
 	(desc.m_OriginPointCoords, n) = UnpackArray(origin_points, 'd')
 	desc.m_OriginPointCount  = int(n / 2); assert((n % 2) == 0)
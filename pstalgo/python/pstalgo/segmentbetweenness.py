@@ -20,7 +20,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 """
 
 import ctypes
-from ctypes import byref, cdll, POINTER, Structure, c_double, c_float, c_int, c_uint, c_void_p
+from ctypes import byref, cdll, POINTER, Structure, c_double, c_float, c_int, c_uint, c_void_p, c_bool
 from .common import _DLL, PSTALGO_PROGRESS_CALLBACK, CreateCallbackWrapper, UnpackArray, DumpStructure, Radii
 
 class SPSTASegmentBetweennessDesc(Structure) :
@@ -44,6 +44,16 @@ class SPSTASegmentBetweennessDesc(Structure) :
 		("m_AttractionPointCoords", POINTER(c_double)),
 		("m_AttractionPointCount", c_uint),
 
+		# Approximation (optional)
+		("m_Approximate", c_bool),
+		("m_TargetError", c_float),
+		("m_TimeBudget", c_float),
+		("m_Confidence", c_float),
+		("m_Seed", c_uint),
+
+		# Search queue
+		("m_UseRadixHeap", c_bool),
+
 		# Progress Callback
 		("m_ProgressCallback", PSTALGO_PROGRESS_CALLBACK),
 		("m_ProgressCallbackUser", c_void_p),
@@ -52,13 +62,19 @@ class SPSTASegmentBetweennessDesc(Structure) :
 		("m_OutBetweenness", POINTER(c_float)),
 		("m_OutNodeCount", POINTER(c_uint)),
 		("m_OutTotalDepth", POINTER(c_float)),
+
+		# Approximation outputs (optional)
+		("m_OutBetweennessError", POINTER(c_float)),
+		("m_OutSampleCount", POINTER(c_uint)),
 	]
 	def __init__(self, *args):
 		Structure.__init__(self, *args)
-		self.m_Version = 1
+		self.m_Version = 3
+		self.m_TargetError = 0.01
+		self.m_Confidence = 0.95
 
 
-def SegmentBetweenness(graph_handle, distance_type, radius, weights = None, attraction_points = None, progress_callback = None, out_betweenness = None, out_node_count = None, out_total_depth = None):
+def SegmentBetweenness(graph_handle, distance_type, radius, weights = None, attraction_points = None, progress_callback = None, out_betweenness = None, out_node_count = None, out_total_depth = None, approximate = False, target_error = 0.01, time_budget = 0, confidence = 0.95, seed = 0, out_betweenness_error = None, use_radix_heap = False):
 	desc = SPSTASegmentBetweennessDesc()
 	# Graph
 	desc.m_Graph = graph_handle
@@ -73,6 +89,16 @@ def SegmentBetweenness(graph_handle, distance_type, radius, weights = None, attr
 	desc.m_DistanceType = distance_type
 	# Radius
 	desc.m_Radius = radius
+	# Approximation
+	desc.m_Approximate = approximate
+	desc.m_TargetError = target_error
+	desc.m_TimeBudget = time_budget
+	desc.m_Confidence = confidence
+	desc.m_Seed = seed
+	# Search queue
+	desc.m_UseRadixHeap = use_radix_heap
+	sample_count = c_uint(0)
+	desc.m_OutSampleCount = ctypes.pointer(sample_count)
 	# Progress Callback
 	desc.m_ProgressCallback = CreateCallbackWrapper(progress_callback)
 	desc.m_ProgressCallbackUser = c_void_p() 
@@ -81,12 +107,14 @@ def SegmentBetweenness(graph_handle, distance_type, radius, weights = None, attr
 	desc.m_OutBetweenness = UnpackArray(out_betweenness, 'f')[0]  
 	desc.m_OutNodeCount = UnpackArray(out_node_count, 'I')[0]
 	desc.m_OutTotalDepth = UnpackArray(out_total_depth, 'f')[0]
+	desc.m_OutBetweennessError = UnpackArray(out_betweenness_error, 'f')[0]
 	# Make the call
 	fn = _DLL.PSTASegmentBetweenness
 	fn.restype = ctypes.c_bool
 	if not fn(byref(desc)):
 		raise Exception("PSTASegmentBetweenness failed.")
-	return True
+	# Number of origins sampled if approximate
+	return sample_count.value if approximate else True
 
 def BetweennessNormalize(in_values, node_counts, count, out_normalized):
 	_DLL.PSTABetweennessNormalize(
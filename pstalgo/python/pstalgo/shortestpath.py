@@ -0,0 +1,85 @@
+"""
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+"""
+
+import ctypes
+from ctypes import byref, cdll, POINTER, Structure, c_double, c_float, c_int, c_uint, c_void_p
+from .common import _DLL, DistanceType
+
+
+class SPSTAShortestPathDesc(Structure) :
+	_fields_ = [
+		# Version
+		("m_Version", c_uint),
+
+		# Graph
+		("m_Graph", c_void_p),
+
+		# End points
+		("m_Origin", c_double * 2),
+		("m_Destination", c_double * 2),
+
+		# Distance Type (DistanceType enum in common.py)
+		("m_DistanceType", ctypes.c_ubyte),
+	]
+	def __init__(self, *args):
+		Structure.__init__(self, *args)
+		self.m_Version = 1
+
+
+class SPSTAShortestPathRes(Structure) :
+	_fields_ = [
+		# Version
+		("m_Version", c_uint),
+
+		# Lines of path
+		("m_LineCount", c_uint),
+		("m_Lines", POINTER(c_uint)),
+
+		# Points of path (m_LineCount + 3, or none if no path was found)
+		("m_PointCount", c_uint),
+		("m_PointCoords", POINTER(c_double)),
+
+		# Distance from origin to each point of path
+		("m_WalkingDistances", POINTER(c_float)),
+		("m_AngularDistances", POINTER(c_float)),
+		("m_StepDistances", POINTER(c_uint)),
+	]
+	def __init__(self, *args):
+		Structure.__init__(self, *args)
+		self.m_Version = 1
+
+
+def ShortestPath(graph_handle, origin, destination, distance_type = DistanceType.WALKING):
+	""" Returns (res, algo), where arrays of res are valid until algo is freed with Free(). """
+	desc = SPSTAShortestPathDesc()
+	desc.m_Graph = graph_handle
+	desc.m_Origin[0], desc.m_Origin[1] = origin
+	desc.m_Destination[0], desc.m_Destination[1] = destination
+	desc.m_DistanceType = distance_type
+	res = SPSTAShortestPathRes()
+	# Make the call
+	fn = _DLL.PSTAShortestPath
+	fn.argtypes = [POINTER(SPSTAShortestPathDesc), POINTER(SPSTAShortestPathRes)]
+	fn.restype = c_void_p
+	algo = fn(byref(desc), byref(res))
+	if not algo:
+		raise Exception("PSTAShortestPath failed.")
+	return (res, algo)
@@ -20,17 +20,23 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <cmath>
+#include <vector>
 
 #include <pstalgo/analyses/AngularChoice.h>
+#include <pstalgo/Debug.h>
 #include "../ProgressUtil.h"
 #include "AngularChoiceAlgo.h"
 
 SPSTAAngularChoiceDesc::SPSTAAngularChoiceDesc()
 	: m_Version(VERSION)
 	, m_Graph(0)
+	, m_Radii(nullptr)
+	, m_RadiusCount(0)
 	, m_WeighByLength(false)
 	, m_AngleThreshold(0)
 	, m_AnglePrecision(1)
+	, m_Weights(nullptr)
+	, m_WeightCount(0)
 	, m_ProgressCallback(nullptr)
 	, m_ProgressCallbackUser(nullptr)
 	, m_OutChoice(nullptr)
@@ -41,13 +47,27 @@ SPSTAAngularChoiceDesc::SPSTAAngularChoiceDesc()
 
 PSTADllExport bool PSTAAngularChoice(const SPSTAAngularChoiceDesc* desc)
 {
+	if (desc->VERSION != desc->m_Version)
+	{
+		LOG_ERROR("SPSTAAngularChoiceDesc version mismatch");
+		return false;
+	}
+
+	auto& graph = *(CSegmentGraph*)desc->m_Graph;
+
+	// Single weighting unless several are given
+	const std::vector<float> lengths = (!desc->m_WeightCount && desc->m_WeighByLength) ? CAngularChoiceAlgo::SegmentLengths(graph) : std::vector<float>();
+	const float* single_weights = lengths.empty() ? nullptr : lengths.data();
+
 	CAngularChoiceAlgo algo;
 	CPSTAlgoProgressCallback progress(desc->m_ProgressCallback, desc->m_ProgressCallbackUser);
 	return algo.Run(
-		*(CSegmentGraph*)desc->m_Graph,
+		graph,
 		CAngularChoiceAlgo::EMode_AngularChoice,
-		desc->m_Radius,
-		desc->m_WeighByLength,
+		desc->m_RadiusCount ? desc->m_Radii : &desc->m_Radius,
+		desc->m_RadiusCount ? desc->m_RadiusCount : 1,
+		desc->m_WeightCount ? desc->m_Weights : &single_weights,
+		desc->m_WeightCount ? desc->m_WeightCount : 1,
 		desc->m_AngleThreshold,
 		desc->m_AnglePrecision,
 		desc->m_OutChoice,
@@ -20,6 +20,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <atomic>
+#include <cstdint>
 #include <future>
 #include <vector>
 
@@ -32,6 +33,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 #include "../Progress.h"
 #include "AngularChoiceAlgo.h"
+#include "PivotSampling.h"
 
 #define USE_MULTIPLE_CORES
 
@@ -46,31 +48,80 @@ public:
 
 	void Run(unsigned int first_segment_index, unsigned int num_segments, std::atomic<unsigned int>& segments_processed_counter)
 	{
+		m_RadiusCount = (unsigned int)m_Analysis.m_Radii.size();
+		m_WeightCount = (unsigned int)m_Analysis.m_Weights.size();
+
 		if (CAngularChoiceAlgo::EMode_AngularChoice == m_Analysis.m_Mode)
-			m_Scores.resize(m_Analysis.GetGraph().GetSegmentCount(), 0.0f);
+			m_Scores.resize((size_t)m_Analysis.GetGraph().GetSegmentCount() * m_RadiusCount * m_WeightCount, 0.0f);
 		else
 			m_Scores.clear();
 
 		m_Queue.Init(360 / m_Analysis.m_AnglePrecisionDegrees + 1);
 
-		m_SegmentStates.resize(m_Analysis.GetGraph().GetSegmentCount() * 2);  // One entry for each direction through every segment
+		// One entry for each direction through every segment (and radius)
+		const size_t segment_state_count = (size_t)m_Analysis.GetGraph().GetSegmentCount() * 2;
+		m_SegmentStates.resize(segment_state_count * m_RadiusCount);
+		m_NumShortestPaths.resize(segment_state_count * m_RadiusCount, 0);
+		if (CAngularChoiceAlgo::EMode_AngularChoice == m_Analysis.m_Mode)
+			m_StateScores.resize(segment_state_count * m_WeightCount);
+		else
+			m_StateScores.clear();
+		m_ProcessedStates.clear();
+
+		m_ReachedTotals.resize(m_RadiusCount);
+		m_ReachedWeights.resize(m_RadiusCount * m_WeightCount);
+		m_PrevStartScores.resize(m_WeightCount);
+
+		if (1 == m_RadiusCount && 1 == m_WeightCount)
+			ProcessSegments<true>(first_segment_index, num_segments, segments_processed_counter);
+		else
+			ProcessSegments<false>(first_segment_index, num_segments, segments_processed_counter);
+	}
+
+	const double* GetSegmentScores() const
+	{
+		return m_Scores.empty() ? 0x0 : &m_Scores.front();
+	}
+
+	// Per radius and target segment, over all pivots processed
+	struct SPivotSums
+	{
+		double m_Count;
+		double m_DepthDeg;
+		double m_DepthDegSqr;
+	};
+
+	// Per weighting, radius and target segment, over all pivots processed
+	struct SPivotWeightSums
+	{
+		double m_Weight;
+		double m_DepthDegWeight;
+	};
+
+	// Makes following runs add up depths to reached segments from every origin, for pivot sampling
+	void InitPivotSums()
+	{
+		const size_t count = (size_t)m_Analysis.GetGraph().GetSegmentCount() * m_Analysis.m_Radii.size();
+		m_PivotSums.assign(count, SPivotSums{ 0, 0, 0 });
+		m_PivotWeightSums.assign(count * m_Analysis.m_Weights.size(), SPivotWeightSums{ 0, 0 });
+	}
+
+	const SPivotSums& GetPivotSums(size_t index) const { return m_PivotSums[index]; }
+	const SPivotWeightSums& GetPivotWeightSums(size_t index) const { return m_PivotWeightSums[index]; }
 
-		for (unsigned int segment_index = first_segment_index; segment_index < first_segment_index + num_segments; ++segment_index)
+private:
+	template <bool SINGLE>
+	void ProcessSegments(unsigned int first_segment_index, unsigned int num_segments, std::atomic<unsigned int>& segments_processed_counter)
+	{
+		for (unsigned int i = first_segment_index; i < first_segment_index + num_segments; ++i)
 		{
-			float dummy_total_depth;
-			float dummy_total_weight;
-			float dummy_total_depth_weight;
-			unsigned int dummy_node_count;
-			ProcessSegment(
-				segment_index,
-				m_Analysis.m_TotalDepths ? m_Analysis.m_TotalDepths[segment_index] : dummy_total_depth,
-				m_Analysis.m_TotalWeights ? m_Analysis.m_TotalWeights[segment_index] : dummy_total_weight,
-				m_Analysis.m_TotalDepthWeights ? m_Analysis.m_TotalDepthWeights[segment_index] : dummy_total_depth_weight,
-				m_Analysis.m_NodeCounts ? m_Analysis.m_NodeCounts[segment_index] : dummy_node_count);
+			const unsigned int segment_index = m_Analysis.m_Origins ? m_Analysis.m_Origins[i] : i;
+
+			ProcessSegment<SINGLE>(segment_index);
 
 			if (CAngularChoiceAlgo::EMode_AngularChoice == m_Analysis.m_Mode)
 			{
-				CollectNSCScores(segment_index);
+				CollectNSCScores<SINGLE>(segment_index);
 			}
 
 			ClearProcessedFlags(segment_index);
@@ -81,19 +132,22 @@ public:
 		}
 	}
 
-	const double* GetSegmentScores() const
-	{
-		return m_Scores.empty() ? 0x0 : &m_Scores.front();
-	}
-
-private:
+	// State per segment direction is split in three arrays, since it is held by
+	// every worker for the whole graph. Only m_NumShortestPaths needs to be
+	// cleared between origins, and the scores are only needed for choice:
+	//
+	//   m_SegmentStates     8 bytes per radius, valid if processed within radius
+	//   m_NumShortestPaths  1 byte per radius, 0 if not processed within radius
+	//   m_StateScores       4 bytes per weighting, EMode_AngularChoice only
+	//
+	// Every radius has its own shortest paths, but a traversal state is shared
+	// by all radii it is within, so a path that is a shortest path within
+	// several radii is only expanded once. Shortest paths don't depend on
+	// weights, so scores of all weightings are collected in the same pass.
 	struct SSegmentState
 	{
 		unsigned int  m_LowestAngle;                   // The lowest accumulated angle leading to this segment from origin segment
 		unsigned int  m_OutSegmentBits;                // A bit is set if the step to corresponding segment in out-intersection is part of a shortest path
-		float         m_Score;
-		unsigned char m_NumShortestPathsToThisSegment; // Number of shortes paths leading into this segment
-		bool          m_Processed;
 
 		void SetOutSegmentBit(unsigned int index_in_out_intersection)         { ASSERT(index_in_out_intersection < 32); m_OutSegmentBits |= BIT(index_in_out_intersection); }
 		bool IsOutSegmentBitSet(unsigned int index_in_out_intersection) const { ASSERT(index_in_out_intersection < 32); return 0 != (m_OutSegmentBits & BIT(index_in_out_intersection)); }
@@ -102,7 +156,7 @@ private:
 	struct STraversalState
 	{
 		STraversalState() {}
-		STraversalState(unsigned int segment_index, bool forwards, unsigned int accumulated_angle, unsigned int source_segment_state, float acc_walking, float acc_angle, unsigned int acc_steps)
+		STraversalState(unsigned int segment_index, bool forwards, unsigned int accumulated_angle, unsigned int source_segment_state, float acc_walking, float acc_angle, unsigned int acc_steps, unsigned int radius_mask)
 			: m_SegmentIndex(segment_index)
 			, m_Forwards(forwards)
 			, m_AccumulatedAngle(accumulated_angle)
@@ -110,6 +164,7 @@ private:
 			, m_AccWalking(acc_walking)
 			, m_AccAngle(acc_angle)
 			, m_AccSteps(acc_steps)
+			, m_RadiusMask(radius_mask)
 		{}
 
 		static const unsigned int NO_SOURCE_SEGMENT_STATE = (unsigned int)-1;
@@ -125,13 +180,39 @@ private:
 		float m_AccWalking;
 		float m_AccAngle;
 		unsigned int m_AccSteps;
+		unsigned int m_RadiusMask;  // Radii this path is within (see CAngularChoiceAlgo::RadiusMask)
+	};
+
+	// Per radius, for current origin
+	struct SReachedTotals
+	{
+		unsigned int m_SegmentCount;
+		double m_DepthDeg;
+	};
+
+	// Per weighting and radius, for current origin
+	struct SReachedWeights
+	{
+		double m_Weight;
+		double m_DepthDegWeight;
 	};
 
 	CAngularChoiceAlgo& m_Analysis;
+	unsigned int m_RadiusCount;
+	unsigned int m_WeightCount;
 	float2     m_CurrentOrigin;  // Center position of current start segment
 	TDiscretePrioQueue<unsigned int, STraversalState> m_Queue;
 	std::vector<SSegmentState> m_SegmentStates;
-	std::vector<double> m_Scores;
+	std::vector<unsigned char> m_NumShortestPaths;  // Number of shortest paths within each radius leading into segment direction
+	std::vector<float> m_StateScores;  // One element per weighting for each segment direction, first is -1 if not collected
+	std::vector<unsigned int> m_ProcessedStates;  // Only kept when more than one radius, since shortest paths of different radii can't be followed to clear flags
+	std::vector<SReachedTotals> m_ReachedTotals;
+	std::vector<SReachedWeights> m_ReachedWeights;  // One block of one element per radius for each weighting
+	std::vector<double> m_PrevStartScores;
+	std::vector<double> m_Scores;  // One block of one element per segment for each radius and weighting
+	unsigned int m_CurrentOriginIndex;
+	std::vector<SPivotSums> m_PivotSums;  // One block of one element per segment for each radius, pivot sampling only
+	std::vector<SPivotWeightSums> m_PivotWeightSums;  // One such set of blocks for each weighting
 
 	CSegmentGraph& GetGraph()
 	{
@@ -148,9 +229,69 @@ private:
 		return segment_state_index >> 1;
 	}
 
-	inline SSegmentState& SegmentState(unsigned int segment_index, bool forwards)
+	// SINGLE is true if there is one radius and one weighting, which is the
+	// common case and lets the compiler drop the loops over them
+
+	template <bool SINGLE> inline unsigned int RadiusCount() const { return SINGLE ? 1 : m_RadiusCount; }
+	template <bool SINGLE> inline unsigned int WeightCount() const { return SINGLE ? 1 : m_WeightCount; }
+
+	// Bit N is set if radius N allows reaching a segment with these distances
+	// from origin, where 'steps' is the number of steps taken to reach it
+	template <bool SINGLE>
+	inline unsigned int RadiusMask(unsigned int steps, float walking, float angle, float straight_line_sqr) const
 	{
-		return m_SegmentStates[SegmentStateIndex(segment_index, forwards)];
+		unsigned int mask = 0;
+		for (unsigned int radius_index = 0; radius_index < RadiusCount<SINGLE>(); ++radius_index)
+		{
+			const SRadius& radius = m_Analysis.m_Radii[radius_index];
+			if (steps <= radius.m_Steps && walking <= radius.m_Walking && angle <= radius.m_Angle && straight_line_sqr <= radius.m_StraightLineSqr)
+				mask |= 1u << radius_index;
+		}
+		return mask;
+	}
+
+	template <bool SINGLE = false>
+	inline SSegmentState& SegmentState(unsigned int segment_state_index, unsigned int radius_index)
+	{
+		return m_SegmentStates[(size_t)segment_state_index * RadiusCount<SINGLE>() + radius_index];
+	}
+
+	template <bool SINGLE = false>
+	inline unsigned char& NumShortestPaths(unsigned int segment_state_index, unsigned int radius_index)
+	{
+		return m_NumShortestPaths[(size_t)segment_state_index * RadiusCount<SINGLE>() + radius_index];
+	}
+
+	template <bool SINGLE>
+	inline float* StateScores(unsigned int segment_state_index)
+	{
+		return &m_StateScores[(size_t)segment_state_index * WeightCount<SINGLE>()];
+	}
+
+	template <bool SINGLE>
+	inline double* SegmentScores(unsigned int weight_index, unsigned int radius_index)
+	{
+		return &m_Scores[((size_t)weight_index * RadiusCount<SINGLE>() + radius_index) * GetGraph().GetSegmentCount()];
+	}
+
+	// Radii within which segment state has been processed
+	template <bool SINGLE = false>
+	inline unsigned int StateRadiusMask(unsigned int segment_state_index) const
+	{
+		const unsigned char* num_shortest_paths = &m_NumShortestPaths[(size_t)segment_state_index * RadiusCount<SINGLE>()];
+		unsigned int mask = 0;
+		for (unsigned int radius_index = 0; radius_index < RadiusCount<SINGLE>(); ++radius_index)
+		{
+			if (num_shortest_paths[radius_index])
+				mask |= 1u << radius_index;
+		}
+		return mask;
+	}
+
+	template <bool SINGLE = false>
+	inline bool IsProcessed(unsigned int segment_state_index) const
+	{
+		return 0 != StateRadiusMask<SINGLE>(segment_state_index);
 	}
 
 	inline unsigned int ScoreIndex(unsigned int segment_index, bool forwards)
@@ -163,173 +304,298 @@ private:
 		return (unsigned int)(angle / m_Analysis.m_AnglePrecisionDegrees + 0.5f);
 	}
 
-	inline bool TestStraightLineDistance(const float2& pos) const
+	inline float StraightLineDistanceSqr(const float2& pos) const
 	{
-		return (pos - m_CurrentOrigin).getLengthSqr() <= m_Analysis.m_Radius.m_StraightLineSqr;
+		return (pos - m_CurrentOrigin).getLengthSqr();
 	}
 
-	void ProcessSegment(unsigned int start_segment_index, float& ret_total_depth, float& ret_total_weight, float& ret_total_depth_weight, unsigned int& ret_node_count)
+	template <bool SINGLE>
+	void ProcessSegment(unsigned int start_segment_index)
 	{
 		m_Queue.Reset(0);
 
-		unsigned int num_segments_reached = 0;
-		double total_depth_deg = 0;
-		double total_weight = 0;
-		double total_depth_deg_weight = 0;
+		for (auto& totals : m_ReachedTotals)
+		{
+			totals.m_SegmentCount = 0;
+			totals.m_DepthDeg = 0;
+		}
+		for (auto& weights : m_ReachedWeights)
+		{
+			weights.m_Weight = 0;
+			weights.m_DepthDegWeight = 0;
+		}
 
 		const auto& segment = GetGraph().GetSegment(start_segment_index);
 		m_CurrentOrigin = segment.m_Center;
+		m_CurrentOriginIndex = start_segment_index;
 
-		STraversalState state(start_segment_index, false, 0, STraversalState::NO_SOURCE_SEGMENT_STATE, 0, 0, 0);
-		ProcessTraversalState(state, total_depth_deg, total_weight, total_depth_deg_weight, num_segments_reached);
+		const unsigned int all_radii_mask = (unsigned int)(((uint64_t)1 << RadiusCount<SINGLE>()) - 1);
+		STraversalState state(start_segment_index, false, 0, STraversalState::NO_SOURCE_SEGMENT_STATE, 0, 0, 0, all_radii_mask);
+		ProcessTraversalState<SINGLE>(state);
 		state.m_Forwards = true;
-		ProcessTraversalState(state, total_depth_deg, total_weight, total_depth_deg_weight, num_segments_reached);
+		ProcessTraversalState<SINGLE>(state);
 
 		while (!m_Queue.Empty())
 		{
 			const STraversalState state = m_Queue.Top();
 			m_Queue.Pop();
-			ProcessTraversalState(state, total_depth_deg, total_weight, total_depth_deg_weight, num_segments_reached);
+			ProcessTraversalState<SINGLE>(state);
 		}
 
-		ret_total_depth = (float)SyntaxAngleWeightFromDegrees(total_depth_deg);
-		ret_total_weight = (float)total_weight;
-		ret_total_depth_weight = (float)SyntaxAngleWeightFromDegrees(total_depth_deg_weight);
-		ret_node_count = num_segments_reached + 1;  // Node count INCLUDING origin segment (hence +1 here)
+		const size_t segment_count = GetGraph().GetSegmentCount();
+		for (unsigned int radius_index = 0; radius_index < RadiusCount<SINGLE>(); ++radius_index)
+		{
+			const SReachedTotals& totals = m_ReachedTotals[radius_index];
+			const size_t output_index = radius_index * segment_count + start_segment_index;
+			if (m_Analysis.m_TotalDepths)
+				m_Analysis.m_TotalDepths[output_index] = (float)SyntaxAngleWeightFromDegrees(totals.m_DepthDeg);
+			if (m_Analysis.m_NodeCounts)
+				m_Analysis.m_NodeCounts[output_index] = totals.m_SegmentCount + 1;  // Node count INCLUDING origin segment (hence +1 here)
+			for (unsigned int weight_index = 0; weight_index < WeightCount<SINGLE>(); ++weight_index)
+			{
+				const SReachedWeights& weights = m_ReachedWeights[weight_index * RadiusCount<SINGLE>() + radius_index];
+				const size_t weight_output_index = weight_index * RadiusCount<SINGLE>() * segment_count + output_index;
+				if (m_Analysis.m_TotalWeights)
+					m_Analysis.m_TotalWeights[weight_output_index] = (float)weights.m_Weight;
+				if (m_Analysis.m_TotalDepthWeights)
+					m_Analysis.m_TotalDepthWeights[weight_output_index] = (float)SyntaxAngleWeightFromDegrees(weights.m_DepthDegWeight);
+			}
+		}
 	}
 
-	void CollectNSCScores(int start_segment_index)
+	template <bool SINGLE>
+	void CollectNSCScores(unsigned int start_segment_index)
 	{
-		const auto prev_score = m_Scores[start_segment_index];
+		for (unsigned int radius_index = 0; radius_index < RadiusCount<SINGLE>(); ++radius_index)
+		{
+			if (radius_index > 0)
+			{
+				// Mark scores of previous radius as not collected
+				for (const unsigned int segment_state_index : m_ProcessedStates)
+					StateScores<SINGLE>(segment_state_index)[0] = -1.0f;
+			}
 
-		CollectScores(start_segment_index, false, start_segment_index);
-		CollectScores(start_segment_index, true, start_segment_index);
+			for (unsigned int weight_index = 0; weight_index < WeightCount<SINGLE>(); ++weight_index)
+				m_PrevStartScores[weight_index] = SegmentScores<SINGLE>(weight_index, radius_index)[start_segment_index];
 
-		if (m_Analysis.IsWeighByLength())
-		{
-			// When calculating WEIGHTED Choice the origin segments DO get a score, but only
-			// half the score that a segment between origin and destination get (Turner 2007, page 544).
-			m_Scores[start_segment_index] = prev_score + (m_Scores[start_segment_index] - prev_score) * 0.5;
-		}
-		else
-		{
-			// The start segment will be an end segment in this processing step, and should 
-			// therefore get no score (only segments BETWEEN other segments will get scores).
-			m_Scores[start_segment_index] = prev_score;
+			CollectScores<SINGLE>(start_segment_index, false, start_segment_index, radius_index);
+			CollectScores<SINGLE>(start_segment_index, true, start_segment_index, radius_index);
+
+			for (unsigned int weight_index = 0; weight_index < WeightCount<SINGLE>(); ++weight_index)
+			{
+				double& start_segment_score = SegmentScores<SINGLE>(weight_index, radius_index)[start_segment_index];
+				const auto prev_score = m_PrevStartScores[weight_index];
+				if (m_Analysis.m_Weights[weight_index])
+				{
+					// When calculating WEIGHTED Choice the origin segments DO get a score, but only
+					// half the score that a segment between origin and destination get (Turner 2007, page 544).
+					start_segment_score = prev_score + (start_segment_score - prev_score) * 0.5;
+				}
+				else
+				{
+					// The start segment will be an end segment in this processing step, and should 
+					// therefore get no score (only segments BETWEEN other segments will get scores).
+					start_segment_score = prev_score;
+				}
+			}
 		}
 	}
 
-	void ProcessTraversalState(const STraversalState& state, double& total_depth_deg, double& total_weight, double& total_depth_deg_weight, unsigned int& segment_count)
+	template <bool SINGLE>
+	void ProcessTraversalState(const STraversalState& state)
 	{
 		const auto& segment = GetGraph().GetSegment(state.m_SegmentIndex);
-		SSegmentState& segment_state = SegmentState(state.m_SegmentIndex, state.m_Forwards);
+		const unsigned int segment_state_index = SegmentStateIndex(state.m_SegmentIndex, state.m_Forwards);
 
-		if (segment_state.m_Processed && state.m_AccumulatedAngle > segment_state.m_LowestAngle)
-			return;  // This segment has been reached via a shorter path
+		// Looked up when first needed, since most states are reached via a
+		// shorter path already
+		unsigned int index_in_source_intersection = (unsigned int)-1;
+		bool source_intersection_index_found = !state.HasSourceState();
 
-		if (state.HasSourceState())
+		// Radii within which this segment state is reached for the first time
+		unsigned int new_radius_mask = 0;
+
+		for (unsigned int radius_index = 0; radius_index < RadiusCount<SINGLE>(); ++radius_index)
 		{
-			// Make the step to this segment known in source segment state
-			SSegmentState& source_segment_state = m_SegmentStates[state.m_SourceSegmentState];
-			const auto* source_intersection = segment.m_Intersections[state.m_Forwards ? 0 : 1];
-			ASSERT(source_intersection);
-			for (unsigned int i = 0; i < source_intersection->m_NumSegments; ++i)
+			if (0 == (state.m_RadiusMask & (1u << radius_index)))
+				continue;
+
+			SSegmentState& segment_state = SegmentState<SINGLE>(segment_state_index, radius_index);
+			unsigned char& num_shortest_paths = NumShortestPaths<SINGLE>(segment_state_index, radius_index);
+
+			if (num_shortest_paths && state.m_AccumulatedAngle > segment_state.m_LowestAngle)
+				continue;  // This segment has been reached via a shorter path
+
+			if (!source_intersection_index_found)
 			{
-				if (source_intersection->m_Segments[i] == state.m_SegmentIndex)
+				const auto* source_intersection = segment.m_Intersections[state.m_Forwards ? 0 : 1];
+				ASSERT(source_intersection);
+				for (unsigned int i = 0; i < source_intersection->m_NumSegments; ++i)
 				{
-					if (source_segment_state.IsOutSegmentBitSet(i))
+					if (source_intersection->m_Segments[i] == state.m_SegmentIndex)
 					{
-						ASSERT(false && "Infinite loop detected.");
-						return;
+						index_in_source_intersection = i;
+						break;
 					}
-					source_segment_state.SetOutSegmentBit(i);
-					break;
 				}
+				source_intersection_index_found = true;
+			}
+
+			if (state.HasSourceState() && index_in_source_intersection < 32)
+			{
+				// Make the step to this segment known in source segment state
+				SSegmentState& source_segment_state = SegmentState<SINGLE>(state.m_SourceSegmentState, radius_index);
+				if (source_segment_state.IsOutSegmentBitSet(index_in_source_intersection))
+				{
+					ASSERT(false && "Infinite loop detected.");
+					continue;
+				}
+				source_segment_state.SetOutSegmentBit(index_in_source_intersection);
+			}
+
+			if (num_shortest_paths)
+			{
+				// Found another eaqually short path to this segment. Saturate rather
+				// than wrap around to 0, which would mean not processed.
+				if (num_shortest_paths < 0xFF)
+					++num_shortest_paths;
+				continue;
 			}
+
+			new_radius_mask |= 1u << radius_index;
 		}
 
-		if (segment_state.m_Processed)
-		{
-			// Found another eaqually short path to this segment
-			++segment_state.m_NumShortestPathsToThisSegment;
+		if (0 == new_radius_mask)
 			return;
-		}
 
-		if (state.HasSourceState() && !SegmentState(state.m_SegmentIndex, !state.m_Forwards).m_Processed)
+		const bool processed = IsProcessed<SINGLE>(segment_state_index);
+
+		if (state.HasSourceState())
 		{
-			// First time we reach this segment, from any direction.
-			// Update "global" metrics.
-			++segment_count;
-			const auto weight = m_Analysis.IsWeighByLength() ? segment.m_Length : 1.f;
-			total_depth_deg += state.m_AccAngle;
-			total_weight += weight;
-			total_depth_deg_weight += state.m_AccAngle * weight;
+			// Update "global" metrics of the radii within which this is the
+			// first time we reach this segment, from any direction.
+			const unsigned int first_reached_mask = new_radius_mask & ~StateRadiusMask<SINGLE>(SegmentStateIndex(state.m_SegmentIndex, !state.m_Forwards));
+			if (first_reached_mask)
+			{
+				for (unsigned int radius_index = 0; radius_index < RadiusCount<SINGLE>(); ++radius_index)
+				{
+					if (0 == (first_reached_mask & (1u << radius_index)))
+						continue;
+					SReachedTotals& totals = m_ReachedTotals[radius_index];
+					++totals.m_SegmentCount;
+					totals.m_DepthDeg += state.m_AccAngle;
+					for (unsigned int weight_index = 0; weight_index < WeightCount<SINGLE>(); ++weight_index)
+					{
+						const float* weights = m_Analysis.m_Weights[weight_index];
+						const auto weight = weights ? weights[state.m_SegmentIndex] : 1.f;
+						SReachedWeights& reached_weights = m_ReachedWeights[weight_index * RadiusCount<SINGLE>() + radius_index];
+						reached_weights.m_Weight += weight;
+						reached_weights.m_DepthDegWeight += state.m_AccAngle * weight;
+					}
+					if (!m_PivotSums.empty())
+						AddPivotSums<SINGLE>(state.m_SegmentIndex, radius_index, state.m_AccAngle);
+				}
+			}
 		}
 
-		segment_state.m_Processed = true;
-		segment_state.m_Score = -1.0f;
-		segment_state.m_NumShortestPathsToThisSegment = 1;
-		segment_state.m_LowestAngle = state.m_AccumulatedAngle;
-		segment_state.m_OutSegmentBits = 0;
+		if (!processed && RadiusCount<SINGLE>() > 1)
+			m_ProcessedStates.push_back(segment_state_index);
+		if (!m_StateScores.empty())
+			StateScores<SINGLE>(segment_state_index)[0] = -1.0f;
+		for (unsigned int radius_index = 0; radius_index < RadiusCount<SINGLE>(); ++radius_index)
+		{
+			if (0 == (new_radius_mask & (1u << radius_index)))
+				continue;
+			NumShortestPaths<SINGLE>(segment_state_index, radius_index) = 1;
+			SSegmentState& segment_state = SegmentState<SINGLE>(segment_state_index, radius_index);
+			segment_state.m_LowestAngle = state.m_AccumulatedAngle;
+			segment_state.m_OutSegmentBits = 0;
+		}
 
-		if (state.m_AccSteps < m_Analysis.m_Radius.m_Steps)
+		if (const auto* intersection = segment.m_Intersections[state.m_Forwards ? 1 : 0])
 		{
-			if (const auto* intersection = segment.m_Intersections[state.m_Forwards ? 1 : 0])
+			const unsigned int intersection_radius_mask = new_radius_mask & RadiusMask<SINGLE>(state.m_AccSteps + 1, 0, 0, StraightLineDistanceSqr(intersection->m_Pos));
+			if (intersection_radius_mask)
 			{
-				if (TestStraightLineDistance(intersection->m_Pos))
-				{
-					const float orientation = state.m_Forwards ? segment.m_Orientation : reverseAngle(segment.m_Orientation);
+				const float orientation = state.m_Forwards ? segment.m_Orientation : reverseAngle(segment.m_Orientation);
 
-					for (unsigned int i = 0; i < intersection->m_NumSegments; ++i)
-					{
-						const unsigned int other_segment_index = intersection->m_Segments[i];
-						if (other_segment_index == state.m_SegmentIndex)
-							continue;  // Do not go back to current segment from intersection
-
-						const auto& other_segment = GetGraph().GetSegment(other_segment_index);
-						if (!TestStraightLineDistance(other_segment.m_Center))
-							continue;
-
-						const float acc_walking = state.m_AccWalking + (segment.m_Length + other_segment.m_Length) * 0.5f;
-						if (acc_walking  > m_Analysis.m_Radius.m_Walking)
-							continue;
-
-						const bool other_forwards = (other_segment.m_Intersections[0] == intersection);
-						const float other_orientation = other_forwards ? other_segment.m_Orientation : reverseAngle(other_segment.m_Orientation);
-						float delta_angle = angleDiff(orientation, other_orientation);
-						if (delta_angle < m_Analysis.m_AngleThresholdDegrees)
-							delta_angle = 0.0f;
-
-						const float acc_angle = state.m_AccAngle + delta_angle;
-						if (acc_angle > m_Analysis.m_Radius.m_Angle)
-							continue;
-
-						const unsigned int delta_angle_descr = GetDiscreteAngle(delta_angle);
-						const unsigned int acc_angle_descr = state.m_AccumulatedAngle + delta_angle_descr;
-
-						m_Queue.Insert(acc_angle_descr,
-							STraversalState(
-							other_segment_index,
-							other_forwards,
-							acc_angle_descr,
-							SegmentStateIndex(state.m_SegmentIndex, state.m_Forwards),
-							acc_walking,
-							acc_angle,
-							state.m_AccSteps + 1));
-					}
+				for (unsigned int i = 0; i < intersection->m_NumSegments; ++i)
+				{
+					const unsigned int other_segment_index = intersection->m_Segments[i];
+					if (other_segment_index == state.m_SegmentIndex)
+						continue;  // Do not go back to current segment from intersection
+
+					const auto& other_segment = GetGraph().GetSegment(other_segment_index);
+
+					const float acc_walking = state.m_AccWalking + (segment.m_Length + other_segment.m_Length) * 0.5f;
+
+					const bool other_forwards = (other_segment.m_Intersections[0] == intersection);
+					const float other_orientation = other_forwards ? other_segment.m_Orientation : reverseAngle(other_segment.m_Orientation);
+					float delta_angle = angleDiff(orientation, other_orientation);
+					if (delta_angle < m_Analysis.m_AngleThresholdDegrees)
+						delta_angle = 0.0f;
+
+					const float acc_angle = state.m_AccAngle + delta_angle;
+
+					const unsigned int radius_mask = intersection_radius_mask & RadiusMask<SINGLE>(0, acc_walking, acc_angle, StraightLineDistanceSqr(other_segment.m_Center));
+					if (0 == radius_mask)
+						continue;
+
+					const unsigned int delta_angle_descr = GetDiscreteAngle(delta_angle);
+					const unsigned int acc_angle_descr = state.m_AccumulatedAngle + delta_angle_descr;
+
+					m_Queue.Insert(
+						acc_angle_descr,
+						STraversalState(
+						other_segment_index,
+						other_forwards,
+						acc_angle_descr,
+						segment_state_index,
+						acc_walking,
+						acc_angle,
+						state.m_AccSteps + 1,
+						radius_mask));
 				}
 			}
 		}
 	}
 
-	void CollectScores(unsigned int segment_index, bool forwards, unsigned int origin_segment_index)
+	// Depth from origin to target is taken as depth from target to origin, so
+	// it is the ORIGIN that is reached, with the weight of the origin
+	template <bool SINGLE>
+	void AddPivotSums(unsigned int target_segment_index, unsigned int radius_index, float depth_deg)
 	{
-		const auto& segment = GetGraph().GetSegment(segment_index);
-		SSegmentState& segment_state = SegmentState(segment_index, forwards);
-		const SSegmentState& opposite_segment_state = SegmentState(segment_index, !forwards);
+		const size_t index = (size_t)radius_index * GetGraph().GetSegmentCount() + target_segment_index;
+		SPivotSums& sums = m_PivotSums[index];
+		sums.m_Count += 1;
+		sums.m_DepthDeg += depth_deg;
+		sums.m_DepthDegSqr += (double)depth_deg * depth_deg;
+		for (unsigned int weight_index = 0; weight_index < WeightCount<SINGLE>(); ++weight_index)
+		{
+			const float* weights = m_Analysis.m_Weights[weight_index];
+			const auto weight = weights ? weights[m_CurrentOriginIndex] : 1.f;
+			SPivotWeightSums& weight_sums = m_PivotWeightSums[(size_t)weight_index * RadiusCount<SINGLE>() * GetGraph().GetSegmentCount() + index];
+			weight_sums.m_Weight += weight;
+			weight_sums.m_DepthDegWeight += depth_deg * weight;
+		}
+	}
 
-		ASSERT(-1.0f == segment_state.m_Score);
-		segment_state.m_Score = 0;
+	template <bool SINGLE>
+	void CollectScores(unsigned int segment_index, bool forwards, unsigned int origin_segment_index, unsigned int radius_index)
+	{
+		const auto& segment = GetGraph().GetSegment(segment_index);
+		const unsigned int segment_state_index = SegmentStateIndex(segment_index, forwards);
+		const unsigned int opposite_segment_state_index = SegmentStateIndex(segment_index, !forwards);
+		const SSegmentState& segment_state = SegmentState<SINGLE>(segment_state_index, radius_index);
+		const SSegmentState& opposite_segment_state = SegmentState<SINGLE>(opposite_segment_state_index, radius_index);
+		const unsigned int num_shortest_paths = NumShortestPaths<SINGLE>(segment_state_index, radius_index);
+		const unsigned int opposite_num_shortest_paths = NumShortestPaths<SINGLE>(opposite_segment_state_index, radius_index);
+		float* score = StateScores<SINGLE>(segment_state_index);
+
+		ASSERT(-1.0f == score[0]);
+		ASSERT(num_shortest_paths > 0);
+		for (unsigned int weight_index = 0; weight_index < WeightCount<SINGLE>(); ++weight_index)
+			score[weight_index] = 0;
 
 		if (const auto* intersection = segment.m_Intersections[forwards ? 1 : 0])
 		{
@@ -340,49 +606,68 @@ private:
 				const unsigned int other_segment_index = intersection->m_Segments[i];
 				const auto& other_segment = GetGraph().GetSegment(other_segment_index);
 				const bool other_forwards = (other_segment.m_Intersections[0] == intersection);
-				SSegmentState& other_segment_state = SegmentState(other_segment_index, other_forwards);
-				if (other_segment_state.m_Score < 0.0f)
-					CollectScores(other_segment_index, other_forwards, origin_segment_index);
-				segment_state.m_Score += other_segment_state.m_Score / other_segment_state.m_NumShortestPathsToThisSegment;
+				const unsigned int other_segment_state_index = SegmentStateIndex(other_segment_index, other_forwards);
+				const float* other_score = StateScores<SINGLE>(other_segment_state_index);
+				if (other_score[0] < 0.0f)
+					CollectScores<SINGLE>(other_segment_index, other_forwards, origin_segment_index, radius_index);
+				const int other_num_shortest_paths = NumShortestPaths<SINGLE>(other_segment_state_index, radius_index);
+				for (unsigned int weight_index = 0; weight_index < WeightCount<SINGLE>(); ++weight_index)
+					score[weight_index] += other_score[weight_index] / other_num_shortest_paths;
 			}
 		}
 
-		m_Scores[segment_index] += segment_state.m_Score;
+		for (unsigned int weight_index = 0; weight_index < WeightCount<SINGLE>(); ++weight_index)
+			SegmentScores<SINGLE>(weight_index, radius_index)[segment_index] += score[weight_index];
 
-		const unsigned int opposite_lowest_angle = opposite_segment_state.m_Processed ? opposite_segment_state.m_LowestAngle : 0xFFFFFFFF;
+		const unsigned int opposite_lowest_angle = opposite_num_shortest_paths ? opposite_segment_state.m_LowestAngle : 0xFFFFFFFF;
 		if (segment_state.m_LowestAngle <= opposite_lowest_angle)
 		{
-			float state_score = m_Analysis.IsWeighByLength() ? (segment.m_Length * GetGraph().GetSegment(origin_segment_index).m_Length) : 1.0f;
-			if (segment_state.m_LowestAngle == opposite_lowest_angle)
+			for (unsigned int weight_index = 0; weight_index < WeightCount<SINGLE>(); ++weight_index)
 			{
-				const int total_shortest_paths_to_segment = segment_state.m_NumShortestPathsToThisSegment + opposite_segment_state.m_NumShortestPathsToThisSegment;
-				ASSERT(total_shortest_paths_to_segment > 0);
-				state_score *= (float)segment_state.m_NumShortestPathsToThisSegment / total_shortest_paths_to_segment;
-			}
+				const float* weights = m_Analysis.m_Weights[weight_index];
+				float state_score = weights ? (weights[segment_index] * weights[origin_segment_index]) : 1.0f;
+				if (segment_state.m_LowestAngle == opposite_lowest_angle)
+				{
+					const int total_shortest_paths_to_segment = num_shortest_paths + opposite_num_shortest_paths;
+					ASSERT(total_shortest_paths_to_segment > 0);
+					state_score *= (float)num_shortest_paths / total_shortest_paths_to_segment;
+				}
 
-			segment_state.m_Score += state_score;
+				score[weight_index] += state_score;
 
-			if (m_Analysis.IsWeighByLength() && segment_index != origin_segment_index)
-			{
-				// When calculating weighted Choice the destination segments DO get a score, but only
-				// half the score that a segment between origin and destination get (Turner 2007, page 544).
-				m_Scores[segment_index] += state_score * 0.5f;
+				if (weights && segment_index != origin_segment_index)
+				{
+					// When calculating weighted Choice the destination segments DO get a score, but only
+					// half the score that a segment between origin and destination get (Turner 2007, page 544).
+					SegmentScores<SINGLE>(weight_index, radius_index)[segment_index] += state_score * 0.5f;
+				}
 			}
 		}
 	}
 
 	void ClearProcessedFlags(unsigned int segment_index)
 	{
+		if (m_RadiusCount > 1)
+		{
+			for (const unsigned int segment_state_index : m_ProcessedStates)
+			{
+				for (unsigned int radius_index = 0; radius_index < m_RadiusCount; ++radius_index)
+					NumShortestPaths(segment_state_index, radius_index) = 0;
+			}
+			m_ProcessedStates.clear();
+			return;
+		}
 		ClearProcessedFlags(segment_index, false);
 		ClearProcessedFlags(segment_index, true);
 	}
 
 	void ClearProcessedFlags(unsigned int segment_index, bool forwards)
 	{
-		SSegmentState& segment_state = SegmentState(segment_index, forwards);
-		if (!segment_state.m_Processed)
+		const unsigned int segment_state_index = SegmentStateIndex(segment_index, forwards);
+		if (!IsProcessed(segment_state_index))
 			return;
-		segment_state.m_Processed = false;
+		NumShortestPaths(segment_state_index, 0) = 0;
+		const SSegmentState& segment_state = SegmentState(segment_state_index, 0);
 		const auto& segment = GetGraph().GetSegment(segment_index);
 		if (const auto* intersection = segment.m_Intersections[forwards ? 1 : 0])
 		{
@@ -399,16 +684,15 @@ private:
 	}
 
 };
-
 CAngularChoiceAlgo::CAngularChoiceAlgo()
 	: m_Graph(nullptr)
-	, m_WeighByLength(false)
 	, m_AngleThresholdDegrees(0)
 	, m_AnglePrecisionDegrees(0)
 	, m_NodeCounts(nullptr)
 	, m_TotalDepths(nullptr)
 	, m_TotalWeights(nullptr)
 	, m_TotalDepthWeights(nullptr)
+	, m_Origins(nullptr)
 {
 	using namespace std;
 	
@@ -426,11 +710,21 @@ CAngularChoiceAlgo::~CAngularChoiceAlgo()
 {
 }
 
+std::vector<float> CAngularChoiceAlgo::SegmentLengths(const CSegmentGraph& graph)
+{
+	std::vector<float> lengths(graph.GetSegmentCount());
+	for (unsigned int segment_index = 0; segment_index < (unsigned int)lengths.size(); ++segment_index)
+		lengths[segment_index] = graph.GetSegment(segment_index).m_Length;
+	return lengths;
+}
+
 bool CAngularChoiceAlgo::Run(
 	CSegmentGraph& graph,
 	EMode mode,
-	const SPSTARadii& radii,
-	bool weigh_by_length,
+	const SPSTARadii* radii,
+	unsigned int radius_count,
+	const float* const* weights,
+	unsigned int weight_count,
 	float angle_threshold,
 	unsigned int angle_precision,
 	float* ret_choice,
@@ -440,30 +734,224 @@ bool CAngularChoiceAlgo::Run(
 	float* ret_total_depth_weights,
 	IProgressCallback& progress)
 {
-	using namespace std;
+	if (!Init(graph, mode, radii, radius_count, weights, weight_count, angle_threshold, angle_precision))
+		return false;
+
+	m_NodeCounts = ret_node_counts;
+	m_TotalDepths = ret_total_depths;
+	m_TotalWeights = ret_total_weights;
+	m_TotalDepthWeights = ret_total_depth_weights;
+
+	std::atomic<unsigned int> num_processed_segments(0);
+
+	VERIFY(num_processed_segments.is_lock_free());
+
+	const unsigned int task_count = RunWorkers(0, graph.GetSegmentCount(), num_processed_segments, graph.GetSegmentCount(), progress);
+
+	if (ret_choice)
+	{
+		// Accumulate scores from all workers.
+		// We iterate over lines first and workers second, even though this
+		// is likely to be less cache efficient, in favor of precision.
+		const size_t score_count = (size_t)graph.GetSegmentCount() * radius_count * weight_count;
+		for (size_t score_index = 0; score_index < score_count; ++score_index)
+		{
+			double score = 0;
+			for (size_t task_index = 0; task_index < task_count; ++task_index)
+				score += m_Workers[task_index]->GetSegmentScores()[score_index];
+			ret_choice[score_index] = (float)score;
+		}
+	}
+
+	// Verify that all segments were processed
+	if (num_processed_segments.load() != graph.GetSegmentCount())
+	{
+		// Failed
+		LOG_ERROR("Network Sequential Choice algorithm failed (all segments were not processed!?).");
+		return false;
+	}
+
+	progress.ReportProgress(1.f);
+
+	return true;
+}
+
+bool CAngularChoiceAlgo::RunPivots(
+	CSegmentGraph& graph,
+	const SPSTARadii* radii,
+	unsigned int radius_count,
+	const float* const* weights,
+	unsigned int weight_count,
+	float angle_threshold,
+	unsigned int angle_precision,
+	const SPivotSampling& sampling,
+	unsigned int* ret_node_counts,
+	float* ret_total_depths,
+	float* ret_total_depth_variances,
+	float* ret_total_weights,
+	float* ret_total_depth_weights,
+	unsigned int* ret_pivot_count,
+	IProgressCallback& progress)
+{
+	if (!CPivotSampler::IsSymmetric(radii, radius_count))
+	{
+		LOG_ERROR("Angular integration pivot sampling only supports no radius or angular radius");
+		return false;
+	}
+
+	if (!Init(graph, EMode_AngularIntegration, radii, radius_count, weights, weight_count, angle_threshold, angle_precision))
+		return false;
+
+	// Totals of pivots themselves are not needed
+	m_NodeCounts = nullptr;
+	m_TotalDepths = nullptr;
+	m_TotalWeights = nullptr;
+	m_TotalDepthWeights = nullptr;
+
+	const unsigned int segment_count = graph.GetSegmentCount();
+
+	std::vector<float2> centers(segment_count);
+	for (unsigned int segment_index = 0; segment_index < segment_count; ++segment_index)
+		centers[segment_index] = graph.GetSegment(segment_index).m_Center;
+	const std::vector<unsigned int> order = CPivotSampler::StratifiedOrder(centers, CPivotSampler::CellsPerSide(sampling), sampling.m_Seed);
+	m_Origins = order.data();
+
+	for (auto& worker : m_Workers)
+		worker->InitPivotSums();
+
+	std::atomic<unsigned int> num_processed_segments(0);
+	const unsigned int progress_total = sampling.m_PivotCount ? std::min(sampling.m_PivotCount, segment_count) : segment_count;
+
+	// Sums of all workers, in the same order every time
+	auto sums = [&](size_t index)
+	{
+		CWorker::SPivotSums sums = { 0, 0, 0 };
+		for (const auto& worker : m_Workers)
+		{
+			const auto& worker_sums = worker->GetPivotSums(index);
+			sums.m_Count += worker_sums.m_Count;
+			sums.m_DepthDeg += worker_sums.m_DepthDeg;
+			sums.m_DepthDegSqr += worker_sums.m_DepthDegSqr;
+		}
+		return sums;
+	};
+
+	auto process = [&](unsigned int first, unsigned int count)
+	{
+		RunWorkers(first, count, num_processed_segments, progress_total, progress);
+		return count;
+	};
 
+	// Largest relative standard error of total depth
+	auto max_relative_error = [&](unsigned int pivot_count)
+	{
+		double max_error = 0;
+		for (size_t index = 0; index < (size_t)segment_count * radius_count; ++index)
+		{
+			const auto s = sums(index);
+			double estimate, variance;
+			CPivotSampler::Estimate(s.m_DepthDeg, s.m_DepthDegSqr, pivot_count, segment_count, estimate, variance);
+			if (estimate > 0)
+				max_error = std::max(max_error, std::sqrt(variance) / estimate);
+		}
+		return max_error;
+	};
+
+	const unsigned int pivot_count = CPivotSampler::Run(segment_count, sampling, process, max_relative_error);
+
+	m_Origins = nullptr;
+
+	const double depth_scale = SyntaxAngleWeightFromDegrees(1.0);
+	for (size_t index = 0; index < (size_t)segment_count * radius_count; ++index)
+	{
+		const auto s = sums(index);
+		double count, depth, variance, unused;
+		// Every pivot adds 0 or 1 to m_Count, so it is also the sum of squares
+		CPivotSampler::Estimate(s.m_Count, s.m_Count, pivot_count, segment_count, count, unused);
+		CPivotSampler::Estimate(s.m_DepthDeg, s.m_DepthDegSqr, pivot_count, segment_count, depth, variance);
+		if (ret_node_counts)
+			ret_node_counts[index] = (unsigned int)(count + 0.5) + 1;  // Node count INCLUDING origin segment (hence +1 here)
+		if (ret_total_depths)
+			ret_total_depths[index] = (float)(depth * depth_scale);
+		if (ret_total_depth_variances)
+			ret_total_depth_variances[index] = (float)(variance * depth_scale * depth_scale);
+		for (unsigned int weight_index = 0; weight_index < weight_count; ++weight_index)
+		{
+			const size_t weight_output_index = (size_t)weight_index * radius_count * segment_count + index;
+			double weight_sum = 0, depth_weight_sum = 0;
+			for (const auto& worker : m_Workers)
+			{
+				const auto& worker_sums = worker->GetPivotWeightSums(weight_output_index);
+				weight_sum += worker_sums.m_Weight;
+				depth_weight_sum += worker_sums.m_DepthDegWeight;
+			}
+			double total_weight, total_depth_weight;
+			CPivotSampler::Estimate(weight_sum, 0, pivot_count, segment_count, total_weight, unused);
+			CPivotSampler::Estimate(depth_weight_sum, 0, pivot_count, segment_count, total_depth_weight, unused);
+			if (ret_total_weights)
+				ret_total_weights[weight_output_index] = (float)total_weight;
+			if (ret_total_depth_weights)
+				ret_total_depth_weights[weight_output_index] = (float)(total_depth_weight * depth_scale);
+		}
+	}
+
+	if (ret_pivot_count)
+		*ret_pivot_count = pivot_count;
+
+	progress.ReportProgress(1.f);
+
+	return true;
+}
+
+bool CAngularChoiceAlgo::Init(
+	CSegmentGraph& graph,
+	EMode mode,
+	const SPSTARadii* radii,
+	unsigned int radius_count,
+	const float* const* weights,
+	unsigned int weight_count,
+	float angle_threshold,
+	unsigned int angle_precision)
+{
 	m_Graph = &graph;
 	m_Mode = mode;
 
+	if (0 == radius_count || radius_count > MAX_RADIUS_COUNT)
+	{
+		LOG_ERROR("Angular analysis supports 1 to %d radii, %d given", MAX_RADIUS_COUNT, radius_count);
+		return false;
+	}
+
+	if (0 == weight_count)
+	{
+		LOG_ERROR("Angular analysis needs at least one weighting");
+		return false;
+	}
+
 	// TODO: Consider making this part of EPSTARadii
-	m_Radius.m_StraightLineSqr = radii.HasStraight() ? radii.m_Straight*radii.m_Straight : std::numeric_limits<float>::infinity();
-	m_Radius.m_Walking =         radii.HasWalking() ?  radii.m_Walking : std::numeric_limits<float>::infinity();
-	m_Radius.m_Angle =           radii.HasAngular() ?  radii.m_Angular : std::numeric_limits<float>::infinity();
-	m_Radius.m_Steps =           radii.HasSteps() ?    radii.m_Steps : 0xFFFFFFFF;
+	m_Radii.resize(radius_count);
+	for (unsigned int radius_index = 0; radius_index < radius_count; ++radius_index)
+	{
+		const SPSTARadii& r = radii[radius_index];
+		SRadius& radius = m_Radii[radius_index];
+		radius.m_StraightLineSqr = r.HasStraight() ? r.m_Straight*r.m_Straight : std::numeric_limits<float>::infinity();
+		radius.m_Walking =         r.HasWalking() ?  r.m_Walking : std::numeric_limits<float>::infinity();
+		radius.m_Angle =           r.HasAngular() ?  r.m_Angular : std::numeric_limits<float>::infinity();
+		radius.m_Steps =           r.HasSteps() ?    r.m_Steps : 0xFFFFFFFF;
+	}
 
-	m_WeighByLength = weigh_by_length;
+	m_Weights.assign(weights, weights + weight_count);
 	m_AngleThresholdDegrees = angle_threshold;
 	m_AnglePrecisionDegrees = angle_precision;
-	m_NodeCounts = ret_node_counts;
-	m_TotalDepths = ret_total_depths;
-	m_TotalWeights = ret_total_weights;
-	m_TotalDepthWeights = ret_total_depth_weights;
 
-	std::atomic<unsigned int> num_processed_segments(0);
+	return true;
+}
 
-	VERIFY(num_processed_segments.is_lock_free());
+unsigned int CAngularChoiceAlgo::RunWorkers(unsigned int first, unsigned int count, std::atomic<unsigned int>& num_processed_segments, unsigned int progress_total, IProgressCallback& progress)
+{
+	using namespace std;
 
-	const unsigned int segments_per_worker = (unsigned int)(graph.GetSegmentCount() / m_Workers.size()) + 1;
+	const unsigned int segments_per_worker = (unsigned int)(count / m_Workers.size()) + 1;
 
 	std::vector<std::future<void>> tasks;
 	tasks.reserve(m_Workers.size());
@@ -471,14 +959,14 @@ bool CAngularChoiceAlgo::Run(
 	for (unsigned int worker_index = 0; worker_index < m_Workers.size(); ++worker_index)
 	{
 		const unsigned int first_segment_to_process = (segments_per_worker * worker_index);
-		const int num_segments_to_process = min((int)graph.GetSegmentCount() - (int)first_segment_to_process, (int)segments_per_worker);
+		const int num_segments_to_process = min((int)count - (int)first_segment_to_process, (int)segments_per_worker);
 		if (num_segments_to_process <= 0)
 			break;
 		tasks.push_back(std::async(
 			std::launch::async,
 			&CWorker::Run,
 			m_Workers[worker_index].get(),
-			first_segment_to_process,
+			first + first_segment_to_process,
 			num_segments_to_process,
 			std::ref(num_processed_segments)));
 	}
@@ -491,36 +979,12 @@ bool CAngularChoiceAlgo::Run(
 		// Wait for task to finish, and update progress every 100ms
 		while (std::future_status::ready != task.wait_for(std::chrono::milliseconds(100)))
 		{
-			progress.ReportProgress((float)num_processed_segments.load() / graph.GetSegmentCount());
+			progress.ReportProgress((float)num_processed_segments.load() / progress_total);
 		}
 
 		// Update progress
-		progress.ReportProgress((float)num_processed_segments.load() / graph.GetSegmentCount());
+		progress.ReportProgress((float)num_processed_segments.load() / progress_total);
 	}
 
-	if (ret_choice)
-	{
-		// Accumulate scores from all workers.
-		// We iterate over lines first and workers second, even though this
-		// is likely to be less cache efficient, in favor of precision.
-		for (unsigned int line_index = 0; line_index < graph.GetSegmentCount(); ++line_index)
-		{
-			double score = 0;
-			for (size_t task_index = 0; task_index < tasks.size(); ++task_index)
-				score += m_Workers[task_index]->GetSegmentScores()[line_index];
-			ret_choice[line_index] = (float)score;
-		}
-	}
-
-	// Verify that all segments were processed
-	if (num_processed_segments.load() != graph.GetSegmentCount())
-	{
-		// Failed
-		LOG_ERROR("Network Sequential Choice algorithm failed (all segments were not processed!?).");
-		return false;
-	}
-
-	progress.ReportProgress(1.f);
-
-	return true;
-}
\ No newline at end of file
+	return (unsigned int)tasks.size();
+}
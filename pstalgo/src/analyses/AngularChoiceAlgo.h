@@ -21,12 +21,14 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <pstalgo/analyses/Common.h>
 
 class CSegmentGraph;
 class IProgressCallback;
+struct SPivotSampling;
 
 class CAngularChoiceAlgo
 {
@@ -40,16 +42,30 @@ public:
 	CAngularChoiceAlgo();
 	~CAngularChoiceAlgo();
 	
+	// Max number of radii that can be calculated in one run
+	static const unsigned int MAX_RADIUS_COUNT = 32;
+
 	/**
-	 *  ret_choice:        Either choice or length-weighted choice values (depending on weigh_by_length).
-	 *  ret_total_depths:  Sum of either depth or depth*weight (depending on weigh_by_length) of each reached segment.
-	 *  ret_total_weights: Sum of weights of all reached segments. NOTE: Weight of ORIGIN segment is NOT INCLUDED. Weight will be 1 or length depending on weigh_by_length.
+	 *  radii:             Every radius gets the same outputs as if run separately, but paths that are shortest paths within
+	 *                     several radii are only traversed once. Memory per thread grows with number of radii.
+	 *  weights:           Weightings to calculate in the same traversal, each either NULL for weight 1 or an array of one
+	 *                     weight per segment. Weighted choice gives origin and destination segments half the score of segments
+	 *                     in between (Turner 2007), unweighted choice gives them no score.
+	 *  ret_choice:        Choice values of each weighting.
+	 *  ret_total_depths:  Sum of depth of each reached segment.
+	 *  ret_total_weights: Sum of weights of all reached segments. NOTE: Weight of ORIGIN segment is NOT INCLUDED.
+	 *  ret_total_depth_weights: Sum of depth*weight of each reached segment.
+	 *
+	 *  Output arrays hold one block of one element per segment for each radius, in order of 'radii'. ret_choice,
+	 *  ret_total_weights and ret_total_depth_weights hold one such set of blocks for each weighting, in order of 'weights'.
 	 */
 	bool Run(
 		CSegmentGraph& graph,
 		EMode mode,
-		const SPSTARadii& radii,
-		bool weigh_by_length,
+		const SPSTARadii* radii,
+		unsigned int radius_count,
+		const float* const* weights,
+		unsigned int weight_count,
 		float angle_threshold,
 		unsigned int angle_precision,
 		float* ret_choice,
@@ -59,9 +75,41 @@ public:
 		float* ret_total_depth_weights,
 		IProgressCallback& progress);
 
+	/**
+	 *  Angular integration estimated from searches from sampled pivot segments only (see PivotSampling.h), with the
+	 *  same outputs as Run() in EMode_AngularIntegration. Depths, and angular radii, are the same in both directions
+	 *  between two segments, so with every segment as pivot the results are the exact ones (up to which of several
+	 *  paths of equal rounded angle is taken). Fails for other radii, which are not (see CPivotSampler::IsSymmetric).
+	 *
+	 *  ret_total_depth_variances: Variance of each estimated total depth.
+	 *  ret_pivot_count:           Number of pivots sampled (single value).
+	 */
+	bool RunPivots(
+		CSegmentGraph& graph,
+		const SPSTARadii* radii,
+		unsigned int radius_count,
+		const float* const* weights,
+		unsigned int weight_count,
+		float angle_threshold,
+		unsigned int angle_precision,
+		const SPivotSampling& sampling,
+		unsigned int* ret_node_counts,
+		float* ret_total_depths,
+		float* ret_total_depth_variances,
+		float* ret_total_weights,
+		float* ret_total_depth_weights,
+		unsigned int* ret_pivot_count,
+		IProgressCallback& progress);
+
+	// Length of every segment, for weighing by length
+	static std::vector<float> SegmentLengths(const CSegmentGraph& graph);
+
 protected:
 
-	bool IsWeighByLength() const { return m_WeighByLength; }
+	bool Init(CSegmentGraph& graph, EMode mode, const SPSTARadii* radii, unsigned int radius_count, const float* const* weights, unsigned int weight_count, float angle_threshold, unsigned int angle_precision);
+
+	// Processes origins [first, first + count) split among the workers. Returns number of workers used.
+	unsigned int RunWorkers(unsigned int first, unsigned int count, std::atomic<unsigned int>& num_processed_segments, unsigned int progress_total, IProgressCallback& progress);
 
 	CSegmentGraph& GetGraph() { return *m_Graph; }
 
@@ -74,9 +122,10 @@ protected:
 		float m_Walking;
 		float m_Angle;
 		unsigned int m_Steps;
-	} m_Radius;
+	};
+	std::vector<SRadius> m_Radii;
 	
-	bool         m_WeighByLength;
+	std::vector<const float*> m_Weights;  // NULL for weight 1
 	float        m_AngleThresholdDegrees;
 	unsigned int m_AnglePrecisionDegrees;
 
@@ -86,6 +135,8 @@ protected:
 	float* m_TotalWeights;
 	float* m_TotalDepthWeights;  // SUM(depth*weight) for each reached node
 
+	const unsigned int* m_Origins;  // Order of origins to process if pivot sampling, otherwise NULL
+
 	class CWorker;
 
 	std::vector<std::unique_ptr<CWorker>> m_Workers;
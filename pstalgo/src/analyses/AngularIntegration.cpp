@@ -22,18 +22,51 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 #include <cmath>
 
 #include <pstalgo/analyses/AngularIntegration.h>
+#include <pstalgo/Debug.h>
 #include "../ProgressUtil.h"
 #include "AngularChoiceAlgo.h"
+#include "PivotSampling.h"
 
 PSTADllExport bool PSTAAngularIntegration(const SPSTAAngularIntegrationDesc* desc)
 {
+	if (desc->VERSION != desc->m_Version)
+	{
+		LOG_ERROR("SPSTAAngularIntegrationDesc version mismatch");
+		return false;
+	}
+
 	CAngularChoiceAlgo algo;
 	CPSTAlgoProgressCallback progress(desc->m_ProgressCallback, desc->m_ProgressCallbackUser);
+	auto& graph = *(CSegmentGraph*)desc->m_Graph;
+	const std::vector<float> lengths = desc->m_WeighByLength ? CAngularChoiceAlgo::SegmentLengths(graph) : std::vector<float>();
+	const float* weights = desc->m_WeighByLength ? lengths.data() : nullptr;
+	if (desc->m_PivotCount || desc->m_PivotTargetError > 0)
+	{
+		const SPivotSampling sampling = { desc->m_PivotCount, desc->m_PivotTargetError, desc->m_PivotSeed };
+		return algo.RunPivots(
+			graph,
+			desc->m_RadiusCount ? desc->m_Radii : &desc->m_Radius,
+			desc->m_RadiusCount ? desc->m_RadiusCount : 1,
+			&weights,
+			1,
+			desc->m_AngleThreshold,
+			desc->m_AnglePrecision,
+			sampling,
+			desc->m_OutNodeCounts,
+			desc->m_OutTotalDepths,
+			desc->m_OutTotalDepthVariances,
+			desc->m_OutTotalWeights,
+			desc->m_OutTotalDepthWeights,
+			desc->m_OutPivotCount,
+			progress);
+	}
 	return algo.Run(
-		*(CSegmentGraph*)desc->m_Graph,
+		graph,
 		CAngularChoiceAlgo::EMode_AngularIntegration,
-		desc->m_Radius,
-		desc->m_WeighByLength,
+		desc->m_RadiusCount ? desc->m_Radii : &desc->m_Radius,
+		desc->m_RadiusCount ? desc->m_RadiusCount : 1,
+		&weights,
+		1,
 		desc->m_AngleThreshold,
 		desc->m_AnglePrecision,
 		nullptr,
@@ -20,15 +20,19 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <atomic>
+#include <cmath>
 #include <future>
 #include <memory>
 
 #include <pstalgo/analyses/AttractionDistance.h>
+#include <pstalgo/experimental/DeltaSteppingSearch.h>
 #include <pstalgo/experimental/ShortestPathTraversal.h>
 #include <pstalgo/experimental/StraightLineMinDistance.h>
 #include <pstalgo/geometry/RegionPoints.h>
 #include <pstalgo/Debug.h>
 #include <pstalgo/graph/AxialGraph.h>
+#include <pstalgo/graph/ContractionHierarchy.h>
+#include <pstalgo/utils/Concurrency.h>
 
 #include "../ProgressUtil.h"
 
@@ -66,12 +70,14 @@ namespace psta
 		const graph_t&     m_Graph;
 		const float* const m_Limits;
 		const float        m_StraightLineDistLimit;
+		const bool         m_UseRadixHeap;
 		float* const       m_Results;
 
-		SAttractionDistanceWorkerContext(const graph_t& graph, const float* limits, float straight_line_dist_limit, float* ret_min_distance_per_destination)
+		SAttractionDistanceWorkerContext(const graph_t& graph, const float* limits, float straight_line_dist_limit, bool use_radix_heap, float* ret_min_distance_per_destination)
 			: m_Graph(graph)
 			, m_Limits(limits)
 			, m_StraightLineDistLimit(straight_line_dist_limit)
+			, m_UseRadixHeap(use_radix_heap)
 			, m_Results(ret_min_distance_per_destination)
 			, m_NextOrigin(0)
 		{}
@@ -92,22 +98,36 @@ namespace psta
 		std::atomic<size_t> m_NextOrigin;
 	};
 
-	void AttractionDistanceWorker(SAttractionDistanceWorkerContext& ctx)
+	template <size_t TDistCount>
+	void TAttractionDistanceWorker(SAttractionDistanceWorkerContext& ctx)
 	{
-		IShortestPathTraversal::dist_callback_t cb([&](size_t destination_index, float distance)
+		auto visit = [&](size_t destination_index, float distance)
 		{
 			float expected = -1;  // std::numeric_limits<float>::infinity();
 			while (!atomic_compare_exchange(ctx.m_Results[destination_index], expected, distance) && distance < expected);
-		});
-		auto traversal = CreateShortestPathTraversal(ctx.m_Graph);
+		};
+		TShortestPathTraversal<TDistCount> traversal(ctx.m_Graph, ctx.m_UseRadixHeap);
 		size_t origin_index;
 		while (ctx.DequeueOrigin(origin_index))
 		{
-			if (ctx.m_Graph.DistanceTypeCount() == 1)
-				traversal->SearchAccumulative(origin_index, cb, ctx.m_Limits, ctx.m_StraightLineDistLimit);
+			if (1 == TDistCount)
+				traversal.SearchAccumulative(origin_index, visit, ctx.m_Limits, ctx.m_StraightLineDistLimit);
 			else
-				traversal->Search(origin_index, cb, ctx.m_Limits, ctx.m_StraightLineDistLimit);
+				traversal.Search(origin_index, visit, ctx.m_Limits, ctx.m_StraightLineDistLimit);
+		}
+	}
+
+	void AttractionDistanceWorker(SAttractionDistanceWorkerContext& ctx)
+	{
+		switch (ctx.m_Graph.DistanceTypeCount())
+		{
+		case 1: TAttractionDistanceWorker<1>(ctx); return;
+		case 2: TAttractionDistanceWorker<2>(ctx); return;
+		case 3: TAttractionDistanceWorker<3>(ctx); return;
+		case 4: TAttractionDistanceWorker<4>(ctx); return;
+		case 5: TAttractionDistanceWorker<5>(ctx); return;
 		}
+		throw std::runtime_error("Unsupported distance type count");
 	}
 
 	void CalculateMinimumDistances(
@@ -115,6 +135,7 @@ namespace psta
 		IProgressCallback& prograss_callback, 
 		const float* limits, 
 		float straight_line_distance_limit, 
+		bool use_radix_heap,
 		float* result_buffer,
 		size_t result_buffer_size)
 	{
@@ -123,8 +144,53 @@ namespace psta
 
 		for (size_t i = 0; i < graph.DestinationCount(); ++i)
 			result_buffer[i] = -1;
+
+		// Searches with all threads working on the same search, for when there
+		// are too few searches to give every thread its own. Without a limit
+		// delta-stepping is also faster than TShortestPathTraversal on a single
+		// thread, on graphs from hundreds to millions of nodes, while limited
+		// searches reach too little of the graph to make up for it visiting every
+		// node on setup.
+		const bool use_delta_stepping = (1 == graph.DistanceTypeCount() && std::isinf(limits[0]));
+
+		if (1 == graph.DistanceTypeCount() && std::isinf(straight_line_distance_limit))
+		{
+			// Minimum distance to any origin is given by a single search from all
+			// origins at once
+			auto visit = [&](size_t destination_index, float distance)
+			{
+				result_buffer[destination_index] = distance;
+			};
+			if (use_delta_stepping)
+			{
+				CDeltaSteppingSearch search(graph);
+				search.SearchMultiSource(visit, limits);
+			}
+			else
+			{
+				TShortestPathTraversal<1> traversal(graph, use_radix_heap);
+				traversal.SearchMultiSource(visit, limits);
+			}
+			prograss_callback.ReportProgress(1);
+			return;
+		}
+
+		if (use_delta_stepping && graph.OriginNodeCount() < max_thread_count())
+		{
+			CDeltaSteppingSearch search(graph);
+			for (size_t origin_index = 0; origin_index < graph.OriginNodeCount(); ++origin_index)
+			{
+				search.Search(origin_index, [&](size_t destination_index, float distance)
+				{
+					if (result_buffer[destination_index] < 0 || distance < result_buffer[destination_index])
+						result_buffer[destination_index] = distance;
+				}, limits, straight_line_distance_limit);
+				prograss_callback.ReportProgress((float)(origin_index + 1) / graph.OriginNodeCount());
+			}
+			return;
+		}
 		
-		SAttractionDistanceWorkerContext ctx(graph, limits, straight_line_distance_limit, result_buffer);
+		SAttractionDistanceWorkerContext ctx(graph, limits, straight_line_distance_limit, use_radix_heap, result_buffer);
 		
 		// Start workers
 		std::vector<std::future<void>> tasks;
@@ -148,6 +214,66 @@ namespace psta
 		prograss_callback.ReportProgress(1);
 	}
 
+	// Same as above for walking distance without limits, but with a single search
+	// from all origins at once over a contraction hierarchy whose first nodes are
+	// the network nodes
+	void CalculateMinimumDistances(
+		const CDirectedMultiDistanceGraph& graph,
+		const CContractionHierarchy& hierarchy,
+		IProgressCallback& prograss_callback,
+		float* result_buffer,
+		size_t result_buffer_size)
+	{
+		if (graph.DestinationCount() != result_buffer_size)
+			throw std::runtime_error("Result buffer size doesn't match destination count");
+		if (graph.NetworkNodeCount() > hierarchy.NodeCount())
+			throw std::runtime_error("Contraction hierarchy doesn't match graph");
+
+		for (size_t i = 0; i < graph.DestinationCount(); ++i)
+			result_buffer[i] = -1;
+
+		auto visit = [&](size_t destination_index, float distance)
+		{
+			if (result_buffer[destination_index] < 0 || distance < result_buffer[destination_index])
+				result_buffer[destination_index] = distance;
+		};
+
+		std::vector<uint32> source_nodes;
+		std::vector<float> source_distances;
+		for (size_t origin_index = 0; origin_index < graph.OriginNodeCount(); ++origin_index)
+		{
+			graph.ForEachEdge(graph.OriginNode(origin_index), [&](const CDirectedMultiDistanceGraph::SEdge& e)
+			{
+				if (graph.EdgePointsToDestination(e))
+				{
+					visit(e.TargetIndex(), graph.EdgePrimaryDistance(e));
+					return;
+				}
+				source_nodes.push_back((uint32)e.TargetIndex());
+				source_distances.push_back(graph.EdgePrimaryDistance(e));
+			});
+		}
+
+		std::vector<float> node_distances(hierarchy.NodeCount());
+		CContractionHierarchySearch search(hierarchy);
+		search.Search(source_nodes.data(), source_distances.data(), (uint32)source_nodes.size(), node_distances.data());
+
+		for (size_t node_index = 0; node_index < graph.NetworkNodeCount(); ++node_index)
+		{
+			const float node_distance = node_distances[node_index];
+			if (std::isinf(node_distance))
+				continue;
+			graph.ForEachEdge(graph.Node(graph.NodeHandleFromIndex(node_index)), [&](const CDirectedMultiDistanceGraph::SEdge& e)
+			{
+				if (graph.EdgePointsToDestination(e))
+					visit(e.TargetIndex(), node_distance + graph.EdgePrimaryDistance(e));
+			});
+		}
+
+		// Report done
+		prograss_callback.ReportProgress(1);
+	}
+
 	// TEMP
 	std::vector<float2> NetworkElementPositions(const CAxialGraph& graph, EPSTANetworkElement element_type)
 	{
@@ -242,7 +368,20 @@ PSTADllExport bool PSTAAttractionDistance(const SPSTAAttractionDistanceDesc* des
 		for (size_t i = 0; i < attraction_points.size(); ++i)
 			attraction_points[i] = axial_graph->worldToLocal(((const double2*)desc->m_AttractionPoints)[i]);
 
-		if (desc->m_PointsPerAttractionPolygon)
+		if (desc->m_PointsPerAttractionPolygon && EPSTAPolygonPointMode_EntryPoints == desc->m_AttractionPolygonPointMode)
+		{
+			const std::vector<float2> poly_points = std::move(attraction_points);
+
+			// Points where polygon edges are closest to the network
+			attraction_points.clear();
+			const auto* pts = poly_points.data();
+			for (unsigned int polygon_index = 0; polygon_index < desc->m_AttractionPolygonCount; ++polygon_index)
+			{
+				axial_graph->getRegionEntryPoints(pts, (int)desc->m_PointsPerAttractionPolygon[polygon_index], attraction_points);
+				pts += desc->m_PointsPerAttractionPolygon[polygon_index];
+			}
+		}
+		else if (desc->m_PointsPerAttractionPolygon)
 		{
 			const std::vector<float2> poly_points = std::move(attraction_points);
 
@@ -299,7 +438,11 @@ PSTADllExport bool PSTAAttractionDistance(const SPSTAAttractionDistanceDesc* des
 
 			CPSTAlgoProgressCallback progress(desc->m_ProgressCallback, desc->m_ProgressCallbackUser);
 
-			psta::CalculateMinimumDistances(analysis_graph, progress, limits.data(), std::numeric_limits<float>::infinity(), results, result_count);
+			const auto* walking_hierarchy = axial_graph->getWalkingHierarchy();
+			if (walking_hierarchy && 1 == distance_types.size() && EPSTADistanceType_Walking == distance_types[0] && std::isinf(limits[0]))
+				psta::CalculateMinimumDistances(analysis_graph, *walking_hierarchy, progress, results, result_count);
+			else
+				psta::CalculateMinimumDistances(analysis_graph, progress, limits.data(), std::numeric_limits<float>::infinity(), desc->m_UseRadixHeap, results, result_count);
 
 			if (EPSTAOriginType_PointGroups == desc->m_OriginType)
 			{
@@ -46,63 +46,102 @@ namespace
 			, m_ProcessCounter(0)
 			, m_PolyPointIndex(0)
 		{
+			// Radii
+			if (desc.m_RadiusCount)
+				m_Radii.assign(desc.m_Radii, desc.m_Radii + desc.m_RadiusCount);
+			else
+				m_Radii.push_back(desc.m_Radius);
+
 			// Weight Function
 			m_WeightFunc = (SPSTAAttractionReachDesc::EWeightFunc)desc.m_WeightFunc;
 			m_WeightFuncConstant = desc.m_WeightFuncConstant;
-			m_WeightFuncMaxX = desc.m_Radius.Get((EPSTADistanceType)desc.m_DistanceType);
-			if (EPSTADistanceTypeMask_Steps == desc.m_DistanceType)
-				m_WeightFuncMaxX += 1.f;
+			for (const auto& radius : m_Radii)
+			{
+				float max_x = radius.Get((EPSTADistanceType)desc.m_DistanceType);
+				if (EPSTADistanceTypeMask_Steps == desc.m_DistanceType)
+					max_x += 1.f;
+				m_WeightFuncMaxX.push_back(max_x);
+			}
 		}
 
 		static bool Run(const SPSTAAttractionReachDesc& desc);
 
 		const SPSTAAttractionReachDesc& Desc() const { return m_Desc; }
 
-		bool IsAttractionPolygons() const { return m_Desc.m_PointsPerAttractionPolygon && (m_Desc.m_AttractionPolygonPointInterval > 0); }
+		bool IsAttractionPolygons() const { return m_Desc.m_PointsPerAttractionPolygon && (IsAttractionPolygonEntryPoints() || m_Desc.m_AttractionPolygonPointInterval > 0); }
+
+		bool IsAttractionPolygonEntryPoints() const { return EPSTAPolygonPointMode_EntryPoints == m_Desc.m_AttractionPolygonPointMode; }
 
 		bool NextAttractionPoint(COORDS& ret_point_local, float& ret_attraction_value);
 
-		bool NextAttractionPolygon(std::vector<double2>& ret_points_world, float& ret_attraction_value);
+		// 'tmp_points_world' is scratch memory, reused between calls
+		bool NextAttractionPolygon(std::vector<double2>& tmp_points_world, std::vector<COORDS>& ret_points_local, float& ret_attraction_value);
 
 		float Progress() const;
 
+		unsigned int RadiusCount() const { return (unsigned int)m_Radii.size(); }
+
 		// Weight function attributes
 		SPSTAAttractionReachDesc::EWeightFunc WeightFunc() const { return m_WeightFunc; }
-		float WeightFuncMaxX() const { return m_WeightFuncConstant; }
-		float WeightFuncConstant() const { return m_WeightFuncMaxX; }
+		float WeightFuncMaxX(unsigned int radius_index) const { return m_WeightFuncMaxX[radius_index]; }
+		float WeightFuncConstant() const { return m_WeightFuncConstant; }
 
-		float GetWeightValue(float x) const;
+		float GetWeightValue(float x, unsigned int radius_index) const;
 
 	private:
-		class CWorker : public CPSTBFS
+		class CWorker : public TPSTBFS<CWorker>
 		{
-			typedef CPSTBFS super_t;
+			typedef TPSTBFS<CWorker> super_t;
+			friend class CPSTBFS;
 		public:
 			CWorker(CAttractionAlgo& algo)
 				: m_Algo(algo) {}
 
 			CWorker& operator=(const CWorker&) = delete;
 
+			// Traversal of either all radii (shared_metric != 0, see
+			// CPSTBFS::getSharedRadiusLimits) or one radius at a time.
+			void Init(CAxialGraph* graph, Target target, const LIMITS& limits, unsigned int first_radius, unsigned int radius_end, unsigned int shared_metric);
+
 			void Run();
 
+			// One block of one element per target for each radius
 			const std::vector<float>& Results() const { return m_Results; }
 
 		private:
 			void ProcessPoint(const COORDS& pt, float attraction_value);
 
+			// Best scores of each radius from shortest distances of shared traversal
+			void CollectRadiusScores();
+
+			// Adds best scores of last processed point to results
+			void AccumulateScores();
+
 			// CPSTBFS Overrides
-			void visitBFS(int iTarget, const DIST& dist) override;
+			void visitBFS(int iTarget, const DIST& dist) override final;
+
+			float GetDistance(int iTarget, const DIST& dist) const;
 
-			float GetWeightValue(float x) const { return m_Algo.GetWeightValue(x); }
+			float GetWeightValue(float x) const { return m_Algo.GetWeightValue(x, m_FirstRadius); }
+
+			float* BestScores() { return m_bestScores.data() + (size_t)m_FirstRadius * getTargetCount(); }
 
 			CAttractionAlgo& m_Algo;
 
+			// Radii of current traversal
+			unsigned int m_FirstRadius = 0;
+			unsigned int m_RadiusEnd = 1;
+			unsigned int m_SharedMetric = 0;
+			std::vector<float> m_RadiusLimits;  // Limit of m_SharedMetric for each radius
+
 			float m_CurrentAttractionValue;
 
 			CBitVector m_TargetVisitedBits; // Bit-mask of targets visited during last call to processPoint
 			std::vector<int> m_visitedTargets;    // Indices of targets visited during last call to processPoint
 
-			std::vector<REAL> m_bestScores;  // Temporary to each ProcessPoint call. Stores best score for each reached target for the processed point.
+			std::vector<REAL> m_bestScores;  // Temporary to each ProcessPoint call. Stores best score for each reached target (and radius) for the processed point.
+			std::vector<float> m_TargetMetricDistances;  // Shared traversal only, shortest m_SharedMetric distance to each visited target
+			std::vector<float> m_TargetDistances;        // Shared traversal only, distance to each visited target by the shortest path above
 
 			std::vector<REAL> m_Results;  // Accumulated score for all processed points
 		};
@@ -115,9 +154,11 @@ namespace
 
 		unsigned int m_PolyPointIndex;
 
+		std::vector<SPSTARadii> m_Radii;
+
 		// Weight function attributes
 		SPSTAAttractionReachDesc::EWeightFunc m_WeightFunc;
-		float m_WeightFuncMaxX;
+		std::vector<float> m_WeightFuncMaxX;  // Per radius
 		float m_WeightFuncConstant;
 	};
 
@@ -201,6 +242,19 @@ namespace
 		}
 
 		CAttractionAlgo algo(desc);
+		const unsigned int radius_count = algo.RadiusCount();
+
+		const DistanceType distance_type = DistanceTypeFromEPSTADistanceType((EPSTADistanceType)desc.m_DistanceType);
+		std::vector<LIMITS> limits;
+		for (const auto& radius : algo.m_Radii)
+			limits.push_back(LimitsFromSPSTARadii(radius));
+
+		// Radii that only differ in one distance share traversal, otherwise
+		// there is one pass over all attractions per radius
+		LIMITS shared_limits;
+		unsigned int shared_metric = 0;
+		const bool shared = radius_count > 1 && CPSTBFS::getSharedRadiusLimits(limits.data(), radius_count, distance_type, shared_limits, shared_metric);
+		const unsigned int pass_count = shared ? 1 : radius_count;
 
 		// Create workers
 		std::vector<std::unique_ptr<CWorker>> workers;
@@ -210,70 +264,90 @@ namespace
 			workers.resize(1);
 		#endif
 		for (auto& w : workers)
-		{
 			w.reset(new CWorker(algo));
-			w->init(&graph, target_type, DistanceTypeFromEPSTADistanceType((EPSTADistanceType)desc.m_DistanceType), LimitsFromSPSTARadii(desc.m_Radius));
-		}
-
-		const auto target_count = (unsigned int)workers.front()->getTargetCount();
-		const auto output_count = (EPSTAOriginType_PointGroups == desc.m_OriginType) ? graph.getPointGroupCount() : target_count;
-		if (output_count != desc.m_OutputCount)
-		{
-			LOG_ERROR("Internal Error: CAttractionAlgo: Output count doesn't match target count!");
-			return false;
-		}
 
 		CPSTAlgoProgressCallback progress(desc.m_ProgressCallback, desc.m_ProgressCallbackUser);
 
-		// Start workers
-		std::vector<std::future<void>> tasks;
-		tasks.reserve(workers.size());
-		for (auto& w : workers)
+		for (unsigned int pass_index = 0; pass_index < pass_count; ++pass_index)
 		{
-			tasks.push_back(std::async(
-				std::launch::async,
-				&CWorker::Run,
-				w.get()));
-		}
+			for (auto& w : workers)
+			{
+				if (shared)
+					w->Init(&graph, target_type, shared_limits, 0, radius_count, shared_metric);
+				else
+					w->Init(&graph, target_type, limits[pass_index], pass_index, pass_index + 1, 0);
+			}
 
-		// Loop through tasks and wait for each one to finish
-		for (size_t task_index = 0; task_index < tasks.size(); ++task_index)
-		{
-			auto& task = tasks[task_index];
+			if (0 == pass_index)
+			{
+				const auto target_count = (unsigned int)workers.front()->getTargetCount();
+				const auto output_count = (EPSTAOriginType_PointGroups == desc.m_OriginType) ? graph.getPointGroupCount() : target_count;
+				if (output_count * radius_count != desc.m_OutputCount)
+				{
+					LOG_ERROR("Internal Error: CAttractionAlgo: Output count doesn't match target count!");
+					return false;
+				}
+			}
 
-			// Wait for task to finish, and update progress every 100ms
-			do {
-				progress.ReportProgress(algo.Progress());
-			} while (std::future_status::ready != task.wait_for(std::chrono::milliseconds(100)));
-		}
+			algo.m_ProcessCounter = 0;
+			algo.m_PolyPointIndex = 0;
 
-		if (algo.IsAttractionPolygons() && desc.m_AttractionPointCount != algo.m_PolyPointIndex)
-		{
-			LOG_ERROR("Polygon point counts do not add up to total point count (%d vs %d)!", algo.m_PolyPointIndex, desc.m_AttractionPointCount);
-			return false;
+			// Start workers
+			std::vector<std::future<void>> tasks;
+			tasks.reserve(workers.size());
+			for (auto& w : workers)
+			{
+				tasks.push_back(std::async(
+					std::launch::async,
+					&CWorker::Run,
+					w.get()));
+			}
+
+			// Loop through tasks and wait for each one to finish
+			for (size_t task_index = 0; task_index < tasks.size(); ++task_index)
+			{
+				auto& task = tasks[task_index];
+
+				// Wait for task to finish, and update progress every 100ms
+				do {
+					progress.ReportProgress((pass_index + algo.Progress()) / pass_count);
+				} while (std::future_status::ready != task.wait_for(std::chrono::milliseconds(100)));
+			}
+
+			if (algo.IsAttractionPolygons() && desc.m_AttractionPointCount != algo.m_PolyPointIndex)
+			{
+				LOG_ERROR("Polygon point counts do not add up to total point count (%d vs %d)!", algo.m_PolyPointIndex, desc.m_AttractionPointCount);
+				return false;
+			}
 		}
 
 		// Collect scores
 		if (desc.m_OutScores)
 		{
-			if (EPSTAOriginType_PointGroups == desc.m_OriginType)
+			const size_t target_count = workers.front()->Results().size() / radius_count;
+			const size_t output_count = desc.m_OutputCount / radius_count;
+			for (unsigned int radius_index = 0; radius_index < radius_count; ++radius_index)
 			{
-				ASSERT((unsigned int)graph.getPointCount() == workers.front()->Results().size());
-				ASSERT(graph.getPointGroupCount() == desc.m_OutputCount);
-				std::vector<const float*> worker_scores;
-				for (const auto& w : workers)
-					worker_scores.push_back(w->Results().data());
-				CollectPointGroupScores(graph, worker_scores.data(), (unsigned int)worker_scores.size(), (SPSTAAttractionReachDesc::EAttractionCollectionFunc)desc.m_AttractionCollectionFunc, desc.m_OutScores);
-			}
-			else
-			{
-				ASSERT(workers.front()->Results().size() == desc.m_OutputCount);
-				for (unsigned int i = 0; i < desc.m_OutputCount; ++i)
+				float* out_scores = desc.m_OutScores + radius_index * output_count;
+				if (EPSTAOriginType_PointGroups == desc.m_OriginType)
 				{
-					double score = 0;
+					ASSERT((unsigned int)graph.getPointCount() == target_count);
+					ASSERT(graph.getPointGroupCount() == output_count);
+					std::vector<const float*> worker_scores;
 					for (const auto& w : workers)
-						score += w->Results()[i];
-					desc.m_OutScores[i] = (float)score;
+						worker_scores.push_back(w->Results().data() + radius_index * target_count);
+					CollectPointGroupScores(graph, worker_scores.data(), (unsigned int)worker_scores.size(), (SPSTAAttractionReachDesc::EAttractionCollectionFunc)desc.m_AttractionCollectionFunc, out_scores);
+				}
+				else
+				{
+					ASSERT(target_count == output_count);
+					for (size_t i = 0; i < output_count; ++i)
+					{
+						double score = 0;
+						for (const auto& w : workers)
+							score += w->Results()[radius_index * target_count + i];
+						out_scores[i] = (float)score;
+					}
 				}
 			}
 		}
@@ -299,7 +373,7 @@ namespace
 		return true;
 	}
 
-	bool CAttractionAlgo::NextAttractionPolygon(std::vector<double2>& ret_points_world, float& ret_polygon_attraction_value)
+	bool CAttractionAlgo::NextAttractionPolygon(std::vector<double2>& tmp_points_world, std::vector<COORDS>& ret_points_local, float& ret_polygon_attraction_value)
 	{
 		ASSERT(IsAttractionPolygons());
 
@@ -322,8 +396,23 @@ namespace
 			}
 		}
 
-		// Generate list of points along polygon edge
-		GeneratePointsAlongRegionEdge(poly_points, poly_point_count, m_Desc.m_AttractionPolygonPointInterval, ret_points_world);
+		ret_points_local.clear();
+		if (IsAttractionPolygonEntryPoints())
+		{
+			// Generate list of points where polygon edge is closest to network
+			std::vector<COORDS> poly_points_local(poly_point_count);
+			for (unsigned int i = 0; i < poly_point_count; ++i)
+				poly_points_local[i] = m_Graph.worldToLocal(poly_points[i]);
+			m_Graph.getRegionEntryPoints(poly_points_local.data(), (int)poly_point_count, ret_points_local);
+		}
+		else
+		{
+			// Generate list of points along polygon edge
+			GeneratePointsAlongRegionEdge(poly_points, poly_point_count, m_Desc.m_AttractionPolygonPointInterval, tmp_points_world);
+			ret_points_local.reserve(tmp_points_world.size());
+			for (const auto& pt : tmp_points_world)
+				ret_points_local.push_back(m_Graph.worldToLocal(pt));
+		}
 
 		return true;
 	}
@@ -333,17 +422,17 @@ namespace
 		return (float)m_ProcessCounter / (IsAttractionPolygons() ? m_Desc.m_AttractionPolygonCount : m_Desc.m_AttractionPointCount);
 	}
 
-	float CAttractionAlgo::GetWeightValue(float x) const
+	float CAttractionAlgo::GetWeightValue(float x, unsigned int radius_index) const
 	{
 		switch (m_WeightFunc)
 		{
 		case SPSTAAttractionReachDesc::EWeightFunc_Constant:
 			return 1.f;
 		case SPSTAAttractionReachDesc::EWeightFunc_Pow:
-			x /= m_WeightFuncMaxX;
+			x /= m_WeightFuncMaxX[radius_index];
 			return 1.f - powf(x, m_WeightFuncConstant);
 		case SPSTAAttractionReachDesc::EWeightFunc_Curve:
-			x /= m_WeightFuncMaxX;
+			x /= m_WeightFuncMaxX[radius_index];
 			return (x < .5f) ? 1.f - .5f * pow(2.f * x, m_WeightFuncConstant) : .5f * pow(2.f - 2.f * x, m_WeightFuncConstant);
 		case SPSTAAttractionReachDesc::EWeightFunc_Divide:
 			return powf(x + 1, -m_WeightFuncConstant);
@@ -352,17 +441,38 @@ namespace
 		return 0.f;
 	}
 
+	void CAttractionAlgo::CWorker::Init(CAxialGraph* graph, Target target, const LIMITS& limits, unsigned int first_radius, unsigned int radius_end, unsigned int shared_metric)
+	{
+		init(graph, target, DistanceTypeFromEPSTADistanceType((EPSTADistanceType)m_Algo.Desc().m_DistanceType), limits);
+		m_FirstRadius = first_radius;
+		m_RadiusEnd = radius_end;
+		m_SharedMetric = shared_metric;
+		m_RadiusLimits.clear();
+		if (shared_metric)
+		{
+			for (unsigned int radius_index = first_radius; radius_index < radius_end; ++radius_index)
+				m_RadiusLimits.push_back(getMetricLimit(LimitsFromSPSTARadii(m_Algo.m_Radii[radius_index]), shared_metric));
+		}
+	}
+
 	void CAttractionAlgo::CWorker::Run()
 	{
 		ASSERT(m_pGraph);
 
-		const auto target_count = getTargetCount();
+		const size_t target_count = getTargetCount();
+		const size_t radius_count = m_Algo.RadiusCount();
 
-		m_Results.clear();
-		m_Results.resize(target_count, 0);
+		// Results of radii of previous passes are kept
+		m_Results.resize(target_count * radius_count, 0);
+		std::fill(m_Results.begin() + m_FirstRadius * target_count, m_Results.begin() + m_RadiusEnd * target_count, 0.f);
 
 		// These are used and reset in every call to ProcessPoint
-		m_bestScores.resize(target_count);
+		m_bestScores.resize(target_count * radius_count);
+		if (m_SharedMetric)
+		{
+			m_TargetMetricDistances.resize(target_count);
+			m_TargetDistances.resize(target_count);
+		}
 		m_visitedTargets.clear();
 		m_visitedTargets.reserve(target_count);
 		m_TargetVisitedBits.resize(target_count);
@@ -376,8 +486,9 @@ namespace
 				// of the attraction value of the polygon. This also means we need to SUM all attraction values on 
 				// the target points during processing of the points for this polygon. 
 				float polygon_attraction_value;
-				std::vector<double2> edge_points;
-				while (m_Algo.NextAttractionPolygon(edge_points, polygon_attraction_value))
+				std::vector<double2> tmp_points;
+				std::vector<COORDS> edge_points;
+				while (m_Algo.NextAttractionPolygon(tmp_points, edge_points, polygon_attraction_value))
 				{
 					if (edge_points.empty())
 						continue;
@@ -385,9 +496,8 @@ namespace
 					// Process all generated points for this polygon
 					for (const auto& pt : edge_points)
 					{
-						ProcessPoint(m_pGraph->worldToLocal(pt), attraction_value_per_point);
-						for (int target_index : m_visitedTargets)
-							m_Results[target_index] += m_bestScores[target_index];
+						ProcessPoint(pt, attraction_value_per_point);
+						AccumulateScores();
 					}
 					edge_points.clear();
 				}
@@ -398,30 +508,32 @@ namespace
 				// value as the polygon - then we should store the MAX attraction value at every target during processing
 				// of the points for this polygon. This is more complecated then above...
 				std::vector<float> max_scores;
-				max_scores.resize(target_count, 0);
+				max_scores.resize(target_count * radius_count, 0);
 				std::vector<unsigned int> poly_visited_target_indices;
 				CBitVector poly_visited_target_bits;
 				poly_visited_target_bits.resize(target_count);
 				poly_visited_target_bits.clearAll();
 				float polygon_attraction_value;
-				std::vector<double2> edge_points;
-				while (m_Algo.NextAttractionPolygon(edge_points, polygon_attraction_value))
+				std::vector<double2> tmp_points;
+				std::vector<COORDS> edge_points;
+				while (m_Algo.NextAttractionPolygon(tmp_points, edge_points, polygon_attraction_value))
 				{
 					// Process all generated points for this polygon
 					for (const auto& pt : edge_points)
 					{
-						ProcessPoint(m_pGraph->worldToLocal(pt), polygon_attraction_value);
+						ProcessPoint(pt, polygon_attraction_value);
 						for (auto target_index : m_visitedTargets)
 						{
-							if (!poly_visited_target_bits.get(target_index))
+							const bool first_visit = !poly_visited_target_bits.get(target_index);
+							if (first_visit)
 							{
 								poly_visited_target_bits.set(target_index);
 								poly_visited_target_indices.push_back(target_index);
-								max_scores[target_index] = m_bestScores[target_index];
 							}
-							else
+							for (size_t radius_index = m_FirstRadius; radius_index < m_RadiusEnd; ++radius_index)
 							{
-								max_scores[target_index] = std::max(max_scores[target_index], m_bestScores[target_index]);
+								const size_t score_index = radius_index * target_count + target_index;
+								max_scores[score_index] = first_visit ? m_bestScores[score_index] : std::max(max_scores[score_index], m_bestScores[score_index]);
 							}
 						}
 					}
@@ -429,7 +541,8 @@ namespace
 					// Accumulate the max values for each reached target
 					for (auto target_index : poly_visited_target_indices)
 					{
-						m_Results[target_index] += max_scores[target_index];
+						for (size_t radius_index = m_FirstRadius; radius_index < m_RadiusEnd; ++radius_index)
+							m_Results[radius_index * target_count + target_index] += max_scores[radius_index * target_count + target_index];
 						poly_visited_target_bits.clear(target_index);
 					}
 					poly_visited_target_indices.clear();
@@ -448,12 +561,23 @@ namespace
 			while (m_Algo.NextAttractionPoint(attraction_point_local, attraction_value))
 			{
 				ProcessPoint(attraction_point_local, attraction_value);
-				for (int target_index : m_visitedTargets)
-					m_Results[target_index] += m_bestScores[target_index];
+				AccumulateScores();
 			}
 		}
 	}
 
+	void CAttractionAlgo::CWorker::AccumulateScores()
+	{
+		const size_t target_count = getTargetCount();
+		for (size_t radius_index = m_FirstRadius; radius_index < m_RadiusEnd; ++radius_index)
+		{
+			float* results = m_Results.data() + radius_index * target_count;
+			const float* best_scores = m_bestScores.data() + radius_index * target_count;
+			for (int target_index : m_visitedTargets)
+				results[target_index] += best_scores[target_index];
+		}
+	}
+
 	void CAttractionAlgo::CWorker::ProcessPoint(const COORDS& pt, float attraction_value)
 	{
 		m_CurrentAttractionValue = attraction_value;
@@ -475,7 +599,7 @@ namespace
 					const float dist_sqr = (pt2 - pt).getLengthSqr();
 					if (dist_sqr > maxDistSqr)
 						continue;
-					m_bestScores[iTarget] = attraction_value * GetWeightValue(sqrt(dist_sqr));
+					BestScores()[iTarget] = attraction_value * GetWeightValue(sqrt(dist_sqr));
 					m_visitedTargets.push_back(iTarget);
 				}
 			}
@@ -494,7 +618,7 @@ namespace
 						CAxialGraph::getNearestPoint(pt, l.p1, l.p2, &dist);
 						if (dist <= radius) 
 						{
-							m_bestScores[iLine] = attraction_value * GetWeightValue(radius);
+							BestScores()[iLine] = attraction_value * GetWeightValue(radius);
 							m_visitedTargets.push_back(iLine);
 						}
 					}
@@ -507,7 +631,7 @@ namespace
 						const CAxialGraph::NETWORKLINE& l = m_pGraph->getLine(iLine);
 						float dist;
 						CAxialGraph::getNearestPoint(pt, l.p1, l.p2, &dist);
-						m_bestScores[iLine] = attraction_value * GetWeightValue(dist);
+						BestScores()[iLine] = attraction_value * GetWeightValue(dist);
 						m_visitedTargets.push_back(iLine);
 					}
 				}
@@ -518,10 +642,59 @@ namespace
 			clrVisitedLineCrossings();
 
 			doBFSFromPoint(pt);
+
+			if (m_SharedMetric)
+				CollectRadiusScores();
+		}
+	}
+
+	void CAttractionAlgo::CWorker::CollectRadiusScores()
+	{
+		const size_t target_count = getTargetCount();
+		for (unsigned int radius_index = m_FirstRadius; radius_index < m_RadiusEnd; ++radius_index)
+		{
+			const float limit = m_RadiusLimits[radius_index - m_FirstRadius];
+			float* best_scores = m_bestScores.data() + radius_index * target_count;
+			// Targets outside of radius add nothing
+			for (int target_index : m_visitedTargets)
+				best_scores[target_index] = (m_TargetMetricDistances[target_index] <= limit) ? m_CurrentAttractionValue * m_Algo.GetWeightValue(m_TargetDistances[target_index], radius_index) : 0;
 		}
 	}
 
 	void CAttractionAlgo::CWorker::visitBFS(int iTarget, const DIST& dist)
+	{
+		const float d = GetDistance(iTarget, dist);
+
+		if (m_SharedMetric)
+		{
+			// Shared traversal of several radii, keep shortest distance
+			const float metric_distance = getMetricDistance(dist, m_SharedMetric);
+			if (!m_TargetVisitedBits.get(iTarget))
+			{
+				m_TargetVisitedBits.set(iTarget);
+				m_visitedTargets.push_back(iTarget);
+			}
+			else if (metric_distance >= m_TargetMetricDistances[iTarget])
+				return;
+			m_TargetMetricDistances[iTarget] = metric_distance;
+			m_TargetDistances[iTarget] = d;
+			return;
+		}
+
+		const float score = m_CurrentAttractionValue * GetWeightValue(d);
+
+		if (!m_TargetVisitedBits.get(iTarget)) 
+		{
+			m_TargetVisitedBits.set(iTarget);
+			m_visitedTargets.push_back(iTarget);
+		}
+		else if (score <= BestScores()[iTarget]) 
+			return;
+
+		BestScores()[iTarget] = score;
+	}
+
+	float CAttractionAlgo::CWorker::GetDistance(int iTarget, const DIST& dist) const
 	{
 		float d = 0;
 		switch (m_distType) 
@@ -554,18 +727,7 @@ namespace
 				ASSERT(false && "Unsupported distance type!");
 				break;
 		}
-
-		const float score = m_CurrentAttractionValue * GetWeightValue(d);
-
-		if (!m_TargetVisitedBits.get(iTarget)) 
-		{
-			m_TargetVisitedBits.set(iTarget);
-			m_visitedTargets.push_back(iTarget);
-		}
-		else if (score <= m_bestScores[iTarget]) 
-			return;
-
-		m_bestScores[iTarget] = score;
+		return d;
 	}
 }
 
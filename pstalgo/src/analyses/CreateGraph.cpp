@@ -19,10 +19,13 @@ You should have received a copy of the GNU Lesser General Public License
 along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+
 #include <pstalgo/analyses/CreateGraph.h>
 #include <pstalgo/geometry/RegionPoints.h>
 #include <pstalgo/Debug.h>
 #include <pstalgo/graph/AxialGraph.h>
+#include <pstalgo/graph/ContractionHierarchy.h>
 #include <pstalgo/geometry/Rect.h>
 #include <pstalgo/graph/SegmentGraph.h>
 
@@ -68,6 +71,38 @@ bool GeneratePointGroupsFromRegions(
 	return true;
 }
 
+bool GeneratePointGroupsFromRegions(
+	const unsigned int* points_per_region, unsigned int region_count,
+	const double2* region_points, unsigned int point_count,
+	const CAxialGraph& graph,
+	std::vector<unsigned int>& ret_point_group_sizes,
+	std::vector<float2>& ret_points)
+{
+	unsigned int point_index = 0;
+	for (unsigned int i = 0; i < region_count; ++i)
+		point_index += points_per_region[i];
+	if (point_count != point_index)
+	{
+		LOG_ERROR("Polygon point counts do not add up to total point count (%d vs %d)!", point_index, point_count);
+		return false;
+	}
+	ret_point_group_sizes.reserve(region_count);
+	std::vector<float2> local_region_points;
+	point_index = 0;
+	for (unsigned int i = 0; i < region_count; ++i)
+	{
+		const auto region_point_count = points_per_region[i];
+		local_region_points.resize(region_point_count);
+		for (unsigned int j = 0; j < region_point_count; ++j)
+			local_region_points[j] = graph.worldToLocal(region_points[point_index + j]);
+		point_index += region_point_count;
+		const auto prev_count = ret_points.size();
+		graph.getRegionEntryPoints(local_region_points.data(), (int)region_point_count, ret_points);
+		ret_point_group_sizes.push_back((unsigned int)(ret_points.size() - prev_count));
+	}
+	return true;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // Axial Graph
@@ -111,7 +146,12 @@ PSTADllExport HPSTAGraph PSTACreateGraph(const SPSTACreateGraphDesc* desc)
 	// Points
 	std::vector<COORDS> points;
 	std::vector<unsigned int> point_groups;
-	if (desc->m_PolygonCount)
+	if (desc->m_PolygonCount && EPSTAPolygonPointMode_EntryPoints == desc->m_PolygonPointMode)
+	{
+		// Entry points depend on the network, they are generated and
+		// connected once the graph has been created (see below).
+	}
+	else if (desc->m_PolygonCount)
 	{
 		if (!GeneratePointGroupsFromRegions(
 			desc->m_PointsPerPolygon, desc->m_PolygonCount,
@@ -138,13 +178,29 @@ PSTADllExport HPSTAGraph PSTACreateGraph(const SPSTACreateGraphDesc* desc)
 		unlinks.empty() ? nullptr : unlinks.data(), (int)unlinks.size(),
 		points.empty() ? nullptr : points.data(), (int)points.size());
 
+	// Set world origin
+	graph->setWorldOrigin(world_origin);
+
+	// Entry points of polygons into the network
+	if (desc->m_PolygonCount && EPSTAPolygonPointMode_EntryPoints == desc->m_PolygonPointMode)
+	{
+		if (!GeneratePointGroupsFromRegions(
+			desc->m_PointsPerPolygon, desc->m_PolygonCount,
+			desc->m_PointCoords, desc->m_PointCount,
+			*graph,
+			point_groups,
+			points))
+		{
+			delete graph;
+			return 0;
+		}
+		graph->setPoints(points.empty() ? nullptr : points.data(), (int)points.size());
+	}
+
 	// Add point groups if available
 	if (!point_groups.empty())
 		graph->setPointGroups(std::move(point_groups));
 
-	// Set world origin
-	graph->setWorldOrigin(world_origin);
-
 	return graph;
 }
 
@@ -210,6 +266,92 @@ PSTADllExport int PSTAGetGraphCrossingCoords(HPSTAGraph handle, double2* out_coo
 	return count;
 }
 
+// Edges of the walking distance graph of line crossings used by
+// BuildDirectedMultiDistanceGraph, where every line crossing has an edge to the
+// opposite of every other line crossing of its line at a different position.
+// Instead of these O(n^2) edges per line we add two chains of extra nodes per
+// line (one per direction) with a node per distinct position of crossings,
+// which gives the same distances but a graph that contracts far better.
+static uint32 GetWalkingHierarchyEdges(const CAxialGraph& graph, std::vector<CContractionHierarchy::SEdge>& ret_edges)
+{
+	uint32 node_count = (uint32)graph.getLineCrossingCount();
+	std::vector<std::pair<float, uint32>> crossings_by_pos;
+	for (int line_index = 0; line_index < graph.getLineCount(); ++line_index)
+	{
+		const auto& line = graph.getLine(line_index);
+		crossings_by_pos.clear();
+		for (int i = 0; i < line.nCrossings; ++i)
+			crossings_by_pos.push_back(std::make_pair(graph.getLineCrossing(line.iFirstCrossing + i).linePos, (uint32)(line.iFirstCrossing + i)));
+		std::sort(crossings_by_pos.begin(), crossings_by_pos.end());
+
+		// Chain node of position index 'p' is 'first_fwd + p' forwards and 'first_bwd + p' backwards
+		uint32 position_count = 0;
+		for (size_t i = 0; i < crossings_by_pos.size(); ++i)
+			if (0 == i || crossings_by_pos[i].first != crossings_by_pos[i - 1].first)
+				++position_count;
+		const uint32 first_fwd = node_count;
+		const uint32 first_bwd = node_count + position_count;
+		node_count += position_count * 2;
+
+		uint32 position_index = 0;
+		for (size_t i = 0; i < crossings_by_pos.size(); ++i)
+		{
+			const float pos = crossings_by_pos[i].first;
+			const uint32 lc_index = crossings_by_pos[i].second;
+			if (i > 0 && pos != crossings_by_pos[i - 1].first)
+				++position_index;
+
+			// Line crossing to next position in each direction
+			size_t next = i;
+			while (next < crossings_by_pos.size() && crossings_by_pos[next].first == pos)
+				++next;
+			if (next < crossings_by_pos.size())
+				ret_edges.push_back({ lc_index, first_fwd + position_index + 1, crossings_by_pos[next].first - pos });
+			size_t prev = i;
+			while (prev > 0 && crossings_by_pos[prev - 1].first == pos)
+				--prev;
+			if (prev > 0)
+				ret_edges.push_back({ lc_index, first_bwd + position_index - 1, pos - crossings_by_pos[prev - 1].first });
+
+			// Chain to opposite line crossing
+			const uint32 opposite_index = (uint32)graph.getLineCrossing(lc_index).iOpposite;
+			ret_edges.push_back({ first_fwd + position_index, opposite_index, 0 });
+			ret_edges.push_back({ first_bwd + position_index, opposite_index, 0 });
+
+			// Chains
+			if (i + 1 < crossings_by_pos.size() && crossings_by_pos[i + 1].first != pos)
+			{
+				const float length = crossings_by_pos[i + 1].first - pos;
+				ret_edges.push_back({ first_fwd + position_index, first_fwd + position_index + 1, length });
+				ret_edges.push_back({ first_bwd + position_index + 1, first_bwd + position_index, length });
+			}
+		}
+		ASSERT(position_count == (crossings_by_pos.empty() ? 0 : position_index + 1));
+	}
+	return node_count;
+}
+
+PSTADllExport bool PSTACreateGraphWalkingHierarchy(HPSTAGraph handle)
+{
+	try
+	{
+		auto* graph = static_cast<CAxialGraph*>(handle);
+
+		std::vector<CContractionHierarchy::SEdge> edges;
+		const uint32 node_count = GetWalkingHierarchyEdges(*graph, edges);
+
+		std::unique_ptr<CContractionHierarchy> hierarchy(new CContractionHierarchy);
+		hierarchy->Create(node_count, edges.data(), edges.size());
+		graph->setWalkingHierarchy(std::move(hierarchy));
+	}
+	catch (const std::exception& e)
+	{
+		LOG_ERROR(e.what());
+		return false;
+	}
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Segment Graph
 
@@ -232,6 +374,25 @@ PSTADllExport void PSTAFreeSegmentGraph(HPSTASegmentGraph handle)
 	delete graph;
 }
 
+PSTADllExport int PSTAGetSegmentGraphLengths(HPSTASegmentGraph handle, float* out_lengths, unsigned int count)
+{
+	const auto* graph = static_cast<CSegmentGraph*>(handle);
+
+	if (nullptr == out_lengths)
+		return graph->GetSegmentCount();
+
+	if (graph->GetSegmentCount() != count)
+	{
+		LOG_ERROR("Number of segments in graph (%d) doesn't match output array size (%d)!", graph->GetSegmentCount(), count);
+		return -1;
+	}
+
+	for (unsigned int i = 0; i < graph->GetSegmentCount(); ++i)
+		out_lengths[i] = graph->GetSegment(i).m_Length;
+
+	return count;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Segment Group Graph
 
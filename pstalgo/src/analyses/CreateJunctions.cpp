@@ -20,7 +20,9 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <future>
 #include <memory>
 #include <vector>
 
@@ -30,6 +32,8 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 #include <pstalgo/maths.h>
 #include "../ProgressUtil.h"
 
+#define USE_MULTIPLE_CORES
+
 namespace
 {
 	const float MIN_TAIL_FRACTION = 0.02f;
@@ -106,65 +110,112 @@ private:
 		}
 	}
 
-	void FindJunctions(const CLine2f* lines, unsigned int line_count, std::vector<double2>& ret_junctions, IProgressCallback& progress)
+	// Per-thread state for parallel junction search
+	struct SWorker
+	{
+		std::vector<unsigned int> m_VisitStamps;  // Index of last query line that visited each candidate line
+		std::vector<double2> m_Junctions;
+	};
+
+	// Calls fn(worker, line_index) for every line index in [0, line_count) using all
+	// available cores, and appends junctions found by all workers to 'ret_junctions'.
+	template <class TFunc>
+	void ForEachLineParallel(unsigned int line_count, unsigned int candidate_count, std::vector<double2>& ret_junctions, IProgressCallback& progress, TFunc&& fn)
 	{
 		using namespace std;
 
-		CLineAABSPTree bsp = CLineAABSPTree::Create(reinterpret_cast<const float2*>(lines), line_count, 16);
+		const unsigned int BATCH_SIZE = 64;
 
-		std::vector<CLineAABSPTree::SObjectSet> sets;
+		#ifdef USE_MULTIPLE_CORES
+			std::vector<SWorker> workers(max(std::thread::hardware_concurrency(), 1u));
+		#else
+			std::vector<SWorker> workers(1);
+		#endif
 
-		std::vector<unsigned int> tmp;
+		std::atomic<unsigned int> next_line(0);
+		std::atomic<unsigned int> num_processed_lines(0);
 
-		for (unsigned int l0_index = 0; l0_index < line_count; ++l0_index)
+		auto worker_func = [&](SWorker& worker)
 		{
-			const auto& l0 = lines[l0_index];
+			worker.m_VisitStamps.resize(candidate_count, (unsigned int)-1);
+			for (;;)
+			{
+				const unsigned int first = next_line.fetch_add(BATCH_SIZE);
+				if (first >= line_count)
+					break;
+				const unsigned int last = min(first + BATCH_SIZE, line_count);
+				for (unsigned int line_index = first; line_index < last; ++line_index)
+					fn(worker, line_index);
+				num_processed_lines += last - first;
+			}
+		};
 
-			if (l0.p1 == l0.p2)
-				continue;  // Zero length
+		std::vector<std::future<void>> tasks;
+		tasks.reserve(workers.size());
+		for (auto& worker : workers)
+			tasks.push_back(std::async(std::launch::async, worker_func, std::ref(worker)));
+
+		// Wait for tasks to finish, and update progress every 100ms
+		for (auto& task : tasks)
+		{
+			while (std::future_status::ready != task.wait_for(std::chrono::milliseconds(100)))
+				progress.ReportProgress((float)num_processed_lines.load() / line_count);
+			task.get();
+		}
+		progress.ReportProgress(1.f);
+
+		size_t junction_count = ret_junctions.size();
+		for (const auto& worker : workers)
+			junction_count += worker.m_Junctions.size();
+		ret_junctions.reserve(junction_count);
+		for (const auto& worker : workers)
+			ret_junctions.insert(ret_junctions.end(), worker.m_Junctions.begin(), worker.m_Junctions.end());
+	}
 
-			bsp.TestCapsule(l0.p1, l0.p2, 0, sets);
+	void FindJunctions(const CLine2f* lines, unsigned int line_count, std::vector<double2>& ret_junctions, IProgressCallback& progress)
+	{
+		using namespace std;
 
-			tmp.clear();
+		CLineAABSPTree bsp = CLineAABSPTree::Create(reinterpret_cast<const float2*>(lines), line_count, 16);
 
-			for (const auto& s : sets)
-			{
-				for (unsigned int o = s.m_FirstObject; o < s.m_FirstObject + s.m_Count; ++o)
-				{
-					const unsigned int l1_index = bsp.GetLineIndex(o);
+		ForEachLineParallel(line_count, line_count, ret_junctions, progress, [&](SWorker& worker, unsigned int l0_index)
+		{
+			const auto& l0 = lines[l0_index];
 
-					if (l1_index <= l0_index)
-						continue;  // Only compare against lines with higher indices (to only compare a pair once)
+			if (l0.p1 == l0.p2)
+				return;  // Zero length
 
-					if (tmp.end() != std::find(tmp.cbegin(), tmp.cend(), l1_index))
-						continue;
+			bsp.TForEachLineInCapsule(l0.p1, l0.p2, 0, [&](unsigned int l1_index)
+			{
+				if (l1_index <= l0_index)
+					return;  // Only compare against lines with higher indices (to only compare a pair once)
 
-					tmp.push_back(l1_index);
+				if (worker.m_VisitStamps[l1_index] == l0_index)
+					return;  // Already tested (line spans multiple cells)
 
-					const auto& l1 = lines[l1_index];
+				worker.m_VisitStamps[l1_index] = l0_index;
 
-					if (l1.p1 == l1.p2)
-						continue; // Zero length
+				const auto& l1 = lines[l1_index];
 
-					float t0, t1;
-					if (!FindLineIntersection2(l0, l1, &t0, &t1))
-						continue;
+				if (l1.p1 == l1.p2)
+					return; // Zero length
 
-					// Calculate intersection coordinates (on line 0)
-					const double2 pt(
-						lerp(l0.p1.x, l0.p2.x, t0),
-						lerp(l0.p1.y, l0.p2.y, t0));
+				float t0, t1;
+				if (!FindLineIntersection2(l0, l1, &t0, &t1))
+					return;
 
-					// Generate only one point if the lines meet at enpoints, or two points otherwise.
-					ret_junctions.push_back(pt);
-					if ((.5f - abs(t0 - .5f) >= MIN_TAIL_FRACTION) ||
-						(.5f - abs(t1 - .5f) >= MIN_TAIL_FRACTION))
-						ret_junctions.push_back(pt);
-				}
-			}
+				// Calculate intersection coordinates (on line 0)
+				const double2 pt(
+					lerp(l0.p1.x, l0.p2.x, t0),
+					lerp(l0.p1.y, l0.p2.y, t0));
 
-			progress.ReportProgress((float)(l0_index + 1) / line_count);
-		}
+				// Generate only one point if the lines meet at enpoints, or two points otherwise.
+				worker.m_Junctions.push_back(pt);
+				if ((.5f - abs(t0 - .5f) >= MIN_TAIL_FRACTION) ||
+					(.5f - abs(t1 - .5f) >= MIN_TAIL_FRACTION))
+					worker.m_Junctions.push_back(pt);
+			});
+		});
 	
 		const bool remove_unique_points = true;
 		SortAndRemoveDuplicates(ret_junctions, remove_unique_points);
@@ -174,52 +225,37 @@ private:
 	{
 		CLineAABSPTree bsp = CLineAABSPTree::Create(reinterpret_cast<const float2*>(lines0), line_count0, 16);
 
-		std::vector<CLineAABSPTree::SObjectSet> sets;
-
-		std::vector<unsigned int> tmp;
-
-		for (unsigned int l1_index = 0; l1_index < line_count1; ++l1_index)
+		ForEachLineParallel(line_count1, line_count0, ret_junctions, progress, [&](SWorker& worker, unsigned int l1_index)
 		{
 			const auto& l1 = lines1[l1_index];
 
 			if (l1.p1 == l1.p2)
-				continue;  // Zero length
-
-			bsp.TestCapsule(l1.p1, l1.p2, 0, sets);
-
-			tmp.clear();
+				return;  // Zero length
 
-			for (const auto& s : sets)
+			bsp.TForEachLineInCapsule(l1.p1, l1.p2, 0, [&](unsigned int l0_index)
 			{
-				for (unsigned int o = s.m_FirstObject; o < s.m_FirstObject + s.m_Count; ++o)
-				{
-					const unsigned int l0_index = bsp.GetLineIndex(o);
-
-					if (tmp.end() != std::find(tmp.cbegin(), tmp.cend(), l0_index))
-						continue;
+				if (worker.m_VisitStamps[l0_index] == l1_index)
+					return;  // Already tested (line spans multiple cells)
 
-					tmp.push_back(l0_index);
+				worker.m_VisitStamps[l0_index] = l1_index;
 
-					const auto& l0 = lines0[l0_index];
+				const auto& l0 = lines0[l0_index];
 
-					if (l0.p1 == l0.p2)
-						continue; // Zero length
+				if (l0.p1 == l0.p2)
+					return; // Zero length
 
-					float t0, t1;
-					if (!FindLineIntersection2(l0, l1, &t0, &t1))
-						continue;
+				float t0, t1;
+				if (!FindLineIntersection2(l0, l1, &t0, &t1))
+					return;
 
-					// Calculate intersection coordinates (on line 0)
-					const double2 pt(
-						lerp(l0.p1.x, l0.p2.x, t0),
-						lerp(l0.p1.y, l0.p2.y, t0));
+				// Calculate intersection coordinates (on line 0)
+				const double2 pt(
+					lerp(l0.p1.x, l0.p2.x, t0),
+					lerp(l0.p1.y, l0.p2.y, t0));
 
-					ret_junctions.push_back(pt);
-				}
-			}
-		
-			progress.ReportProgress((float)(l1_index + 1) / line_count1);
-		}
+				worker.m_Junctions.push_back(pt);
+			});
+		});
 
 		const bool remove_unique_points = false;
 		SortAndRemoveDuplicates(ret_junctions, remove_unique_points);
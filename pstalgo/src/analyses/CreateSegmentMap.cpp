@@ -353,7 +353,6 @@ public:
 
 		const CBitVector connection_bits = FindConnectedEndPoints(lines, line_count);
 
-		std::vector<CLineAABSPTree::SObjectSet> sets;
 		std::vector<SCut> cuts;
 
 		for (unsigned int l0_index = 0; l0_index < line_count; ++l0_index)
@@ -365,47 +364,42 @@ public:
 				continue;
 			const auto l0_v = v * (1.0f / l0_len);
 			cuts.clear();
-			bsp.TestCapsule(l0.p1, l0.p2, extrude_len, sets);
-			for (const auto& s : sets)
+			bsp.TForEachLineInCapsule(l0.p1, l0.p2, extrude_len, [&](unsigned int l1_index)
 			{
-				for (unsigned int o = s.m_FirstObject; o < s.m_FirstObject + s.m_Count; ++o)
-				{
-					const unsigned int l1_index = bsp.GetLineIndex(o);
-					if (l1_index == l0_index)
-						continue;
-					const auto& l1 = lines[l1_index];
-
-					// Do not count touching end-points as a cut
-					if (l0.p1 == l1.p1 || l0.p1 == l1.p2 || l0.p2 == l1.p1 || l0.p2 == l1.p2)
-						continue;
-
-					if (l1.p1 == l1.p2)
-						continue; // Zero length
-
-					const float2 v = l1.p2 - l1.p1;
-					const float l1_len = v.getLength();
-					const float2 l1_v = v * (1.0f / l1_len);
-
-					float t0, t1;
-					if (!Find2DRayIntersection(l0.p1, l0_v, l1.p1, l1_v, t0, t1))
-						continue;
-
-					// Extrude L1 at unconnected end-points
-					const float l1_min = connection_bits.get(l1_index * 2) ? 0.f : -extrude_len;
-					const float l1_max = connection_bits.get(l1_index * 2 + 1) ? l1_len : l1_len + extrude_len;
-
-					if (t0 <= .0f || t0 >= l0_len || t1 <= l1_min || t1 >= l1_max)
-						continue;
-
-					// IMPORTANT: Make sure we get exact same cutting coordinates in L0-L1 and L1-L0 cuts
-					//            by always calculating cutting point on line with lowest index.
-					SCut cut;
-					cut.m_Line = l0_index;
-					cut.m_T = t0;
-					cut.m_Point = (l0_index < l1_index) ? (l0.p1 + l0_v * t0) : (l1.p1 + l1_v * t1);
-					cuts.push_back(cut);
-				}
-			}
+				if (l1_index == l0_index)
+					return;
+				const auto& l1 = lines[l1_index];
+
+				// Do not count touching end-points as a cut
+				if (l0.p1 == l1.p1 || l0.p1 == l1.p2 || l0.p2 == l1.p1 || l0.p2 == l1.p2)
+					return;
+
+				if (l1.p1 == l1.p2)
+					return; // Zero length
+
+				const float2 v = l1.p2 - l1.p1;
+				const float l1_len = v.getLength();
+				const float2 l1_v = v * (1.0f / l1_len);
+
+				float t0, t1;
+				if (!Find2DRayIntersection(l0.p1, l0_v, l1.p1, l1_v, t0, t1))
+					return;
+
+				// Extrude L1 at unconnected end-points
+				const float l1_min = connection_bits.get(l1_index * 2) ? 0.f : -extrude_len;
+				const float l1_max = connection_bits.get(l1_index * 2 + 1) ? l1_len : l1_len + extrude_len;
+
+				if (t0 <= .0f || t0 >= l0_len || t1 <= l1_min || t1 >= l1_max)
+					return;
+
+				// IMPORTANT: Make sure we get exact same cutting coordinates in L0-L1 and L1-L0 cuts
+				//            by always calculating cutting point on line with lowest index.
+				SCut cut;
+				cut.m_Line = l0_index;
+				cut.m_T = t0;
+				cut.m_Point = (l0_index < l1_index) ? (l0.p1 + l0_v * t0) : (l1.p1 + l1_v * t1);
+				cuts.push_back(cut);
+			});
 
 			// Sort cuts
 			if (cuts.empty())
@@ -472,27 +466,22 @@ public:
 				idx = order[idx];
 		}
 
-		std::vector<CLineAABSPTree::SObjectSet> sets;
 		for (unsigned int i = 0; i < unlink_count; ++i)
 		{
 			const float2 unlink_pos = unlinks[i];
 			int closest_index = -1;
 			float closest_dist_sqr = 0;
-			bsp.TestSphere(unlinks[i], MAX_UNLINK_DIST, sets);
-			for (const auto& s : sets)
+			bsp.TForEachPointInSphere(unlinks[i], MAX_UNLINK_DIST, [&](unsigned int o)
 			{
-				for (unsigned int o = s.m_FirstObject; o < s.m_FirstObject + s.m_Count; ++o)
+				if (isnan(points[o].x))
+					return;  // point is already unlinked
+				const float dist_sqr = (unlink_pos - points[o]).getLengthSqr();
+				if (-1 == closest_index || dist_sqr < closest_dist_sqr)
 				{
-					if (isnan(points[o].x))
-						continue;  // point is already unlinked
-					const float dist_sqr = (unlink_pos - points[o]).getLengthSqr();
-					if (-1 == closest_index || dist_sqr < closest_dist_sqr)
-					{
-						closest_index = o;
-						closest_dist_sqr = dist_sqr;
-					}
+					closest_index = o;
+					closest_dist_sqr = dist_sqr;
 				}
-			}
+			});
 			if (-1 != closest_index && closest_dist_sqr < MAX_UNLINK_DIST*MAX_UNLINK_DIST)
 				points[closest_index].x = NAN;  // Mark for removal
 		}
@@ -567,8 +556,6 @@ public:
 		for (unsigned int i = 0; i < idx.size(); ++i)
 			idx[i] = i;
 
-		std::vector<CLineAABSPTree::SObjectSet> sets;
-
 		const float snap_sqr = snap*snap;
 
 		// Snap points
@@ -578,30 +565,26 @@ public:
 				continue;
 			unsigned int point_index = i;  // Can change if point is snapped to another...
 			const auto& p0 = points[point_index];
-			bsp.TestSphere(p0, snap, sets);
-			for (const auto& s : sets)
+			bsp.TForEachPointInSphere(p0, snap, [&](unsigned int o)
 			{
-				for (unsigned int o = s.m_FirstObject; o < s.m_FirstObject + s.m_Count; ++o)
+				if (o == point_index || idx[o] != o)
+					return;
+				const auto& p1 = points[o];
+				if ((p1 - p0).getLengthSqr() > snap_sqr)
+					return;
+				
+				// Snap towwards point with most connections
+				// TODO: Hmm, do we want to add connection counts when two points are snapped together?
+				if (connections_per_point[o] > connections_per_point[point_index])
 				{
-					if (o == point_index || idx[o] != o)
-						continue;
-					const auto& p1 = points[o];
-					if ((p1 - p0).getLengthSqr() > snap_sqr)
-						continue;
-					
-					// Snap towwards point with most connections
-					// TODO: Hmm, do we want to add connection counts when two points are snapped together?
-					if (connections_per_point[o] > connections_per_point[point_index])
-					{
-						idx[point_index] = o;
-						point_index = o;
-					}
-					else
-					{
-						idx[o] = point_index;
-					}
+					idx[point_index] = o;
+					point_index = o;
 				}
-			}
+				else
+				{
+					idx[o] = point_index;
+				}
+			});
 		}
 
 		// Pack snapped points and calculate new indices (mark snap indices by setting most significant bit)
@@ -19,13 +19,21 @@ You should have received a copy of the GNU Lesser General Public License
 along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <atomic>
+#include <cmath>
+#include <future>
+#include <vector>
+
 #include <pstalgo/analyses/NetworkIntegration.h>
 #include <pstalgo/BFS.h>
-#include <pstalgo/utils/BitVector.h>
+#include <pstalgo/utils/Concurrency.h>
+#include <pstalgo/utils/StampedBitVector.h>
 #include <pstalgo/Debug.h>
 #include <pstalgo/Limits.h>
 #include <pstalgo/graph/AxialGraph.h>
+#include <pstalgo/graph/AxialMultiSourceBFS.h>
 #include "../ProgressUtil.h"
+#include "PivotSampling.h"
 
 // N  = Number of reached nodes INCLUDING origin node
 // TD = Total depth
@@ -42,42 +50,246 @@ float CalculateIntegrationScore(unsigned int N, float TD)
 
 namespace
 {
-	class CNetworkIntegrationAlgo : public CPSTBFS 
+	// Integration for steps radii only, using multi-source BFS on all cores.
+	// Outputs hold one block of one element per line for each radius.
+	void MultiSourceNetworkIntegration(const CAxialLineAdjacency& adjacency, const uint32* max_steps, uint32 radius_count, float* ret_integration_scores, unsigned int* ret_node_counts, float* ret_total_depths, IProgressCallback& progress)
+	{
+		const uint32 line_count = adjacency.LineCount();
+		const uint32 batch_count = (line_count + CAxialMultiSourceBFS::MAX_ORIGIN_COUNT - 1) / CAxialMultiSourceBFS::MAX_ORIGIN_COUNT;
+
+		std::atomic<uint32> batch_counter(0);
+		std::atomic<uint32> lines_processed_count(0);
+
+		auto worker = [&]()
+		{
+			CAxialMultiSourceBFS bfs(adjacency);
+			uint32 origins[CAxialMultiSourceBFS::MAX_ORIGIN_COUNT];
+			std::vector<uint32> reached_counts(CAxialMultiSourceBFS::MAX_ORIGIN_COUNT * radius_count);
+			std::vector<uint64> total_depths(CAxialMultiSourceBFS::MAX_ORIGIN_COUNT * radius_count);
+			for (;;)
+			{
+				const uint32 batch_index = batch_counter++;
+				if (batch_index >= batch_count)
+					break;
+				const uint32 first_line = batch_index * CAxialMultiSourceBFS::MAX_ORIGIN_COUNT;
+				const uint32 origin_count = std::min(line_count - first_line, CAxialMultiSourceBFS::MAX_ORIGIN_COUNT);
+				for (uint32 i = 0; i < origin_count; ++i)
+					origins[i] = first_line + i;
+				bfs.Search(origins, origin_count, max_steps, radius_count, reached_counts.data(), total_depths.data());
+				for (uint32 radius_index = 0; radius_index < radius_count; ++radius_index)
+				{
+					for (uint32 i = 0; i < origin_count; ++i)
+					{
+						const size_t result_index = radius_index * origin_count + i;
+						const size_t output_index = (size_t)radius_index * line_count + first_line + i;
+						const auto N = reached_counts[result_index] + 1;  // N = number of reached nodes INCLUDING origin node
+						if (ret_node_counts)
+							ret_node_counts[output_index] = N;
+						if (ret_total_depths)
+							ret_total_depths[output_index] = (float)total_depths[result_index];
+						if (ret_integration_scores)
+							ret_integration_scores[output_index] = CalculateIntegrationScore(N, (float)total_depths[result_index]);
+					}
+				}
+				lines_processed_count += origin_count;
+			}
+		};
+
+		std::vector<std::future<void>> tasks;
+		for (uint32 i = 0; i < std::min(psta::max_thread_count(), batch_count); ++i)
+			tasks.push_back(std::async(std::launch::async, worker));
+
+		// Wait for tasks to finish, and update progress every 100ms
+		for (auto& task : tasks)
+		{
+			while (std::future_status::ready != task.wait_for(std::chrono::milliseconds(100)))
+				progress.ReportProgress((float)lines_processed_count.load() / line_count);
+		}
+		progress.ReportProgress(1.f);
+	}
+
+	class CNetworkIntegrationAlgo : public TPSTBFS<CNetworkIntegrationAlgo>
 	{
-		typedef CPSTBFS super_t;
+		typedef TPSTBFS<CNetworkIntegrationAlgo> super_t;
+		friend class CPSTBFS;
 	public:
-		void Run(CAxialGraph& graph, const LIMITS& limits, float* ret_integration_scores, unsigned int* ret_node_counts, float* ret_total_depths, IProgressCallback& progress);
+		// Outputs hold one block of one element per line for each radius
+		void Run(CAxialGraph& graph, const LIMITS* limits, unsigned int radius_count, float* ret_integration_scores, unsigned int* ret_node_counts, float* ret_total_depths, IProgressCallback& progress);
+
+		// Outputs estimated from searches from sampled pivot lines only (see PivotSampling.h)
+		void RunPivots(CAxialGraph& graph, const LIMITS* limits, unsigned int radius_count, const SPivotSampling& sampling, float* ret_integration_scores, unsigned int* ret_node_counts, float* ret_total_depths, float* ret_total_depth_variances, unsigned int* ret_pivot_count, IProgressCallback& progress);
 
 	// Operations
 	private:
+		void processLines(CAxialGraph& graph, const LIMITS& limits, unsigned int pass_index, unsigned int pass_count, IProgressCallback& progress);
 		void processLine(int iLine);
-		void visitBFS(int iTarget, const DIST& dist) override;
+		void visitBFS(int iTarget, const DIST& dist) override final;
 
 		int m_iCurrLine;
-		CBitVector m_TargetVisitedBits;
+		CStampedBitVector m_TargetVisitedBits;
 
 		float*        m_IntegrationScores;
 		unsigned int* m_NodeCounts;
 		float*        m_TotalDepths;
 
+		// Shared traversal of several radii (empty m_RadiusLimits if not shared)
+		std::vector<float> m_RadiusLimits;  // Steps limit of each radius
+		std::vector<int>   m_VisitedTargets;
+		std::vector<int>   m_TargetDepths;
+
 		unsigned long long m_totalDist;
 		int m_nVisitedLines;  // Origin line is NOT INCLUDED in count
+
+		// Pivot sampling, sums over all pivots processed per radius and target line
+		struct SPivotSums
+		{
+			double m_Count;
+			double m_Depth;
+			double m_DepthSqr;
+		};
+		std::vector<SPivotSums> m_PivotSums;  // One block of one element per line for each radius (empty if not sampling)
+		unsigned int m_PivotRadiusIndex;
 	};
 
-	void CNetworkIntegrationAlgo::Run(CAxialGraph& graph, const LIMITS& limits, float* ret_integration_scores, unsigned int* ret_node_counts, float* ret_total_depths, IProgressCallback& progress)
+	void CNetworkIntegrationAlgo::Run(CAxialGraph& graph, const LIMITS* limits, unsigned int radius_count, float* ret_integration_scores, unsigned int* ret_node_counts, float* ret_total_depths, IProgressCallback& progress)
+	{
+		// Steps is the only distance needed if there are no other radii, and then all
+		// lines can be searched from 64 at a time
+		bool steps_only = true;
+		for (unsigned int radius_index = 0; radius_index < radius_count; ++radius_index)
+			steps_only &= !(limits[radius_index].mask & ~LIMITS::MASK_TURNS);
+		if (steps_only)
+		{
+			CAxialLineAdjacency adjacency;
+			if (adjacency.Create(graph))
+			{
+				std::vector<uint32> max_steps(radius_count);
+				for (unsigned int radius_index = 0; radius_index < radius_count; ++radius_index)
+				{
+					const LIMITS& l = limits[radius_index];
+					max_steps[radius_index] = (l.mask & LIMITS::MASK_TURNS) ? (uint32)std::max(l.turns, 0) : (uint32)-1;
+				}
+				MultiSourceNetworkIntegration(adjacency, max_steps.data(), radius_count, ret_integration_scores, ret_node_counts, ret_total_depths, progress);
+				return;
+			}
+		}
+
+		const size_t line_count = graph.getLineCount();
+
+		LIMITS shared_limits;
+		unsigned int shared_metric;
+		if (radius_count > 1 && getSharedRadiusLimits(limits, radius_count, DIST_LINES, shared_limits, shared_metric))
+		{
+			// One traversal per line for all radii
+			m_RadiusLimits.resize(radius_count);
+			for (unsigned int radius_index = 0; radius_index < radius_count; ++radius_index)
+				m_RadiusLimits[radius_index] = getMetricLimit(limits[radius_index], shared_metric);
+			m_TargetDepths.resize(line_count);
+			m_IntegrationScores = ret_integration_scores;
+			m_NodeCounts = ret_node_counts;
+			m_TotalDepths = ret_total_depths;
+			processLines(graph, shared_limits, 0, 1, progress);
+			return;
+		}
+
+		m_RadiusLimits.clear();
+		for (unsigned int radius_index = 0; radius_index < radius_count; ++radius_index)
+		{
+			const size_t output_offset = radius_index * line_count;
+			m_IntegrationScores = ret_integration_scores ? ret_integration_scores + output_offset : nullptr;
+			m_NodeCounts = ret_node_counts ? ret_node_counts + output_offset : nullptr;
+			m_TotalDepths = ret_total_depths ? ret_total_depths + output_offset : nullptr;
+			processLines(graph, limits[radius_index], radius_index, radius_count, progress);
+		}
+	}
+
+	void CNetworkIntegrationAlgo::RunPivots(CAxialGraph& graph, const LIMITS* limits, unsigned int radius_count, const SPivotSampling& sampling, float* ret_integration_scores, unsigned int* ret_node_counts, float* ret_total_depths, float* ret_total_depth_variances, unsigned int* ret_pivot_count, IProgressCallback& progress)
+	{
+		const unsigned int line_count = (unsigned int)graph.getLineCount();
+
+		std::vector<float2> centers(line_count);
+		for (unsigned int line_index = 0; line_index < line_count; ++line_index)
+			centers[line_index] = (graph.getLine(line_index).p1 + graph.getLine(line_index).p2) * 0.5f;
+		const std::vector<unsigned int> order = CPivotSampler::StratifiedOrder(centers, CPivotSampler::CellsPerSide(sampling), sampling.m_Seed);
+
+		// Totals of pivots themselves are not needed
+		m_RadiusLimits.clear();
+		m_IntegrationScores = nullptr;
+		m_NodeCounts = nullptr;
+		m_TotalDepths = nullptr;
+
+		m_PivotSums.assign((size_t)line_count * radius_count, SPivotSums{ 0, 0, 0 });
+
+		const unsigned int progress_total = (sampling.m_PivotCount ? std::min(sampling.m_PivotCount, line_count) : line_count) * radius_count;
+		unsigned int processed_count = 0;
+
+		auto process = [&](unsigned int first, unsigned int count)
+		{
+			for (m_PivotRadiusIndex = 0; m_PivotRadiusIndex < radius_count; ++m_PivotRadiusIndex)
+			{
+				super_t::init(&graph, TARGET_LINES, DIST_LINES, limits[m_PivotRadiusIndex]);
+				m_TargetVisitedBits.resize(getTargetCount());
+				for (unsigned int i = first; i < first + count; ++i)
+				{
+					processLine(order[i]);
+					progress.ReportProgress(std::min((float)++processed_count / progress_total, 1.0f));
+				}
+			}
+			return count;
+		};
+
+		// Largest relative standard error of total depth
+		auto max_relative_error = [&](unsigned int pivot_count)
+		{
+			double max_error = 0;
+			for (const SPivotSums& sums : m_PivotSums)
+			{
+				double estimate, variance;
+				CPivotSampler::Estimate(sums.m_Depth, sums.m_DepthSqr, pivot_count, line_count, estimate, variance);
+				if (estimate > 0)
+					max_error = std::max(max_error, std::sqrt(variance) / estimate);
+			}
+			return max_error;
+		};
+
+		const unsigned int pivot_count = CPivotSampler::Run(line_count, sampling, process, max_relative_error);
+
+		for (size_t index = 0; index < m_PivotSums.size(); ++index)
+		{
+			const SPivotSums& sums = m_PivotSums[index];
+			double count, depth, variance, unused;
+			// Every pivot adds 0 or 1 to m_Count, so it is also the sum of squares
+			CPivotSampler::Estimate(sums.m_Count, sums.m_Count, pivot_count, line_count, count, unused);
+			CPivotSampler::Estimate(sums.m_Depth, sums.m_DepthSqr, pivot_count, line_count, depth, variance);
+			const auto N = (unsigned int)(count + 0.5) + 1;  // N = number of reached nodes INCLUDING origin node
+			if (ret_node_counts)
+				ret_node_counts[index] = N;
+			if (ret_total_depths)
+				ret_total_depths[index] = (float)depth;
+			if (ret_total_depth_variances)
+				ret_total_depth_variances[index] = (float)variance;
+			if (ret_integration_scores)
+				ret_integration_scores[index] = CalculateIntegrationScore(N, (float)depth);
+		}
+
+		m_PivotSums.clear();
+
+		if (ret_pivot_count)
+			*ret_pivot_count = pivot_count;
+
+		progress.ReportProgress(1.f);
+	}
+
+	void CNetworkIntegrationAlgo::processLines(CAxialGraph& graph, const LIMITS& limits, unsigned int pass_index, unsigned int pass_count, IProgressCallback& progress)
 	{
 		super_t::init(&graph, TARGET_LINES, DIST_LINES, limits);
 
 		m_TargetVisitedBits.resize(getTargetCount());
 
-		m_IntegrationScores = ret_integration_scores;
-		m_NodeCounts = ret_node_counts;
-		m_TotalDepths = ret_total_depths;
-
 		for (int i = 0; i < graph.getLineCount(); ++i)
 		{
 			processLine(i);
-			progress.ReportProgress((float)(i + 1) / graph.getLineCount());
+			progress.ReportProgress((float)(pass_index * graph.getLineCount() + i + 1) / (pass_count * graph.getLineCount()));
 		}
 	}
 
@@ -89,9 +301,37 @@ namespace
 		m_iCurrLine = iLine;
 
 		m_TargetVisitedBits.clearAll();
+		m_VisitedTargets.clear();
 
 		doBFSFromLine(iLine);
 
+		if (!m_RadiusLimits.empty())
+		{
+			// Results of every radius from shared traversal
+			const size_t line_count = m_pGraph->getLineCount();
+			for (unsigned int radius_index = 0; radius_index < (unsigned int)m_RadiusLimits.size(); ++radius_index)
+			{
+				unsigned long long total_depth = 0;
+				unsigned int visited_count = 0;
+				for (const int target_index : m_VisitedTargets)
+				{
+					if (m_TargetDepths[target_index] > m_RadiusLimits[radius_index])
+						continue;
+					total_depth += m_TargetDepths[target_index];
+					++visited_count;
+				}
+				const size_t output_index = radius_index * line_count + iLine;
+				const auto N = visited_count + 1;  // N = number of reached nodes INCLUDING origin node
+				if (m_NodeCounts)
+					m_NodeCounts[output_index] = N;
+				if (m_TotalDepths)
+					m_TotalDepths[output_index] = (float)total_depth;
+				if (m_IntegrationScores)
+					m_IntegrationScores[output_index] = CalculateIntegrationScore(N, (float)total_depth);
+			}
+			return;
+		}
+
 		if (m_NodeCounts)
 			m_NodeCounts[iLine] = m_nVisitedLines + 1;
 
@@ -110,6 +350,22 @@ namespace
 		if (m_iCurrLine == iTarget || m_TargetVisitedBits.get(iTarget))
 			return;
 		m_TargetVisitedBits.set(iTarget);
+		if (!m_PivotSums.empty())
+		{
+			// Depth from pivot to target is taken as depth from target to pivot
+			SPivotSums& sums = m_PivotSums[(size_t)m_PivotRadiusIndex * m_pGraph->getLineCount() + iTarget];
+			sums.m_Count += 1;
+			sums.m_Depth += dist.turns;
+			sums.m_DepthSqr += (double)dist.turns * dist.turns;
+			return;
+		}
+		if (!m_RadiusLimits.empty())
+		{
+			// Lines are visited in order of depth, so first visit is shortest
+			m_VisitedTargets.push_back(iTarget);
+			m_TargetDepths[iTarget] = dist.turns;
+			return;
+		}
 		m_totalDist += dist.turns;
 		++m_nVisitedLines;
 	}
@@ -118,6 +374,11 @@ namespace
 SPSTANetworkIntegrationDesc::SPSTANetworkIntegrationDesc()
 : m_Version(VERSION)
 , m_Graph(nullptr)
+, m_Radii(nullptr)
+, m_RadiusCount(0)
+, m_PivotCount(0)
+, m_PivotTargetError(0)
+, m_PivotSeed(0)
 , m_ProgressCallback(nullptr)
 , m_ProgressCallbackUser(nullptr)
 , m_OutJunctionCoords(nullptr)
@@ -126,6 +387,8 @@ SPSTANetworkIntegrationDesc::SPSTANetworkIntegrationDesc()
 , m_OutLineIntegration(nullptr)
 , m_OutLineNodeCount(nullptr)
 , m_OutLineTotalDepth(nullptr)
+, m_OutLineTotalDepthVariance(nullptr)
+, m_OutPivotCount(nullptr)
 {}
 
 PSTADllExport bool PSTANetworkIntegration(const SPSTANetworkIntegrationDesc* desc)
@@ -138,24 +401,58 @@ PSTADllExport bool PSTANetworkIntegration(const SPSTANetworkIntegrationDesc* des
 
 	const CAxialGraph& graph = *(CAxialGraph*)desc->m_Graph;
 
+	std::vector<LIMITS> limits;
+	if (desc->m_RadiusCount)
+	{
+		for (unsigned int i = 0; i < desc->m_RadiusCount; ++i)
+			limits.push_back(LimitsFromSPSTARadii(desc->m_Radii[i]));
+	}
+	else
+		limits.push_back(LimitsFromSPSTARadii(desc->m_Radius));
+	const unsigned int radius_count = (unsigned int)limits.size();
+
 	float* line_integration_scores = desc->m_OutLineIntegration;
 	std::vector<float> line_scores_needed_to_calculate_junction_scores;
 	if (nullptr == line_integration_scores && desc->m_OutJunctionScores)
 	{
-		line_scores_needed_to_calculate_junction_scores.resize(graph.getLineCount());
+		line_scores_needed_to_calculate_junction_scores.resize((size_t)graph.getLineCount() * radius_count);
 		line_integration_scores = line_scores_needed_to_calculate_junction_scores.data();
 	}
 
 	CNetworkIntegrationAlgo algo;
 
 	CPSTAlgoProgressCallback progress(desc->m_ProgressCallback, desc->m_ProgressCallbackUser);
-	algo.Run(
-		*(CAxialGraph*)desc->m_Graph, 
-		LimitsFromSPSTARadii(desc->m_Radius), 
-		line_integration_scores,
-		desc->m_OutLineNodeCount,
-		desc->m_OutLineTotalDepth,
-		progress);
+	if (desc->m_PivotCount || desc->m_PivotTargetError > 0)
+	{
+		if (!CPivotSampler::IsSymmetric(desc->m_RadiusCount ? desc->m_Radii : &desc->m_Radius, desc->m_RadiusCount ? desc->m_RadiusCount : 1))
+		{
+			LOG_ERROR("Network Integration pivot sampling only supports no radius or angular radius");
+			return false;
+		}
+		const SPivotSampling sampling = { desc->m_PivotCount, desc->m_PivotTargetError, desc->m_PivotSeed };
+		algo.RunPivots(
+			*(CAxialGraph*)desc->m_Graph,
+			limits.data(),
+			radius_count,
+			sampling,
+			line_integration_scores,
+			desc->m_OutLineNodeCount,
+			desc->m_OutLineTotalDepth,
+			desc->m_OutLineTotalDepthVariance,
+			desc->m_OutPivotCount,
+			progress);
+	}
+	else
+	{
+		algo.Run(
+			*(CAxialGraph*)desc->m_Graph, 
+			limits.data(),
+			radius_count,
+			line_integration_scores,
+			desc->m_OutLineNodeCount,
+			desc->m_OutLineTotalDepth,
+			progress);
+	}
 
 	if ((desc->m_OutJunctionCoords || desc->m_OutJunctionScores) && (unsigned int)graph.getCrossingCount() != desc->m_OutJunctionCount)
 	{
@@ -163,7 +460,7 @@ PSTADllExport bool PSTANetworkIntegration(const SPSTANetworkIntegrationDesc* des
 		if (desc->m_OutJunctionCoords)
 			memset(desc->m_OutJunctionCoords, 0, desc->m_OutJunctionCount * sizeof(desc->m_OutJunctionCoords[0]));
 		if (desc->m_OutJunctionScores)
-			memset(desc->m_OutJunctionScores, 0, desc->m_OutJunctionCount * sizeof(desc->m_OutJunctionScores[0]));
+			memset(desc->m_OutJunctionScores, 0, (size_t)desc->m_OutJunctionCount * radius_count * sizeof(desc->m_OutJunctionScores[0]));
 	}
 	else
 	{
@@ -175,14 +472,19 @@ PSTADllExport bool PSTANetworkIntegration(const SPSTANetworkIntegrationDesc* des
 		if (desc->m_OutJunctionScores)
 		{
 			ASSERT(line_integration_scores);
-			for (int line_index = 0; line_index < graph.getLineCount(); ++line_index)
+			for (unsigned int radius_index = 0; radius_index < radius_count; ++radius_index)
 			{
-				const CAxialGraph::NETWORKLINE& line = graph.getLine(line_index);
-				for (int lc = 0; lc < line.nCrossings; ++lc)
+				float* junction_scores = desc->m_OutJunctionScores + (size_t)radius_index * graph.getCrossingCount();
+				const float* line_scores = line_integration_scores + (size_t)radius_index * graph.getLineCount();
+				for (int line_index = 0; line_index < graph.getLineCount(); ++line_index)
 				{
-					const CAxialGraph::LINECROSSING& line_crossing = graph.getLineCrossing(line.iFirstCrossing + lc);
-					const CAxialGraph::CROSSING& crossing = graph.getCrossing(line_crossing.iCrossing);
-					desc->m_OutJunctionScores[line_crossing.iCrossing] += line_integration_scores[line_index] / crossing.nLines;
+					const CAxialGraph::NETWORKLINE& line = graph.getLine(line_index);
+					for (int lc = 0; lc < line.nCrossings; ++lc)
+					{
+						const CAxialGraph::LINECROSSING& line_crossing = graph.getLineCrossing(line.iFirstCrossing + lc);
+						const CAxialGraph::CROSSING& crossing = graph.getCrossing(line_crossing.iCrossing);
+						junction_scores[line_crossing.iCrossing] += line_scores[line_index] / crossing.nLines;
+					}
 				}
 			}
 		}
@@ -20,14 +20,18 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <atomic>
+#include <cmath>
 #include <future>
 #include <memory>
 #include <queue>
+#include <tuple>
 
 #include <pstalgo/analyses/ODBetweenness.h>
 #include <pstalgo/experimental/ShortestPathTraversal.h>
 #include <pstalgo/experimental/StraightLineMinDistance.h>
 #include <pstalgo/graph/AxialGraph.h>
+#include <pstalgo/utils/RadixHeap.h>
+#include <pstalgo/utils/StampedBitVector.h>
 #include <pstalgo/Debug.h>
 
 #include "../ProgressUtil.h"
@@ -51,6 +55,118 @@ namespace psta
 			angle -= 180.0f;
 			return (angle < 0.0f) ? 360.0f + angle : angle;
 		}
+
+		// Walking distance from position on line to closest destination point on
+		// same line, or infinity if line has no destination points
+		float ClosestDestinationOnLine(const CAxialGraph& graph, const float* destination_weights, const CAxialGraph::NETWORKLINE& line, float line_pos)
+		{
+			float min_dist = std::numeric_limits<float>::infinity();
+			for (int p = 0; p < line.nPoints; ++p)
+			{
+				const int point_index = graph.getLinePoint(line.iFirstPoint + p);
+				if (destination_weights && destination_weights[point_index] <= 0.0f)
+					continue;
+				const CAxialGraph::POINT& point = graph.getPoint(point_index);
+				min_dist = std::min(min_dist, fabsf(point.linePos - line_pos) + point.distFromLine);
+			}
+			return min_dist;
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	//
+	//  CClosestDestinationForest
+	//
+
+	// Shortest walking path from every line crossing to its closest destination
+	// point, as a forest grown by one search backwards from all destinations at
+	// once. Forest node i means having stepped onto the line of line crossing i
+	// at that crossing, the same state as CODBetweennessWorker steps have.
+	class CClosestDestinationForest
+	{
+	public:
+		CClosestDestinationForest(const CAxialGraph& graph, const float* destination_weights, bool use_radix_heap);
+
+		// Infinity if no destination is reachable
+		float Distance(int line_crossing_index) const { return m_Nodes[line_crossing_index].m_Distance; }
+
+		// Line crossing of next line on path, or -1 if closest destination is on the line of 'line_crossing_index'
+		int NextLineCrossing(int line_crossing_index) const { return m_Nodes[line_crossing_index].m_Next; }
+
+	private:
+		struct SNode
+		{
+			float m_Distance;
+			int   m_Next;
+		};
+
+		// Ties are settled in order of line crossing, which decides the path
+		// taken among equally short ones
+		struct SQueueItem
+		{
+			float m_Distance;
+			int   m_LineCrossing;
+			inline bool operator<(const SQueueItem& rhs) const { return std::tie(rhs.m_Distance, rhs.m_LineCrossing) < std::tie(m_Distance, m_LineCrossing); }
+			struct GetKey { inline float operator()(const SQueueItem& item) const { return item.m_Distance; } };
+		};
+
+		template <class TQueue>
+		void Build(const CAxialGraph& graph, const float* destination_weights);
+
+		std::vector<SNode> m_Nodes;
+	};
+
+	CClosestDestinationForest::CClosestDestinationForest(const CAxialGraph& graph, const float* destination_weights, bool use_radix_heap)
+		: m_Nodes(graph.getLineCrossingCount())
+	{
+		if (use_radix_heap)
+			Build<psta::radix_heap<SQueueItem, SQueueItem::GetKey>>(graph, destination_weights);
+		else
+			Build<std::priority_queue<SQueueItem>>(graph, destination_weights);
+	}
+
+	template <class TQueue>
+	void CClosestDestinationForest::Build(const CAxialGraph& graph, const float* destination_weights)
+	{
+		TQueue queue;
+
+		// Roots are the line crossings with a destination point on their own line
+		for (int i = 0; i < (int)m_Nodes.size(); ++i)
+		{
+			const CAxialGraph::LINECROSSING& lc = graph.getLineCrossing(i);
+			SNode& node = m_Nodes[i];
+			node.m_Distance = ClosestDestinationOnLine(graph, destination_weights, graph.getLine(lc.iLine), lc.linePos);
+			node.m_Next = -1;
+			if (!std::isinf(node.m_Distance))
+				queue.push({ node.m_Distance, i });
+		}
+
+		while (!queue.empty())
+		{
+			const SQueueItem item = queue.top();
+			queue.pop();
+			if (item.m_Distance > m_Nodes[item.m_LineCrossing].m_Distance)
+				continue;  // Node has been reached with a shorter distance since queued
+
+			// Relax all crossings on the line we stepped off from, except those at
+			// the same position (see CODBetweennessWorker::ProcessOrigin)
+			const CAxialGraph::LINECROSSING& exit = graph.getLineCrossing(graph.getLineCrossing(item.m_LineCrossing).iOpposite);
+			const CAxialGraph::NETWORKLINE& line = graph.getLine(exit.iLine);
+			for (int c = 0; c < line.nCrossings; ++c)
+			{
+				const int line_crossing_index = line.iFirstCrossing + c;
+				const CAxialGraph::LINECROSSING& linecrossing = graph.getLineCrossing(line_crossing_index);
+				if (linecrossing.linePos == exit.linePos)
+					continue;
+				const float dist = item.m_Distance + fabsf(linecrossing.linePos - exit.linePos);
+				SNode& node = m_Nodes[line_crossing_index];
+				if (dist >= node.m_Distance)
+					continue;
+				node.m_Distance = dist;
+				node.m_Next = item.m_LineCrossing;
+				queue.push({ dist, line_crossing_index });
+			}
+		}
 	}
 
 	///////////////////////////////////////////////////////////////////////////////
@@ -69,6 +185,17 @@ namespace psta
 				throw std::runtime_error("SPSTAODBetweenness::m_DestinationCount does not match graph point count");
 			if (desc.m_OutputCount != Graph().getLineCount())
 				throw std::runtime_error("SPSTAODBetweenness::m_OutputCount does not match graph line count");
+
+			// When only the closest destination within a walking radius is wanted the
+			// path of every origin can be looked up in one shared shortest path forest
+			// instead of searched for. Other radii depend on the path taken from each
+			// origin, and angular distances on the direction it was walked in.
+			if (SPSTAODBetweenness::EDestinationMode_ClosestDestinationOnly == DestinationMode() &&
+				EPSTADistanceType_Walking == DistanceType() &&
+				!Radius().HasStraight() && !Radius().HasSteps() && !Radius().HasAngular())
+			{
+				m_ClosestDestinationForest = std::make_unique<CClosestDestinationForest>(Graph(), desc.m_DestinationWeights, UseRadixHeap());
+			}
 		}
 
 		float Progress() const { return (float)m_OriginProcessedCounter / m_Desc.m_OriginCount; }
@@ -81,12 +208,18 @@ namespace psta
 			return m_Desc.m_DestinationWeights ? m_Desc.m_DestinationWeights[destination_index] : 1.f;
 		}
 
+		const float* DestinationWeights() const { return m_Desc.m_DestinationWeights; }
+
 		SPSTAODBetweenness::EDestinationMode DestinationMode() const { return (SPSTAODBetweenness::EDestinationMode)m_Desc.m_DestinationMode; }
 
 		EPSTADistanceType DistanceType() const { return (EPSTADistanceType)m_Desc.m_DistanceType; }
 		
 		const SPSTARadii& Radius() const { return m_Desc.m_Radius; }
 
+		bool UseRadixHeap() const { return m_Desc.m_UseRadixHeap; }
+
+		const CClosestDestinationForest* ClosestDestinationForest() const { return m_ClosestDestinationForest.get(); }
+
 		bool FetchNextOrigin(COORDS& coords, float& weight, int& category)
 		{
 			const auto origin_index = m_OriginProcessedCounter++;
@@ -111,6 +244,7 @@ namespace psta
 	private:
 		const SPSTAODBetweenness& m_Desc;
 		std::atomic<unsigned int> m_OriginProcessedCounter;
+		std::unique_ptr<CClosestDestinationForest> m_ClosestDestinationForest;
 	};
 
 
@@ -130,6 +264,8 @@ namespace psta
 
 	private:
 		void ProcessOrigin(const COORDS& pt, float weight, int origin_category);
+
+		void ProcessOriginInForest(const CClosestDestinationForest& forest, const COORDS& pt, float weight);
 		
 		struct SCrossingDist
 		{
@@ -171,7 +307,12 @@ namespace psta
 
 			void UpdateDistModeDist(EPSTADistanceType dist_type);
 
-			inline bool operator<(const SStep& d) const { return m_DistModeDist > d.m_DistModeDist; }
+			// Equally short steps are ordered by the other members, so that every
+			// priority queue settles ties in the same order. Steps that are equal in
+			// all of them have been queued from the same trace through the same
+			// crossing, and are the same.
+			inline bool operator<(const SStep& d) const { return std::tie(d.m_DistModeDist, d.m_Line, d.m_LineCrossing, d.m_Forwards, d.m_PrevTrace) < std::tie(m_DistModeDist, m_Line, m_LineCrossing, m_Forwards, m_PrevTrace); }
+			struct GetKey { inline float operator()(const SStep& s) const { return s.m_DistModeDist; } };
 		};
 
 		struct STrace
@@ -182,13 +323,16 @@ namespace psta
 		};
 
 		void QueueStep(SStep& step);
+		SStep PopStep();
+		bool IsQueueEmpty() const;
 		void ClearQueue();
 		bool UpdateShortestCrossingDist(int crossing_index, const SDist& dist, bool forwards);
 		bool IsWithinRadius(const SDist& dist) const;
 		bool IsWithinStraightRadius(const COORDS& p0, const COORDS& p1);
 
 		typedef std::vector<SReachedPoint> ReachedPointVec;
-		typedef std::priority_queue<SStep> StepQueue;
+		typedef std::priority_queue<SStep> BinaryHeapStepQueue;
+		typedef psta::radix_heap<SStep, SStep::GetKey> RadixHeapStepQueue;
 		typedef std::vector<SCrossingDist> CrossingDistVec;
 		typedef std::vector<STrace>        TraceVec;
 		typedef std::vector<float>         LineScoreVector;
@@ -196,9 +340,12 @@ namespace psta
 
 		CODBetweennessWorkerContext& m_Ctx;
 
-		StepQueue       m_Queue;
+		bool                m_UseRadixHeap;
+		BinaryHeapStepQueue m_BinaryHeapQueue;
+		RadixHeapStepQueue  m_RadixHeapQueue;
 		ReachedPointVec m_ReachedPoints;
 		CrossingDistVec m_ShortestCrossingDists;
+		CStampedBitVector m_ShortestCrossingDistSet;  // Entries of m_ShortestCrossingDists that are valid for current origin
 		TraceVec        m_Trace;
 		LineScoreVector m_LineScores;
 		PointDistVector m_ShortestPointDists;
@@ -207,6 +354,7 @@ namespace psta
 
 	CODBetweennessWorker::CODBetweennessWorker(CODBetweennessWorkerContext& ctx)
 		: m_Ctx(ctx)
+		, m_UseRadixHeap(ctx.UseRadixHeap())
 	{
 		auto& graph = m_Ctx.Graph();
 
@@ -215,6 +363,7 @@ namespace psta
 		for (size_t i = 0; i < m_ShortestPointDists.size(); ++i)
 			m_ShortestPointDists[i] = -1.0f;
 		m_ShortestCrossingDists.resize(graph.getLineCrossingCount());
+		m_ShortestCrossingDistSet.resize(graph.getLineCrossingCount());
 		m_Trace.reserve(graph.getLineCrossingCount());
 		m_LineScores.resize(graph.getLineCount());
 		if (!m_LineScores.empty())
@@ -228,7 +377,48 @@ namespace psta
 		float weight;
 		int category;
 		while (m_Ctx.FetchNextOrigin(coords, weight, category))
-			ProcessOrigin(coords, weight, category);
+		{
+			if (const CClosestDestinationForest* forest = m_Ctx.ClosestDestinationForest())
+				ProcessOriginInForest(*forest, coords, weight);
+			else
+				ProcessOrigin(coords, weight, category);
+		}
+	}
+
+	void CODBetweennessWorker::ProcessOriginInForest(const CClosestDestinationForest& forest, const COORDS& pt, float weight)
+	{
+		CAxialGraph& graph = m_Ctx.Graph();
+
+		// find closest line for this origin
+		REAL dist_from_line, start_line_pos;
+		const int start_line_index = graph.getClosestLine(pt, &dist_from_line, &start_line_pos);
+		if (start_line_index < 0)
+			return;
+
+		// Closest destination is either on the start line or reached by stepping
+		// off it at one of its crossings
+		const CAxialGraph::NETWORKLINE& line = graph.getLine(start_line_index);
+		float dist = ClosestDestinationOnLine(graph, m_Ctx.DestinationWeights(), line, start_line_pos);
+		int next_line_crossing = -1;
+		for (int c = 0; c < line.nCrossings; ++c)
+		{
+			const CAxialGraph::LINECROSSING& linecrossing = graph.getLineCrossing(line.iFirstCrossing + c);
+			if (linecrossing.linePos == start_line_pos)
+				continue;
+			const float crossing_dist = fabsf(linecrossing.linePos - start_line_pos) + forest.Distance(linecrossing.iOpposite);
+			if (crossing_dist < dist)
+			{
+				dist = crossing_dist;
+				next_line_crossing = linecrossing.iOpposite;
+			}
+		}
+		if (std::isinf(dist) || dist_from_line + dist > m_Ctx.Radius().Walking())
+			return;
+
+		// Whole origin weight goes to every line on path, since only one destination is reached
+		m_LineScores[start_line_index] += weight;
+		for (; next_line_crossing >= 0; next_line_crossing = forest.NextLineCrossing(next_line_crossing))
+			m_LineScores[graph.getLineCrossing(next_line_crossing).iLine] += weight;
 	}
 
 	void CODBetweennessWorker::ProcessOrigin(const COORDS& pt, float weight, int origin_category)
@@ -244,7 +434,7 @@ namespace psta
 		const bool we_care_about_angles = (EPSTADistanceType_Angular == m_Ctx.DistanceType() || m_Ctx.Radius().HasAngular());
 
 		// Clear queue, just to make sure
-		ASSERT(m_Queue.empty());
+		ASSERT(IsQueueEmpty());
 		ClearQueue();
 
 		// Generate initial step from origin to closest line
@@ -272,15 +462,13 @@ namespace psta
 		m_ReachedPoints.clear();
 		m_Trace.clear();
 
-		// Reset shortest dists per crossing
-		for (size_t i = 0; i < m_ShortestCrossingDists.size(); ++i)
-			m_ShortestCrossingDists[i].SetMax();
+		// Reset shortest dists per crossing (lazily, see UpdateShortestCrossingDist)
+		m_ShortestCrossingDistSet.clearAll();
 
 		// BFS
-		while (!m_Queue.empty())
+		while (!IsQueueEmpty())
 		{
-			const SStep step = m_Queue.top();
-			m_Queue.pop();
+			const SStep step = PopStep();
 
 			if (step.m_Line < 0)
 			{
@@ -404,7 +592,7 @@ namespace psta
 			}
 		}
 
-		ASSERT(m_Queue.empty());
+		ASSERT(IsQueueEmpty());
 
 		// Calculate sum of reached points' weights per category
 		ASSERT(!m_DestWeightsPerCategory.empty());
@@ -453,17 +641,45 @@ namespace psta
 	void CODBetweennessWorker::QueueStep(SStep& step)
 	{
 		step.UpdateDistModeDist(m_Ctx.DistanceType());
-		m_Queue.push(step);
+		if (m_UseRadixHeap)
+			m_RadixHeapQueue.push(step);
+		else
+			m_BinaryHeapQueue.push(step);
+	}
+
+	CODBetweennessWorker::SStep CODBetweennessWorker::PopStep()
+	{
+		if (m_UseRadixHeap)
+		{
+			const SStep step = m_RadixHeapQueue.top();
+			m_RadixHeapQueue.pop();
+			return step;
+		}
+		const SStep step = m_BinaryHeapQueue.top();
+		m_BinaryHeapQueue.pop();
+		return step;
+	}
+
+	bool CODBetweennessWorker::IsQueueEmpty() const
+	{
+		return m_UseRadixHeap ? m_RadixHeapQueue.empty() : m_BinaryHeapQueue.empty();
 	}
 
 	void CODBetweennessWorker::ClearQueue()
 	{
-		while (!m_Queue.empty())
-			m_Queue.pop();
+		m_RadixHeapQueue.clear();
+		while (!m_BinaryHeapQueue.empty())
+			m_BinaryHeapQueue.pop();
 	}
 
 	bool CODBetweennessWorker::UpdateShortestCrossingDist(int crossing_index, const SDist& dist, bool forwards)
 	{
+		if (!m_ShortestCrossingDistSet.get(crossing_index))
+		{
+			m_ShortestCrossingDistSet.set(crossing_index);
+			m_ShortestCrossingDists[crossing_index].SetMax();
+		}
+
 		switch (m_Ctx.DistanceType())
 		{
 		case EPSTADistanceType_Angular:
@@ -0,0 +1,140 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <random>
+
+#include "PivotSampling.h"
+
+std::vector<unsigned int> CPivotSampler::StratifiedOrder(const std::vector<float2>& positions, unsigned int cells_per_side, unsigned int seed)
+{
+	const unsigned int count = (unsigned int)positions.size();
+	if (0 == count)
+		return std::vector<unsigned int>();
+
+	float2 bb_min = positions[0], bb_max = positions[0];
+	for (const auto& pos : positions)
+	{
+		bb_min.x = std::min(bb_min.x, pos.x);
+		bb_min.y = std::min(bb_min.y, pos.y);
+		bb_max.x = std::max(bb_max.x, pos.x);
+		bb_max.y = std::max(bb_max.y, pos.y);
+	}
+
+	auto cell_coord = [&](float v, float lo, float hi)
+	{
+		if (!(hi > lo))
+			return 0u;
+		return std::min((unsigned int)((v - lo) / (hi - lo) * cells_per_side), cells_per_side - 1);
+	};
+
+	// Elements sorted by cell
+	const unsigned int cell_count = cells_per_side * cells_per_side;
+	std::vector<unsigned int> cell_of_element(count);
+	std::vector<unsigned int> first_in_cell(cell_count + 1, 0);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		cell_of_element[i] = cell_coord(positions[i].y, bb_min.y, bb_max.y) * cells_per_side + cell_coord(positions[i].x, bb_min.x, bb_max.x);
+		++first_in_cell[cell_of_element[i] + 1];
+	}
+	for (unsigned int cell = 0; cell < cell_count; ++cell)
+		first_in_cell[cell + 1] += first_in_cell[cell];
+	std::vector<unsigned int> elements(count);
+	{
+		std::vector<unsigned int> next(first_in_cell.begin(), first_in_cell.end() - 1);
+		for (unsigned int i = 0; i < count; ++i)
+			elements[next[cell_of_element[i]]++] = i;
+	}
+
+	// Random order within every cell. Indices are drawn directly from the
+	// generator rather than with std::uniform_int_distribution, whose output
+	// differs between standard library implementations.
+	std::mt19937 rng(seed);
+	for (unsigned int cell = 0; cell < cell_count; ++cell)
+	{
+		unsigned int* cell_elements = elements.data() + first_in_cell[cell];
+		for (unsigned int i = first_in_cell[cell + 1] - first_in_cell[cell]; i > 1; --i)
+			std::swap(cell_elements[i - 1], cell_elements[(unsigned int)(((unsigned long long)rng() * i) >> 32)]);
+	}
+
+	// Always take next element from the cell that is furthest behind its share
+	typedef std::pair<double, unsigned int> cell_entry_t;  // (share of cell taken after next element, cell)
+	std::priority_queue<cell_entry_t, std::vector<cell_entry_t>, std::greater<cell_entry_t>> queue;
+	std::vector<unsigned int> taken(cell_count, 0);
+	for (unsigned int cell = 0; cell < cell_count; ++cell)
+	{
+		const unsigned int n = first_in_cell[cell + 1] - first_in_cell[cell];
+		if (n)
+			queue.push(cell_entry_t(0.5 / n, cell));
+	}
+	std::vector<unsigned int> order;
+	order.reserve(count);
+	while (!queue.empty())
+	{
+		const unsigned int cell = queue.top().second;
+		queue.pop();
+		order.push_back(elements[first_in_cell[cell] + taken[cell]]);
+		const unsigned int n = first_in_cell[cell + 1] - first_in_cell[cell];
+		if (++taken[cell] < n)
+			queue.push(cell_entry_t((taken[cell] + 0.5) / n, cell));
+	}
+
+	return order;
+}
+
+unsigned int CPivotSampler::CellsPerSide(const SPivotSampling& sampling)
+{
+	const unsigned int PIVOTS_PER_CELL = 4;
+	const unsigned int MAX_CELLS_PER_SIDE = 64;
+	const unsigned int pivot_count = sampling.m_PivotCount ? sampling.m_PivotCount : MIN_PIVOT_COUNT;
+	return std::max(1u, std::min((unsigned int)std::sqrt((double)(pivot_count / PIVOTS_PER_CELL)), MAX_CELLS_PER_SIDE));
+}
+
+bool CPivotSampler::IsSymmetric(const SPSTARadii* radii, unsigned int radius_count)
+{
+	for (unsigned int radius_index = 0; radius_index < radius_count; ++radius_index)
+		if (radii[radius_index].m_Mask & ~EPSTADistanceTypeMask_Angular)
+			return false;
+	return true;
+}
+
+void CPivotSampler::Estimate(double sum, double sum_sqr, unsigned int sample_count, unsigned int population, double& ret_estimate, double& ret_variance)
+{
+	if (sample_count >= population)
+	{
+		ret_estimate = sum;
+		ret_variance = 0;
+		return;
+	}
+	const double k = sample_count;
+	const double N = population;
+	ret_estimate = sample_count ? sum * N / k : 0;
+	if (sample_count < 2)
+	{
+		ret_variance = std::numeric_limits<double>::infinity();
+		return;
+	}
+	const double mean = sum / k;
+	const double sample_variance = std::max(0.0, (sum_sqr - sum * mean) / (k - 1));
+	ret_variance = N * N * (1.0 - k / N) * sample_variance / k;
+}
@@ -0,0 +1,105 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <pstalgo/Vec2.h>
+#include <pstalgo/analyses/Common.h>
+
+// Pivot sampling (Eppstein & Wang, "Fast Approximation of Centrality"). When
+// depth from A to B is the same as from B to A, the total depth of every
+// element is a sum over all origins of their depth to it, which can be
+// estimated from searches from a sample of the origins (pivots) only, scaled
+// by population size over sample size. Origin sampling of other sums over
+// origins (such as betweenness) uses the same order, driver and estimator.
+struct SPivotSampling
+{
+	unsigned int m_PivotCount;   // 0 to sample until within m_TargetError
+	float        m_TargetError;  // Max relative standard error of any estimate
+	unsigned int m_Seed;
+};
+
+class CPivotSampler
+{
+public:
+	// Smallest number of pivots sampled until within target error, since
+	// variances estimated from fewer are too unreliable
+	static const unsigned int MIN_PIVOT_COUNT = 64;
+
+	// Returns all elements in the order they are sampled in. Elements are put
+	// in strata by a square grid of cells over their positions, and picked from
+	// the cells in random order, so that every prefix of the order holds the
+	// cells in proportion to their number of elements (within one).
+	static std::vector<unsigned int> StratifiedOrder(const std::vector<float2>& positions, unsigned int cells_per_side, unsigned int seed);
+
+	// Grid resolution for StratifiedOrder() giving a few pivots per cell
+	static unsigned int CellsPerSide(const SPivotSampling& sampling);
+
+	// True if every radius in 'radii' reaches from A to B exactly when it
+	// reaches from B to A, which pivot sampling of depths relies on. This only
+	// holds for no radius and angular radius. Walking, steps, axmeter and
+	// straight line radii are measured from the origin to where a target is
+	// reached, which is not the same distance in both directions.
+	static bool IsSymmetric(const SPSTARadii* radii, unsigned int radius_count);
+
+	// Calls process(first, count) for consecutive ranges of the sampling order,
+	// until m_PivotCount pivots have been processed or, if m_PivotCount is 0,
+	// until max_relative_error(pivot_count) is within m_TargetError. process()
+	// returns the number of pivots it processed, and sampling stops if that is
+	// fewer than 'count' (e.g. out of time). Returns number of pivots processed.
+	template <class TProcess, class TMaxRelativeError>
+	static unsigned int Run(unsigned int population, const SPivotSampling& sampling, TProcess&& process, TMaxRelativeError&& max_relative_error);
+
+	// Estimated sum over a population of 'population' elements, from the sum
+	// and sum of squares of 'sample_count' of them sampled without replacement.
+	// Variance is that of simple random sampling, which is conservative for
+	// proportionally stratified samples. It is 0 if every element is sampled,
+	// and infinite if too few are sampled to tell.
+	static void Estimate(double sum, double sum_sqr, unsigned int sample_count, unsigned int population, double& ret_estimate, double& ret_variance);
+};
+
+template <class TProcess, class TMaxRelativeError>
+unsigned int CPivotSampler::Run(unsigned int population, const SPivotSampling& sampling, TProcess&& process, TMaxRelativeError&& max_relative_error)
+{
+	if (sampling.m_PivotCount)
+	{
+		return process(0, std::min(sampling.m_PivotCount, population));
+	}
+
+	// Batches grow with the number of pivots, so that the error is checked at
+	// a roughly constant relative rate
+	unsigned int pivot_count = 0;
+	unsigned int batch_size = MIN_PIVOT_COUNT;
+	while (pivot_count < population)
+	{
+		batch_size = std::min(batch_size, population - pivot_count);
+		const unsigned int processed_count = process(pivot_count, batch_size);
+		pivot_count += processed_count;
+		if (processed_count < batch_size)
+			break;
+		if (pivot_count < population && max_relative_error(pivot_count) <= sampling.m_TargetError)
+			break;
+		batch_size = std::max(batch_size, pivot_count / 2);
+	}
+	return pivot_count;
+}
@@ -20,11 +20,14 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <algorithm>
+#include <vector>
 
 #include <pstalgo/analyses/Reach.h>
+#include <pstalgo/experimental/DeltaSteppingSearch.h>
+#include <pstalgo/experimental/DirectedMultiDistanceGraph.h>
 #include <pstalgo/geometry/ConvexHull.h>
 #include <pstalgo/BFS.h>
-#include <pstalgo/utils/BitVector.h>
+#include <pstalgo/utils/StampedBitVector.h>
 #include <pstalgo/Limits.h>
 #include <pstalgo/graph/AxialGraph.h>
 #include "../ProgressUtil.h"
@@ -41,9 +44,10 @@ namespace
 	}
 }
 
-class CReachAlgorithm : public CPSTBFS 
+class CReachAlgorithm : public TPSTBFS<CReachAlgorithm>
 {
-	typedef CPSTBFS super_t;
+	typedef TPSTBFS<CReachAlgorithm> super_t;
+	friend class CPSTBFS;
 public:
 
 	CReachAlgorithm()
@@ -53,8 +57,10 @@ public:
 	{
 	}
 
+	// Outputs hold one block of one element per origin for each radius
 	void Run(CAxialGraph* pGraph, 
-			 const LIMITS& limits, 
+			 const LIMITS* limits, 
+			 unsigned int radius_count,
 			 const double2* origin_points,
 			 unsigned int origin_point_count, 
 			 unsigned int* ret_reached_count, 
@@ -62,29 +68,132 @@ public:
 			 float* ret_reached_area,
 			 IProgressCallback& progress)
 	{
-		super_t::init(pGraph, TARGET_LINES, DIST_NONE, limits);
-		m_TargetReachedBits.resize(getTargetCount());
-
 		const unsigned int origin_count = origin_points ? origin_point_count : pGraph->getLineCount();
+		const size_t output_count = (size_t)origin_count * radius_count;
 
 		if (ret_reached_count)
-			memset(ret_reached_count, 0, origin_count * sizeof(ret_reached_count[0]));
-		m_ReachedCount = ret_reached_count;
-
+			memset(ret_reached_count, 0, output_count * sizeof(ret_reached_count[0]));
 		if (ret_reached_length)
-			memset(ret_reached_length, 0, origin_count * sizeof(ret_reached_length[0]));
-		m_ReachedLength = ret_reached_length;
-
+			memset(ret_reached_length, 0, output_count * sizeof(ret_reached_length[0]));
 		if (ret_reached_area)
-			memset(ret_reached_area, 0, origin_count * sizeof(ret_reached_area[0]));
-		m_ReachedArea = ret_reached_area;
+			memset(ret_reached_area, 0, output_count * sizeof(ret_reached_area[0]));
+
+		if (origin_points && useWalkingDistanceSearch(*pGraph, limits, radius_count))
+		{
+			m_OriginCount = origin_point_count;
+			m_ReachedCount = ret_reached_count;
+			m_ReachedLength = ret_reached_length;
+			m_ReachedArea = ret_reached_area;
+			processPointsByWalkingDistance(pGraph, limits, radius_count, origin_points, origin_point_count, progress);
+			return;
+		}
+
+		LIMITS shared_limits;
+		unsigned int shared_metric;
+		if (radius_count > 1 && getSharedRadiusLimits(limits, radius_count, DIST_NONE, shared_limits, shared_metric))
+		{
+			// One traversal per origin for all radii
+			m_RadiusLimits.resize(radius_count);
+			for (unsigned int radius_index = 0; radius_index < radius_count; ++radius_index)
+				m_RadiusLimits[radius_index] = getMetricLimit(limits[radius_index], shared_metric);
+			m_SharedMetric = shared_metric;
+			m_OriginCount = origin_count;
+			m_ReachedCount = ret_reached_count;
+			m_ReachedLength = ret_reached_length;
+			m_ReachedArea = ret_reached_area;
+			m_TargetDistances.resize(pGraph->getLineCount());
+			processOrigins(pGraph, shared_limits, origin_points, origin_point_count, 0, 1, progress);
+			return;
+		}
+
+		m_RadiusLimits.clear();
+		for (unsigned int radius_index = 0; radius_index < radius_count; ++radius_index)
+		{
+			const size_t output_offset = (size_t)radius_index * origin_count;
+			m_ReachedCount = ret_reached_count ? ret_reached_count + output_offset : nullptr;
+			m_ReachedLength = ret_reached_length ? ret_reached_length + output_offset : nullptr;
+			m_ReachedArea = ret_reached_area ? ret_reached_area + output_offset : nullptr;
+			processOrigins(pGraph, limits[radius_index], origin_points, origin_point_count, radius_index, radius_count, progress);
+		}
+	}
+
+private:
+	// Radii that only limit walking distance from origin points can be served by
+	// one shortest path search per origin over a directed graph of the network,
+	// relaxed by CDeltaSteppingSearch, instead of by CPSTBFS. A line is reached if
+	// the walking distance to its mid point is within radius either way. Building
+	// the graph costs about as much as CPSTBFS reaching a third to half of the
+	// network, so it is only done for radii whose circle covers at least half of
+	// the bounding box of the network.
+	static bool useWalkingDistanceSearch(const CAxialGraph& graph, const LIMITS* limits, unsigned int radius_count)
+	{
+		if (0 == graph.getLineCount())
+			return false;
+		float max_walking = 0;
+		for (unsigned int radius_index = 0; radius_index < radius_count; ++radius_index)
+		{
+			if (LIMITS::MASK_WALKING != limits[radius_index].mask)
+				return false;
+			max_walking = std::max(max_walking, limits[radius_index].walking);
+		}
+		const CAxialGraph::BBOX& bbox = graph.getBBox();
+		const float bbox_area = (bbox.max.x - bbox.min.x) * (bbox.max.y - bbox.min.y);
+		return 3.1415927f * max_walking * max_walking >= 0.5f * bbox_area;
+	}
+
+	void processPointsByWalkingDistance(CAxialGraph* pGraph, const LIMITS* limits, unsigned int radius_count, const double2* origin_points, unsigned int origin_point_count, IProgressCallback& progress)
+	{
+		// For m_pGraph and m_lim of area calculation
+		super_t::init(pGraph, TARGET_LINES, DIST_NONE, limits[0]);
+
+		std::vector<float2> origins(origin_point_count);
+		for (unsigned int point_index = 0; point_index < origin_point_count; ++point_index)
+			origins[point_index] = pGraph->worldToLocal(origin_points[point_index]);
+
+		const EPSTADistanceType distance_type = EPSTADistanceType_Walking;
+		const auto graph = psta::BuildDirectedMultiDistanceGraph(
+			*pGraph,
+			psta::span<const EPSTADistanceType>(&distance_type, 1),
+			psta::span<const float>(),
+			0,
+			false,
+			origins.data(), origins.size(),
+			EPSTANetworkElement_Line);
+
+		m_RadiusLimits.resize(radius_count);
+		float max_limit = 0;
+		for (unsigned int radius_index = 0; radius_index < radius_count; ++radius_index)
+		{
+			m_RadiusLimits[radius_index] = limits[radius_index].walking;
+			max_limit = std::max(max_limit, limits[radius_index].walking);
+		}
+		m_TargetDistances.resize(pGraph->getLineCount());
+
+		psta::CDeltaSteppingSearch search(graph);
+		for (unsigned int point_index = 0; point_index < origin_point_count; ++point_index)
+		{
+			m_ReachedTargets.clear();
+			search.Search(point_index, [&](size_t line_index, float distance)
+			{
+				m_ReachedTargets.push_back((int)line_index);
+				m_TargetDistances[line_index] = distance;
+			}, &max_limit);
+			collectRadiusResults(point_index, &origins[point_index]);
+			progress.ReportProgress((float)(point_index + 1) / origin_point_count);
+		}
+	}
+
+	void processOrigins(CAxialGraph* pGraph, const LIMITS& limits, const double2* origin_points, unsigned int origin_point_count, unsigned int pass_index, unsigned int pass_count, IProgressCallback& progress)
+	{
+		super_t::init(pGraph, TARGET_LINES, DIST_NONE, limits);
+		m_TargetReachedBits.resize(getTargetCount());
 
 		if (origin_points)
 		{
 			for (unsigned int point_index = 0; point_index < origin_point_count; ++point_index)
 			{
 				processPoint(point_index, pGraph->worldToLocal(origin_points[point_index]));
-				progress.ReportProgress((float)(point_index + 1) / origin_point_count);
+				progress.ReportProgress((float)(pass_index * origin_point_count + point_index + 1) / (pass_count * origin_point_count));
 			}
 		}
 		else
@@ -92,12 +201,11 @@ public:
 			for (int line_index = 0; line_index < pGraph->getLineCount(); ++line_index)
 			{
 				processLine(line_index);
-				progress.ReportProgress((float)(line_index + 1) / pGraph->getLineCount());
+				progress.ReportProgress((float)(pass_index * pGraph->getLineCount() + line_index + 1) / (pass_count * pGraph->getLineCount()));
 			}
 		}
 	}
 
-private:
 	void processPoint(unsigned int index, const float2& pt)
 	{
 		m_iCurrOrigin = (int)index;
@@ -134,7 +242,15 @@ private:
 
 			clrVisitedLineCrossings();  // NOTE: Shouldn't this be in CPSTPBS::doBFSFromPoint (called below)!?!?!?
 
+			m_ReachedTargets.clear();
+
 			doBFSFromPoint(pt);
+
+			if (!m_RadiusLimits.empty())
+			{
+				collectRadiusResults(index, &pt);
+				return;
+			}
 		}
 
 		if (m_ReachedArea)
@@ -180,15 +296,38 @@ private:
 
 			m_TargetReachedBits.clearAll();
 
+			m_ReachedTargets.clear();
+
 			doBFSFromLine(iLine);
+
+			if (!m_RadiusLimits.empty())
+			{
+				collectRadiusResults(iLine, nullptr);
+				return;
+			}
 		}
 
 		if (m_ReachedArea)
 			m_ReachedArea[iLine] = CalculateReachedArea();
 	}
 
-	void visitBFS(int iTarget, const DIST& /*dist*/) override
+	void visitBFS(int iTarget, const DIST& dist) override final
 	{
+		if (!m_RadiusLimits.empty())
+		{
+			// Shared traversal of several radii, keep shortest distance
+			const float d = getMetricDistance(dist, m_SharedMetric);
+			if (!m_TargetReachedBits.get(iTarget))
+			{
+				m_TargetReachedBits.set(iTarget);
+				m_ReachedTargets.push_back(iTarget);
+				m_TargetDistances[iTarget] = d;
+			}
+			else if (d < m_TargetDistances[iTarget])
+				m_TargetDistances[iTarget] = d;
+			return;
+		}
+
 		if (m_TargetReachedBits.get(iTarget))
 			return;
 
@@ -209,6 +348,42 @@ private:
 		}
 	}
 
+	// Results of every radius from shared traversal
+	void collectRadiusResults(unsigned int origin_index, const float2* origin_point)
+	{
+		for (unsigned int radius_index = 0; radius_index < (unsigned int)m_RadiusLimits.size(); ++radius_index)
+		{
+			const float limit = m_RadiusLimits[radius_index];
+			const size_t output_index = (size_t)radius_index * m_OriginCount + origin_index;
+			unsigned int count = 0;
+			float length = 0;
+			m_ReachedEndPoints.clear();
+			for (const int target_index : m_ReachedTargets)
+			{
+				if (m_TargetDistances[target_index] > limit)
+					continue;
+				const CAxialGraph::NETWORKLINE& line = m_pGraph->getLine(target_index);
+				++count;
+				length += line.length;
+				if (m_ReachedArea)
+				{
+					m_ReachedEndPoints.push_back(line.p1);
+					m_ReachedEndPoints.push_back(line.p2);
+				}
+			}
+			if (m_ReachedCount)
+				m_ReachedCount[output_index] = count;
+			if (m_ReachedLength)
+				m_ReachedLength[output_index] = length;
+			if (m_ReachedArea)
+			{
+				if (origin_point)
+					m_ReachedEndPoints.push_back(*origin_point);
+				m_ReachedArea[output_index] = CalculateReachedArea();
+			}
+		}
+	}
+
 	float CalculateReachedArea()
 	{
 		if (LIMITS::MASK_STRAIGHT == m_lim.mask)
@@ -256,11 +431,18 @@ private:
 	}
 
 	int           m_iCurrOrigin;
-	CBitVector    m_TargetReachedBits;
+	CStampedBitVector m_TargetReachedBits;
 	unsigned int* m_ReachedCount;
 	float*        m_ReachedLength;
 	float*        m_ReachedArea;
 
+	// Shared traversal of several radii (empty m_RadiusLimits if not shared)
+	std::vector<float> m_RadiusLimits;  // Limit of m_SharedMetric for each radius
+	unsigned int       m_SharedMetric;
+	unsigned int       m_OriginCount;
+	std::vector<int>   m_ReachedTargets;
+	std::vector<float> m_TargetDistances;
+
 	// Area Calculation
 	std::vector<COORDS> m_ReachedEndPoints;
 	std::vector<COORDS> m_ConvexHull;
@@ -272,11 +454,21 @@ PSTADllExport bool PSTAReach(const SPSTAReachDesc* desc)
 	if (desc->VERSION != desc->m_Version)
 		return false;
 
+	std::vector<LIMITS> limits;
+	if (desc->m_RadiusCount)
+	{
+		for (unsigned int i = 0; i < desc->m_RadiusCount; ++i)
+			limits.push_back(LimitsFromSPSTARadii(desc->m_Radii[i]));
+	}
+	else
+		limits.push_back(LimitsFromSPSTARadii(desc->m_Radius));
+
 	CReachAlgorithm algo;
 	CPSTAlgoProgressCallback progress(desc->m_ProgressCallback, desc->m_ProgressCallbackUser);
 	algo.Run(
 		(CAxialGraph*)desc->m_Graph,
-		LimitsFromSPSTARadii(desc->m_Radius),
+		limits.data(),
+		(unsigned int)limits.size(),
 		desc->m_OriginCoords,
 		desc->m_OriginCount,
 		desc->m_OutReachedCount,
@@ -19,18 +19,25 @@ You should have received a copy of the GNU Lesser General Public License
 along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <future>
+#include <limits>
 #include <queue>
-#include <stack>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
 #include <pstalgo/analyses/SegmentBetweenness.h>
-#include <pstalgo/utils/BitVector.h>
+#include <pstalgo/utils/RadixHeap.h>
 #include <pstalgo/Debug.h>
 #include <pstalgo/graph/AxialGraph.h>
+#include <pstalgo/graph/BrandesSearch.h>
 
+#include "../Platform.h"
 #include "../ProgressUtil.h"
+#include "PivotSampling.h"
 
 #define USE_MULTIPLE_CORES
 
@@ -38,9 +45,30 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 namespace
 {
+	// Parameters of approximate betweenness, see SPSTASegmentBetweennessDesc
+	struct SSampling
+	{
+		float        m_TargetError;
+		float        m_TimeBudget;
+		float        m_Confidence;
+		unsigned int m_Seed;
+	};
+
 	class CBetweennessAlgoWorker
 	{
 	public:
+		// If 'sampled' is set the contributions of every origin are also summed
+		// squared, for estimating the variance of sampled betweenness.
+		// 'use_radix_heap' selects the radix heap over the binary heap for
+		// searches that need a priority queue, which gives the same results.
+		void Init(
+			CAxialGraph& graph,
+			EPSTADistanceType distType,
+			const SPSTARadii& limits,
+			const float* weight_per_segment,
+			bool use_radix_heap,
+			bool sampled);
+
 		// NOTE: All of the segment pointers here (weight_per_segment, ret_node_counts, ret_total_depths) point 
 		//       to segment #0, NOT #first_segment_to_process! It is up to this method to index correctly.
 		void Run(
@@ -50,39 +78,33 @@ namespace
 			EPSTADistanceType distType,
 			const SPSTARadii& limits,
 			const float* weight_per_segment,
+			bool use_radix_heap,
 			unsigned int* ret_node_counts,
 			float* ret_total_depths,
 			std::atomic<unsigned int>& segments_processed_counter);
 
-		const double* GetBetweennessScores() const { return m_result.data(); }
-
-	private:
-		struct SPredecessorElement
-		{
-			static const unsigned int END = (unsigned int)-1;
-
-			unsigned int m_Predecessor = END;
-			unsigned int m_Next = END;
+		// Processes the given origins, after Init() with 'sampled' set. Stops early
+		// if 'time_budget_msec' (0 for none) has passed since 'start_msec'. Returns
+		// number of origins processed.
+		unsigned int RunSampled(
+			const unsigned int* origins,
+			unsigned int origin_count,
+			unsigned int* ret_node_counts,
+			float* ret_total_depths,
+			unsigned int start_msec,
+			unsigned int time_budget_msec,
+			std::atomic<unsigned int>& segments_processed_counter);
 
-			inline bool HasPredecessor() const { return END != m_Predecessor; }
-			inline bool HasNext() const { return END != m_Next; }
-			inline void Clear() { m_Predecessor = m_Next = END; }
-		};
-		std::vector<SPredecessorElement> m_Predecessors;
+		const double* GetBetweennessScores() const { return m_result.data(); }
 
-		struct SEGDATA {
-			float    dist;
-			int      nPaths;
-			SPredecessorElement pred;
-		};
-		typedef std::vector<SEGDATA> SegDataArray;
+		// Sum of squared contributions per origin, if sampled
+		const double* GetSquaredScores() const { return m_resultSqr.data(); }
 
-		void AddPredecessor(SEGDATA& seg_data, unsigned int pred);
-		template <class TLambda> void PopPredecessors(SEGDATA& seg_data, TLambda&& lambda);
+		// Largest contribution of any one origin to any line, if sampled
+		double GetMaxContribution() const { return m_maxContribution; }
 
-		void ProcessSegment(const int iSegment, unsigned int& ret_node_count, float& ret_total_depth);
+	private:
 		inline bool UseWeights() const { return nullptr != m_WeightPerSegment; }
-		inline bool IsBiDirectional() const { return (int)m_segData.size() > m_Graph->getLineCount(); }
 		unsigned int GetReverseSegmentIndex(unsigned int index) const;
 
 		struct DIST {
@@ -98,21 +120,127 @@ namespace
 			float        cmpdist;
 			DIST         dist;
 		public:
-			inline bool operator<(const STATE& s) const { return cmpdist > s.cmpdist; }
+			// Equally short states are ordered by segment and previous segment, so
+			// that every priority queue settles ties in the same order. A segment
+			// is only left once, so no two states differ in these alone.
+			inline bool operator<(const STATE& s) const { return std::tie(s.cmpdist, s.iSegment, s.iPrevSegment) < std::tie(cmpdist, iSegment, iPrevSegment); }
+			struct GetKey { inline float operator()(const STATE& s) const { return s.cmpdist; } };
 		};
-		typedef std::priority_queue<STATE> Queue;
+		// FIFO with the interface of std::priority_queue, backed by a flat array. When
+		// every step has the same cost this pops states in order of distance, one
+		// level at a time (breadth first).
+		class CFifoQueue
+		{
+		public:
+			inline bool empty() const { return m_Front == m_States.size(); }
+			inline const STATE& top() const { return m_States[m_Front]; }
+			inline void push(const STATE& state) { m_States.push_back(state); }
+			inline void pop()
+			{
+				if (++m_Front == m_States.size())
+				{
+					m_States.clear();
+					m_Front = 0;
+				}
+			}
+		private:
+			std::vector<STATE> m_States;
+			size_t m_Front = 0;
+		};
+
+		// Graph view for m_Search. Nodes are lines, or line directions (reverse direction
+		// at index + line count) if BIDIRECTIONAL.
+		template <EPSTADistanceType DIST_TYPE, unsigned int METRICS>
+		struct TGraphView
+		{
+			static const bool BIDIRECTIONAL = (EPSTADistanceType_Angular == DIST_TYPE);
+
+			CBetweennessAlgoWorker& m_Worker;
+			const unsigned int m_LineCount;
+			const bool m_HasStraightRadius;
+			const float2 m_OriginCenter;
+			unsigned int m_NumSegmentsReached;  // Sum of lines that were reached within radius from origin
+			double m_TotalDepth;                // Sum of minimum distances from origin to all reached lines
+
+			inline unsigned int NodeFromSegment(unsigned int iSegment) const { return (BIDIRECTIONAL || iSegment < m_LineCount) ? iSegment : iSegment - m_LineCount; }
+
+			inline unsigned int Node(const STATE& state) const { return NodeFromSegment(state.iSegment); }
+			inline unsigned int Pred(const STATE& state) const { return NodeFromSegment(state.iPrevSegment); }
+			inline float Key(const STATE& state) const { return state.cmpdist; }
+
+			template <class TQueue>
+			void OnSettle(const STATE& state, TQueue& queue);
+		};
+
+		typedef std::priority_queue<STATE> BinaryHeapQueue;
+		typedef psta::radix_heap<STATE, STATE::GetKey> RadixHeapQueue;
+
+		enum EQueueType { QUEUE_BINARY_HEAP, QUEUE_RADIX_HEAP, QUEUE_FIFO };
+
+		// Steps with no other radius than straight is a plain breadth first search,
+		// if the graph allows it (see IsBreadthFirstSafe). Otherwise HEAP_TYPE is
+		// used, which is either of the heaps. Both settle ties in the same order
+		// (see STATE), which matters since which of several equally short paths is
+		// settled first decides the radius tests of the other distance types.
+		template <EPSTADistanceType DIST_TYPE, unsigned int METRICS, EQueueType HEAP_TYPE>
+		static constexpr EQueueType TQueueType()
+		{
+			return (EPSTADistanceType_Steps == DIST_TYPE && EPSTADistanceTypeMask_Steps == METRICS) ? QUEUE_FIFO : HEAP_TYPE;
+		}
+
+		template <EQueueType QUEUE_TYPE> using TQueueTag = std::integral_constant<EQueueType, QUEUE_TYPE>;
+		inline BinaryHeapQueue& GetQueue(TQueueTag<QUEUE_BINARY_HEAP>) { return m_binaryHeapQueue; }
+		inline RadixHeapQueue&  GetQueue(TQueueTag<QUEUE_RADIX_HEAP>)  { return m_radixHeapQueue; }
+		inline CFifoQueue&      GetQueue(TQueueTag<QUEUE_FIFO>)        { return m_fifoQueue; }
+
+		typedef void (CBetweennessAlgoWorker::*ProcessSegmentFunc)(const int iSegment, unsigned int& ret_node_count, float& ret_total_depth);
+
+		// Returns version of TProcessSegment for the distance type, the radius types in use and the heap
+		static ProcessSegmentFunc SelectProcessSegmentFunc(const CAxialGraph& graph, EPSTADistanceType distType, unsigned int radius_mask, bool use_radix_heap);
+		template <EPSTADistanceType DIST_TYPE, EQueueType HEAP_TYPE>
+		static ProcessSegmentFunc TSelectProcessSegmentFunc(const CAxialGraph& graph, unsigned int radius_mask);
+
+		// A line is only left through the end opposite to the one it was first
+		// reached from, so which of several equally short paths is settled first
+		// matters, and a FIFO settles them in another order than the binary heap.
+		// That only makes no difference if lines cross at their end points alone,
+		// where all lines meeting at a point cross each other, as in segment maps.
+		static bool IsBreadthFirstSafe(const CAxialGraph& graph);
+
+		// METRICS is the mask (EPSTADistanceTypeMask_*) of distances that are used, either
+		// for ordering (DIST_TYPE) or as radius. Other distances are never calculated.
+		template <EPSTADistanceType DIST_TYPE, unsigned int METRICS, EQueueType HEAP_TYPE, EQueueType QUEUE_TYPE = TQueueType<DIST_TYPE, METRICS, HEAP_TYPE>()>
+		void TProcessSegment(const int iSegment, unsigned int& ret_node_count, float& ret_total_depth);
+
+		template <unsigned int METRICS>
+		inline void TStep(const DIST& from, const CAxialGraph::NETWORKLINE& seg, bool bReverse, const CAxialGraph::NETWORKLINE& seg2, bool bNextReverse, DIST& ret) const;
+
+		template <unsigned int METRICS>
+		inline bool TIsWithinRadius(const DIST& dist) const;
+
+		template <EPSTADistanceType DIST_TYPE>
+		static inline float TGetDist(const DIST& dist);
 
 		CAxialGraph* m_Graph;
-		EPSTADistanceType m_distType;
-		SPSTARadii m_limits;
 		const float* m_WeightPerSegment;
-
-		Queue              m_queue;
-		CBitVector         m_visitFlags;
-		SegDataArray       m_segData;
-		std::stack<unsigned int> m_segStack;
+		ProcessSegmentFunc m_ProcessSegment;
+
+		// Radii (infinite if not used)
+		float        m_maxWalking;
+		unsigned int m_maxSteps;
+		float        m_maxAngular;
+		float        m_maxAxmeter;
+		float        m_maxStraightSqr;
+
+		BinaryHeapQueue    m_binaryHeapQueue;
+		RadixHeapQueue     m_radixHeapQueue;
+		CFifoQueue         m_fifoQueue;
+		CBrandesSearch     m_Search;
 		std::vector<float> m_dep;
 		std::vector<double> m_result;
+		std::vector<double> m_resultSqr;     // Only if sampled
+		std::vector<double> m_originResult;  // Contributions of current origin, only if sampled
+		double              m_maxContribution;
 	};
 
 	class CBetweennessAlgo
@@ -120,12 +248,61 @@ namespace
 	public:
 		CBetweennessAlgo();
 
-		bool Run(CAxialGraph& graph, EPSTADistanceType distType, const SPSTARadii& limits, const float* weight_per_segment, float* ret_betweenness, unsigned int* ret_node_counts, float* ret_total_depths, IProgressCallback& progress);
+		bool Run(CAxialGraph& graph, EPSTADistanceType distType, const SPSTARadii& limits, const float* weight_per_segment, bool use_radix_heap, float* ret_betweenness, unsigned int* ret_node_counts, float* ret_total_depths, IProgressCallback& progress);
+
+		// Estimates betweenness from origins sampled in random order, until the
+		// confidence intervals are narrow enough, the time budget has run out or
+		// all origins have been processed. Node counts and total depths are only
+		// calculated for sampled origins, and are 0 for other lines.
+		bool RunSampled(CAxialGraph& graph, EPSTADistanceType distType, const SPSTARadii& limits, const float* weight_per_segment, bool use_radix_heap, const SSampling& sampling, float* ret_betweenness, float* ret_errors, unsigned int* ret_sample_count, unsigned int* ret_node_counts, float* ret_total_depths, IProgressCallback& progress);
 
 	private:
+		static bool IsSupportedDistanceType(EPSTADistanceType distType);
+
+		// Returns z such that a standard normal variable is within [-z, z] with
+		// probability 'confidence'
+		static double ZFromConfidence(double confidence);
+
 		std::vector<CBetweennessAlgoWorker> m_Workers;
 	};
 
+	void CBetweennessAlgoWorker::Init(
+		CAxialGraph& graph,
+		EPSTADistanceType distType,
+		const SPSTARadii& limits,
+		const float* weight_per_segment,
+		bool use_radix_heap,
+		bool sampled)
+	{
+		m_Graph = &graph;
+		m_WeightPerSegment = weight_per_segment;
+		m_maxWalking = limits.Walking();
+		m_maxSteps = limits.Steps();
+		m_maxAngular = limits.Angular();
+		m_maxAxmeter = limits.Axmeter();
+		m_maxStraightSqr = limits.StraightSqr();
+
+		m_ProcessSegment = SelectProcessSegmentFunc(graph, distType, limits.m_Mask, use_radix_heap);
+
+		const int segment_count = (EPSTADistanceType_Angular == distType) ? graph.getLineCount() * 2 : graph.getLineCount();
+
+		m_Search.Init(segment_count);
+		m_dep.resize(segment_count);
+
+		m_result.assign(graph.getLineCount(), 0.0);
+		m_maxContribution = 0;
+		if (sampled)
+		{
+			m_resultSqr.assign(graph.getLineCount(), 0.0);
+			m_originResult.assign(graph.getLineCount(), 0.0);
+		}
+		else
+		{
+			m_resultSqr.clear();
+			m_originResult.clear();
+		}
+	}
+
 	void CBetweennessAlgoWorker::Run(
 		unsigned int first_segment_to_process,
 		unsigned int num_segments_to_process,
@@ -133,6 +310,7 @@ namespace
 		EPSTADistanceType distType,
 		const SPSTARadii& limits,
 		const float* weight_per_segment,
+		bool use_radix_heap,
 		unsigned int* ret_node_counts,
 		float* ret_total_depths,
 		std::atomic<unsigned int>& segments_processed_counter)
@@ -141,27 +319,13 @@ namespace
 			LOG_INFO("worker started");
 		#endif
 
-		m_Graph = &graph;
-		m_WeightPerSegment = weight_per_segment;
-		m_distType = distType;
-		m_limits = limits;
-
-		const int segment_count = (EPSTADistanceType_Angular == distType) ? graph.getLineCount() * 2 : graph.getLineCount();
-
-		m_Predecessors.reserve(segment_count);
-
-		m_visitFlags.resize(segment_count);
-		m_segData.resize(segment_count);
-		m_dep.resize(segment_count);
-
-		m_result.resize(graph.getLineCount());
-		memset(m_result.data(), 0, m_result.size() * sizeof(m_result.front()));
+		Init(graph, distType, limits, weight_per_segment, use_radix_heap, false);
 
 		for (unsigned int i = first_segment_to_process; i < first_segment_to_process+num_segments_to_process; ++i)
 		{
 			unsigned int dummy_node_count;
 			float dummy_total_depth;
-			ProcessSegment(i, ret_node_counts ? ret_node_counts[i] : dummy_node_count, ret_total_depths ? ret_total_depths[i] : dummy_total_depth);
+			(this->*m_ProcessSegment)(i, ret_node_counts ? ret_node_counts[i] : dummy_node_count, ret_total_depths ? ret_total_depths[i] : dummy_total_depth);
 			segments_processed_counter++;
 			// TODO: Handle cancelling
 		}
@@ -171,66 +335,86 @@ namespace
 		#endif
 	}
 
-	void CBetweennessAlgoWorker::AddPredecessor(SEGDATA& seg_data, unsigned int pred)
+	unsigned int CBetweennessAlgoWorker::RunSampled(
+		const unsigned int* origins,
+		unsigned int origin_count,
+		unsigned int* ret_node_counts,
+		float* ret_total_depths,
+		unsigned int start_msec,
+		unsigned int time_budget_msec,
+		std::atomic<unsigned int>& segments_processed_counter)
 	{
-		if (!seg_data.pred.HasPredecessor())
-		{
-			seg_data.pred.m_Predecessor = pred;
-			ASSERT(!seg_data.pred.HasNext());
-		}
-		else
+		const unsigned int line_count = (unsigned int)m_Graph->getLineCount();
+
+		// Moves contribution of current origin to a line over to the sums
+		auto fold = [&](unsigned int line)
 		{
-			m_Predecessors.push_back(seg_data.pred);
-			seg_data.pred.m_Next = (unsigned int)(m_Predecessors.size() - 1);
-			seg_data.pred.m_Predecessor = pred;
-		}
-	}
-	
-	template <class TLambda> void CBetweennessAlgoWorker::PopPredecessors(SEGDATA& seg_data, TLambda&& lambda)
-	{
-		auto* p = &seg_data.pred;
-		if (!p->HasPredecessor())
-			return;
-		for (;;)
+			const double x = m_originResult[line];
+			if (0 == x)
+				return;
+			m_result[line] += x;
+			m_resultSqr[line] += x * x;
+			m_maxContribution = std::max(m_maxContribution, x);
+			m_originResult[line] = 0;
+		};
+
+		for (unsigned int i = 0; i < origin_count; ++i)
 		{
-			lambda(p->m_Predecessor);
-			if (!p->HasNext())
-				break;
-			p = &m_Predecessors[p->m_Next];
+			if (time_budget_msec && GetTimeMSec() - start_msec >= time_budget_msec)
+				return i;
+
+			const unsigned int origin = origins[i];
+			unsigned int dummy_node_count;
+			float dummy_total_depth;
+			(this->*m_ProcessSegment)(origin, ret_node_counts ? ret_node_counts[origin] : dummy_node_count, ret_total_depths ? ret_total_depths[origin] : dummy_total_depth);
+
+			// Only the origin and the lines reached from it have been given a contribution
+			fold(origin);
+			m_Search.ForEachSettled([&](unsigned int node) { fold((node < line_count) ? node : node - line_count); });
+
+			segments_processed_counter++;
 		}
-		seg_data.pred.Clear();
+
+		return origin_count;
 	}
 
-	void CBetweennessAlgoWorker::ProcessSegment(const int iSegment, unsigned int& ret_node_count, float& ret_total_depth)
+	template <EPSTADistanceType DIST_TYPE, unsigned int METRICS, CBetweennessAlgoWorker::EQueueType HEAP_TYPE, CBetweennessAlgoWorker::EQueueType QUEUE_TYPE>
+	void CBetweennessAlgoWorker::TProcessSegment(const int iSegment, unsigned int& ret_node_count, float& ret_total_depth)
 	{
+		typedef TGraphView<DIST_TYPE, METRICS> graph_view_t;
+
+		// Angular analysis has one segment per line direction
+		const bool BIDIRECTIONAL = graph_view_t::BIDIRECTIONAL;
 
 		if (UseWeights() && !(m_WeightPerSegment[iSegment] > 0.0f))
 			return;
 
-		unsigned int num_segments_reached = 0;  // Will be sum of lines that was reached within radius from iSegment
-		double total_depth = 0;                 // Will be sum of minimum distances from iSegment to all reached segments
+		// Contributions of each origin are kept apart when sampling
+		double* const result = m_originResult.empty() ? m_result.data() : m_originResult.data();
 
-		m_visitFlags.clearAll();
+		CAxialGraph::NETWORKLINE& seg = m_Graph->getLine(iSegment);
 
-		m_Predecessors.clear();
+		graph_view_t view = {
+			*this,
+			(unsigned int)m_Graph->getLineCount(),
+			m_maxStraightSqr < std::numeric_limits<float>::infinity(),  // For Straight radius calculation
+			(seg.p1 + seg.p2) * 0.5f,
+			0,
+			0,
+		};
 
-		m_visitFlags.set(iSegment);
-		m_segData[iSegment].nPaths = 1;
-		m_segData[iSegment].dist = 0.0f;
-		//m_segStack.push(iLine); // Should we do this???
+		m_Search.Clear();
 
-		int iReverseSegment = iSegment + m_Graph->getLineCount();
-		if (IsBiDirectional()) {
-			m_visitFlags.set(iReverseSegment);
-			m_segData[iReverseSegment].nPaths = 1;
-			m_segData[iReverseSegment].dist = 0.0f;
-			//m_segStack.push(iReverseSegment); // Should we do this???
-		}
+		auto& queue = GetQueue(TQueueTag<QUEUE_TYPE>());
 
-		CAxialGraph::NETWORKLINE& seg = m_Graph->getLine(iSegment);
+		m_Search.SetOrigin(iSegment);
+		m_dep[iSegment] = 0.0f;
 
-		// For Straight radius calculation
-		const float2 ptCenter = (seg.p1 + seg.p2) * 0.5f;
+		int iReverseSegment = iSegment + m_Graph->getLineCount();
+		if (BIDIRECTIONAL) {
+			m_Search.SetOrigin(iReverseSegment);
+			m_dep[iReverseSegment] = 0.0f;
+		}
 
 		for (int i = 0; i < seg.nCrossings; ++i) {
 
@@ -245,53 +429,16 @@ namespace
 			bool bReverse = (lc.linePos < (seg.length * 0.5f));
 			bool bNextReverse = (olc.linePos >(seg2.length * 0.5f));
 
-			// Walking Distance
-			state.dist.walking = (seg.length + seg2.length) * 0.5f;
-
-			// Turns
-			state.dist.turns = 1.0f;
-
-			// Angle
-			float currAngle = bReverse ? reverseAngle(seg.angle) : seg.angle;
-			float targetAngle = bNextReverse ? reverseAngle(seg2.angle) : seg2.angle;
-			state.dist.angle = angleDiff(currAngle, targetAngle);
-
-			// Ax-meter
-			state.dist.axmeter = (seg.length * 0.5f) + seg2.length;
+			const DIST zero_dist = { 0, 0, 0, 0 };
+			TStep<METRICS>(zero_dist, seg, bReverse, seg2, bNextReverse, state.dist);
 
 			// Radius Tests
-			if (EPSTADistanceTypeMask_Walking & m_limits.m_Mask) {
-				if (state.dist.walking > m_limits.m_Walking)
-					continue;
-			}
-			if (EPSTADistanceTypeMask_Steps & m_limits.m_Mask) {
-				if ((int)state.dist.turns > m_limits.m_Steps)
-					continue;
-			}
-			if (EPSTADistanceTypeMask_Angular & m_limits.m_Mask) {
-				if (state.dist.angle > m_limits.m_Angular)
-					continue;
-			}
-			if (EPSTADistanceTypeMask_Axmeter & m_limits.m_Mask) {
-				if (state.dist.axmeter > m_limits.m_Axmeter)
-					continue;
-			}
-			if (EPSTADistanceTypeMask_Straight & m_limits.m_Mask) {
-				if ((((seg2.p1 + seg2.p2) * 0.5f) - ptCenter).getLengthSqr() > m_limits.m_Straight*m_limits.m_Straight)
-					continue;
-			}
+			if (!TIsWithinRadius<METRICS>(state.dist))
+				continue;
+			if (view.m_HasStraightRadius && (((seg2.p1 + seg2.p2) * 0.5f) - view.m_OriginCenter).getLengthSqr() > m_maxStraightSqr)
+				continue;
 
-			switch (m_distType) {
-			case EPSTADistanceType_Walking: state.cmpdist = state.dist.walking; break;
-			case EPSTADistanceType_Steps:   state.cmpdist = state.dist.turns;   break;
-			case EPSTADistanceType_Angular: state.cmpdist = state.dist.angle;   break;
-			case EPSTADistanceType_Axmeter: state.cmpdist = state.dist.axmeter; break;
-			
-			// Unhandled
-			case EPSTADistanceType_Undefined:
-			default:
-				ASSERT(false && "Unsupported distance type");
-			}
+			state.cmpdist = TGetDist<DIST_TYPE>(state.dist);
 
 			state.iPrevSegment = iSegment;
 			if (bReverse)
@@ -301,156 +448,19 @@ namespace
 			if (bNextReverse)
 				state.iSegment += m_Graph->getLineCount();
 
-			m_queue.push(state);
+			queue.push(state);
 
 		}
 
 
 		// Traverse graph
 
-		while (!m_queue.empty()) {
-
-			const STATE state = m_queue.top();
-			m_queue.pop();
-
-			unsigned int iSegment = state.iSegment;
-
-			bool bReverse = (iSegment >= (unsigned int)m_Graph->getLineCount());
-
-			unsigned int iRealSegment = iSegment;
-			if (bReverse)
-				iRealSegment -= (unsigned int)m_Graph->getLineCount();
-
-			const CAxialGraph::NETWORKLINE& seg = m_Graph->getLine(iRealSegment);
-
-			if (!IsBiDirectional())
-				iSegment = iRealSegment;
-
-			SEGDATA &segData = m_segData[iSegment];
-
-			if (!m_visitFlags.get(iSegment)) {
-
-				// Check if first time this segment is reached in EITHER direction
-				if (!IsBiDirectional() || !m_visitFlags.get(GetReverseSegmentIndex(iSegment)))
-				{
-					total_depth += state.cmpdist;
-					++num_segments_reached;
-				}
-
-				m_visitFlags.set(iSegment);
-
-				m_segStack.push(iSegment);
-
-				segData.dist = state.cmpdist;
-				segData.nPaths = 0;
-
-				for (int i = 0; i < seg.nCrossings; ++i) {
-
-					int iNLC = seg.iFirstCrossing + i;
-
-					const CAxialGraph::LINECROSSING& nlc = m_Graph->getLineCrossing(iNLC);
-
-					if ((nlc.linePos > seg.length * 0.5f) == bReverse)
-						continue; // Never leave the same end we entered
-
-					const CAxialGraph::LINECROSSING& olc = m_Graph->getLineCrossing(nlc.iOpposite);
-					const CAxialGraph::NETWORKLINE&  seg2 = m_Graph->getLine(olc.iLine);
-
-					// ----------------------
-					STATE nextState;
-
-					int iNextSegment = olc.iLine;
-
-					// Check if we'll enter the next segment in reverse direction
-					bool bNextReverse = (olc.linePos > (seg2.length * 0.5f));
-
-					if (bNextReverse)
-						iNextSegment += m_Graph->getLineCount();
-
-					// Don't visit the next segment if it has already been visited
-					if (m_visitFlags.get(IsBiDirectional() ? iNextSegment : olc.iLine))
-						continue;
-
-					// Walking Distance
-					nextState.dist.walking = state.dist.walking + (seg.length + seg2.length) * 0.5f;
-
-					// Turns
-					nextState.dist.turns = state.dist.turns + 1;
-
-					// Angle
-					float currAngle = bReverse ? reverseAngle(seg.angle) : seg.angle;
-					float targetAngle = bNextReverse ? reverseAngle(seg2.angle) : seg2.angle;
-					nextState.dist.angle = state.dist.angle + angleDiff(currAngle, targetAngle);
-
-					// Ax-meter
-					nextState.dist.axmeter = state.dist.axmeter +
-						((seg.length * (state.dist.turns + 1.0f)) + (seg2.length * (state.dist.turns + 2.0f))) * 0.5f;
-
-					// Radius Tests
-					if (EPSTADistanceTypeMask_Walking & m_limits.m_Mask) {
-						if (nextState.dist.walking > m_limits.m_Walking)
-							continue;
-					}
-					if (EPSTADistanceTypeMask_Steps & m_limits.m_Mask) {
-						if ((int)nextState.dist.turns > m_limits.m_Steps)
-							continue;
-					}
-					if (EPSTADistanceTypeMask_Angular & m_limits.m_Mask) {
-						if (nextState.dist.angle > m_limits.m_Angular)
-							continue;
-					}
-					if (EPSTADistanceTypeMask_Axmeter & m_limits.m_Mask) {
-						if (nextState.dist.axmeter > m_limits.m_Axmeter)
-							continue;
-					}
-					if (EPSTADistanceTypeMask_Straight & m_limits.m_Mask) {
-						if ((((seg2.p1 + seg2.p2) * 0.5f) - ptCenter).getLengthSqr() > m_limits.m_Straight*m_limits.m_Straight)
-							continue;
-					}
-
-					switch (m_distType) {
-					case EPSTADistanceType_Walking: nextState.cmpdist = nextState.dist.walking; break;
-					case EPSTADistanceType_Steps:   nextState.cmpdist = nextState.dist.turns;   break;
-					case EPSTADistanceType_Angular: nextState.cmpdist = nextState.dist.angle;   break;
-					case EPSTADistanceType_Axmeter: nextState.cmpdist = nextState.dist.axmeter; break;
-
-					// Unhandled
-					case EPSTADistanceType_Undefined:
-					default:
-						ASSERT(false && "Unsupported distance type");
-					}
-
-					nextState.iPrevSegment = iSegment;
-					nextState.iSegment = iNextSegment;
-
-					m_queue.push(nextState);
-
-				}
-
-			} // [end] if (!m_visitFlags.get(state.iSegment))
-
-
-			if (state.cmpdist == segData.dist) {
-
-				unsigned int iPrevSegment = state.iPrevSegment;
-
-				if (!IsBiDirectional() && (iPrevSegment >= (unsigned int)m_Graph->getLineCount()))
-					iPrevSegment -= m_Graph->getLineCount();
-
-				segData.nPaths += m_segData[iPrevSegment].nPaths;
-				AddPredecessor(segData, iPrevSegment);
-			}
-
-		} // [end] while (!m_queue.empty())
-
+		m_Search.Run(queue, view);
 
 
 		///////////////
 		// Accumulate
 
-		if (!m_dep.empty())
-			memset(&m_dep.front(), 0, m_dep.size() * sizeof(m_dep.front()));
-
 		//float srcLength = m_pGraph->getLine(iSegment).length;
 
 		float srcWeight = 0.0f;
@@ -458,14 +468,11 @@ namespace
 			srcWeight = m_WeightPerSegment[iSegment];
 		}
 
-		while (!m_segStack.empty()) {
-
-			const unsigned int w = m_segStack.top();
-			m_segStack.pop();
-
-			SEGDATA& segdata = m_segData[w];
+		m_Search.ForEachSettledReverse([&](const unsigned int w, const unsigned int* preds, unsigned int pred_count)
+		{
+			const float nPaths = (float)m_Search.PathCount(w);
 
-			if (IsBiDirectional()) {
+			if (BIDIRECTIONAL) {
 
 				// Bi-directional algorithm
 
@@ -476,42 +483,40 @@ namespace
 				//const CAxialGraph::NETWORKLINE& targetSegment = m_pGraph->getLine(iRealSegment);
 
 				// Get index of reverse line 
-				unsigned int iOpposite =
-					(w < (unsigned int)m_Graph->getLineCount()) ?
-					m_Graph->getLineCount() + w :
-					w - m_Graph->getLineCount();
+				unsigned int iOpposite = GetReverseSegmentIndex(w);
 
-				bool bShortestPath = (!m_visitFlags.get(iOpposite) || (segdata.dist <= m_segData[iOpposite].dist));
+				bool bShortestPath = (!m_Search.IsSettled(iOpposite) || (m_Search.Distance(w) <= m_Search.Distance(iOpposite)));
 
 				// Loop through predecessors
-				PopPredecessors(segdata, [&](unsigned int v)
+				for (unsigned int i = 0; i < pred_count; ++i)
 				{
+					const unsigned int v = preds[i];
 					if (bShortestPath) {
 						if (UseWeights()) {
 							//m_dep[v] += ((float)m_segData[v].nPaths / segdata.nPaths) * (targetSegment.length + m_dep[w]);
-							m_dep[v] += ((float)m_segData[v].nPaths / segdata.nPaths) * (m_WeightPerSegment[iRealSegment] + m_dep[w]);
+							m_dep[v] += ((float)m_Search.PathCount(v) / nPaths) * (m_WeightPerSegment[iRealSegment] + m_dep[w]);
 						}
 						else {
-							m_dep[v] += ((float)m_segData[v].nPaths / segdata.nPaths) * (1.0f + m_dep[w]);
+							m_dep[v] += ((float)m_Search.PathCount(v) / nPaths) * (1.0f + m_dep[w]);
 						}
 					}
 					else {
-						m_dep[v] += ((float)m_segData[v].nPaths / segdata.nPaths) * m_dep[w];
+						m_dep[v] += ((float)m_Search.PathCount(v) / nPaths) * m_dep[w];
 					}
-				});
+				}
 
 				// NOTE: We only add half the score because the algorithm counts
 				//       each path twice - once for each direction.
 				if (UseWeights()) {
 					//m_result[iRealSegment] += srcLength * m_dep[w] * 0.5f;			
-					m_result[iRealSegment] += srcWeight * m_dep[w] * 0.5f;
+					result[iRealSegment] += srcWeight * m_dep[w] * 0.5f;
 					if (bShortestPath) {
 						//m_result[iRealSegment] += srcLength * targetSegment.length * 0.25f;			
-						m_result[iRealSegment] += srcWeight * m_WeightPerSegment[iRealSegment] * 0.25f;
+						result[iRealSegment] += srcWeight * m_WeightPerSegment[iRealSegment] * 0.25f;
 					}
 				}
 				else {
-					m_result[iRealSegment] += m_dep[w] * 0.5f;
+					result[iRealSegment] += m_dep[w] * 0.5f;
 				}
 
 			}
@@ -522,52 +527,246 @@ namespace
 				//const CAxialGraph::NETWORKLINE& targetSegment = m_pGraph->getLine(w);
 
 				// Loop through predecessors
-				PopPredecessors(segdata, [&](unsigned int v)
+				for (unsigned int i = 0; i < pred_count; ++i)
 				{
+					const unsigned int v = preds[i];
 					if (UseWeights()) {
 						//m_dep[v] += ((float)m_segData[v].nPaths / segdata.nPaths) * (targetSegment.length + m_dep[w]);
-						m_dep[v] += ((float)m_segData[v].nPaths / segdata.nPaths) * (m_WeightPerSegment[w] + m_dep[w]);
+						m_dep[v] += ((float)m_Search.PathCount(v) / nPaths) * (m_WeightPerSegment[w] + m_dep[w]);
 					}
 					else {
-						m_dep[v] += ((float)m_segData[v].nPaths / segdata.nPaths) * (1.0f + m_dep[w]);
+						m_dep[v] += ((float)m_Search.PathCount(v) / nPaths) * (1.0f + m_dep[w]);
 					}
-				});
+				}
 
 				// NOTE: We only add half the score because the algorithm counts
 				//       each path twice - once for each direction.
 				if (UseWeights()) {
 					//m_result[w] += srcLength * (m_dep[w] + (targetSegment.length * 0.5f)) * 0.5f; 
-					m_result[w] += srcWeight * (m_dep[w] + (m_WeightPerSegment[w] * 0.5f)) * 0.5f;
+					result[w] += srcWeight * (m_dep[w] + (m_WeightPerSegment[w] * 0.5f)) * 0.5f;
 				}
 				else {
-					m_result[w] += m_dep[w] * 0.5f;
+					result[w] += m_dep[w] * 0.5f;
 				}
 
 			}
 
-		}
+		});
 
 		if (UseWeights()) {
 
 			// NOTE: We only add half the score because the algorithm count
 			//       each path twice - once for each direction.
 			//m_result[iSegment] += m_dep[iSegment] * srcLength * 0.5f * 0.5f;
-			m_result[iSegment] += m_dep[iSegment] * srcWeight * 0.5f * 0.5f;
+			result[iSegment] += m_dep[iSegment] * srcWeight * 0.5f * 0.5f;
 
-			if (IsBiDirectional()) {
+			if (BIDIRECTIONAL) {
 				//m_result[iSegment] += m_dep[iReverseSegment] * srcLength * 0.5f * 0.5f;
-				m_result[iSegment] += m_dep[iReverseSegment] * srcWeight * 0.5f * 0.5f;
+				result[iSegment] += m_dep[iReverseSegment] * srcWeight * 0.5f * 0.5f;
 			}
 
 			// This "self-betweenness" score however is only counted once per 
 			// segment and is therefore not divided by two.
 			//m_result[iSegment] += srcLength * srcLength * 0.25f;	
-			m_result[iSegment] += srcWeight * srcWeight * 0.25f;
+			result[iSegment] += srcWeight * srcWeight * 0.25f;
 
 		}
 
-		ret_node_count = num_segments_reached + 1;  // We want to store count INCLUDING origin segment (so +1 here)!
-		ret_total_depth = (EPSTADistanceType_Angular == m_distType) ? SyntaxAngleWeightFromDegrees((float)total_depth) : (float)total_depth;
+		ret_node_count = view.m_NumSegmentsReached + 1;  // We want to store count INCLUDING origin segment (so +1 here)!
+		ret_total_depth = (EPSTADistanceType_Angular == DIST_TYPE) ? SyntaxAngleWeightFromDegrees((float)view.m_TotalDepth) : (float)view.m_TotalDepth;
+	}
+
+	template <EPSTADistanceType DIST_TYPE, unsigned int METRICS>
+	template <class TQueue>
+	void CBetweennessAlgoWorker::TGraphView<DIST_TYPE, METRICS>::OnSettle(const STATE& state, TQueue& queue)
+	{
+		const CAxialGraph& graph = *m_Worker.m_Graph;
+
+		unsigned int iSegment = state.iSegment;
+
+		bool bReverse = (iSegment >= m_LineCount);
+
+		unsigned int iRealSegment = iSegment;
+		if (bReverse)
+			iRealSegment -= m_LineCount;
+
+		const CAxialGraph::NETWORKLINE& seg = graph.getLine(iRealSegment);
+
+		if (!BIDIRECTIONAL)
+			iSegment = iRealSegment;
+
+		// Check if first time this segment is reached in EITHER direction
+		if (!BIDIRECTIONAL || !m_Worker.m_Search.IsSettled(m_Worker.GetReverseSegmentIndex(iSegment)))
+		{
+			m_TotalDepth += state.cmpdist;
+			++m_NumSegmentsReached;
+		}
+
+		// Only dependencies of reached segments are accumulated (and read), so
+		// only those need to be reset, rather than all of m_dep
+		m_Worker.m_dep[iSegment] = 0.0f;
+
+		for (int i = 0; i < seg.nCrossings; ++i) {
+
+			int iNLC = seg.iFirstCrossing + i;
+
+			const CAxialGraph::LINECROSSING& nlc = graph.getLineCrossing(iNLC);
+
+			if ((nlc.linePos > seg.length * 0.5f) == bReverse)
+				continue; // Never leave the same end we entered
+
+			const CAxialGraph::LINECROSSING& olc = graph.getLineCrossing(nlc.iOpposite);
+			const CAxialGraph::NETWORKLINE&  seg2 = graph.getLine(olc.iLine);
+
+			// ----------------------
+			STATE nextState;
+
+			unsigned int iNextSegment = olc.iLine;
+
+			// Check if we'll enter the next segment in reverse direction
+			bool bNextReverse = (olc.linePos > (seg2.length * 0.5f));
+
+			if (bNextReverse)
+				iNextSegment += m_LineCount;
+
+			// Don't visit the next segment if it has already been visited
+			if (m_Worker.m_Search.IsSettled(BIDIRECTIONAL ? iNextSegment : olc.iLine))
+				continue;
+
+			m_Worker.TStep<METRICS>(state.dist, seg, bReverse, seg2, bNextReverse, nextState.dist);
+
+			// Radius Tests
+			if (!m_Worker.TIsWithinRadius<METRICS>(nextState.dist))
+				continue;
+			if (m_HasStraightRadius && (((seg2.p1 + seg2.p2) * 0.5f) - m_OriginCenter).getLengthSqr() > m_Worker.m_maxStraightSqr)
+				continue;
+
+			nextState.cmpdist = TGetDist<DIST_TYPE>(nextState.dist);
+
+			nextState.iPrevSegment = iSegment;
+			nextState.iSegment = iNextSegment;
+
+			queue.push(nextState);
+
+		}
+	}
+
+	template <unsigned int METRICS>
+	inline void CBetweennessAlgoWorker::TStep(const DIST& from, const CAxialGraph::NETWORKLINE& seg, bool bReverse, const CAxialGraph::NETWORKLINE& seg2, bool bNextReverse, DIST& ret) const
+	{
+		// Walking Distance
+		ret.walking = (METRICS & EPSTADistanceTypeMask_Walking) ? from.walking + (seg.length + seg2.length) * 0.5f : 0.0f;
+
+		// Turns
+		ret.turns = from.turns + 1;
+
+		// Angle
+		if (METRICS & EPSTADistanceTypeMask_Angular) {
+			float currAngle = bReverse ? reverseAngle(seg.angle) : seg.angle;
+			float targetAngle = bNextReverse ? reverseAngle(seg2.angle) : seg2.angle;
+			ret.angle = from.angle + angleDiff(currAngle, targetAngle);
+		}
+		else {
+			ret.angle = 0.0f;
+		}
+
+		// Ax-meter
+		ret.axmeter = (METRICS & EPSTADistanceTypeMask_Axmeter) ?
+			from.axmeter + ((seg.length * (from.turns + 1.0f)) + (seg2.length * (from.turns + 2.0f))) * 0.5f :
+			0.0f;
+	}
+
+	template <unsigned int METRICS>
+	inline bool CBetweennessAlgoWorker::TIsWithinRadius(const DIST& dist) const
+	{
+		if ((METRICS & EPSTADistanceTypeMask_Walking) && (dist.walking > m_maxWalking))
+			return false;
+		if ((METRICS & EPSTADistanceTypeMask_Steps) && ((unsigned int)dist.turns > m_maxSteps))
+			return false;
+		if ((METRICS & EPSTADistanceTypeMask_Angular) && (dist.angle > m_maxAngular))
+			return false;
+		if ((METRICS & EPSTADistanceTypeMask_Axmeter) && (dist.axmeter > m_maxAxmeter))
+			return false;
+		return true;
+	}
+
+	template <EPSTADistanceType DIST_TYPE>
+	inline float CBetweennessAlgoWorker::TGetDist(const DIST& dist)
+	{
+		switch (DIST_TYPE) {
+		case EPSTADistanceType_Walking: return dist.walking;
+		case EPSTADistanceType_Steps:   return dist.turns;
+		case EPSTADistanceType_Angular: return dist.angle;
+		case EPSTADistanceType_Axmeter: return dist.axmeter;
+		default:
+			ASSERT(false && "Unsupported distance type");
+		}
+		return 0.0f;
+	}
+
+	CBetweennessAlgoWorker::ProcessSegmentFunc CBetweennessAlgoWorker::SelectProcessSegmentFunc(const CAxialGraph& graph, EPSTADistanceType distType, unsigned int radius_mask, bool use_radix_heap)
+	{
+		if (use_radix_heap)
+		{
+			switch (distType) {
+			case EPSTADistanceType_Walking: return TSelectProcessSegmentFunc<EPSTADistanceType_Walking, QUEUE_RADIX_HEAP>(graph, radius_mask);
+			case EPSTADistanceType_Steps:   return TSelectProcessSegmentFunc<EPSTADistanceType_Steps, QUEUE_RADIX_HEAP>(graph, radius_mask);
+			case EPSTADistanceType_Angular: return TSelectProcessSegmentFunc<EPSTADistanceType_Angular, QUEUE_RADIX_HEAP>(graph, radius_mask);
+			case EPSTADistanceType_Axmeter: return TSelectProcessSegmentFunc<EPSTADistanceType_Axmeter, QUEUE_RADIX_HEAP>(graph, radius_mask);
+			default:
+				ASSERT(false && "Unsupported distance type");
+			}
+			return nullptr;
+		}
+		switch (distType) {
+		case EPSTADistanceType_Walking: return TSelectProcessSegmentFunc<EPSTADistanceType_Walking, QUEUE_BINARY_HEAP>(graph, radius_mask);
+		case EPSTADistanceType_Steps:   return TSelectProcessSegmentFunc<EPSTADistanceType_Steps, QUEUE_BINARY_HEAP>(graph, radius_mask);
+		case EPSTADistanceType_Angular: return TSelectProcessSegmentFunc<EPSTADistanceType_Angular, QUEUE_BINARY_HEAP>(graph, radius_mask);
+		case EPSTADistanceType_Axmeter: return TSelectProcessSegmentFunc<EPSTADistanceType_Axmeter, QUEUE_BINARY_HEAP>(graph, radius_mask);
+		default:
+			ASSERT(false && "Unsupported distance type");
+		}
+		return nullptr;
+	}
+
+	template <EPSTADistanceType DIST_TYPE, CBetweennessAlgoWorker::EQueueType HEAP_TYPE>
+	CBetweennessAlgoWorker::ProcessSegmentFunc CBetweennessAlgoWorker::TSelectProcessSegmentFunc(const CAxialGraph& graph, unsigned int radius_mask)
+	{
+		const unsigned int D = EPSTADistanceMaskFromType(DIST_TYPE);
+		const unsigned int W = EPSTADistanceTypeMask_Walking;
+		const unsigned int S = EPSTADistanceTypeMask_Steps;
+		const unsigned int A = EPSTADistanceTypeMask_Angular;
+		const unsigned int X = EPSTADistanceTypeMask_Axmeter;
+		const unsigned int metrics = D | (radius_mask & (W | S | A | X));
+		if (metrics == (D) && QUEUE_FIFO == TQueueType<DIST_TYPE, D, HEAP_TYPE>() && !IsBreadthFirstSafe(graph))
+			return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D, HEAP_TYPE, HEAP_TYPE>;
+		if (metrics == (D))                 return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D, HEAP_TYPE>;
+		if (metrics == (D | W))             return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | W, HEAP_TYPE>;
+		if (metrics == (D | S))             return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | S, HEAP_TYPE>;
+		if (metrics == (D | A))             return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | A, HEAP_TYPE>;
+		if (metrics == (D | X))             return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | X, HEAP_TYPE>;
+		if (metrics == (D | W | S))         return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | W | S, HEAP_TYPE>;
+		if (metrics == (D | W | A))         return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | W | A, HEAP_TYPE>;
+		if (metrics == (D | W | X))         return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | W | X, HEAP_TYPE>;
+		if (metrics == (D | S | A))         return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | S | A, HEAP_TYPE>;
+		if (metrics == (D | S | X))         return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | S | X, HEAP_TYPE>;
+		if (metrics == (D | A | X))         return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | A | X, HEAP_TYPE>;
+		if (metrics == (D | W | S | A))     return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | W | S | A, HEAP_TYPE>;
+		if (metrics == (D | W | S | X))     return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | W | S | X, HEAP_TYPE>;
+		if (metrics == (D | W | A | X))     return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | W | A | X, HEAP_TYPE>;
+		if (metrics == (D | S | A | X))     return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | S | A | X, HEAP_TYPE>;
+		return &CBetweennessAlgoWorker::TProcessSegment<DIST_TYPE, D | W | S | A | X, HEAP_TYPE>;
+	}
+
+	bool CBetweennessAlgoWorker::IsBreadthFirstSafe(const CAxialGraph& graph)
+	{
+		for (int i = 0; i < graph.getLineCrossingCount(); ++i)
+		{
+			const CAxialGraph::LINECROSSING& lc = graph.getLineCrossing(i);
+			if (lc.linePos != 0 && lc.linePos != graph.getLine(lc.iLine).length)
+				return false;
+		}
+		return true;
 	}
 
 	unsigned int CBetweennessAlgoWorker::GetReverseSegmentIndex(unsigned int index) const
@@ -594,6 +793,7 @@ namespace
 		EPSTADistanceType distType, 
 		const SPSTARadii& limits, 
 		const float* weight_per_segment, 
+		bool use_radix_heap,
 		float* ret_betweenness, 
 		unsigned int* ret_node_counts, 
 		float* ret_total_depths, 
@@ -601,17 +801,8 @@ namespace
 	{
 		using namespace std;
 
-		// Verify valid distance type
-		switch (distType) {
-			case EPSTADistanceType_Walking:
-			case EPSTADistanceType_Steps:
-			case EPSTADistanceType_Angular:
-			case EPSTADistanceType_Axmeter:
-				break;
-			default:
-				LOG_ERROR("Unsupported distance type");
-				return false;
-		}
+		if (!IsSupportedDistanceType(distType))
+			return false;
 
 		std::atomic<unsigned int> num_processed_segments(0);
 
@@ -638,6 +829,7 @@ namespace
 				distType,
 				std::ref(limits),
 				weight_per_segment,
+				use_radix_heap,
 				ret_node_counts,
 				ret_total_depths,
 				std::ref(num_processed_segments)));
@@ -684,6 +876,208 @@ namespace
 
 		return true;
 	}
+
+	bool CBetweennessAlgo::RunSampled(
+		CAxialGraph& graph,
+		EPSTADistanceType distType,
+		const SPSTARadii& limits,
+		const float* weight_per_segment,
+		bool use_radix_heap,
+		const SSampling& sampling,
+		float* ret_betweenness,
+		float* ret_errors,
+		unsigned int* ret_sample_count,
+		unsigned int* ret_node_counts,
+		float* ret_total_depths,
+		IProgressCallback& progress)
+	{
+		using namespace std;
+
+		if (!IsSupportedDistanceType(distType))
+			return false;
+
+		const unsigned int line_count = (unsigned int)graph.getLineCount();
+
+		// Origins without weight contribute nothing, and are left out of the population
+		std::vector<unsigned int> origins;
+		std::vector<float2> centers;
+		origins.reserve(line_count);
+		centers.reserve(line_count);
+		for (unsigned int i = 0; i < line_count; ++i)
+		{
+			if (weight_per_segment && !(weight_per_segment[i] > 0.0f))
+				continue;
+			const auto& line = graph.getLine(i);
+			origins.push_back(i);
+			centers.push_back((line.p1 + line.p2) * 0.5f);
+		}
+		const unsigned int population = (unsigned int)origins.size();
+
+		// Origins in the order they will be sampled in, spread over the map
+		const SPivotSampling pivot_sampling = { 0, sampling.m_TargetError, sampling.m_Seed };
+		std::vector<unsigned int> order = CPivotSampler::StratifiedOrder(centers, CPivotSampler::CellsPerSide(pivot_sampling), sampling.m_Seed);
+		for (auto& origin : order)
+			origin = origins[origin];
+
+		if (ret_node_counts)
+			std::fill(ret_node_counts, ret_node_counts + line_count, 0);
+		if (ret_total_depths)
+			std::fill(ret_total_depths, ret_total_depths + line_count, 0.0f);
+
+		for (auto& worker : m_Workers)
+			worker.Init(graph, distType, limits, weight_per_segment, use_radix_heap, true);
+
+		const double z = ZFromConfidence(sampling.m_Confidence);
+
+		std::vector<double> estimates(line_count);
+		std::vector<double> half_widths(line_count);
+
+		// Betweenness is estimated as population / sample_count times the sum of
+		// contributions of sampled origins (see CPivotSampler::Estimate). Lines
+		// that no or few sampled origins contribute to get a sample variance that
+		// is far too small, even zero, although unsampled origins may well
+		// contribute to them. Their variance is therefore raised to what it would
+		// be if one of the sampled origins had contributed as much as the largest
+		// contribution of any origin to any line, and the others nothing.
+		auto estimate = [&](unsigned int sample_count)
+		{
+			double min_variance = 0;
+			if (sample_count > 0 && sample_count < population)
+			{
+				double max_contribution = 0;
+				for (const auto& worker : m_Workers)
+					max_contribution = max(max_contribution, worker.GetMaxContribution());
+				const double k = sample_count;
+				const double N = population;
+				min_variance = N * N * (1.0 - k / N) * max_contribution * max_contribution / (k * k);
+			}
+			for (unsigned int line_index = 0; line_index < line_count; ++line_index)
+			{
+				double sum = 0, sum_sqr = 0;
+				for (const auto& worker : m_Workers)
+				{
+					sum += worker.GetBetweennessScores()[line_index];
+					sum_sqr += worker.GetSquaredScores()[line_index];
+				}
+				double variance;
+				CPivotSampler::Estimate(sum, sum_sqr, sample_count, population, estimates[line_index], variance);
+				half_widths[line_index] = z * sqrt(max(variance, min_variance));
+			}
+		};
+
+		std::atomic<unsigned int> num_processed_segments(0);
+
+		auto report_progress = [&](unsigned int elapsed_msec)
+		{
+			float p = population ? (float)num_processed_segments.load() / population : 1.0f;
+			if (sampling.m_TimeBudget > 0)
+				p = max(p, elapsed_msec * 0.001f / sampling.m_TimeBudget);
+			progress.ReportProgress(min(p, 1.0f));
+		};
+
+		const unsigned int start_msec = GetTimeMSec();
+		const unsigned int time_budget_msec = (sampling.m_TimeBudget > 0) ? max(1u, (unsigned int)(sampling.m_TimeBudget * 1000.0f)) : 0;
+
+		// Every batch of origins is split among the workers. Workers that run out
+		// of time stop early, which ends the sampling.
+		auto process = [&](unsigned int first, unsigned int count)
+		{
+			const unsigned int origins_per_worker = count / (unsigned int)m_Workers.size() + 1;
+
+			std::vector<std::future<unsigned int>> tasks;
+			tasks.reserve(m_Workers.size());
+
+			for (unsigned int worker_index = 0; worker_index < m_Workers.size(); ++worker_index)
+			{
+				const unsigned int first_for_worker = origins_per_worker * worker_index;
+				if (first_for_worker >= count)
+					break;
+				tasks.push_back(std::async(
+					std::launch::async,
+					&CBetweennessAlgoWorker::RunSampled,
+					&m_Workers[worker_index],
+					order.data() + first + first_for_worker,
+					min(origins_per_worker, count - first_for_worker),
+					ret_node_counts,
+					ret_total_depths,
+					start_msec,
+					time_budget_msec,
+					std::ref(num_processed_segments)));
+			}
+
+			unsigned int processed_count = 0;
+			for (auto& task : tasks)
+			{
+				while (std::future_status::ready != task.wait_for(std::chrono::milliseconds(100)))
+					report_progress(GetTimeMSec() - start_msec);
+				processed_count += task.get();
+			}
+			report_progress(GetTimeMSec() - start_msec);
+
+			return processed_count;
+		};
+
+		// Largest half width relative to the highest betweenness
+		auto max_relative_error = [&](unsigned int sample_count)
+		{
+			if (!(sampling.m_TargetError > 0))
+				return std::numeric_limits<double>::infinity();
+			estimate(sample_count);
+			double max_estimate = 0, max_half_width = 0;
+			for (unsigned int line_index = 0; line_index < line_count; ++line_index)
+			{
+				max_estimate = max(max_estimate, estimates[line_index]);
+				max_half_width = max(max_half_width, half_widths[line_index]);
+			}
+			return (max_half_width > 0) ? max_half_width / max_estimate : 0.0;
+		};
+
+		const unsigned int sample_count = CPivotSampler::Run(population, pivot_sampling, process, max_relative_error);
+
+		estimate(sample_count);
+
+		if (ret_betweenness)
+			for (unsigned int line_index = 0; line_index < line_count; ++line_index)
+				ret_betweenness[line_index] = (float)estimates[line_index];
+		if (ret_errors)
+			for (unsigned int line_index = 0; line_index < line_count; ++line_index)
+				ret_errors[line_index] = (float)half_widths[line_index];
+		if (ret_sample_count)
+			*ret_sample_count = sample_count;
+
+		progress.ReportProgress(1.f);
+
+		return true;
+	}
+
+	bool CBetweennessAlgo::IsSupportedDistanceType(EPSTADistanceType distType)
+	{
+		switch (distType) {
+			case EPSTADistanceType_Walking:
+			case EPSTADistanceType_Steps:
+			case EPSTADistanceType_Angular:
+			case EPSTADistanceType_Axmeter:
+				return true;
+			default:
+				LOG_ERROR("Unsupported distance type");
+				return false;
+		}
+	}
+
+	double CBetweennessAlgo::ZFromConfidence(double confidence)
+	{
+		// P(|Z| <= z) = erf(z / sqrt(2)) is increasing in z, so bisect for it
+		double lo = 0, hi = 10;
+		for (int i = 0; i < 64; ++i)
+		{
+			const double mid = 0.5 * (lo + hi);
+			if (std::erf(mid / std::sqrt(2.0)) < confidence)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		return 0.5 * (lo + hi);
+	}
 }
 
 // node_counts[i] = number of nodes reached from node i, INCLUDING origin node i
@@ -739,6 +1133,12 @@ PSTADllExport bool PSTASegmentBetweenness(const SPSTASegmentBetweennessDesc* des
 	CBetweennessAlgo algo;
 	CPSTAlgoProgressCallback progress(desc->m_ProgressCallback, desc->m_ProgressCallbackUser);
 
+	if (desc->m_Approximate)
+	{
+		const SSampling sampling = { desc->m_TargetError, desc->m_TimeBudget, desc->m_Confidence, desc->m_Seed };
+		return algo.RunSampled(*graph, (EPSTADistanceType)desc->m_DistanceType, desc->m_Radius, weights_per_segment, desc->m_UseRadixHeap, sampling, desc->m_OutBetweenness, desc->m_OutBetweennessError, desc->m_OutSampleCount, desc->m_OutNodeCount, desc->m_OutTotalDepth, progress);
+	}
+
 	// Run the algorithm
-	return algo.Run(*graph, (EPSTADistanceType)desc->m_DistanceType, desc->m_Radius, weights_per_segment, desc->m_OutBetweenness, desc->m_OutNodeCount, desc->m_OutTotalDepth, progress);
+	return algo.Run(*graph, (EPSTADistanceType)desc->m_DistanceType, desc->m_Radius, weights_per_segment, desc->m_UseRadixHeap, desc->m_OutBetweenness, desc->m_OutNodeCount, desc->m_OutTotalDepth, progress);
 }
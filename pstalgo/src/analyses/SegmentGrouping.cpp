@@ -20,7 +20,6 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <algorithm>
-#include <queue>
 #include <vector>
 
 #include <pstalgo/Debug.h>
@@ -30,80 +29,86 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 #include <pstalgo/graph/SegmentGraph.h>
 #include <pstalgo/graph/SegmentGroupGraph.h>
 #include <pstalgo/graph/SimpleGraph.h>
-#include <pstalgo/utils/BitVector.h>
+#include <pstalgo/utils/Concurrency.h>
 
 #include "../ProgressUtil.h"
 
+// Neighbours of a group are the groups of all segments that share an intersection
+// with any segment of the group. Groups are processed in parallel, in blocks.
 CSimpleGraph CreateSegmentGroupConnectionGraph(const CSegmentGraph& segment_graph, const uint32* group_id_per_segment, const uint32 group_count)
 {
-	CBitVector segment_bitmask;
-	segment_bitmask.resize(segment_graph.GetSegmentCount());
-	segment_bitmask.clearAll();
-		
-	std::vector<uint32> group_to_segment(group_count, (uint32)-1);
-	for (uint32 i = segment_graph.GetSegmentCount() - 1; (uint32)-1 != i; --i)
-		group_to_segment[group_id_per_segment[i]] = i;
+	const uint32 BLOCK_SIZE = 0x1000;
+
+	// Segments ordered by group
+	std::vector<uint32> first_segment_per_group(group_count + 1, 0);
+	for (uint32 i = 0; i < segment_graph.GetSegmentCount(); ++i)
+		++first_segment_per_group[group_id_per_segment[i] + 1];
+	for (uint32 i = 0; i < group_count; ++i)
+		first_segment_per_group[i + 1] += first_segment_per_group[i];
+	std::vector<uint32> segments_by_group(segment_graph.GetSegmentCount());
+	{
+		std::vector<uint32> cursor(first_segment_per_group.begin(), first_segment_per_group.end() - 1);
+		for (uint32 i = 0; i < segment_graph.GetSegmentCount(); ++i)
+			segments_by_group[cursor[group_id_per_segment[i]]++] = i;
+	}
 
-	CSimpleGraph graph;
-	graph.Reserve(
-		segment_graph.GetSegmentCount(), 
-		segment_graph.GetSegmentCount() * 3);  // Estimation
-
-	std::queue<uint32> bfs_queue;
-	std::vector<uint32> processed_segments;
-	std::vector<uint32> neighbour_groups;
-	for (uint32 group_index = 0; group_index < group_count; ++group_index)
+	struct SBlock
 	{
-		const uint32 start_segment_index = group_to_segment[group_index];
-		
-		bfs_queue.push(start_segment_index);
-		segment_bitmask.set(start_segment_index);
-		processed_segments.push_back(start_segment_index);
-		
-		// Do BFS search and find neighbour groups
-		neighbour_groups.clear();
-		while (!bfs_queue.empty())
+		std::vector<uint32> m_NeighbourCounts;
+		std::vector<uint32> m_Neighbours;
+	};
+	std::vector<SBlock> blocks((group_count + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+	psta::parallel_for_blocks(group_count, BLOCK_SIZE, [&](uint32 begin, uint32 end)
+	{
+		auto& block = blocks[begin / BLOCK_SIZE];
+		block.m_NeighbourCounts.reserve(end - begin);
+		std::vector<uint32> neighbour_groups;
+		for (uint32 group_index = begin; group_index < end; ++group_index)
 		{
-			const uint32 segment_index = bfs_queue.front();
-			bfs_queue.pop();
-			const auto& segment = segment_graph.GetSegment(segment_index);
-			for (auto* intersection : segment.m_Intersections)
+			neighbour_groups.clear();
+			for (uint32 i = first_segment_per_group[group_index]; i < first_segment_per_group[group_index + 1]; ++i)
 			{
-				if (nullptr == intersection)
-					continue;
-				for (unsigned int neighbour_index = 0; neighbour_index < intersection->m_NumSegments; ++neighbour_index)
+				const auto& segment = segment_graph.GetSegment(segments_by_group[i]);
+				for (auto* intersection : segment.m_Intersections)
 				{
-					const auto neighbour_segment_index = intersection->m_Segments[neighbour_index];
-					if (segment_bitmask.get(neighbour_segment_index))
-						continue;  // Already visited
-					segment_bitmask.set(neighbour_segment_index);
-					processed_segments.push_back(neighbour_segment_index);
-					if (group_id_per_segment[neighbour_segment_index] == group_index)
-						bfs_queue.push(neighbour_segment_index);
-					else
-						neighbour_groups.push_back(group_id_per_segment[neighbour_segment_index]);
+					if (nullptr == intersection)
+						continue;
+					for (unsigned int neighbour_index = 0; neighbour_index < intersection->m_NumSegments; ++neighbour_index)
+					{
+						const auto neighbour_group = group_id_per_segment[intersection->m_Segments[neighbour_index]];
+						if (neighbour_group != group_index)
+							neighbour_groups.push_back(neighbour_group);
+					}
 				}
 			}
+
+			// Sort neighbour_groups and remove duplicates
+			std::sort(neighbour_groups.begin(), neighbour_groups.end());
+			neighbour_groups.erase(std::unique(neighbour_groups.begin(), neighbour_groups.end()), neighbour_groups.end());
+
+			block.m_NeighbourCounts.push_back((uint32)neighbour_groups.size());
+			block.m_Neighbours.insert(block.m_Neighbours.end(), neighbour_groups.begin(), neighbour_groups.end());
 		}
+	});
+
+	size_t neighbour_count = 0;
+	for (const auto& block : blocks)
+		neighbour_count += block.m_Neighbours.size();
 
-		// Clear segment_bitmask and processed_segments
-		for (uint32 seg_index : processed_segments)
-			segment_bitmask.clear(seg_index);
-		processed_segments.clear();
+	CSimpleGraph graph;
+	graph.Reserve(group_count, (uint32)(neighbour_count / 2));
 
-		// Sort neighbour_groups and remove duplicates
-		std::sort(neighbour_groups.begin(), neighbour_groups.end());
-		uint32 n = std::min((uint32)neighbour_groups.size(), (uint32)1);
-		for (uint32 i = 1; i < neighbour_groups.size(); ++i)
+	// Add nodes
+	for (auto& block : blocks)
+	{
+		const uint32* neighbours = block.m_Neighbours.data();
+		for (const auto count : block.m_NeighbourCounts)
 		{
-			if (neighbour_groups[i - 1] == neighbour_groups[i])
-				continue;
-			neighbour_groups[n++] = neighbour_groups[i];
+			graph.AddNode(neighbours, count);
+			neighbours += count;
 		}
-		neighbour_groups.resize(n);
-
-		// Add node
-		graph.AddNode(neighbour_groups.data(), (uint32)neighbour_groups.size());
+		block = SBlock();
 	}
 
 	return graph;
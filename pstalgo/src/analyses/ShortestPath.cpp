@@ -0,0 +1,497 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <pstalgo/analyses/ShortestPath.h>
+#include <pstalgo/graph/AxialGraph.h>
+#include <pstalgo/Debug.h>
+
+namespace psta
+{
+	namespace
+	{
+		float GetTurnAngle(float from, float to)
+		{
+			float delta = fabsf(to - from);
+			if (delta > 180.0f)
+				delta = 360.0f - delta;
+			return delta;
+		}
+
+		inline float OppositeAngle(float angle)
+		{
+			angle -= 180.0f;
+			return (angle < 0.0f) ? 360.0f + angle : angle;
+		}
+
+		COORDS GetPointOnLine(const CAxialGraph::NETWORKLINE& line, float line_pos)
+		{
+			return (line.length > 0.f) ? line.p1 + (line.p2 - line.p1) * (line_pos / line.length) : line.p1;
+		}
+	}
+
+	class CShortestPathResult : public IPSTAlgo
+	{
+	public:
+		std::vector<unsigned int> m_Lines;
+		std::vector<double2>      m_Points;
+		std::vector<float>        m_WalkingDistances;
+		std::vector<float>        m_AngularDistances;
+		std::vector<unsigned int> m_StepDistances;
+	};
+
+	// End point of path, connected to its closest line
+	struct SPathEnd
+	{
+		COORDS m_Point;
+		int    m_Line;
+		REAL   m_DistFromLine;
+		REAL   m_LinePos;
+	};
+
+	// Returns false if graph has no lines
+	bool ConnectPathEnd(const CAxialGraph& graph, const COORDS& pt, SPathEnd& ret_end)
+	{
+		ret_end.m_Point = pt;
+		ret_end.m_Line = graph.getClosestLine(pt, &ret_end.m_DistFromLine, &ret_end.m_LinePos);
+		return ret_end.m_Line >= 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	//
+	//  CShortestPathSearch
+	//
+
+	// Point to point search over the same states as CODBetweennessWorker: being
+	// on a line having stepped onto it at one of its line crossings, and also
+	// in which direction the line is walked when angles matter. Paths are
+	// compared by the distance type being minimized first and by walking
+	// distance (or steps, when minimizing walking distance) second, which
+	// picks the most sensible among the many equally short paths in steps or
+	// angular distance. Walking distance searches are A* searches, since the
+	// straight line distance to the destination can never be longer than what
+	// remains to walk.
+	//
+	// States are kept between searches and only those reached by the current
+	// search are valid (see stamped_bit_vector), so that a search reaching a
+	// small part of a big graph doesn't pay for resetting all of it. The same
+	// instance can be used for searches in different graphs.
+	class CShortestPathSearch
+	{
+	public:
+		// Returns lines of path, and the line crossing each of them but the first
+		// was stepped onto at. Returns false if destination can't be reached.
+		bool Search(const CAxialGraph& graph, EPSTADistanceType distance_type, const SPathEnd& origin, const SPathEnd& destination, std::vector<int>& ret_lines, std::vector<int>& ret_line_crossings);
+
+	private:
+		struct SCost
+		{
+			float m_Primary;
+			float m_Secondary;
+			bool operator<(const SCost& c) const { return (m_Primary < c.m_Primary) || ((m_Primary == c.m_Primary) && (m_Secondary < c.m_Secondary)); }
+		};
+
+		enum { LINE_CROSSING_DESTINATION = -2 };
+
+		struct SStep
+		{
+			SCost m_Cost;
+			float m_Estimate;  // m_Cost.m_Primary plus lower bound of what remains
+			int   m_Line;
+			int   m_LineCrossing;  // -1 for origin line, LINE_CROSSING_DESTINATION for destination
+			int   m_PrevTrace;
+			bool  m_Forwards;
+			inline bool operator<(const SStep& s) const
+			{
+				if (m_Estimate != s.m_Estimate)
+					return m_Estimate > s.m_Estimate;
+				return m_Cost.m_Secondary > s.m_Cost.m_Secondary;
+			}
+		};
+
+		struct STrace
+		{
+			int m_Line;
+			int m_LineCrossing;
+			int m_PrevTrace;
+		};
+
+		int StateIndex(int line_crossing, bool forwards) const { return m_WeCareAboutAngles ? (line_crossing * 2 + (forwards ? 1 : 0)) : line_crossing; }
+
+		struct SState
+		{
+			SCost        m_Cost;
+			unsigned int m_Stamp;  // State is unreached unless equal to m_Generation
+			bool         m_Processed;
+		};
+
+		// Starts a new generation of m_States, where all states are unreached
+		void ResetStates(size_t state_count);
+
+		SState& State(int line_crossing, bool forwards);
+
+		void QueueStep(const SStep& step);
+
+		float LowerBound(int line_crossing) const;
+
+		const CAxialGraph* m_Graph = nullptr;
+		EPSTADistanceType m_DistanceType = EPSTADistanceType_Walking;
+		bool m_WeCareAboutAngles = false;
+		COORDS m_Destination;
+		std::vector<SStep> m_Queue;  // Heap
+		std::vector<SState> m_States;
+		unsigned int m_Generation = 0;
+		std::vector<STrace> m_Trace;
+	};
+
+	void CShortestPathSearch::ResetStates(size_t state_count)
+	{
+		if (m_States.size() < state_count)
+			m_States.resize(state_count, SState { { 0, 0 }, 0, false });
+		if (0 == ++m_Generation)
+		{
+			for (SState& state : m_States)
+				state.m_Stamp = 0;
+			m_Generation = 1;
+		}
+	}
+
+	CShortestPathSearch::SState& CShortestPathSearch::State(int line_crossing, bool forwards)
+	{
+		SState& state = m_States[StateIndex(line_crossing, forwards)];
+		if (state.m_Stamp != m_Generation)
+		{
+			state.m_Cost.m_Primary = state.m_Cost.m_Secondary = std::numeric_limits<float>::infinity();
+			state.m_Stamp = m_Generation;
+			state.m_Processed = false;
+		}
+		return state;
+	}
+
+	float CShortestPathSearch::LowerBound(int line_crossing) const
+	{
+		if (EPSTADistanceType_Walking != m_DistanceType)
+			return 0;
+		const COORDS& pt = m_Graph->getCrossing(m_Graph->getLineCrossing(line_crossing).iCrossing).pt;
+		return (m_Destination - pt).getLength();
+	}
+
+	void CShortestPathSearch::QueueStep(const SStep& step)
+	{
+		if (step.m_LineCrossing >= 0)
+		{
+			SState& state = State(step.m_LineCrossing, step.m_Forwards);
+			if (state.m_Processed || !(step.m_Cost < state.m_Cost))
+				return;
+			state.m_Cost = step.m_Cost;
+		}
+		m_Queue.push_back(step);
+		std::push_heap(m_Queue.begin(), m_Queue.end());
+	}
+
+	bool CShortestPathSearch::Search(const CAxialGraph& graph, EPSTADistanceType distance_type, const SPathEnd& origin, const SPathEnd& destination, std::vector<int>& ret_lines, std::vector<int>& ret_line_crossings)
+	{
+		switch (distance_type)
+		{
+		case EPSTADistanceType_Walking:
+		case EPSTADistanceType_Steps:
+		case EPSTADistanceType_Angular:
+			break;
+		default:
+			throw std::runtime_error("Unsupported distance type for shortest path");
+		}
+
+		ret_lines.clear();
+		ret_line_crossings.clear();
+
+		m_Graph = &graph;
+		m_DistanceType = distance_type;
+		m_WeCareAboutAngles = (EPSTADistanceType_Angular == distance_type);
+		m_Destination = destination.m_Point;
+		m_Queue.clear();
+		ResetStates(graph.getLineCrossingCount() * (m_WeCareAboutAngles ? 2 : 1));
+		m_Trace.clear();
+
+		const float origin_line_pos = origin.m_LinePos;
+		const int dest_line_index = destination.m_Line;
+		const float dest_line_pos = destination.m_LinePos;
+
+		// Adds distances of a step to 'cost', in the order paths are compared
+		auto add_cost = [&](SCost& cost, float walking, float steps, float angle)
+		{
+			switch (m_DistanceType)
+			{
+			case EPSTADistanceType_Walking:
+				cost.m_Primary += walking;
+				cost.m_Secondary += steps;
+				break;
+			case EPSTADistanceType_Steps:
+				cost.m_Primary += steps;
+				cost.m_Secondary += walking;
+				break;
+			default:
+				cost.m_Primary += angle;
+				cost.m_Secondary += walking;
+				break;
+			}
+		};
+
+		SStep step;
+		step.m_Cost.m_Primary = step.m_Cost.m_Secondary = 0;
+		add_cost(step.m_Cost, origin.m_DistFromLine, 0, 0);
+		step.m_Estimate = step.m_Cost.m_Primary;
+		step.m_Line = origin.m_Line;
+		step.m_LineCrossing = -1;
+		step.m_PrevTrace = -1;
+		step.m_Forwards = true;
+		QueueStep(step);
+		if (m_WeCareAboutAngles)
+		{
+			step.m_Forwards = false;
+			QueueStep(step);
+		}
+
+		while (!m_Queue.empty())
+		{
+			std::pop_heap(m_Queue.begin(), m_Queue.end());
+			const SStep step = m_Queue.back();
+			m_Queue.pop_back();
+
+			if (LINE_CROSSING_DESTINATION == step.m_LineCrossing)
+			{
+				for (int trace_index = step.m_PrevTrace; trace_index >= 0; trace_index = m_Trace[trace_index].m_PrevTrace)
+				{
+					ret_lines.push_back(m_Trace[trace_index].m_Line);
+					if (m_Trace[trace_index].m_LineCrossing >= 0)
+						ret_line_crossings.push_back(m_Trace[trace_index].m_LineCrossing);
+				}
+				std::reverse(ret_lines.begin(), ret_lines.end());
+				std::reverse(ret_line_crossings.begin(), ret_line_crossings.end());
+				return true;
+			}
+
+			if (step.m_LineCrossing >= 0)
+			{
+				// Skip if state has been reached with a lower cost since queued
+				SState& state = State(step.m_LineCrossing, step.m_Forwards);
+				if (state.m_Processed || state.m_Cost < step.m_Cost)
+					continue;
+				state.m_Processed = true;
+			}
+
+			STrace trace;
+			trace.m_Line = step.m_Line;
+			trace.m_LineCrossing = step.m_LineCrossing;
+			trace.m_PrevTrace = step.m_PrevTrace;
+			m_Trace.push_back(trace);
+
+			SStep next_step;
+			next_step.m_PrevTrace = (int)m_Trace.size() - 1;
+
+			const CAxialGraph::NETWORKLINE& line = graph.getLine(step.m_Line);
+			const float from_line_pos = (-1 == step.m_LineCrossing) ? origin_line_pos : graph.getLineCrossing(step.m_LineCrossing).linePos;
+
+			// Destination
+			if (step.m_Line == dest_line_index && (!m_WeCareAboutAngles || dest_line_pos == from_line_pos || step.m_Forwards == (dest_line_pos > from_line_pos)))
+			{
+				next_step.m_Cost = step.m_Cost;
+				add_cost(next_step.m_Cost, fabsf(dest_line_pos - from_line_pos) + destination.m_DistFromLine, 0, 0);
+				next_step.m_Estimate = next_step.m_Cost.m_Primary;
+				next_step.m_Line = step.m_Line;
+				next_step.m_LineCrossing = LINE_CROSSING_DESTINATION;
+				next_step.m_Forwards = step.m_Forwards;
+				m_Queue.push_back(next_step);
+				std::push_heap(m_Queue.begin(), m_Queue.end());
+			}
+
+			// Crossings
+			for (int c = 0; c < line.nCrossings; ++c)
+			{
+				const int line_crossing_index = line.iFirstCrossing + c;
+				if (line_crossing_index == step.m_LineCrossing)
+					continue;
+				const CAxialGraph::LINECROSSING& linecrossing = graph.getLineCrossing(line_crossing_index);
+				// Stepping out at the same position as stepped in means this line
+				// was visited in vain (see CODBetweennessWorker::ProcessOrigin),
+				// but on the origin line it is how crossings at the origin are reached
+				if (linecrossing.linePos == from_line_pos && step.m_LineCrossing >= 0)
+					continue;
+				if (m_WeCareAboutAngles && linecrossing.linePos != from_line_pos && step.m_Forwards != (linecrossing.linePos > from_line_pos))
+					continue;
+
+				const CAxialGraph::LINECROSSING& opposite = graph.getLineCrossing(linecrossing.iOpposite);
+				next_step.m_Line = opposite.iLine;
+				next_step.m_LineCrossing = linecrossing.iOpposite;
+				const float walking = fabsf(from_line_pos - linecrossing.linePos);
+
+				if (m_WeCareAboutAngles)
+				{
+					const CAxialGraph::NETWORKLINE& next_line = graph.getLine(opposite.iLine);
+					const float current_angle = step.m_Forwards ? line.angle : OppositeAngle(line.angle);
+					const float forward_turn = GetTurnAngle(current_angle, next_line.angle);
+					for (const bool forwards : { true, false })
+					{
+						next_step.m_Cost = step.m_Cost;
+						add_cost(next_step.m_Cost, walking, 1, forwards ? forward_turn : 180.0f - forward_turn);
+						next_step.m_Estimate = next_step.m_Cost.m_Primary;
+						next_step.m_Forwards = forwards;
+						QueueStep(next_step);
+					}
+				}
+				else
+				{
+					next_step.m_Cost = step.m_Cost;
+					add_cost(next_step.m_Cost, walking, 1, 0);
+					next_step.m_Estimate = next_step.m_Cost.m_Primary + LowerBound(next_step.m_LineCrossing);
+					next_step.m_Forwards = true;
+					QueueStep(next_step);
+				}
+			}
+		}
+
+		return false;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+	//
+	//  Path distances
+	//
+
+	// Fills in points of path and the distances to each of them, in all
+	// distance types. The walking direction on a line isn't given by the path
+	// if the line is stepped onto and off at the same position, which only
+	// happens at the first and last line, and is then taken to be the one that
+	// turns the least.
+	void CalculatePathPoints(const CAxialGraph& graph, const SPathEnd& origin, const SPathEnd& destination, const std::vector<int>& lines, const std::vector<int>& line_crossings, CShortestPathResult& res)
+	{
+		ASSERT(!lines.empty() && line_crossings.size() + 1 == lines.size());
+		ASSERT(lines.front() == origin.m_Line && lines.back() == destination.m_Line);
+
+		const float origin_line_pos = origin.m_LinePos;
+		const float dest_line_pos = destination.m_LinePos;
+
+		// Position on each line where it is stepped onto and off
+		std::vector<std::pair<float, float>> line_spans(lines.size());
+		line_spans.front().first = origin_line_pos;
+		for (size_t i = 0; i < line_crossings.size(); ++i)
+		{
+			const CAxialGraph::LINECROSSING& linecrossing = graph.getLineCrossing(line_crossings[i]);
+			line_spans[i].second = graph.getLineCrossing(linecrossing.iOpposite).linePos;
+			line_spans[i + 1].first = linecrossing.linePos;
+		}
+		line_spans.back().second = dest_line_pos;
+
+		float walking = 0;
+		float angle = 0;
+		unsigned int steps = 0;
+		auto add_point = [&](const COORDS& pt)
+		{
+			res.m_Points.push_back(graph.localToWorld(pt));
+			res.m_WalkingDistances.push_back(walking);
+			res.m_AngularDistances.push_back(angle);
+			res.m_StepDistances.push_back(steps);
+		};
+
+		const CAxialGraph::NETWORKLINE& first_line = graph.getLine(lines.front());
+		add_point(origin.m_Point);
+		walking += origin.m_DistFromLine;
+		add_point(GetPointOnLine(first_line, origin_line_pos));
+
+		for (size_t i = 0; i < line_crossings.size(); ++i)
+		{
+			const CAxialGraph::NETWORKLINE& line = graph.getLine(lines[i]);
+			const CAxialGraph::NETWORKLINE& next_line = graph.getLine(lines[i + 1]);
+			const auto& span = line_spans[i];
+			const auto& next_span = line_spans[i + 1];
+			const float current_angle = (span.second < span.first) ? OppositeAngle(line.angle) : line.angle;
+			const float next_angle = (next_span.second < next_span.first) ? OppositeAngle(next_line.angle) : next_line.angle;
+			float turn = GetTurnAngle(current_angle, next_angle);
+			if (span.first == span.second || next_span.first == next_span.second)
+				turn = std::min(turn, 180.0f - turn);
+			walking += fabsf(span.second - span.first);
+			angle += turn;
+			++steps;
+			add_point(graph.getCrossing(graph.getLineCrossing(line_crossings[i]).iCrossing).pt);
+		}
+
+		walking += fabsf(line_spans.back().second - line_spans.back().first);
+		add_point(GetPointOnLine(graph.getLine(lines.back()), dest_line_pos));
+		walking += destination.m_DistFromLine;
+		add_point(destination.m_Point);
+	}
+
+	IPSTAlgo* DoShortestPath(const SPSTAShortestPathDesc& desc, SPSTAShortestPathRes& res)
+	{
+		const CAxialGraph& graph = *(const CAxialGraph*)desc.m_Graph;
+
+		auto result = std::make_unique<CShortestPathResult>();
+
+		// Reused by all calls from the same thread, so that a query doesn't
+		// allocate and reset states for the whole graph
+		thread_local CShortestPathSearch search;
+		thread_local std::vector<int> lines, line_crossings;
+
+		SPathEnd origin, destination;
+		if (ConnectPathEnd(graph, graph.worldToLocal(desc.m_Origin), origin) &&
+			ConnectPathEnd(graph, graph.worldToLocal(desc.m_Destination), destination) &&
+			search.Search(graph, (EPSTADistanceType)desc.m_DistanceType, origin, destination, lines, line_crossings))
+		{
+			result->m_Lines.assign(lines.begin(), lines.end());
+			CalculatePathPoints(graph, origin, destination, lines, line_crossings, *result);
+		}
+
+		res.m_LineCount = (unsigned int)result->m_Lines.size();
+		res.m_Lines = result->m_Lines.data();
+		res.m_PointCount = (unsigned int)result->m_Points.size();
+		res.m_PointCoords = result->m_Points.empty() ? nullptr : &result->m_Points.data()->x;
+		res.m_WalkingDistances = result->m_WalkingDistances.data();
+		res.m_AngularDistances = result->m_AngularDistances.data();
+		res.m_StepDistances = result->m_StepDistances.data();
+
+		return result.release();
+	}
+}
+
+PSTADllExport IPSTAlgo* PSTAShortestPath(const SPSTAShortestPathDesc* desc, SPSTAShortestPathRes* res)
+{
+	if ((desc->VERSION != desc->m_Version) ||
+		(res->VERSION != res->m_Version))
+	{
+		LOG_ERROR("SPSTAShortestPath version mismatch");
+		return nullptr;
+	}
+
+	try
+	{
+		return psta::DoShortestPath(*desc, *res);
+	}
+	catch (const std::exception& e)
+	{
+		LOG_ERROR(e.what());
+		return nullptr;
+	}
+}
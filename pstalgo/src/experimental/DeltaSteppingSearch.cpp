@@ -0,0 +1,197 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include <pstalgo/experimental/DeltaSteppingSearch.h>
+#include <pstalgo/utils/Concurrency.h>
+
+namespace psta
+{
+	namespace
+	{
+		// Frontier nodes per parallel task
+		const size_t FRONTIER_BLOCK_SIZE = 256;
+
+		// Smaller frontiers are relaxed on the calling thread only, since
+		// starting the threads would take longer than the relaxation itself
+		const size_t MIN_PARALLEL_FRONTIER_SIZE = 0x2000;
+
+		bool AtomicMin(std::atomic<float>& value, float new_value)
+		{
+			float prev = value.load(std::memory_order_relaxed);
+			while (new_value < prev)
+			{
+				if (value.compare_exchange_weak(prev, new_value, std::memory_order_relaxed))
+					return true;
+			}
+			return false;
+		}
+	}
+
+	CDeltaSteppingSearch::CDeltaSteppingSearch(const graph_t& graph)
+		: CShortestPathTraversalBase(graph)
+		, m_Delta(1)
+		, m_Limit(0)
+		, m_Distances(new std::atomic<float>[graph.NetworkNodeCount() + graph.DestinationCount()])
+		, m_CurrentBucket(0)
+		, m_InFrontier(graph.NetworkNodeCount(), 0)
+	{
+		ASSERT(graph.DistanceTypeCount() == 1);
+
+		// Bucket width is the mean edge length, which keeps the number of nodes
+		// relaxed more than once low while still giving each bucket many nodes
+		double length_sum = 0;
+		size_t edge_count = 0;
+		float max_length = 0;
+		for (size_t node_index = 0; node_index < graph.NodeCount(); ++node_index)
+		{
+			graph.ForEachEdge(graph.Node(graph.NodeHandleFromIndex(node_index)), [&](const graph_t::SEdge& e)
+			{
+				const float length = graph.EdgePrimaryDistance(e);
+				length_sum += length;
+				max_length = std::max(max_length, length);
+				++edge_count;
+			});
+		}
+		if (length_sum > 0)
+			m_Delta = (float)(length_sum / edge_count);
+
+		// One extra bucket for rounding
+		m_Buckets.resize((size_t)(max_length / m_Delta) + 3);
+	}
+
+	void CDeltaSteppingSearch::Run(const size_t* origin_indices, size_t origin_count, float limit)
+	{
+		m_Limit = limit;
+
+		const size_t distance_count = m_Graph.NetworkNodeCount() + m_Graph.DestinationCount();
+		parallel_for_blocks(distance_count, (size_t)0x10000, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+				m_Distances[i].store(std::numeric_limits<float>::infinity(), std::memory_order_relaxed);
+		});
+
+		for (auto& bucket : m_Buckets)
+			bucket.clear();
+		m_CurrentBucket = 0;
+		m_Frontier.clear();
+		m_BlockImproved.resize(1);
+
+		auto& improved = m_BlockImproved[0];
+		improved.clear();
+		for (size_t i = 0; i < origin_count; ++i)
+		{
+			const size_t origin_index = origin_indices ? origin_indices[i] : i;
+			RelaxEdges(m_Graph.NodeHandleFromIndex(m_Graph.OriginNodeIndex(origin_index)), 0, improved);
+		}
+		QueueImproved(improved);
+
+		for (size_t empty_bucket_count = 0; empty_bucket_count < m_Buckets.size(); )
+		{
+			// Move nodes still in current bucket to frontier
+			auto& bucket = m_Buckets[m_CurrentBucket % m_Buckets.size()];
+			for (const auto node_index : bucket)
+			{
+				if (m_InFrontier[node_index] || BucketIndex(m_Distances[node_index].load(std::memory_order_relaxed)) != m_CurrentBucket)
+					continue;  // Queued more than once, or has since been moved to another bucket
+				m_InFrontier[node_index] = 1;
+				m_Frontier.push_back(node_index);
+			}
+			bucket.clear();
+
+			if (m_Frontier.empty())
+			{
+				++m_CurrentBucket;
+				++empty_bucket_count;
+				continue;
+			}
+			empty_bucket_count = 0;
+
+			while (!m_Frontier.empty())
+			{
+				for (const auto node_index : m_Frontier)
+					m_InFrontier[node_index] = 0;
+
+				const size_t block_count = (m_Frontier.size() < MIN_PARALLEL_FRONTIER_SIZE) ? 1 : (m_Frontier.size() + FRONTIER_BLOCK_SIZE - 1) / FRONTIER_BLOCK_SIZE;
+				if (m_BlockImproved.size() < block_count)
+					m_BlockImproved.resize(block_count);
+				if (1 == block_count)
+					RelaxFrontier(0, m_Frontier.size(), m_BlockImproved[0]);
+				else parallel_for_blocks(m_Frontier.size(), FRONTIER_BLOCK_SIZE, [&](size_t begin, size_t end)
+				{
+					RelaxFrontier(begin, end, m_BlockImproved[begin / FRONTIER_BLOCK_SIZE]);
+				});
+
+				m_Frontier.clear();
+				for (size_t i = 0; i < block_count; ++i)
+					QueueImproved(m_BlockImproved[i]);
+			}
+
+			++m_CurrentBucket;
+		}
+	}
+
+	void CDeltaSteppingSearch::RelaxFrontier(size_t begin, size_t end, std::vector<unsigned int>& ret_improved)
+	{
+		ret_improved.clear();
+		for (size_t i = begin; i < end; ++i)
+		{
+			const unsigned int node_index = m_Frontier[i];
+			RelaxEdges(m_Graph.NodeHandleFromIndex(node_index), m_Distances[node_index].load(std::memory_order_relaxed), ret_improved);
+		}
+	}
+
+	void CDeltaSteppingSearch::RelaxEdges(graph_t::HNode node_handle, float distance, std::vector<unsigned int>& ret_improved)
+	{
+		const size_t network_node_count = m_Graph.NetworkNodeCount();
+		m_Graph.ForEachEdge(m_Graph.Node(node_handle), [&](const graph_t::SEdge& e)
+		{
+			const float new_distance = distance + m_Graph.EdgePrimaryDistance(e);
+			if (new_distance > m_Limit)
+				return;
+			const bool to_destination = m_Graph.EdgePointsToDestination(e);
+			const size_t index = to_destination ? network_node_count + e.TargetIndex() : e.TargetIndex();
+			if (!(new_distance < m_Distances[index].load(std::memory_order_relaxed)))
+				return;
+			if (HasStraightLineLimit() && !TestStraightLineLimit(m_Graph.TargetPosition(e)))
+				return;
+			if (AtomicMin(m_Distances[index], new_distance) && !to_destination)
+				ret_improved.push_back(e.TargetIndex());
+		});
+	}
+
+	void CDeltaSteppingSearch::QueueImproved(const std::vector<unsigned int>& improved)
+	{
+		for (const auto node_index : improved)
+		{
+			const size_t bucket_index = BucketIndex(m_Distances[node_index].load(std::memory_order_relaxed));
+			ASSERT(bucket_index >= m_CurrentBucket && bucket_index < m_CurrentBucket + m_Buckets.size());
+			if (bucket_index != m_CurrentBucket)
+				m_Buckets[bucket_index % m_Buckets.size()].push_back(node_index);
+			else if (!m_InFrontier[node_index])
+			{
+				m_InFrontier[node_index] = 1;
+				m_Frontier.push_back(node_index);
+			}
+		}
+	}
+}
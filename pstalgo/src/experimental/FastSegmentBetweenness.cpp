@@ -27,6 +27,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 #include <pstalgo/experimental/SparseDirectedGraph.h>
 #include <pstalgo/experimental/FastSegmentBetweenness.h>
 #include <pstalgo/experimental/IntPrioQueue.h>
+#include <pstalgo/graph/BrandesSearch.h>
 #include <pstalgo/graph/SegmentGraph.h>
 #include <pstalgo/system/System.h>
 #include <pstalgo/utils/BitVector.h>
@@ -46,18 +47,6 @@ namespace psta
 {
 	namespace
 	{
-		struct SPredecessorElement
-		{
-			typedef TSparseDirectedGraph<> graph_t;
-			static const unsigned int END = (unsigned int)-1;
-
-			graph_t::HNode m_Predecessor = graph_t::INVALID_HANDLE;
-			unsigned int   m_Next = END;
-
-			inline void SetEnd() { m_Next = END; }
-			inline bool IsEnd() const { return END != m_Next; }
-		};
-
 		struct SNodeData 
 		{
 			float m_Weight;
@@ -221,39 +210,31 @@ namespace psta
 			inline bool operator<(const SQueueElement& rhs) const { return m_PrimaryDistance > rhs.m_PrimaryDistance; }
 		};
 
-		struct SNodeState
+		// Graph view for m_Search, with one node per segment direction
+		struct SGraphView
 		{
-			SNodeState() { Reset(); }
+			CSegmentBetweennessWorker& m_Worker;
+			const graph_t& m_Graph;
 
-			inline void Reset()
-			{
-				m_ShortestDistance = std::numeric_limits<float>::infinity();
-				m_Accumulator = 0;
-				m_PredecessorListHead = -1;
-			}
+			inline unsigned int Node(const SQueueElement& qe) const { return qe.m_NodeIndex; }
+			inline unsigned int Pred(const SQueueElement& qe) const { return qe.m_PrevNodeIndex; }
+			inline float Key(const SQueueElement& qe) const { return qe.m_PrimaryDistance; }
 
-			inline bool Visited() const
-			{
-				return m_ShortestDistance != std::numeric_limits<float>::infinity();
-			}
+			template <class TQueue>
+			void OnSettle(const SQueueElement& qe, TQueue& queue);
+		};
 
-			float m_ShortestDistance;
+		struct SNodeState
+		{
 			float m_Accumulator;
-			unsigned int m_PredecessorListHead;
 			float m_CachedNodeWeight;  // Stored here to avoid having to look up in graph (1.0 if non-weight-mode)
 		};
 
-		template <class TLambda> void ForEachPredecessor(const SNodeState& node_data, TLambda&& lambda) const;
-		unsigned int PredecessorCount(const SNodeState& node_data) const;
-		void AddPredecessor(SNodeState& node_data, graph_t::HNode pred);
-
 		void ProcessSegment(const graph_t& graph, graph_t::index_t origin_segment_index, unsigned int& out_node_count, float& out_total_depth);
 
 		enum EPerfCounters
 		{
-			EPerfCounter_QueueMax,
-			EPerfCounter_QueueTicks,
-			EPerfCounter_TraversalTicks,
+			EPerfCounter_SearchTicks,
 			EPerfCounter_CollectTicks,
 			EPerfCounter_NUM,
 		};
@@ -265,9 +246,8 @@ namespace psta
 		#endif
 
 		SPSTARadii m_Limits;
+		CBrandesSearch m_Search;
 		std::vector<SNodeState> m_NodeStates;
-		std::vector<SPredecessorElement> m_Predecessors;
-		std::vector<graph_t::HNode> m_VisitedNodesStack;
 		std::vector<double> m_Scores;
 
 		unsigned long long m_PerfCounters[EPerfCounter_NUM];
@@ -290,9 +270,8 @@ namespace psta
 		m_Scores.clear();
 		m_Scores.resize(segment_count, 0.0);
 
-		m_NodeStates.resize(node_count);
-
-		m_Predecessors.reserve(node_count / 4);  // Guess
+		m_Search.Init(node_count);
+		m_NodeStates.resize(node_count, SNodeState{ 0, 0 });
 
 		unsigned int segment_index;
 		while (ctx.DequeueSegment(segment_index)) {
@@ -308,70 +287,48 @@ namespace psta
 		pstdbg::Log(
 			pstdbg::EErrorLevel_Info,
 			nullptr,
-			"Queue max: %d\n"
-			"Queue:     %.3f\n"
-			"Traversal: %.3f\n"
+			"Search:    %.3f\n"
 			"Collect:   %.3f",
-			(unsigned int)m_PerfCounters[EPerfCounter_QueueMax],
-			CPerfTimer::SecondsFromTicks(m_PerfCounters[EPerfCounter_QueueTicks]),
-			CPerfTimer::SecondsFromTicks(m_PerfCounters[EPerfCounter_TraversalTicks]),
+			CPerfTimer::SecondsFromTicks(m_PerfCounters[EPerfCounter_SearchTicks]),
 			CPerfTimer::SecondsFromTicks(m_PerfCounters[EPerfCounter_CollectTicks]));
 	}
 
-	template <class TLambda> void CSegmentBetweennessWorker::ForEachPredecessor(const SNodeState& node_data, TLambda&& lambda) const
+	template <class TQueue>
+	void CSegmentBetweennessWorker::SGraphView::OnSettle(const SQueueElement& qe, TQueue& queue)
 	{
-		if ((unsigned int)-1 == node_data.m_PredecessorListHead)
-			return;
+		const auto& node = m_Graph.Node(qe.m_NodeHandle);
 
-		if (!(0x80000000 & node_data.m_PredecessorListHead))
-		{
-			lambda(node_data.m_PredecessorListHead);
-			return;
-		}
+		// First time this node is reached
+		auto& state = m_Worker.m_NodeStates[qe.m_NodeIndex];
+		state.m_CachedNodeWeight = node.m_Weight;
 
-		auto* p = &m_Predecessors[node_data.m_PredecessorListHead & 0x7FFFFFFF];
-		for (;;)
+		// Process edges
+		SQueueElement next_qe;
+		next_qe.m_PrevNodeIndex = node.Index();
+		for (unsigned int edge_index = 0; edge_index < node.EdgeCount(); ++edge_index)
 		{
-			lambda(p->m_Predecessor);
-			if (!p->IsEnd())
-				break;
-			p = &m_Predecessors[p->m_Next];
-		}
-	}
+			const auto& edge = node.Edge(edge_index);
 
-	unsigned int CSegmentBetweennessWorker::PredecessorCount(const SNodeState& node_data) const
-	{
-		unsigned int predecessor_count = 0;
-		ForEachPredecessor(node_data, [&predecessor_count](graph_t::HNode) { ++predecessor_count; });
-		return predecessor_count;
-	}
+			next_qe.m_RadiusDistance = qe.m_RadiusDistance + edge.m_RadiusDist;
+			if (next_qe.m_RadiusDistance > m_Worker.m_Limits.Walking())
+				continue;
+			next_qe.m_PrimaryDistance = qe.m_PrimaryDistance + edge.m_PrimaryDist;
 
-	void CSegmentBetweennessWorker::AddPredecessor(SNodeState& node_data, graph_t::HNode pred)
-	{
-		if ((unsigned int)-1 == node_data.m_PredecessorListHead)
-		{
-			node_data.m_PredecessorListHead = pred;
-			return;
-		}
-
-		if (!(0x80000000 & node_data.m_PredecessorListHead))
-		{
-			m_Predecessors.resize(m_Predecessors.size() + 1);
-			m_Predecessors.back().m_Predecessor = node_data.m_PredecessorListHead;
-			m_Predecessors.back().SetEnd();
-			node_data.m_PredecessorListHead = ((unsigned int)m_Predecessors.size() - 1) | 0x80000000;
-		}
+			// Check if target already has shorter distance before queueing
+			const auto target_index = m_Graph.TargetIndex(edge);
+			if (m_Worker.m_Search.IsSettled(target_index) && m_Worker.m_Search.Distance(target_index) < next_qe.m_PrimaryDistance)
+				continue;
 
-		m_Predecessors.resize(m_Predecessors.size() + 1);
-		m_Predecessors.back().m_Predecessor = pred;
-		m_Predecessors.back().m_Next = node_data.m_PredecessorListHead & 0x7FFFFFFF;
+			next_qe.m_NodeHandle = edge.TargetHandle();
+			next_qe.m_NodeIndex = target_index;
 
-		node_data.m_PredecessorListHead = ((unsigned int)m_Predecessors.size() - 1) | 0x80000000;
+			queue.push(next_qe);
+		}
 	}
 
 	void CSegmentBetweennessWorker::ProcessSegment(const graph_t& graph, graph_t::index_t origin_segment_index, unsigned int& out_node_count, float& out_total_depth)
 	{
-		m_Predecessors.clear();
+		m_Search.Clear();
 
 		SQueueElement qe;
 
@@ -380,7 +337,7 @@ namespace psta
 		qe.m_RadiusDistance = 0;
 		qe.m_NodeIndex = origin_segment_index << 1;
 		qe.m_NodeHandle = graph.NodeHandleFromIndex(qe.m_NodeIndex);
-		qe.m_PrevNodeIndex = (unsigned int)-1;
+		qe.m_PrevNodeIndex = CBrandesSearch::INVALID_NODE;
 		m_Queue.push(qe);
 
 		// Enqueue backward node for origin segment
@@ -396,84 +353,21 @@ namespace psta
 			perf_timer.Start();
 		#endif
 
-		unsigned int visited_segment_count = 1;  // Including self
-		double total_depth = 0;
+		SGraphView view = { *this, graph };
+		m_Search.Run(m_Queue, view);
 
-		while (!m_Queue.empty())
-		{
-			const auto qe = m_Queue.top();
-			m_Queue.pop();
-
-			#ifdef PERF_ENABLED
-				m_PerfCounters[EPerfCounter_QueueTicks] += perf_timer.ReadAndRestart();
-			#endif
-
-			auto& state = m_NodeStates[qe.m_NodeIndex];
-			
-			if (qe.m_PrimaryDistance > state.m_ShortestDistance)
-				continue;  // A shorter path has already been found to this node
-
-			if (std::numeric_limits<float>::infinity() == state.m_ShortestDistance)
-			{
-				const auto& node = graph.Node(qe.m_NodeHandle);
-
-				// First time this node is reached
-				state.m_ShortestDistance = qe.m_PrimaryDistance;
-				state.m_CachedNodeWeight = node.m_Weight;
-				m_VisitedNodesStack.push_back(node.Index());
-
-				// Process edges
-				SQueueElement next_qe;
-				next_qe.m_PrevNodeIndex = node.Index();
-				for (unsigned int edge_index = 0; edge_index < node.EdgeCount(); ++edge_index)
-				{
-					const auto& edge = node.Edge(edge_index);
-
-					next_qe.m_RadiusDistance = qe.m_RadiusDistance + edge.m_RadiusDist;
-					if (next_qe.m_RadiusDistance > m_Limits.Walking())
-						continue;
-					next_qe.m_PrimaryDistance = qe.m_PrimaryDistance + edge.m_PrimaryDist;
-
-					// Check if target already has shorter distance before queueing
-					if (m_NodeStates[graph.TargetIndex(edge)].m_ShortestDistance < next_qe.m_PrimaryDistance)
-						continue;
-
-					next_qe.m_NodeHandle = edge.TargetHandle();
-					next_qe.m_NodeIndex = graph.TargetIndex(edge);
-
-					#ifdef PERF_ENABLED
-						m_PerfCounters[EPerfCounter_TraversalTicks] += perf_timer.ReadAndRestart();
-					#endif
-
-					m_Queue.push(next_qe);
-
-					#ifdef PERF_ENABLED
-						m_PerfCounters[EPerfCounter_QueueMax] = std::max((size_t)m_PerfCounters[EPerfCounter_QueueMax], m_Queue.size());
-						m_PerfCounters[EPerfCounter_QueueTicks] += perf_timer.ReadAndRestart();
-					#endif
-				}
-			}
-			else
-			{
-				// A new path was found to this node with same shortest distance
-				ASSERT(qe.m_PrimaryDistance == state.m_ShortestDistance);
-			}
-
-			if ((unsigned int)-1 != qe.m_PrevNodeIndex)
-				AddPredecessor(state, qe.m_PrevNodeIndex);
+		#ifdef PERF_ENABLED
+			m_PerfCounters[EPerfCounter_SearchTicks] += perf_timer.ReadAndRestart();
+		#endif
 
-			#ifdef PERF_ENABLED
-				m_PerfCounters[EPerfCounter_TraversalTicks] += perf_timer.ReadAndRestart();
-			#endif
-		}
+		unsigned int visited_segment_count = 1;  // Including self
+		double total_depth = 0;
 
 		// Traverse list of visited nodes in reverse order
-		while (!m_VisitedNodesStack.empty()) 
+		m_Search.ForEachSettledReverse([&](unsigned int node_index, const unsigned int* preds, unsigned int predecessor_count)
 		{
-			const auto node_index = m_VisitedNodesStack.back();
-			m_VisitedNodesStack.pop_back();
-
 			auto& state = m_NodeStates[node_index];
+			const float shortest_distance = m_Search.Distance(node_index);
 
 			const auto segment_index = node_index >> 1;
 
@@ -483,47 +377,45 @@ namespace psta
 				m_Scores[segment_index] += origin_weight * state.m_Accumulator * .5f;
 
 				const auto opposite_node_index = node_index ^ 1;
-				const auto& opposite_state = m_NodeStates[opposite_node_index];
+				const bool opposite_visited = m_Search.IsSettled(opposite_node_index);
+				const float opposite_shortest_distance = opposite_visited ? m_Search.Distance(opposite_node_index) : std::numeric_limits<float>::infinity();
 
 				// Update visited segment count
-				// NOTE: States are resetted as they are being processed here, so we 
+				// NOTE: Nodes are unsettled as they are being processed here, so we 
 				//       make sure a segment is counted only once by counting only on
 				//       the last remaining direction it has been visited on.
-				if (!opposite_state.Visited()) {  
+				if (!opposite_visited) {  
 					++visited_segment_count;
 				}
 
 				// Update total depth
-				if (!opposite_state.Visited()) {
+				if (!opposite_visited) {
 					// This segment was only traversed in this direction, so this is the shortest distance to it
-					total_depth += state.m_ShortestDistance;
-				} else if (state.m_ShortestDistance < opposite_state.m_ShortestDistance) {
+					total_depth += shortest_distance;
+				} else if (shortest_distance < opposite_shortest_distance) {
 					// This segment was traversed in BOTH directions, and this current direction was the shortest.
-					// Since this direction state will be reset before the opposita state is processed, the opposite
-					// state will think it was the only state, and will therefore add its m_ShortestDistance-value, 
+					// Since this direction will be unsettled before the opposite direction is processed, the opposite
+					// direction will think it was the only one, and will therefore add its shortest distance, 
 					// so we have to subtract it here to cancel out that operation.
-					total_depth += state.m_ShortestDistance;
-					total_depth -= opposite_state.m_ShortestDistance;
+					total_depth += shortest_distance;
+					total_depth -= opposite_shortest_distance;
 				}
 
 				float score_to_pass_on = state.m_Accumulator;
-				if (state.m_ShortestDistance < opposite_state.m_ShortestDistance)
+				if (shortest_distance < opposite_shortest_distance)
 					score_to_pass_on += state.m_CachedNodeWeight;
 
-				const auto predecessor_count = PredecessorCount(state);
-				if (predecessor_count)
+				for (unsigned int i = 0; i < predecessor_count; ++i)
 				{
-					ForEachPredecessor(state, [&](unsigned int pred_index)
-					{
-						auto& pred = m_NodeStates[pred_index];
-						pred.m_Accumulator += (1.f / predecessor_count) * score_to_pass_on;
-					});
+					auto& pred = m_NodeStates[preds[i]];
+					pred.m_Accumulator += (1.f / predecessor_count) * score_to_pass_on;
 				}
 			}
 
 			// Reset temporary traversal state on node
-			state.Reset();
-		}
+			state.m_Accumulator = 0;
+			m_Search.Unsettle(node_index);
+		});
 
 		out_node_count = visited_segment_count;
 		out_total_depth = SyntaxAngleWeightFromDegrees(total_depth);  // NOTE: Assuming distance mode is ANGULAR
@@ -21,6 +21,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
 #include <cmath>
+#include <future>
 
 #include <pstalgo/geometry/AABSPTree.h>
 #include <pstalgo/geometry/Geometry.h>
@@ -43,150 +44,52 @@ const CAABSPTree& CAABSPTree::operator=(CAABSPTree&& other)
 	return *this;
 }
 
-void CAABSPTree::TestSphere(const float2& center, float radius, std::vector<SObjectSet>& ret_sets)
+void CAABSPTree::TestSphere(const float2& center, float radius, std::vector<SObjectSet>& ret_sets) const
 {
 	ret_sets.clear();
-
-	const float2 bb_center(m_BB.CenterX(), m_BB.CenterY());
-	const float2 bb_half_size(.5f * m_BB.Width(), .5f * m_BB.Height());
-
-	if (m_Nodes.empty() || !TestAABBCircleOverlap(bb_half_size, center - bb_center, radius))
-		return;
-
-	TestSphere(m_BB, center, radius, 0, ret_sets);
-}
-
-void CAABSPTree::TestCapsule(const float2& p0, const float2 p1, float radius, std::vector<SObjectSet>& ret_sets)
-{
-	ret_sets.clear();
-
-	if (m_Nodes.empty() || !TestAABBCapsuleOverlap(m_BB, p0, p1, radius))
-		return;
-
-	TestCapsule(m_BB, p0, p1, radius, 0, ret_sets);
-}
-
-void CAABSPTree::TestSphere(const CRectf& bb, const float2& center, float radius, unsigned int node_index, std::vector<SObjectSet>& ret_sets)
-{
-	using namespace std;
-
-	const auto& node = m_Nodes[node_index];
-
-	if (node.IsCell())
+	TForEachCellInSphere(center, radius, [&](unsigned int first_object, unsigned int object_count)
 	{
 		ret_sets.resize(ret_sets.size() + 1);
 		auto& os = ret_sets.back();
-		os.m_FirstObject = node.GetFirstObject();
-		os.m_Count = node.GetObjectCount();
-		return;
-	}
-
-	const unsigned char split_axis = node.GetSplitAxis();
-	const float2* bb_pts = (const float2*)&bb;
-	const float split_pos = node.GetSplitAt();
-	
-	const float d = center[split_axis] - split_pos;
-	
-	unsigned char child_bits = (d < 0) ? 1 : 2;
-
-	if (abs(d) < radius)
-	{
-		const unsigned char non_split_axis = split_axis ^ 1;
-		const float bb_half_size = .5f * (bb_pts[1][non_split_axis] - bb_pts[0][non_split_axis]);
-		const float d2 = abs(center[non_split_axis] - bb_pts[0][non_split_axis] - bb_half_size);
-		if (d2 <= bb_half_size || sqr(d2 - bb_half_size) + sqr(d) <= sqr(radius))
-			child_bits = 3;
-	}
-
-	if (child_bits & 1)
-	{
-		CRectf bb_child(bb);
-		(&bb_child.m_Right)[split_axis] = split_pos;
-		TestSphere(bb_child, center, radius, node_index + 1, ret_sets);
-	}
-
-	if (child_bits & 2)
-	{
-		CRectf bb_child(bb);
-		(&bb_child.m_Left)[split_axis] = split_pos;
-		TestSphere(bb_child, center, radius, node.GetRightNode(), ret_sets);
-	}
+		os.m_FirstObject = first_object;
+		os.m_Count = object_count;
+	});
 }
 
-void CAABSPTree::TestCapsule(const CRectf& bb, const float2& p0, const float2 p1, float radius, unsigned int node_index, std::vector<SObjectSet>& ret_sets)
+void CAABSPTree::TestCapsule(const float2& p0, const float2 p1, float radius, std::vector<SObjectSet>& ret_sets) const
 {
-	using namespace std;
-
-	const auto& node = m_Nodes[node_index];
-
-	if (node.IsCell())
+	ret_sets.clear();
+	TForEachCellInCapsule(p0, p1, radius, [&](unsigned int first_object, unsigned int object_count)
 	{
 		ret_sets.resize(ret_sets.size() + 1);
 		auto& os = ret_sets.back();
-		os.m_FirstObject = node.GetFirstObject();
-		os.m_Count = node.GetObjectCount();
-		return;
-	}
-
-	const unsigned char split_axis = node.GetSplitAxis();
-	const float split_pos = node.GetSplitAt();
-
-	const float d0 = p0[split_axis] - split_pos;
-	const float d1 = p1[split_axis] - split_pos;
-	const float ad0 = abs(d0);
-	const float ad1 = abs(d1);
-
-	unsigned char child_bits = 0;
-
-	if (d0*d1 >= 0)
-	{
-		// End-points are on same side of splitter
-		child_bits = (d0 < 0) ? 1 : 2;
-
-		if (ad0 > radius && ad1 > radius)
-			goto done; // The whole capsule is on one side of the splitter
-
-		if (ad0 <= radius && ad1 <= radius)
-		{
-			child_bits = 3;
-			goto done;
-		}
-	}
-
-	if (!(child_bits & 1))
-	{
-		CRectf bb_child(bb);
-		(&bb_child.m_Right)[split_axis] = split_pos;
-		if (TestAABBCapsuleOverlap(bb_child, p0, p1, radius))
-			child_bits |= 1;
-	}
-
-	if (!(child_bits & 2))
-	{
-		CRectf bb_child(bb);
-		(&bb_child.m_Left)[split_axis] = split_pos;
-		if (TestAABBCapsuleOverlap(bb_child, p0, p1, radius))
-			child_bits |= 2;
-	}
-
-done:
+		os.m_FirstObject = first_object;
+		os.m_Count = object_count;
+	});
+}
 
-	if (child_bits & 1)
-	{
-		CRectf bb_child(bb);
-		(&bb_child.m_Right)[split_axis] = split_pos;
-		TestCapsule(bb_child, p0, p1, radius, node_index + 1, ret_sets);
-	}
+unsigned int CAABSPTree::ParallelBuildDepth(size_t count)
+{
+	if (count < MIN_PARALLEL_BUILD_COUNT)
+		return 0;
+	unsigned int depth = 0;
+	while ((1u << depth) < psta::max_thread_count())
+		++depth;
+	return depth;
+}
 
-	if (child_bits & 2)
+void CAABSPTree::AppendSubTree(const std::vector<SNode>& nodes, unsigned int object_offset)
+{
+	const unsigned int node_offset = (unsigned int)m_Nodes.size();
+	m_Nodes.reserve(m_Nodes.size() + nodes.size());
+	for (auto node : nodes)
 	{
-		CRectf bb_child(bb);
-		(&bb_child.m_Left)[split_axis] = split_pos;
-		TestCapsule(bb_child, p0, p1, radius, node.GetRightNode(), ret_sets);
+		node.Offset(node_offset, object_offset);
+		m_Nodes.push_back(node);
 	}
 }
 
-void CPointAABSPTree::CreateSubTree(const CRectf& bb, SPointAndIndex* points_by_x, SPointAndIndex* points_by_y, SPointAndIndex* points_tmp, unsigned int count, unsigned int max_points_per_cell, unsigned int start_index, unsigned int* ret_order)
+void CPointAABSPTree::CreateSubTree(const CRectf& bb, SPointAndIndex* points_by_x, SPointAndIndex* points_by_y, SPointAndIndex* points_tmp, unsigned int count, unsigned int max_points_per_cell, unsigned int start_index, unsigned int* ret_order, unsigned int parallel_depth)
 {
 	if (count <= max_points_per_cell)
 	{
@@ -221,15 +124,36 @@ void CPointAABSPTree::CreateSubTree(const CRectf& bb, SPointAndIndex* points_by_
 	const unsigned int node_index = (unsigned int)m_Nodes.size();
 	m_Nodes.resize(m_Nodes.size() + 1);
 
-	CRectf child_bb = bb;
-	*(horiz_split_line ? &child_bb.m_Bottom : &child_bb.m_Right) = split_pos;
-	CreateSubTree(child_bb, points_by_x, points_by_y, points_tmp, child0_count, max_points_per_cell, start_index, ret_order);
+	CRectf child0_bb = bb;
+	*(horiz_split_line ? &child0_bb.m_Bottom : &child0_bb.m_Right) = split_pos;
+
+	CRectf child1_bb = bb;
+	*(horiz_split_line ? &child1_bb.m_Top : &child1_bb.m_Left) = split_pos;
+
+	// NOTE: Children use separate parts of 'points_tmp', so they can be built concurrently
+	if (parallel_depth && count >= MIN_PARALLEL_BUILD_COUNT)
+	{
+		// Build right child as a separate tree on another thread, and move it in place when done
+		CPointAABSPTree child1_tree;
+		auto child1_task = std::async(std::launch::async, [&]()
+		{
+			child1_tree.CreateSubTree(child1_bb, points_by_x + child0_count, points_by_y + child0_count, points_tmp + child0_count, child1_count, max_points_per_cell, start_index + child0_count, ret_order, parallel_depth - 1);
+		});
+
+		CreateSubTree(child0_bb, points_by_x, points_by_y, points_tmp, child0_count, max_points_per_cell, start_index, ret_order, parallel_depth - 1);
+
+		child1_task.get();
+
+		m_Nodes[node_index].MakeNode(split_pos, horiz_split_line, (unsigned int)m_Nodes.size());
+		AppendSubTree(child1_tree.m_Nodes, 0);
+		return;
+	}
+
+	CreateSubTree(child0_bb, points_by_x, points_by_y, points_tmp, child0_count, max_points_per_cell, start_index, ret_order, 0);
 
 	m_Nodes[node_index].MakeNode(split_pos, horiz_split_line, (unsigned int)m_Nodes.size());
 
-	child_bb = bb;
-	*(horiz_split_line ? &child_bb.m_Top : &child_bb.m_Left) = split_pos;
-	CreateSubTree(child_bb, points_by_x + child0_count, points_by_y + child0_count, points_tmp, child1_count, max_points_per_cell, start_index + child0_count, ret_order);
+	CreateSubTree(child1_bb, points_by_x + child0_count, points_by_y + child0_count, points_tmp + child0_count, child1_count, max_points_per_cell, start_index + child0_count, ret_order, 0);
 }
 
 void CPointAABSPTree::MakeCell(const SPointAndIndex* points_by_x, unsigned int count, unsigned int start_index, unsigned int* ret_order)
@@ -284,12 +208,12 @@ CLineAABSPTree CLineAABSPTree::Create(const float2* line_points, unsigned int co
 		lines_tmp[i].m_Index = i;
 	}
 
-	tree.CreateSubTree(tree.m_BB, lines_tmp, count, max_lines_per_cell, 3 + (int)std::log2((count + max_lines_per_cell - 1) / max_lines_per_cell));
+	tree.CreateSubTree(tree.m_BB, lines_tmp, count, max_lines_per_cell, 3 + (int)std::log2((count + max_lines_per_cell - 1) / max_lines_per_cell), ParallelBuildDepth(count));
 
 	return tree;
 }
 
-void CLineAABSPTree::CreateSubTree(const CRectf& bb, std::vector<SLineAndIndex>& lines_tmp, unsigned int count, unsigned int max_lines_per_cell, unsigned int max_depth)
+void CLineAABSPTree::CreateSubTree(const CRectf& bb, std::vector<SLineAndIndex>& lines_tmp, unsigned int count, unsigned int max_lines_per_cell, unsigned int max_depth, unsigned int parallel_depth)
 {
 	const unsigned int first = (unsigned int)lines_tmp.size() - count;
 
@@ -307,75 +231,98 @@ void CLineAABSPTree::CreateSubTree(const CRectf& bb, std::vector<SLineAndIndex>&
 	const unsigned int node_index = (unsigned int)m_Nodes.size();
 	m_Nodes.resize(m_Nodes.size() + 1);
 
+	CRectf child_bb[2] = { bb, bb };
+	*(horiz_split_line ? &child_bb[0].m_Bottom : &child_bb[0].m_Right) = split_pos;
+	*(horiz_split_line ? &child_bb[1].m_Top : &child_bb[1].m_Left) = split_pos;
+
+	if (parallel_depth && count >= MIN_PARALLEL_BUILD_COUNT)
+	{
+		// Build right child as a separate tree on another thread, and move it in place when done
+		CLineAABSPTree child1_tree;
+		std::vector<SLineAndIndex> child1_lines;
+		SplitLines(lines_tmp, first, count, split_axis, split_pos, 1, child1_lines);
+		auto child1_task = std::async(std::launch::async, [&]()
+		{
+			child1_tree.CreateSubTree(child_bb[1], child1_lines, (unsigned int)child1_lines.size(), max_lines_per_cell, max_depth - 1, parallel_depth - 1);
+		});
+
+		SplitLines(lines_tmp, first, count, split_axis, split_pos, 0, lines_tmp);
+		CreateSubTree(child_bb[0], lines_tmp, (unsigned int)lines_tmp.size() - first - count, max_lines_per_cell, max_depth - 1, parallel_depth - 1);
+		lines_tmp.resize(first + count);
+
+		child1_task.get();
+
+		m_Nodes[node_index].MakeNode(split_pos, horiz_split_line, (unsigned int)m_Nodes.size());
+		AppendSubTree(child1_tree.m_Nodes, (unsigned int)m_Lines.size());
+		m_Lines.insert(m_Lines.end(), child1_tree.m_Lines.begin(), child1_tree.m_Lines.end());
+		return;
+	}
+
 	for (unsigned char child = 0; child < 2; ++child)
 	{
-		CRectf child_bb = bb;
-		if (0 == child)
-			*(horiz_split_line ? &child_bb.m_Bottom : &child_bb.m_Right) = split_pos;
-		else
-			*(horiz_split_line ? &child_bb.m_Top : &child_bb.m_Left) = split_pos;
+		SplitLines(lines_tmp, first, count, split_axis, split_pos, child, lines_tmp);
+
+		CreateSubTree(child_bb[child], lines_tmp, (unsigned int)lines_tmp.size() - first - count, max_lines_per_cell, max_depth - 1, 0);
 
-		const float2 bb_center(child_bb.CenterX(), child_bb.CenterY());
-		const float2 bb_half_size(child_bb.Width() * .5f, child_bb.Height() * .5f);
+		lines_tmp.resize(first + count);
 
 		if (0 == child)
 		{
-			for (unsigned int i = first; i < first + count; ++i)
-			{
-				const auto& line = lines_tmp[i];
-				if (line.m_P0[split_axis] > split_pos && line.m_P1[split_axis] > split_pos)
-					continue; // Both points on other side
-				if (line.m_P0[split_axis] <= split_pos && line.m_P1[split_axis] <= split_pos)
-				{
-					// Both points on this side
-					lines_tmp.push_back(SLineAndIndex(line));  // Need a copy here since reference might become invalid when vector grows
-				}
-				else
-				{
-					// Line is split
-					auto piece = line;
-					if (piece.m_P0[split_axis] > split_pos)
-						std::swap(piece.m_P0, piece.m_P1);
-					const float t = (split_pos - piece.m_P0[split_axis]) / (piece.m_P1[split_axis] - piece.m_P0[split_axis]);
-					piece.m_P1[!split_axis] = piece.m_P0[!split_axis] + t * (piece.m_P1[!split_axis] - piece.m_P0[!split_axis]);
-					piece.m_P1[split_axis] = split_pos;
-					lines_tmp.push_back(piece);
-				}
-			}
+			m_Nodes[node_index].MakeNode(split_pos, horiz_split_line, (unsigned int)m_Nodes.size());
 		}
-		else
+	}
+}
+
+void CLineAABSPTree::SplitLines(std::vector<SLineAndIndex>& lines_tmp, unsigned int first, unsigned int count, unsigned char split_axis, float split_pos, unsigned char child, std::vector<SLineAndIndex>& ret_lines)
+{
+	if (0 == child)
+	{
+		for (unsigned int i = first; i < first + count; ++i)
 		{
-			for (unsigned int i = first; i < first + count; ++i)
+			const auto& line = lines_tmp[i];
+			if (line.m_P0[split_axis] > split_pos && line.m_P1[split_axis] > split_pos)
+				continue; // Both points on other side
+			if (line.m_P0[split_axis] <= split_pos && line.m_P1[split_axis] <= split_pos)
+			{
+				// Both points on this side
+				ret_lines.push_back(SLineAndIndex(line));  // Need a copy here since reference might become invalid when vector grows
+			}
+			else
 			{
-				const auto& line = lines_tmp[i];
-				if (line.m_P0[split_axis] < split_pos && line.m_P1[split_axis] < split_pos)
-					continue; // Both points on other side
-				if (line.m_P0[split_axis] >= split_pos && line.m_P1[split_axis] >= split_pos)
-				{
-					// Both points on this side
-					lines_tmp.push_back(SLineAndIndex(line));  // Need a copy here since reference might become invalid when vector grows
-				}
-				else
-				{
-					// Line is split
-					auto piece = line;
-					if (piece.m_P0[split_axis] < split_pos)
-						std::swap(piece.m_P0, piece.m_P1);
-					const float t = (split_pos - piece.m_P0[split_axis]) / (piece.m_P1[split_axis] - piece.m_P0[split_axis]);
-					piece.m_P1[!split_axis] = piece.m_P0[!split_axis] + t * (piece.m_P1[!split_axis] - piece.m_P0[!split_axis]);
-					piece.m_P1[split_axis] = split_pos;
-					lines_tmp.push_back(piece);
-				}
+				// Line is split
+				auto piece = line;
+				if (piece.m_P0[split_axis] > split_pos)
+					std::swap(piece.m_P0, piece.m_P1);
+				const float t = (split_pos - piece.m_P0[split_axis]) / (piece.m_P1[split_axis] - piece.m_P0[split_axis]);
+				piece.m_P1[!split_axis] = piece.m_P0[!split_axis] + t * (piece.m_P1[!split_axis] - piece.m_P0[!split_axis]);
+				piece.m_P1[split_axis] = split_pos;
+				ret_lines.push_back(piece);
 			}
 		}
-
-		CreateSubTree(child_bb, lines_tmp, (unsigned int)lines_tmp.size() - first - count, max_lines_per_cell, max_depth - 1);
-
-		lines_tmp.resize(first + count);
-
-		if (0 == child)
+	}
+	else
+	{
+		for (unsigned int i = first; i < first + count; ++i)
 		{
-			m_Nodes[node_index].MakeNode(split_pos, horiz_split_line, (unsigned int)m_Nodes.size());
+			const auto& line = lines_tmp[i];
+			if (line.m_P0[split_axis] < split_pos && line.m_P1[split_axis] < split_pos)
+				continue; // Both points on other side
+			if (line.m_P0[split_axis] >= split_pos && line.m_P1[split_axis] >= split_pos)
+			{
+				// Both points on this side
+				ret_lines.push_back(SLineAndIndex(line));  // Need a copy here since reference might become invalid when vector grows
+			}
+			else
+			{
+				// Line is split
+				auto piece = line;
+				if (piece.m_P0[split_axis] < split_pos)
+					std::swap(piece.m_P0, piece.m_P1);
+				const float t = (split_pos - piece.m_P0[split_axis]) / (piece.m_P1[split_axis] - piece.m_P0[split_axis]);
+				piece.m_P1[!split_axis] = piece.m_P0[!split_axis] + t * (piece.m_P1[!split_axis] - piece.m_P0[!split_axis]);
+				piece.m_P1[split_axis] = split_pos;
+				ret_lines.push_back(piece);
+			}
 		}
 	}
 }
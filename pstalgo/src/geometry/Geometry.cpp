@@ -32,7 +32,10 @@ bool TestAABBCircleOverlap(const float2& bb_half_size, const float2& circle_cent
 		return false;
 	if (d.x <= 0 && d.y <= 0)
 		return true;
-	return d.x*d.x + d.y*d.y <= circle_radius*circle_radius;
+	// Only distance outside the box along each axis counts
+	const float dx = max(d.x, 0.f);
+	const float dy = max(d.y, 0.f);
+	return dx*dx + dy*dy <= circle_radius*circle_radius;
 }
 
 bool TestAABBCircleOverlap(const float2& bb_center, const float2& bb_half_size, const float2& circle_center, float radius)
@@ -84,7 +87,9 @@ bool TestAABBOBBOverlap(const CRectf& aabb, const float2& center, const float2&
 	CRectf bb1(corners->x, corners->y, corners->x, corners->y);
 	for (unsigned char i = 1; i < 4; ++i)
 		bb1.GrowToIncludePoint(corners[i].x, corners[i].y);
-	return bb0.Overlaps(bb1);
+	// Touching counts as overlap, since a zero-width box (e.g. a capsule of zero
+	// radius along an axis-aligned line) lying on an edge must not be missed
+	return bb0.m_Left <= bb1.m_Right && bb0.m_Top <= bb1.m_Bottom && bb0.m_Right >= bb1.m_Left && bb0.m_Bottom >= bb1.m_Top;
 }
 
 bool TestAABBCapsuleOverlap(const CRectf& aabb, const float2& p0, const float2 p1, float radius)
@@ -21,17 +21,132 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 
 #include <algorithm>
+#include <limits>
 #include <math.h>
 
 #include <pstalgo/Debug.h>
+#include <pstalgo/geometry/Geometry.h>
 #include <pstalgo/graph/AxialGraph.h>
-#include "../utils/SphereTree.h"
+#include <pstalgo/graph/ContractionHierarchy.h>
 #include "../Platform.h"
 
-#define USE_SPHERE_TREE
-
 #define MIN_LINE_LENGTH 0.01f
 
+#define MAX_LINES_PER_LINE_TREE_CELL 8
+
+// How far inside a stretch of region edge with the same closest line its
+// ends are moved when generating entry points
+#define ENTRY_POINT_NUDGE 0.001f
+
+// Squared distances from 'pt' to 'count' line segments. Kept free of
+// branches so that the compiler can vectorize it.
+static void LineSegmentDistancesSq(const COORDS& pt, const float* x0, const float* y0, const float* dx, const float* dy, const float* inv_len_sq, unsigned int count, float* ret_dist_sq)
+{
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const float px = pt.x - x0[i];
+		const float py = pt.y - y0[i];
+		const float t = std::min(std::max((px * dx[i] + py * dy[i]) * inv_len_sq[i], 0.f), 1.f);
+		const float ex = px - t * dx[i];
+		const float ey = py - t * dy[i];
+		ret_dist_sq[i] = ex * ex + ey * ey;
+	}
+}
+
+// Squared distance from a point moving along an edge, a + s * v for s in
+// [0..1], to a line segment is piecewise quadratic in s: distance to p1
+// before its projection reaches the segment, to p2 after it, and to the
+// supporting line in between.
+struct SDistSqPiece
+{
+	double s0, s1;  // Range of s
+	double A, B, C;  // A * s^2 + B * s + C
+};
+
+static void EdgeToLineDistSqPieces(const COORDS& a, const COORDS& v, const COORDS& p1, const COORDS& p2, std::vector<SDistSqPiece>& ret_pieces)
+{
+	ret_pieces.clear();
+
+	const double vx = v.x, vy = v.y;
+	auto toPoint = [&](const COORDS& q, double s0, double s1)
+	{
+		const double dx = a.x - q.x, dy = a.y - q.y;
+		const SDistSqPiece piece = { s0, s1, vx * vx + vy * vy, 2 * (dx * vx + dy * vy), dx * dx + dy * dy };
+		ret_pieces.push_back(piece);
+	};
+
+	const double lx = p2.x - p1.x, ly = p2.y - p1.y;
+	const double len = sqrt(lx * lx + ly * ly);
+	if (len <= 0) {
+		toPoint(p1, 0, 1);
+		return;
+	}
+	const double dirx = lx / len, diry = ly / len;
+
+	// Position of projection onto the line, and signed distance from it
+	const double posA = (a.x - p1.x) * dirx + (a.y - p1.y) * diry;
+	const double posV = vx * dirx + vy * diry;
+	const double perpA = dirx * (a.y - p1.y) - diry * (a.x - p1.x);
+	const double perpV = dirx * vy - diry * vx;
+
+	double cuts[4] = { 0, 0, 0, 1 };
+	unsigned int nCuts = 1;
+	if (posV != 0) {
+		const double c0 = -posA / posV;
+		const double c1 = (len - posA) / posV;
+		if (c0 > 0 && c0 < 1) cuts[nCuts++] = c0;
+		if (c1 > 0 && c1 < 1) cuts[nCuts++] = c1;
+	}
+	cuts[nCuts++] = 1;
+	std::sort(cuts + 1, cuts + nCuts - 1);
+
+	for (unsigned int i = 0; i + 1 < nCuts; ++i) {
+		const double s0 = cuts[i], s1 = cuts[i + 1];
+		const double pos = posA + posV * (s0 + s1) * .5;
+		if (pos < 0)
+			toPoint(p1, s0, s1);
+		else if (pos > len)
+			toPoint(p2, s0, s1);
+		else {
+			const SDistSqPiece piece = { s0, s1, perpV * perpV, 2 * perpA * perpV, perpA * perpA };
+			ret_pieces.push_back(piece);
+		}
+	}
+}
+
+// Value of piecewise quadratic at s
+static double DistSqAt(const std::vector<SDistSqPiece>& pieces, double s)
+{
+	for (const auto& piece : pieces) {
+		if (s <= piece.s1)
+			return (piece.A * s + piece.B) * s + piece.C;
+	}
+	const auto& piece = pieces.back();
+	return (piece.A * s + piece.B) * s + piece.C;
+}
+
+// Appends the roots of A * s^2 + B * s + C in [s0..s1] to 'ret_roots'
+static void QuadraticRoots(double A, double B, double C, double s0, double s1, std::vector<double>& ret_roots)
+{
+	auto add = [&](double s)
+	{
+		if (s >= s0 && s <= s1)
+			ret_roots.push_back(s);
+	};
+	if (fabs(A) <= 1e-12 * (fabs(B) + fabs(C))) {
+		if (B != 0)
+			add(-C / B);
+		return;
+	}
+	const double disc = B * B - 4 * A * C;
+	if (disc < 0)
+		return;
+	// Numerically stable form
+	const double q = -.5 * (B + ((B < 0) ? -sqrt(disc) : sqrt(disc)));
+	add(q / A);
+	if (q != 0)
+		add(C / q);
+}
 
 
 
@@ -52,8 +167,15 @@ void CAxialGraph::clear()
 	m_linePoints.clear();
 	m_crossings.clear();
 	m_lineCrossings.clear();
-	m_sphereTree->Release();
+	m_lineTree = CLineAABSPTree();
+	m_lineTreeSegments = LINETREESEGMENTS();
 	m_tmpLineIdx.clear();
+	m_WalkingHierarchy.reset();
+}
+
+void CAxialGraph::setWalkingHierarchy(std::unique_ptr<CContractionHierarchy>&& hierarchy)
+{
+	m_WalkingHierarchy = std::move(hierarchy);
 }
 
 void CAxialGraph::createGraph(const LINE* pLines, int nLines,
@@ -88,15 +210,27 @@ void CAxialGraph::createGraph(const LINE* pLines, int nLines,
 		}
 	}
 
-	m_maxDist = sqrt((m_bbox.max.x - m_bbox.min.x) * (m_bbox.max.x - m_bbox.min.x) +
-			  		 (m_bbox.max.y - m_bbox.min.y) * (m_bbox.max.y - m_bbox.min.y));
-
-	// Create Sphere Tree
-	m_sphereTree.reset(new SphereTree);
-	const float a = log(4.f, (float)(m_lines.size() + 1));
-	const int num_levels = max(3, (int)(a + .5f) - 1);
-	m_sphereTree->Create(m_bbox.min.x, m_bbox.min.y, m_bbox.max.x, m_bbox.max.y, num_levels);
-	m_sphereTree->SetLines(&pLines->p1.x, nLines, sizeof(LINE));
+	// Create Line Tree
+	m_lineTree = CLineAABSPTree::Create(reinterpret_cast<const float2*>(pLines), nLines, MAX_LINES_PER_LINE_TREE_CELL);
+	{
+		const unsigned int n = m_lineTree.GetObjectCount();
+		auto& segs = m_lineTreeSegments;
+		segs.x0.resize(n);
+		segs.y0.resize(n);
+		segs.dx.resize(n);
+		segs.dy.resize(n);
+		segs.invLenSq.resize(n);
+		for (unsigned int i = 0; i < n; ++i) {
+			const auto& l = pLines[m_lineTree.GetLineIndex(i)];
+			const auto v = l.p2 - l.p1;
+			const float len_sq = v.x * v.x + v.y * v.y;
+			segs.x0[i] = l.p1.x;
+			segs.y0[i] = l.p1.y;
+			segs.dx[i] = v.x;
+			segs.dy[i] = v.y;
+			segs.invLenSq[i] = (len_sq > 0) ? 1.f / len_sq : 0.f;
+		}
+	}
 
 	// Find Crossings
 	findCrossings(pUnlinks, nUnlinks);
@@ -115,51 +249,88 @@ void CAxialGraph::setPointGroups(std::vector<unsigned int>&& points_per_group)
 	m_PointGroups = std::move(points_per_group);
 }
 
+void CAxialGraph::setPoints(const COORDS* pPoints, int nPoints)
+{
+	m_points.clear();
+	m_linePoints.clear();
+	for (auto& l : m_lines)
+		l.nPoints = 0;
+
+	auto tick = GetTimeMSec();
+	connectPointsToNetwork(pPoints, nPoints);
+	m_stat.timeConnectPoints = 0.001f * (GetTimeMSec() - tick);
+}
+
 int CAxialGraph::getClosestLine(const COORDS& pt, REAL* pRetDist, REAL* pRetPos) const
 {
-	int iClosestLine = -1;
-	REAL minDist = -1, pos = -1;
+	int line;
+	REAL dist, pos;
 
-	const auto graph_center = (m_bbox.max + m_bbox.min) * .5f;
-	const auto max_dist = m_maxDist + (graph_center - pt).getLength();
+	const int count = getClosestLines(pt, 1, &line, &dist, &pos);
 
-	float tolerance = 15;
-	do
-	{
-		tolerance *= 2;
+	if (pRetDist)
+		*pRetDist = count ? dist : -1;
+
+	if (pRetPos)
+		*pRetPos = count ? pos : -1;
 
-		iClosestLine = -1;
-		minDist = pos = -1;
+	return count ? line : -1;
+}
+
+int CAxialGraph::getClosestLines(const COORDS& pt, int k, int* pRetLines, REAL* pRetDists, REAL* pRetPos) const
+{
+	struct CANDIDATE {
+		float distSq;
+		int   iLine;
+		bool operator<(const CANDIDATE& rhs) const { return (distSq < rhs.distSq) || (distSq == rhs.distSq && iLine < rhs.iLine); }
+	};
 
-		m_sphereTree->TForEachCloseLine(pt.x, pt.y, tolerance, [&](int line_index)
+	if (k <= 0)
+		return 0;
+
+	// Closest lines found so far, sorted
+	std::vector<CANDIDATE> closest;
+	closest.reserve(k + 1);
+
+	const auto& segs = m_lineTreeSegments;
+
+	m_lineTree.TForEachCellNearestFirst(pt, [&](unsigned int first_object, unsigned int object_count, float) -> float
+	{
+		const unsigned int BATCH_SIZE = 32;
+		float dist_sq[BATCH_SIZE];
+		for (unsigned int batch_first = first_object; batch_first < first_object + object_count; batch_first += BATCH_SIZE)
 		{
-			const auto& l = m_lines[line_index];
-			// Find closest point on line
-			REAL dist;
-			const auto t = getNearestPoint(pt, l.p1, l.p2, &dist);
-			// Better than what we've found so far?
-			if (iClosestLine < 0 || dist < minDist)
+			const unsigned int batch_count = std::min(first_object + object_count - batch_first, BATCH_SIZE);
+			LineSegmentDistancesSq(pt, &segs.x0[batch_first], &segs.y0[batch_first], &segs.dx[batch_first], &segs.dy[batch_first], &segs.invLenSq[batch_first], batch_count, dist_sq);
+			for (unsigned int i = 0; i < batch_count; ++i)
 			{
-				minDist = dist;
-				iClosestLine = line_index;
-				pos = t * l.length;
+				const CANDIDATE c = { dist_sq[i], (int)m_lineTree.GetLineIndex(batch_first + i) };
+				if ((int)closest.size() == k && !(c < closest.back()))
+					continue;
+				// Lines spanning several cells are visited once per cell
+				if (std::any_of(closest.begin(), closest.end(), [&](const CANDIDATE& other) { return other.iLine == c.iLine; }))
+					continue;
+				closest.insert(std::upper_bound(closest.begin(), closest.end(), c), c);
+				if ((int)closest.size() > k)
+					closest.pop_back();
 			}
-		});
-
-		// IMPORTANT: Only accept this line as the closest one if it is closer than the tolerance
-		// we used in the query. If the closest line we found is farther away than the tolerance 
-		// then there might be lines that are closer that we can find by increasing tolerance.
-		if (minDist >= 0 && minDist < tolerance)
-			break;
-	} while (tolerance < max_dist);
-
-	if (pRetDist)
-		*pRetDist = minDist;
+		}
+		return ((int)closest.size() < k) ? std::numeric_limits<float>::infinity() : closest.back().distSq;
+	});
 
-	if (pRetPos)
-		*pRetPos = pos;
+	for (size_t i = 0; i < closest.size(); ++i)
+	{
+		const auto& l = m_lines[closest[i].iLine];
+		pRetLines[i] = closest[i].iLine;
+		REAL dist;
+		const auto t = getNearestPoint(pt, l.p1, l.p2, &dist);
+		if (pRetDists)
+			pRetDists[i] = dist;
+		if (pRetPos)
+			pRetPos[i] = t * l.length;
+	}
 
-	return iClosestLine;
+	return (int)closest.size();
 }
 
 int CAxialGraph::getLinesFromPoint(const COORDS& ptCenter, float radius, int** ppRetLinesIdx)
@@ -170,26 +341,26 @@ int CAxialGraph::getLinesFromPoint(const COORDS& ptCenter, float radius, int** p
 	if (m_lines.empty()) 
 		return 0;
 
-	if (m_tmpLineIdx.size() < m_lines.size())
-		m_tmpLineIdx.resize(m_lines.size());
-
-
-	int nFound = m_sphereTree->GetCloseLines(&m_tmpLineIdx.front(), ptCenter.x, ptCenter.y, radius);
-	if (nFound <= 0)
-		return 0;
+	m_tmpLineIdx.clear();
+	m_lineTree.TForEachLineInSphere(ptCenter, radius, [&](unsigned int line_index)
+	{
+		m_tmpLineIdx.push_back((int)line_index);
+	});
+	std::sort(m_tmpLineIdx.begin(), m_tmpLineIdx.end());
+	m_tmpLineIdx.erase(std::unique(m_tmpLineIdx.begin(), m_tmpLineIdx.end()), m_tmpLineIdx.end());
 
 	// Remove lines that are outside the radius
-	for (int i=0; i<nFound; ++i) {
+	int nFound = 0;
+	for (const int iLine : m_tmpLineIdx) {
 		REAL dist;
-		getNearestPoint(ptCenter, m_lines[m_tmpLineIdx[i]].p1, m_lines[m_tmpLineIdx[i]].p2, &dist);
-		if (dist > radius) {
-			--nFound;
-			if (i < nFound)
-				m_tmpLineIdx[i] = m_tmpLineIdx[nFound];
-			--i;
-		}
+		getNearestPoint(ptCenter, m_lines[iLine].p1, m_lines[iLine].p2, &dist);
+		if (dist <= radius)
+			m_tmpLineIdx[nFound++] = iLine;
 	}
 
+	if (nFound <= 0)
+		return 0;
+
 	if (ppRetLinesIdx) 
 		*ppRetLinesIdx = &m_tmpLineIdx.front();
 
@@ -198,12 +369,290 @@ int CAxialGraph::getLinesFromPoint(const COORDS& ptCenter, float radius, int** p
 
 int CAxialGraph::getCloseLines(int* pRetIdx, REAL x1, REAL y1, REAL x2, REAL y2)
 {
-	return m_sphereTree->GetCloseLines(pRetIdx, x1, y1, x2, y2);
+	std::vector<int> lines;
+	getLinesNearSegment(COORDS(x1, y1), COORDS(x2, y2), lines);
+	std::copy(lines.begin(), lines.end(), pRetIdx);
+	return (int)lines.size();
+}
+
+void CAxialGraph::getLinesNearSegment(const COORDS& p1, const COORDS& p2, std::vector<int>& ret_lines) const
+{
+	ret_lines.clear();
+	m_lineTree.TForEachLineInCapsule(p1, p2, 0, [&](unsigned int line_index)
+	{
+		ret_lines.push_back((int)line_index);
+	});
+	std::sort(ret_lines.begin(), ret_lines.end());
+	ret_lines.erase(std::unique(ret_lines.begin(), ret_lines.end()), ret_lines.end());
+}
+
+void CAxialGraph::getRegionEntryPoints(const COORDS* pPoints, int nPoints, std::vector<COORDS>& ret_points) const
+{
+	// Rings are separated by NaN points
+	int iFirst = 0;
+	for (int i = 0; i <= nPoints; ++i) {
+		if (i < nPoints && !std::isnan(pPoints[i].x))
+			continue;
+		if (i > iFirst)
+			getRingEntryPoints(pPoints + iFirst, i - iFirst, ret_points);
+		iFirst = i + 1;
+	}
+}
+
+void CAxialGraph::getRingEntryPoints(const COORDS* pPoints, int nPoints, std::vector<COORDS>& ret_points) const
+{
+	if (m_lines.empty())
+		return;
+
+	// A point on the ring is attached to its closest line, and a path from it
+	// leaves that line at an anchor: a crossing, a point attached to the line
+	// or the line center. For every anchor we keep the ring point with the
+	// smallest snap distance plus distance along the line to it. Along an
+	// edge stretch with the same closest line both distances are
+	// piecewise linear in edge position (or distance to a line end), so the
+	// cheapest points are among: stretch ends, where the projection enters or
+	// leaves the line, where the edge crosses the line, the points closest to
+	// the line ends, and where the projection passes an anchor.
+	struct SCandidate {
+		int    iLine;
+		REAL   snapDist;
+		REAL   pos;
+		COORDS pt;
+	};
+	std::vector<SCandidate> candidates;
+
+	std::vector<REAL> anchors;
+	auto getAnchors = [&](int iLine)
+	{
+		const auto& l = m_lines[iLine];
+		anchors.clear();
+		for (int c = 0; c < l.nCrossings; ++c)
+			anchors.push_back(m_lineCrossings[l.iFirstCrossing + c].linePos);
+		for (int p = 0; p < l.nPoints; ++p)
+			anchors.push_back(m_points[m_linePoints[l.iFirstPoint + p]].linePos);
+		anchors.push_back(l.length * .5f);
+	};
+
+	auto addCandidate = [&](const COORDS& pt)
+	{
+		SCandidate c;
+		c.iLine = getClosestLine(pt, &c.snapDist, &c.pos);
+		c.pt = pt;
+		if (c.iLine >= 0)
+			candidates.push_back(c);
+	};
+
+	// Distance to network at every corner, negative if there is none
+	std::vector<REAL> cornerDist(nPoints);
+	for (int i = 0; i < nPoints; ++i) {
+		if (getClosestLine(pPoints[i], &cornerDist[i], nullptr) < 0)
+			cornerDist[i] = -1;
+	}
+
+	std::vector<int> nearLines;
+	std::vector<std::vector<SDistSqPiece>> nearPieces;
+	std::vector<double> cuts, roots;
+
+	for (int i = 0; i < nPoints; ++i) {
+		const int j = (i + 1 < nPoints) ? i + 1 : 0;
+		if (cornerDist[i] < 0 || cornerDist[j] < 0)
+			continue;
+		const COORDS& a = pPoints[i];
+		const COORDS& b = pPoints[j];
+		const COORDS edgeV = b - a;
+		const REAL edgeLength = edgeV.getLength();
+		if (edgeLength <= 0) {
+			addCandidate(a);
+			continue;
+		}
+
+		// No point on this edge is farther than max corner distance plus half
+		// edge length from its closest line, and no line that is closest
+		// somewhere on the edge is farther than that from the edge center.
+		const COORDS center = (a + b) * .5f;
+		const REAL radius = std::max(cornerDist[i], cornerDist[j]) + edgeLength * .5f;
+		nearLines.clear();
+		m_lineTree.TForEachLineInSphere(center, radius, [&](unsigned int iLine)
+		{
+			nearLines.push_back((int)iLine);
+		});
+		std::sort(nearLines.begin(), nearLines.end());
+		nearLines.erase(std::unique(nearLines.begin(), nearLines.end()), nearLines.end());
+
+		// Distance from a line segment to a point moving along the edge is
+		// convex, so no point on the edge is farther from the network than
+		// the smallest max distance of any line at the edge ends. Lines that
+		// never come closer than that are never the closest line.
+		REAL maxNetworkDist = std::numeric_limits<REAL>::infinity();
+		for (const int iLine : nearLines) {
+			const auto& l = m_lines[iLine];
+			REAL distA, distB;
+			getNearestPoint(a, l.p1, l.p2, &distA);
+			getNearestPoint(b, l.p1, l.p2, &distB);
+			maxNetworkDist = std::min(maxNetworkDist, std::max(distA, distB));
+		}
+		nearPieces.resize(nearLines.size());
+		size_t nNear = 0;
+		for (const int iLine : nearLines) {
+			const auto& l = m_lines[iLine];
+			REAL dist;
+			getNearestPoint(ClosestPointOnLineSegmentToLineSegment(a, b, l.p1, l.p2), l.p1, l.p2, &dist);
+			if (dist > maxNetworkDist * 1.0001f + 0.0001f)
+				continue;
+			nearLines[nNear] = iLine;
+			EdgeToLineDistSqPieces(a, edgeV, l.p1, l.p2, nearPieces[nNear]);
+			++nNear;
+		}
+
+		// The closest line can only change where two lines are equally far
+		// away, and no other line is closer
+		cuts.clear();
+		cuts.push_back(0);
+		cuts.push_back(1);
+		for (size_t l0 = 0; l0 < nNear; ++l0) {
+			for (size_t l1 = l0 + 1; l1 < nNear; ++l1) {
+				roots.clear();
+				for (const auto& piece0 : nearPieces[l0]) {
+					for (const auto& piece1 : nearPieces[l1]) {
+						const double s0 = std::max(piece0.s0, piece1.s0);
+						const double s1 = std::min(piece0.s1, piece1.s1);
+						if (s0 <= s1)
+							QuadraticRoots(piece0.A - piece1.A, piece0.B - piece1.B, piece0.C - piece1.C, s0, s1, roots);
+					}
+				}
+				for (const double root : roots) {
+					const double distSq = DistSqAt(nearPieces[l0], root);
+					size_t k = 0;
+					for (; k < nNear; ++k) {
+						if (DistSqAt(nearPieces[k], root) < distSq * (1 - 1e-6) - 1e-12)
+							break;
+					}
+					if (k == nNear)
+						cuts.push_back(root);
+				}
+			}
+		}
+		std::sort(cuts.begin(), cuts.end());
+		cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+		// Points exactly where the closest line changes are attached to the
+		// line with lowest index, so stretch ends are moved slightly inwards
+		// to get a point attached to the line of that stretch.
+		const double nudge = ENTRY_POINT_NUDGE / edgeLength;
+
+		for (size_t c = 0; c + 1 < cuts.size(); ++c) {
+			const double s0 = cuts[c];
+			const double s1 = cuts[c + 1];
+			const double sMid = (s0 + s1) * .5;
+			auto addAt = [&](double s)
+			{
+				if (s >= s0 && s <= s1)
+					addCandidate(a + edgeV * (REAL)s);
+			};
+
+			if (s1 - s0 <= 2 * nudge) {
+				addAt(sMid);
+				continue;
+			}
+			addAt(s0 + nudge);
+			addAt(s1 - nudge);
+
+			const int iLine = getClosestLine(a + edgeV * (REAL)sMid, nullptr, nullptr);
+			if (iLine < 0)
+				continue;
+			const auto& l = m_lines[iLine];
+
+			// Closest points to the line ends
+			addAt(dot(l.p1 - a, edgeV) / (edgeLength * edgeLength));
+			addAt(dot(l.p2 - a, edgeV) / (edgeLength * edgeLength));
+
+			if (l.length <= 0)
+				continue;
+			const COORDS lineDir = (l.p2 - l.p1) * (1.f / l.length);
+
+			// Where the edge crosses the line
+			const double perpA = crp(lineDir, a - l.p1);
+			const double perpV = crp(lineDir, edgeV);
+			if (perpV != 0)
+				addAt(-perpA / perpV);
+
+			// Where the projection onto the line enters or leaves it, or passes an anchor
+			const double posA = dot(a - l.p1, lineDir);
+			const double posV = dot(edgeV, lineDir);
+			if (posV == 0)
+				continue;
+			addAt(-posA / posV);
+			addAt((l.length - posA) / posV);
+			getAnchors(iLine);
+			for (const REAL anchor : anchors)
+				addAt((anchor - posA) / posV);
+		}
+	}
+
+	// For every anchor, and side of it since that matters for angular
+	// distance, keep the candidate closest to it in walking distance
+	std::sort(candidates.begin(), candidates.end(), [](const SCandidate& lhs, const SCandidate& rhs)
+	{
+		if (lhs.iLine != rhs.iLine)
+			return lhs.iLine < rhs.iLine;
+		if (lhs.snapDist != rhs.snapDist)
+			return lhs.snapDist < rhs.snapDist;
+		return lhs.pos < rhs.pos;
+	});
+
+	const size_t iFirstRet = ret_points.size();
+
+	for (size_t first = 0; first < candidates.size(); ) {
+		const int iLine = candidates[first].iLine;
+		size_t last = first;
+		REAL minPos = candidates[first].pos, maxPos = minPos;
+		for (; last < candidates.size() && candidates[last].iLine == iLine; ++last) {
+			minPos = std::min(minPos, candidates[last].pos);
+			maxPos = std::max(maxPos, candidates[last].pos);
+		}
+
+		// All anchors before (or after) every candidate on the line pick the
+		// same candidate, so only one of them is needed
+		getAnchors(iLine);
+		for (auto& anchor : anchors)
+			anchor = std::min(std::max(anchor, minPos - 1), maxPos + 1);
+		std::sort(anchors.begin(), anchors.end());
+		anchors.erase(std::unique(anchors.begin(), anchors.end()), anchors.end());
+
+		for (const REAL anchor : anchors) {
+			for (int side = 0; side < 2; ++side) {
+				const SCandidate* best = nullptr;
+				REAL bestDist = 0;
+				for (size_t c = first; c < last; ++c) {
+					const auto& cand = candidates[c];
+					if ((anchor < cand.pos) != (0 == side))
+						continue;
+					const REAL dist = cand.snapDist + (REAL)fabs(cand.pos - anchor);
+					if (!best || dist < bestDist) {
+						best = &cand;
+						bestDist = dist;
+					}
+				}
+				if (best)
+					ret_points.push_back(best->pt);
+			}
+		}
+
+		first = last;
+	}
+
+	// Same point can be the best one for several anchors
+	auto itFirst = ret_points.begin() + iFirstRet;
+	std::sort(itFirst, ret_points.end(), [](const COORDS& lhs, const COORDS& rhs)
+	{
+		return (lhs.x < rhs.x) || ((lhs.x == rhs.x) && (lhs.y < rhs.y));
+	});
+	ret_points.erase(std::unique(itFirst, ret_points.end()), ret_points.end());
 }
 
 void CAxialGraph::findCrossings(const COORDS* pUnlinks, int nUnlinks) 
 {
-	std::vector<int> lineList(m_lines.size());
+	std::vector<int> lineList;
 
 	struct SCrossMapEntry
 	{
@@ -223,16 +672,11 @@ void CAxialGraph::findCrossings(const COORDS* pUnlinks, int nUnlinks)
 		if (line0.length < MIN_LINE_LENGTH)
 			continue;
 
-	#ifdef USE_SPHERE_TREE
-		const int nClose = m_sphereTree->GetCloseLines(&lineList.front(), line0.p1.x, line0.p1.y, line0.p2.x, line0.p2.y);
-		for (int i=0; i<nClose; ++i) {
-			const int iLine1 = lineList[i];
+		getLinesNearSegment(line0.p1, line0.p2, lineList);
+		for (const int iLine1 : lineList) {
 			// Only store connections to lines with greater index
 			if (iLine1 <= iLine0)
 				continue; 
-	#else
-		for (int iLine1=iLine+1; iLine1<(int)m_lines.size(); ++iLine1) {
-	#endif
 
 			const auto& line1 = m_lines[iLine1];
 			
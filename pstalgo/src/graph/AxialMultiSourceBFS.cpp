@@ -0,0 +1,176 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include <pstalgo/Debug.h>
+#include <pstalgo/graph/AxialGraph.h>
+#include <pstalgo/graph/AxialMultiSourceBFS.h>
+#include <pstalgo/utils/Bit.h>
+
+bool CAxialLineAdjacency::Create(const CAxialGraph& graph)
+{
+	const int line_count = graph.getLineCount();
+
+	m_FirstNeighbour.resize(line_count + 1);
+	m_Neighbours.clear();
+	m_Neighbours.reserve(graph.getLineCrossingCount());
+	for (int line_index = 0; line_index < line_count; ++line_index)
+	{
+		const CAxialGraph::NETWORKLINE& line = graph.getLine(line_index);
+		m_FirstNeighbour[line_index] = (uint32)m_Neighbours.size();
+		for (int i = 0; i < line.nCrossings; ++i)
+		{
+			const CAxialGraph::LINECROSSING& lc = graph.getLineCrossing(line.iFirstCrossing + i);
+			m_Neighbours.push_back((uint32)graph.getLineCrossing(lc.iOpposite).iLine);
+		}
+		auto* first = m_Neighbours.data() + m_FirstNeighbour[line_index];
+		std::sort(first, m_Neighbours.data() + m_Neighbours.size());
+		m_Neighbours.resize(std::unique(first, m_Neighbours.data() + m_Neighbours.size()) - m_Neighbours.data());
+	}
+	m_FirstNeighbour[line_count] = (uint32)m_Neighbours.size();
+
+	// CPSTBFS never leaves a line at the same position as it entered it. That makes
+	// no difference to depths if the lines linked to a line at the same position
+	// are also linked to each other, since the line we came from is then linked to
+	// the same lines as well.
+	std::vector<std::pair<float, uint32>> neighbours_by_pos;
+	for (int line_index = 0; line_index < line_count; ++line_index)
+	{
+		const CAxialGraph::NETWORKLINE& line = graph.getLine(line_index);
+		neighbours_by_pos.clear();
+		for (int i = 0; i < line.nCrossings; ++i)
+		{
+			const CAxialGraph::LINECROSSING& lc = graph.getLineCrossing(line.iFirstCrossing + i);
+			neighbours_by_pos.push_back(std::make_pair(lc.linePos, (uint32)graph.getLineCrossing(lc.iOpposite).iLine));
+		}
+		std::sort(neighbours_by_pos.begin(), neighbours_by_pos.end());
+		for (size_t i = 0; i < neighbours_by_pos.size(); ++i)
+		{
+			for (size_t j = i + 1; j < neighbours_by_pos.size() && neighbours_by_pos[j].first == neighbours_by_pos[i].first; ++j)
+			{
+				const uint32 a = neighbours_by_pos[i].second;
+				const uint32 b = neighbours_by_pos[j].second;
+				if (a != b && !std::binary_search(NeighboursBegin(a), NeighboursEnd(a), b))
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+CAxialMultiSourceBFS::CAxialMultiSourceBFS(const CAxialLineAdjacency& adjacency)
+	: m_Adjacency(adjacency)
+	, m_Seen(adjacency.LineCount(), 0)
+	, m_Frontier(adjacency.LineCount(), 0)
+	, m_Next(adjacency.LineCount(), 0)
+{
+	m_FrontierLines.reserve(adjacency.LineCount());
+	m_NextLines.reserve(adjacency.LineCount());
+}
+
+void CAxialMultiSourceBFS::Search(const uint32* origin_lines, uint32 origin_count, const uint32* max_steps, uint32 limit_count, uint32* ret_reached_counts, uint64* ret_total_depths)
+{
+	ASSERT(origin_count <= MAX_ORIGIN_COUNT);
+
+	uint32 max_max_steps = 0;
+	for (uint32 limit_index = 0; limit_index < limit_count; ++limit_index)
+		max_max_steps = std::max(max_max_steps, max_steps[limit_index]);
+
+	// Copies results so far to the limits within [min_steps, max_steps]
+	auto store_results = [&](uint32 min_steps_incl, uint32 max_steps_incl)
+	{
+		for (uint32 limit_index = 0; limit_index < limit_count; ++limit_index)
+		{
+			if (max_steps[limit_index] < min_steps_incl || max_steps[limit_index] > max_steps_incl)
+				continue;
+			std::copy(m_ReachedCounts, m_ReachedCounts + origin_count, ret_reached_counts + limit_index * origin_count);
+			std::copy(m_TotalDepths, m_TotalDepths + origin_count, ret_total_depths + limit_index * origin_count);
+		}
+	};
+
+	std::fill(m_Seen.begin(), m_Seen.end(), 0);
+
+	m_FrontierLines.clear();
+	for (uint32 i = 0; i < origin_count; ++i)
+	{
+		const uint32 line_index = origin_lines[i];
+		if (!m_Frontier[line_index])
+			m_FrontierLines.push_back(line_index);
+		m_Seen[line_index] |= (uint64)1 << i;
+		m_Frontier[line_index] |= (uint64)1 << i;
+		m_ReachedCounts[i] = 0;
+		m_TotalDepths[i] = 0;
+	}
+	store_results(0, 0);
+
+	uint32 depth = 1;
+	for (; depth <= max_max_steps && !m_FrontierLines.empty(); ++depth)
+	{
+		// Expand the frontier of all origins at once
+		m_NextLines.clear();
+		for (const uint32 line_index : m_FrontierLines)
+		{
+			const uint64 frontier = m_Frontier[line_index];
+			m_Frontier[line_index] = 0;
+			for (auto* it = m_Adjacency.NeighboursBegin(line_index); it != m_Adjacency.NeighboursEnd(line_index); ++it)
+			{
+				const uint64 reached = frontier & ~m_Seen[*it];
+				if (!reached)
+					continue;
+				if (!m_Next[*it])
+					m_NextLines.push_back(*it);
+				m_Next[*it] |= reached;
+			}
+		}
+
+		// Lines reached for the first time make up the next frontier
+		for (const uint32 line_index : m_NextLines)
+		{
+			const uint64 reached = m_Next[line_index];
+			m_Next[line_index] = 0;
+			m_Seen[line_index] |= reached;
+			m_Frontier[line_index] = reached;
+			for (uint32 half = 0; half < 2; ++half)
+			{
+				uint32 bits = (uint32)(reached >> (half * 32));
+				while (bits)
+				{
+					const uint32 i = psta::bit_scan_reverse(bits);
+					bits &= ~((uint32)1 << i);
+					++m_ReachedCounts[half * 32 + i];
+					m_TotalDepths[half * 32 + i] += depth;
+				}
+			}
+		}
+
+		m_FrontierLines.swap(m_NextLines);
+
+		store_results(depth, depth);
+	}
+
+	// Nothing more is reachable within the remaining limits
+	store_results(depth, (uint32)-1);
+
+	for (const uint32 line_index : m_FrontierLines)
+		m_Frontier[line_index] = 0;
+}
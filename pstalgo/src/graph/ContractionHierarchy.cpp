@@ -0,0 +1,339 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+#include <pstalgo/Debug.h>
+#include <pstalgo/graph/ContractionHierarchy.h>
+
+namespace
+{
+	// Max number of nodes settled by a witness search. A witness search that gives
+	// up early only means that an unnecessary shortcut might be added.
+	const uint32 WITNESS_SETTLE_LIMIT = 128;
+
+	// Contraction stops when the node with lowest priority has more edges than
+	// this, since the remaining graph is then dense and slow to contract
+	const uint32 MAX_CONTRACTION_DEGREE = 16;
+
+	struct SAdjacent
+	{
+		uint32 m_Node;
+		float  m_Weight;
+	};
+
+	class CContractionGraph
+	{
+	public:
+		CContractionGraph(uint32 node_count, const CContractionHierarchy::SEdge* edges, size_t edge_count)
+			: m_Out(node_count)
+			, m_In(node_count)
+			, m_ContractedNeighbourCount(node_count, 0)
+			, m_Level(node_count, 0)
+			, m_WitnessDistance(node_count, std::numeric_limits<float>::infinity())
+			, m_IsTarget(node_count, false)
+		{
+			for (size_t i = 0; i < edge_count; ++i)
+				if (edges[i].m_From != edges[i].m_To)
+					AddEdge(edges[i].m_From, edges[i].m_To, edges[i].m_Weight);
+		}
+
+		// Number of shortcuts needed minus number of edges removed if node is
+		// contracted, plus number of already contracted neighbours and depth in
+		// hierarchy (to contract nodes evenly over the graph)
+		int Priority(uint32 node)
+		{
+			int shortcut_count = 0;
+			ForEachShortcut(node, [&](uint32, uint32, float) { ++shortcut_count; });
+			return 2 * (shortcut_count - (int)(m_Out[node].size() + m_In[node].size())) + (int)m_ContractedNeighbourCount[node] + (int)m_Level[node];
+		}
+
+		uint32 Degree(uint32 node) const { return (uint32)(m_Out[node].size() + m_In[node].size()); }
+
+		void GetEdges(uint32 node, std::vector<CContractionHierarchy::SEdge>& ret_out_edges, std::vector<CContractionHierarchy::SEdge>& ret_in_edges) const
+		{
+			for (const auto& e : m_Out[node])
+				ret_out_edges.push_back({ node, e.m_Node, e.m_Weight });
+			for (const auto& e : m_In[node])
+				ret_in_edges.push_back({ e.m_Node, node, e.m_Weight });
+		}
+
+		// Removes node from the graph, adding shortcuts between its neighbours
+		// where needed. Edges of node at the time of contraction are returned.
+		void Contract(uint32 node, std::vector<CContractionHierarchy::SEdge>& ret_out_edges, std::vector<CContractionHierarchy::SEdge>& ret_in_edges)
+		{
+			m_Shortcuts.clear();
+			ForEachShortcut(node, [&](uint32 from, uint32 to, float weight)
+			{
+				m_Shortcuts.push_back({ from, to, weight });
+			});
+
+			GetEdges(node, ret_out_edges, ret_in_edges);
+			for (const auto& e : m_Out[node])
+			{
+				RemoveAdjacent(m_In[e.m_Node], node);
+				++m_ContractedNeighbourCount[e.m_Node];
+				m_Level[e.m_Node] = std::max(m_Level[e.m_Node], m_Level[node] + 1);
+			}
+			for (const auto& e : m_In[node])
+			{
+				RemoveAdjacent(m_Out[e.m_Node], node);
+				++m_ContractedNeighbourCount[e.m_Node];
+				m_Level[e.m_Node] = std::max(m_Level[e.m_Node], m_Level[node] + 1);
+			}
+			std::vector<SAdjacent>().swap(m_Out[node]);
+			std::vector<SAdjacent>().swap(m_In[node]);
+
+			for (const auto& shortcut : m_Shortcuts)
+				AddEdge(shortcut.m_From, shortcut.m_To, shortcut.m_Weight);
+		}
+
+	private:
+		struct SQueueItem
+		{
+			float  m_Distance;
+			uint32 m_Node;
+			inline bool operator<(const SQueueItem& rhs) const { return m_Distance > rhs.m_Distance; }
+		};
+		struct SGetQueueItemKey
+		{
+			float operator()(const SQueueItem& item) const { return item.m_Distance; }
+		};
+
+		void AddEdge(uint32 from, uint32 to, float weight)
+		{
+			auto it = std::find_if(m_Out[from].begin(), m_Out[from].end(), [to](const SAdjacent& e) { return e.m_Node == to; });
+			if (it == m_Out[from].end())
+			{
+				m_Out[from].push_back({ to, weight });
+				m_In[to].push_back({ from, weight });
+				return;
+			}
+			if (weight >= it->m_Weight)
+				return;
+			it->m_Weight = weight;
+			for (auto& e : m_In[to])
+				if (e.m_Node == from)
+					e.m_Weight = weight;
+		}
+
+		static void RemoveAdjacent(std::vector<SAdjacent>& adjacent, uint32 node)
+		{
+			adjacent.erase(std::remove_if(adjacent.begin(), adjacent.end(), [node](const SAdjacent& e) { return e.m_Node == node; }), adjacent.end());
+		}
+
+		// Calls lmbd(from, to, weight) for every pair of neighbours of node that
+		// would need a shortcut if node was contracted
+		template <class TLambda>
+		void ForEachShortcut(uint32 node, TLambda&& lmbd)
+		{
+			float max_out_weight = 0;
+			for (const auto& e : m_Out[node])
+			{
+				max_out_weight = std::max(max_out_weight, e.m_Weight);
+				m_IsTarget[e.m_Node] = true;
+			}
+			for (const auto& in : m_In[node])
+			{
+				WitnessSearch(in.m_Node, node, in.m_Weight + max_out_weight, (uint32)m_Out[node].size());
+				for (const auto& out : m_Out[node])
+				{
+					if (out.m_Node == in.m_Node)
+						continue;
+					const float shortcut_weight = in.m_Weight + out.m_Weight;
+					if (m_WitnessDistance[out.m_Node] > shortcut_weight)
+						lmbd(in.m_Node, out.m_Node, shortcut_weight);
+				}
+				for (const auto n : m_Touched)
+					m_WitnessDistance[n] = std::numeric_limits<float>::infinity();
+				m_Touched.clear();
+			}
+			for (const auto& e : m_Out[node])
+				m_IsTarget[e.m_Node] = false;
+		}
+
+		// Dijkstra search from 'source' that avoids 'skip_node', up to 'max_distance'
+		// or until 'target_count' nodes flagged in m_IsTarget have been settled
+		void WitnessSearch(uint32 source, uint32 skip_node, float max_distance, uint32 target_count)
+		{
+			m_WitnessDistance[source] = 0;
+			m_Touched.push_back(source);
+			m_Queue.push({ 0, source });
+			uint32 settle_count = 0;
+			while (!m_Queue.empty())
+			{
+				const auto item = m_Queue.top();
+				m_Queue.pop();
+				if (item.m_Distance > m_WitnessDistance[item.m_Node])
+					continue;
+				if (item.m_Distance > max_distance || ++settle_count > WITNESS_SETTLE_LIMIT)
+					break;
+				if (m_IsTarget[item.m_Node] && 0 == --target_count)
+					break;
+				for (const auto& e : m_Out[item.m_Node])
+				{
+					if (e.m_Node == skip_node)
+						continue;
+					const float distance = item.m_Distance + e.m_Weight;
+					if (distance >= m_WitnessDistance[e.m_Node])
+						continue;
+					if (std::numeric_limits<float>::infinity() == m_WitnessDistance[e.m_Node])
+						m_Touched.push_back(e.m_Node);
+					m_WitnessDistance[e.m_Node] = distance;
+					m_Queue.push({ distance, e.m_Node });
+				}
+			}
+			m_Queue.clear();
+		}
+
+		std::vector<std::vector<SAdjacent>> m_Out;
+		std::vector<std::vector<SAdjacent>> m_In;
+		std::vector<uint32> m_ContractedNeighbourCount;
+		std::vector<uint32> m_Level;
+		std::vector<CContractionHierarchy::SEdge> m_Shortcuts;
+		std::vector<float> m_WitnessDistance;
+		std::vector<bool> m_IsTarget;
+		std::vector<uint32> m_Touched;
+		psta::radix_heap<SQueueItem, SGetQueueItemKey> m_Queue;
+	};
+
+	// Edges grouped by rank of node 'm_From' (if by_source) or 'm_To', with the
+	// rank of the other node
+	void BuildRankEdges(const std::vector<CContractionHierarchy::SEdge>& edges, const std::vector<uint32>& rank_from_node, bool by_source, std::vector<uint32>& ret_first_edge, std::vector<CContractionHierarchy::SRankEdge>& ret_edges)
+	{
+		const uint32 node_count = (uint32)rank_from_node.size();
+		ret_first_edge.assign(node_count + 1, 0);
+		for (const auto& e : edges)
+			++ret_first_edge[rank_from_node[by_source ? e.m_From : e.m_To] + 1];
+		for (uint32 i = 0; i < node_count; ++i)
+			ret_first_edge[i + 1] += ret_first_edge[i];
+		ret_edges.resize(edges.size());
+		std::vector<uint32> next(ret_first_edge.begin(), ret_first_edge.end() - 1);
+		for (const auto& e : edges)
+		{
+			const uint32 rank = rank_from_node[by_source ? e.m_From : e.m_To];
+			ret_edges[next[rank]++] = { rank_from_node[by_source ? e.m_To : e.m_From], e.m_Weight };
+		}
+	}
+}
+
+void CContractionHierarchy::Create(uint32 node_count, const SEdge* edges, size_t edge_count)
+{
+	CContractionGraph graph(node_count, edges, edge_count);
+
+	// Nodes are contracted in order of priority, which is updated lazily
+	// (re-calculated when popped, and re-inserted if no longer smallest)
+	typedef std::pair<int, uint32> prio_node_t;
+	std::priority_queue<prio_node_t, std::vector<prio_node_t>, std::greater<prio_node_t>> queue;
+	for (uint32 node = 0; node < node_count; ++node)
+		queue.push(prio_node_t(graph.Priority(node), node));
+
+	m_RankFromNode.resize(node_count);
+	m_NodeFromRank.clear();
+	m_NodeFromRank.reserve(node_count);
+	std::vector<SEdge> up_edges, down_edges;
+	while (!queue.empty())
+	{
+		const uint32 node = queue.top().second;
+		queue.pop();
+		const int priority = graph.Priority(node);
+		if (!queue.empty() && priority > queue.top().first)
+		{
+			queue.push(prio_node_t(priority, node));
+			continue;
+		}
+		if (graph.Degree(node) > MAX_CONTRACTION_DEGREE)
+		{
+			queue.push(prio_node_t(priority, node));
+			break;
+		}
+		m_RankFromNode[node] = (uint32)m_NodeFromRank.size();
+		m_NodeFromRank.push_back(node);
+		graph.Contract(node, up_edges, down_edges);
+	}
+
+	// Remaining nodes are left uncontracted as a core at the top of the hierarchy,
+	// with all their edges as both up and down edges
+	while (!queue.empty())
+	{
+		const uint32 node = queue.top().second;
+		queue.pop();
+		m_RankFromNode[node] = (uint32)m_NodeFromRank.size();
+		m_NodeFromRank.push_back(node);
+		graph.GetEdges(node, up_edges, down_edges);
+	}
+	ASSERT(m_NodeFromRank.size() == node_count);
+
+	BuildRankEdges(up_edges, m_RankFromNode, true, m_FirstUpEdge, m_UpEdges);
+	BuildRankEdges(down_edges, m_RankFromNode, false, m_FirstDownEdge, m_DownEdges);
+}
+
+CContractionHierarchySearch::CContractionHierarchySearch(const CContractionHierarchy& hierarchy)
+	: m_Hierarchy(hierarchy)
+	, m_DistanceFromRank(hierarchy.NodeCount())
+{}
+
+void CContractionHierarchySearch::Search(const uint32* source_nodes, const float* source_distances, uint32 source_count, float* ret_distance_per_node)
+{
+	const uint32 node_count = m_Hierarchy.NodeCount();
+
+	std::fill(m_DistanceFromRank.begin(), m_DistanceFromRank.end(), std::numeric_limits<float>::infinity());
+
+	// Upward search
+	for (uint32 i = 0; i < source_count; ++i)
+	{
+		const uint32 rank = m_Hierarchy.RankFromNode(source_nodes[i]);
+		if (source_distances[i] >= m_DistanceFromRank[rank])
+			continue;
+		m_DistanceFromRank[rank] = source_distances[i];
+		m_Queue.push({ source_distances[i], rank });
+	}
+	while (!m_Queue.empty())
+	{
+		const auto item = m_Queue.top();
+		m_Queue.pop();
+		if (item.m_Distance > m_DistanceFromRank[item.m_Rank])
+			continue;
+		for (auto* e = m_Hierarchy.UpEdgesBegin(item.m_Rank); e != m_Hierarchy.UpEdgesEnd(item.m_Rank); ++e)
+		{
+			const float distance = item.m_Distance + e->m_Weight;
+			if (distance >= m_DistanceFromRank[e->m_Rank])
+				continue;
+			m_DistanceFromRank[e->m_Rank] = distance;
+			m_Queue.push({ distance, e->m_Rank });
+		}
+	}
+
+	// Downward sweep
+	for (uint32 rank = node_count; rank-- > 0; )
+	{
+		float distance = m_DistanceFromRank[rank];
+		for (auto* e = m_Hierarchy.DownEdgesBegin(rank); e != m_Hierarchy.DownEdgesEnd(rank); ++e)
+			distance = std::min(distance, m_DistanceFromRank[e->m_Rank] + e->m_Weight);
+		m_DistanceFromRank[rank] = distance;
+	}
+
+	for (uint32 node = 0; node < node_count; ++node)
+		ret_distance_per_node[node] = m_DistanceFromRank[m_Hierarchy.RankFromNode(node)];
+}
@@ -20,44 +20,103 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <algorithm>
+#include <atomic>
 #include <pstalgo/graph/SimpleGraph.h>
+#include <pstalgo/utils/Concurrency.h>
 
+// Jones-Plassmann coloring, where priority is given by valency, with ties
+// broken by a hash of the node index. A node is colored as soon as all of its
+// neighbours with higher priority are colored, and only those can have been
+// colored already in the sequential greedy algorithm. Result is therefore
+// identical to coloring nodes one by one in order of priority, while
+// independent nodes are colored concurrently. Tie breaking by index instead
+// would make e.g. a chain of equal valency nodes take one round per node.
 unsigned int ColorGraph(const CSimpleGraph& graph, unsigned int* out_colors)
 {
+	const uint32 BLOCK_SIZE = 0x1000;
 	const uint32 NO_COLOR = (uint32)-1;
 
-	for (uint32 i = 0; i < graph.NodeCount(); ++i)
-		out_colors[i] = NO_COLOR;
+	const uint32 node_count = (uint32)graph.NodeCount();
 
-	// Create ordering of nodes by (valency, index)
-	std::vector<uint32> order(graph.NodeCount());
-	for (uint32 i = 0; i < graph.NodeCount(); ++i)
-		order[i] = i;
-	std::sort(order.begin(), order.end(), [&](uint32 a, uint32 b) -> bool
+	// Bijective integer hash (lowbias32), so there are no ties
+	auto hash = [](uint32 x) -> uint32
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352d;
+		x ^= x >> 15;
+		x *= 0x846ca68b;
+		x ^= x >> 16;
+		return x;
+	};
+
+	auto has_priority = [&](uint32 a, uint32 b) -> bool
 	{
 		const uint32 a_valency = graph.NeighbourCount(a);
 		const uint32 b_valency = graph.NeighbourCount(b);
-		return (a_valency == b_valency) ? (a < b) : (a_valency > b_valency);
+		return (a_valency == b_valency) ? (hash(a) < hash(b)) : (a_valency > b_valency);
+	};
+
+	// Number of uncolored neighbours with higher priority, per node
+	std::vector<std::atomic<uint32>> wait_count(node_count);
+	std::vector<uint32> frontier(node_count);
+	std::atomic<uint32> frontier_size(0);
+	psta::parallel_for_blocks(node_count, BLOCK_SIZE, [&](uint32 begin, uint32 end)
+	{
+		for (uint32 node_index = begin; node_index < end; ++node_index)
+		{
+			out_colors[node_index] = NO_COLOR;
+			uint32 n = 0;
+			for (uint32 i = 0; i < graph.NeighbourCount(node_index); ++i)
+				if (has_priority(graph.GetNeighbour(node_index, i), node_index))
+					++n;
+			wait_count[node_index].store(n, std::memory_order_relaxed);
+			if (0 == n)
+				frontier[frontier_size++] = node_index;
+		}
 	});
 
-	uint32 num_colors = 0;
-	for (unsigned int i = 0; i < order.size(); ++i)
+	std::vector<uint32> next_frontier(node_count);
+	std::atomic<uint32> num_colors(0);
+	while (frontier_size.load())
 	{
-		const auto node_index = order[i];
-		uint32 n, color = (uint32)-1;
-		do 
+		std::atomic<uint32> next_frontier_size(0);
+
+		// No two nodes of the frontier are neighbours, and all neighbours with
+		// higher priority have been colored in previous rounds.
+		psta::parallel_for_blocks(frontier_size.load(), BLOCK_SIZE, [&](uint32 begin, uint32 end)
 		{
-			++color;
-			for (n = 0; n < graph.NeighbourCount(node_index); ++n)
+			for (uint32 f = begin; f < end; ++f)
 			{
-				if (color == out_colors[graph.GetNeighbour(node_index, n)])
-					break;
+				const auto node_index = frontier[f];
+				uint32 n, color = (uint32)-1;
+				do
+				{
+					++color;
+					for (n = 0; n < graph.NeighbourCount(node_index); ++n)
+					{
+						const auto neighbour_index = graph.GetNeighbour(node_index, n);
+						if (has_priority(neighbour_index, node_index) && color == out_colors[neighbour_index])
+							break;
+					}
+				} while (graph.NeighbourCount(node_index) != n);
+				out_colors[node_index] = color;
+
+				for (uint32 expected = num_colors.load(); color >= expected && !num_colors.compare_exchange_weak(expected, color + 1);)
+					;
+
+				// Release neighbours with lower priority
+				for (n = 0; n < graph.NeighbourCount(node_index); ++n)
+				{
+					const auto neighbour_index = graph.GetNeighbour(node_index, n);
+					if (has_priority(node_index, neighbour_index) && 1 == wait_count[neighbour_index]--)
+						next_frontier[next_frontier_size++] = neighbour_index;
+				}
 			}
-		} while (graph.NeighbourCount(node_index) != n);
-		out_colors[node_index] = color;
-		if (color >= num_colors)
-			num_colors = color + 1;
+		});
+
+		std::swap(frontier, next_frontier);
+		frontier_size.store(next_frontier_size.load());
 	}
 
-	return num_colors;
-}
\ No newline at end of file
+	return num_colors.load();
+}
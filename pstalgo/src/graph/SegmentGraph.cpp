@@ -20,15 +20,28 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <algorithm>
+#include <atomic>
 
 #include <pstalgo/Debug.h>
 #include <pstalgo/graph/AxialGraph.h>
 #include <pstalgo/geometry/Rect.h>
 #include <pstalgo/graph/SegmentGraph.h>
+#include <pstalgo/utils/Concurrency.h>
+
+namespace
+{
+	const unsigned int BLOCK_SIZE = 0x10000;
+	const unsigned int NO_INTERSECTION = (unsigned int)-1;
+
+	// Size of an SIntersection object with 'num_segments' segments, in 32-bit words
+	inline unsigned int IntersectionWordCount(unsigned int num_segments)
+	{
+		return (unsigned int)((sizeof(CSegmentGraph::SIntersection) + 3) / 4) - 1 + num_segments;
+	}
+}
 
 CSegmentGraph::CSegmentGraph()
-	: m_IntersectionAllocator(0x1000, 4)
-	, m_WorldOrigin(0, 0)
+	: m_WorldOrigin(0, 0)
 {
 }
 
@@ -38,6 +51,8 @@ CSegmentGraph::~CSegmentGraph()
 
 bool CSegmentGraph::Create(const double2* line_coords, unsigned int line_coord_count, unsigned int* line_indices, unsigned int line_count)
 {
+	using namespace psta;
+
 	if (!line_indices && 0 == line_coord_count)
 		line_coord_count = line_count * 2;
 
@@ -48,96 +63,154 @@ bool CSegmentGraph::Create(const double2* line_coords, unsigned int line_coord_c
 	const double2 world_origin(bb.CenterX(), bb.CenterY());
 	m_WorldOrigin = world_origin;
 
-	// Create intersections and a mapping from line coordinate index to intersections
-	std::vector<SIntersection*> coord_to_intersection(line_coord_count);  // nullptr for coordinates with no intersection (dead ends)
+	// Create intersections and a mapping from line coordinate index to intersection index.
+	// All steps are done in parallel, and the result is independent of thread count.
+	std::vector<unsigned int> coord_to_intersection(line_coord_count, NO_INTERSECTION);  // NO_INTERSECTION for coordinates with no intersection (dead ends)
+	std::vector<unsigned int> intersection_offsets;  // Offset in m_IntersectionData per intersection
 	{
-		memset(coord_to_intersection.data(), 0, coord_to_intersection.size() * sizeof(SIntersection*));
-		// This here is ugly, but it saves us from allocating more memory. We calculate 
-		// number of occurances of every coord index in line_indices, and store that in
-		// the data of coord_to_intersection, temporarily.
+		// Number of occurances of every coord index in line_indices
+		std::vector<unsigned int> coord_use_count;
 		if (line_indices)
 		{
+			coord_use_count.resize(line_coord_count, 0);
 			for (unsigned int i = 0; i < line_count * 2; ++i)
-			{
-				auto& at = coord_to_intersection[line_indices[i]];
-				at = (SIntersection*)((size_t)at + 1);
-			}
+				++coord_use_count[line_indices[i]];
 		}
-		// Create an ordering of line coordinates
+
+		// Create an ordering of line coordinates (coordinate index is tie-breaker to get a total order)
 		std::vector<unsigned int> order(line_coord_count);
-		for (unsigned int i = 0; i < order.size(); ++i)
-			order[i] = i;
-		std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) -> bool
+		parallel_for_blocks(line_coord_count, BLOCK_SIZE, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; ++i)
+				order[i] = i;
+		});
+		parallel_sort(order.data(), order.data() + order.size(), [&](unsigned int a, unsigned int b) -> bool
 		{
 			const auto& p0 = line_coords[a];
 			const auto& p1 = line_coords[b];
-			return (p0.x == p1.x) ? (p0.y < p1.y) : (p0.x < p1.x);
+			return (p0.x == p1.x) ? ((p0.y == p1.y) ? (a < b) : (p0.y < p1.y)) : (p0.x < p1.x);
+		});
+
+		// Find start of every run of identical coordinates
+		auto is_run_start = [&](unsigned int i) { return 0 == i || line_coords[order[i]] != line_coords[order[i - 1]]; };
+		const unsigned int block_count = (line_coord_count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		std::vector<unsigned int> first_run_per_block(block_count + 1, 0);
+		parallel_for_blocks(line_coord_count, BLOCK_SIZE, [&](unsigned int begin, unsigned int end)
+		{
+			unsigned int n = 0;
+			for (unsigned int i = begin; i < end; ++i)
+				n += is_run_start(i) ? 1 : 0;
+			first_run_per_block[begin / BLOCK_SIZE + 1] = n;
+		});
+		for (unsigned int i = 0; i < block_count; ++i)
+			first_run_per_block[i + 1] += first_run_per_block[i];
+		const unsigned int run_count = first_run_per_block.back();
+		std::vector<unsigned int> run_starts(run_count + 1);
+		run_starts[run_count] = line_coord_count;
+		parallel_for_blocks(line_coord_count, BLOCK_SIZE, [&](unsigned int begin, unsigned int end)
+		{
+			unsigned int run_index = first_run_per_block[begin / BLOCK_SIZE];
+			for (unsigned int i = begin; i < end; ++i)
+				if (is_run_start(i))
+					run_starts[run_index++] = i;
 		});
-		// Fill in mappings
-		for (unsigned int i = 0; i < order.size();)
+
+		// Number of segments per run. Runs with less than two are dead ends.
+		std::vector<unsigned int> seg_count_per_run(run_count);
+		parallel_for_blocks(run_count, BLOCK_SIZE, [&](unsigned int begin, unsigned int end)
 		{
-			const unsigned int start_coord_index = order[i];
-			const unsigned int start = i;
-			// Look how many identical coordinates we have
-			unsigned int seg_count = 0;
-			if (line_indices)
+			for (unsigned int r = begin; r < end; ++r)
 			{
-				for (; i < order.size() && line_coords[order[i]] == line_coords[start_coord_index]; ++i)
-					seg_count += (unsigned int)(size_t)coord_to_intersection[order[i]];  // This is ugly. See explanataion above!
+				unsigned int seg_count = run_starts[r + 1] - run_starts[r];
+				if (line_indices)
+				{
+					seg_count = 0;
+					for (unsigned int i = run_starts[r]; i < run_starts[r + 1]; ++i)
+						seg_count += coord_use_count[order[i]];
+				}
+				seg_count_per_run[r] = seg_count;
 			}
-			else
+		});
+
+		// Assign intersection index and storage offset to runs (in coordinate order)
+		std::vector<unsigned int> intersection_per_run(run_count, NO_INTERSECTION);
+		unsigned int data_size = 0;
+		for (unsigned int r = 0; r < run_count; ++r)
+		{
+			if (seg_count_per_run[r] < 2)
+				continue;
+			intersection_per_run[r] = (unsigned int)intersection_offsets.size();
+			intersection_offsets.push_back(data_size);
+			data_size += IntersectionWordCount(seg_count_per_run[r]);
+		}
+		m_IntersectionData.clear();
+		m_IntersectionData.resize(data_size);
+
+		// Fill in intersections and mappings
+		parallel_for_blocks(run_count, BLOCK_SIZE, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int r = begin; r < end; ++r)
 			{
-				for (++i; i < order.size() && line_coords[order[i]] == line_coords[start_coord_index]; ++i);
-				seg_count = i - start;
+				const unsigned int intersection_index = intersection_per_run[r];
+				if (NO_INTERSECTION == intersection_index)
+					continue;
+				SIntersection* intersection = (SIntersection*)(m_IntersectionData.data() + intersection_offsets[intersection_index]);
+				intersection->m_Pos = (float2)(line_coords[order[run_starts[r]]] - world_origin);
+				intersection->m_NumSegments = seg_count_per_run[r];
+				for (unsigned int i = run_starts[r]; i < run_starts[r + 1]; ++i)
+					coord_to_intersection[order[i]] = intersection_index;
 			}
-			if (1 == seg_count)
+		});
+	}
+
+	auto get_intersection = [&](unsigned int coord_index) -> SIntersection*
+	{
+		const unsigned int intersection_index = coord_to_intersection[coord_index];
+		return (NO_INTERSECTION == intersection_index) ? nullptr : (SIntersection*)(m_IntersectionData.data() + intersection_offsets[intersection_index]);
+	};
+
+	// Create segments, and add them to intersections in arbitrary order
+	std::vector<std::atomic<unsigned int>> intersection_fill(intersection_offsets.size());
+	for (auto& fill : intersection_fill)
+		fill.store(0, std::memory_order_relaxed);
+	m_Segments.resize(line_count);
+	parallel_for_blocks(line_count, BLOCK_SIZE, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int line_index = begin; line_index < end; ++line_index)
+		{
+			auto& segment = m_Segments[line_index];
+			const unsigned int coord0_index = line_indices ? line_indices[line_index << 1] : (line_index << 1);
+			const unsigned int coord1_index = line_indices ? line_indices[(line_index << 1) + 1] : ((line_index << 1) + 1);
+			const auto& p0 = line_coords[coord0_index];
+			const auto& p1 = line_coords[coord1_index];
+			const auto v = p1 - p0;
+			segment.m_Length = (float)v.getLength();
+			segment.m_Orientation = (float)OrientationAngleFromVector(v);
+			segment.m_Center = (float2)((p0 + p1) * 0.5 - world_origin);
+
+			for (int i = 0; i < 2; ++i)
 			{
-				// Only one instance of this coordinate. Then it is a dead end.
-				coord_to_intersection[start_coord_index] = nullptr;
-				continue;
+				const unsigned int coord_index = i ? coord1_index : coord0_index;
+				segment.m_Intersections[i] = get_intersection(coord_index);
+				if (segment.m_Intersections[i])
+					segment.m_Intersections[i]->m_Segments[intersection_fill[coord_to_intersection[coord_index]]++] = line_index;
 			}
-			// We have multiple identical coordinates, create an intersection.
-			SIntersection* intersection = NewIntersection(seg_count);
-			intersection->m_Pos = (float2)(line_coords[start_coord_index] - world_origin);
-			intersection->m_NumSegments = 0;
-			for (unsigned int ii = start; ii < i; ++ii)
-				coord_to_intersection[order[ii]] = intersection;
+
+			ASSERT(!segment.m_Intersections[0] || (float2)(p0 - world_origin) == segment.m_Intersections[0]->m_Pos);
+			ASSERT(!segment.m_Intersections[1] || (float2)(p1 - world_origin) == segment.m_Intersections[1]->m_Pos);
 		}
-	}
+	});
 
-	// Create segments
-	m_Segments.resize(line_count);
-	for (unsigned int line_index = 0; line_index < line_count; ++line_index)
+	// Sort segments of every intersection by index, to make order deterministic
+	parallel_for_blocks((unsigned int)intersection_offsets.size(), BLOCK_SIZE, [&](unsigned int begin, unsigned int end)
 	{
-		auto& segment = m_Segments[line_index];
-		const unsigned int coord0_index = line_indices ? line_indices[line_index << 1] : (line_index << 1);
-		const unsigned int coord1_index = line_indices ? line_indices[(line_index << 1) + 1] : ((line_index << 1) + 1);
-		const auto& p0 = line_coords[coord0_index];
-		const auto& p1 = line_coords[coord1_index];
-		const auto v = p1 - p0;
-		segment.m_Length = (float)v.getLength();
-		segment.m_Orientation = (float)OrientationAngleFromVector(v);
-		segment.m_Center = (float2)((p0 + p1) * 0.5 - world_origin);
-
-		segment.m_Intersections[0] = coord_to_intersection[coord0_index];
-		if (segment.m_Intersections[0])
-			segment.m_Intersections[0]->m_Segments[segment.m_Intersections[0]->m_NumSegments++] = line_index;
-
-		segment.m_Intersections[1] = coord_to_intersection[coord1_index];
-		if (segment.m_Intersections[1])
-			segment.m_Intersections[1]->m_Segments[segment.m_Intersections[1]->m_NumSegments++] = line_index;
-
-		ASSERT(!segment.m_Intersections[0] || (float2)(p0 - world_origin) == segment.m_Intersections[0]->m_Pos);
-		ASSERT(!segment.m_Intersections[1] || (float2)(p1 - world_origin) == segment.m_Intersections[1]->m_Pos);
-	}
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			SIntersection* intersection = (SIntersection*)(m_IntersectionData.data() + intersection_offsets[i]);
+			ASSERT(intersection_fill[i].load() == intersection->m_NumSegments);
+			std::sort(intersection->m_Segments, intersection->m_Segments + intersection->m_NumSegments);
+		}
+	});
 
 	return true;
 }
-
-CSegmentGraph::SIntersection* CSegmentGraph::NewIntersection(unsigned int num_segments)
-{
-	SIntersection* intersection = (SIntersection*)m_IntersectionAllocator.Alloc(sizeof(SIntersection) + ((int)num_segments - 1) * sizeof(unsigned int));
-	intersection->m_NumSegments = num_segments;
-	memset(intersection->m_Segments, -1, num_segments * sizeof(unsigned int));
-	return intersection;
-}
\ No newline at end of file
@@ -20,90 +20,133 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <algorithm>
+#include <atomic>
 
 #include <pstalgo/Debug.h>
 #include <pstalgo/maths.h>
 #include <pstalgo/graph/SegmentGraph.h>
 #include <pstalgo/graph/SegmentGroupGraph.h>
 #include <pstalgo/utils/BitVector.h>
+#include <pstalgo/utils/Concurrency.h>
 #include <pstalgo/utils/Macros.h>
 
-uint32 GroupSegmentsByAngularThreshold(const CSegmentGraph& graph, float threshold_degrees, bool split_groups_at_junctions, uint32* ret_group_id_per_line)
+namespace
 {
-	if (split_groups_at_junctions)
-	{
-		const uint32 NO_GROUP = (uint32)-1;
+	const uint32 BLOCK_SIZE = 0x4000;
 
-		uint32 group_count = 0;
+	// Lock-free union-find, where the root of every set is its lowest index
+	class CConcurrentUnionFind
+	{
+	public:
+		CConcurrentUnionFind(uint32 size)
+			: m_Parents(size)
+		{
+			psta::parallel_for_blocks(size, BLOCK_SIZE, [&](uint32 begin, uint32 end)
+			{
+				for (uint32 i = begin; i < end; ++i)
+					m_Parents[i].store(i, std::memory_order_relaxed);
+			});
+		}
 
-		// Initially segments have no group
-		for (uint32 i = 0; i < graph.GetSegmentCount(); ++i)
-			ret_group_id_per_line[i] = NO_GROUP;
+		uint32 Find(uint32 index) const
+		{
+			for (uint32 parent; (parent = m_Parents[index].load(std::memory_order_relaxed)) != index; index = parent);
+			return index;
+		}
 
-		for (uint32 segment_index = 0; segment_index < graph.GetSegmentCount(); ++segment_index)
+		void Union(uint32 a, uint32 b)
 		{
-			if (NO_GROUP != ret_group_id_per_line[segment_index])
-				continue;
+			INFINITE_LOOP
+			{
+				a = Find(a);
+				b = Find(b);
+				if (a == b)
+					return;
+				if (a > b)
+					std::swap(a, b);
+				// Link root with higher index to root with lower index, unless it got linked by someone else meanwhile
+				uint32 expected = b;
+				if (m_Parents[b].compare_exchange_weak(expected, a))
+					return;
+			}
+		}
 
-			ret_group_id_per_line[segment_index] = group_count;
+	private:
+		std::vector<std::atomic<uint32>> m_Parents;
+	};
 
-			const auto& start_segment = graph.GetSegment(segment_index);
+	inline float OrientationAtIntersection(const CSegmentGraph::SSegment& segment, const CSegmentGraph::SIntersection* intersection)
+	{
+		return (segment.m_Intersections[0] == intersection) ? segment.m_Orientation : reverseAngle(segment.m_Orientation);
+	}
 
-			for (const auto* intersection : start_segment.m_Intersections)
+	// Calls fn(intersection) once for every intersection of the graph, in parallel
+	template <class TFunc>
+	void ForEachIntersectionParallel(const CSegmentGraph& graph, TFunc&& fn)
+	{
+		psta::parallel_for_blocks(graph.GetSegmentCount(), BLOCK_SIZE, [&](uint32 begin, uint32 end)
+		{
+			for (uint32 segment_index = begin; segment_index < end; ++segment_index)
 			{
-				for (uint32 seg_idx = segment_index; intersection && 2 == intersection->m_NumSegments;)
+				const auto& segment = graph.GetSegment(segment_index);
+				for (int i = 0; i < 2; ++i)
 				{
-					const uint32 next_seg_idx = (intersection->m_Segments[0] == seg_idx) ? intersection->m_Segments[1] : intersection->m_Segments[0];
-					if (next_seg_idx == segment_index)
-						break;  // Loop
-					if (NO_GROUP != ret_group_id_per_line[next_seg_idx])
-						break;
-					const auto& this_seg = graph.GetSegment(seg_idx);
-					const auto& next_seg = graph.GetSegment(next_seg_idx);
-					const auto d = 180.f - angleDiff(
-						(this_seg.m_Intersections[0] == intersection) ? this_seg.m_Orientation : reverseAngle(this_seg.m_Orientation),
-						(next_seg.m_Intersections[0] == intersection) ? next_seg.m_Orientation : reverseAngle(next_seg.m_Orientation));
-					if (d > threshold_degrees)
-						break;
-					ret_group_id_per_line[next_seg_idx] = group_count;
-					seg_idx = next_seg_idx;
-					intersection = (next_seg.m_Intersections[0] == intersection) ? next_seg.m_Intersections[1] : next_seg.m_Intersections[0];
+					const auto* intersection = segment.m_Intersections[i];
+					if (nullptr == intersection || intersection->m_Segments[0] != segment_index)
+						continue;  // Only visit intersection from its first segment
+					if (1 == i && segment.m_Intersections[0] == intersection)
+						continue;  // Both ends at same intersection
+					fn(*intersection);
 				}
 			}
-
-			++group_count;
-		}
-
-		return group_count;
+		});
 	}
+}
 
-	// We initially assign a unique group for each line
-	for (uint32 i = 0; i < graph.GetSegmentCount(); ++i)
-		ret_group_id_per_line[i] = i;
+// Groups are the connected components of the segment pairs that are joined at each
+// intersection. Pairs are found independently per intersection and merged with a
+// concurrent union-find. Group ids are ordered by lowest segment index in group.
+uint32 GroupSegmentsByAngularThreshold(const CSegmentGraph& graph, float threshold_degrees, bool split_groups_at_junctions, uint32* ret_group_id_per_line)
+{
+	const uint32 segment_count = graph.GetSegmentCount();
 
-	struct SSeg
-	{
-		uint32 m_Index;  //  [0..lines at intersection - 1]
-		float  m_Orientation;  // 0 - 360
-	};
-	std::vector<SSeg> tmp;
+	CConcurrentUnionFind groups(segment_count);
 
-	for (uint32 segment_index = 0; segment_index < graph.GetSegmentCount(); ++segment_index)
+	if (split_groups_at_junctions)
 	{
-		const auto& segment = graph.GetSegment(segment_index);
-		for (const auto* intersection : segment.m_Intersections)
+		// Only join segments at intersections of exactly two segments
+		ForEachIntersectionParallel(graph, [&](const CSegmentGraph::SIntersection& intersection)
 		{
-			if (nullptr == intersection || intersection->m_NumSegments < 2)
-				continue;
+			if (2 != intersection.m_NumSegments || intersection.m_Segments[0] == intersection.m_Segments[1])
+				return;
+			const auto d = 180.f - angleDiff(
+				OrientationAtIntersection(graph.GetSegment(intersection.m_Segments[0]), &intersection),
+				OrientationAtIntersection(graph.GetSegment(intersection.m_Segments[1]), &intersection));
+			if (d <= threshold_degrees)
+				groups.Union(intersection.m_Segments[0], intersection.m_Segments[1]);
+		});
+	}
+	else
+	{
+		struct SSeg
+		{
+			uint32 m_Index;  //  [0..lines at intersection - 1]
+			float  m_Orientation;  // 0 - 360
+		};
+
+		ForEachIntersectionParallel(graph, [&](const CSegmentGraph::SIntersection& intersection)
+		{
+			if (intersection.m_NumSegments < 2)
+				return;
 
 			// Create list of (index, angle) pairs for each line at intersection
+			thread_local std::vector<SSeg> tmp;
 			tmp.clear();
-			for (uint32 i = 0; i < intersection->m_NumSegments; ++i)
+			for (uint32 i = 0; i < intersection.m_NumSegments; ++i)
 			{
 				SSeg s;
-				s.m_Index = intersection->m_Segments[i];
-				const auto& seg = graph.GetSegment(s.m_Index);
-				s.m_Orientation = (seg.m_Intersections[0] == intersection) ? seg.m_Orientation : reverseAngle(seg.m_Orientation);
+				s.m_Index = intersection.m_Segments[i];
+				s.m_Orientation = OrientationAtIntersection(graph.GetSegment(s.m_Index), &intersection);
 				tmp.push_back(s);
 			}
 
@@ -132,41 +175,48 @@ uint32 GroupSegmentsByAngularThreshold(const CSegmentGraph& graph, float thresho
 				if (lowest_deviation > threshold_degrees)
 					break;  // No more pairs of lines with deviation lower than threshold at this intersection
 
-				// Find root groups of both lines
-				uint32 g0, g1;
-				for (g0 = tmp[s0].m_Index; ret_group_id_per_line[g0] != g0; g0 = ret_group_id_per_line[g0]);
-				for (g1 = tmp[s1].m_Index; ret_group_id_per_line[g1] != g1; g1 = ret_group_id_per_line[g1]);
-
-				// Make the group with lowest index be the root of the other group
-				const auto g = std::min(g0, g1);
-				ret_group_id_per_line[g0] = g;
-				ret_group_id_per_line[g1] = g;
-
-				// Make both lines point directly to root group to decrease future lookup time for them
-				ret_group_id_per_line[tmp[s0].m_Index] = g;
-				ret_group_id_per_line[tmp[s1].m_Index] = g;
+				groups.Union(tmp[s0].m_Index, tmp[s1].m_Index);
 
 				// Remove these lines from the lines to be processed for this intersection
 				tmp.erase(tmp.begin() + s1);
 				tmp.erase(tmp.begin() + s0);
 			}
-		}
+		});
 	}
 
-	// Lookup root groups
-	for (uint32 i = 0; i < graph.GetSegmentCount(); ++i)
+	// Lookup root groups, and count roots per block
+	const uint32 block_count = (segment_count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	std::vector<uint32> first_group_per_block(block_count + 1, 0);
+	psta::parallel_for_blocks(segment_count, BLOCK_SIZE, [&](uint32 begin, uint32 end)
 	{
-		uint32 g;
-		for (g = i; ret_group_id_per_line[g] != g; g = ret_group_id_per_line[g]);
-		ret_group_id_per_line[i] = g;
-	}
-
-	// Pack group numbers
-	uint32 group_count = 0;
-	for (uint32 i = 0; i < graph.GetSegmentCount(); ++i)
-		ret_group_id_per_line[i] = (ret_group_id_per_line[i] == i) ? group_count++ : ret_group_id_per_line[ret_group_id_per_line[i]];
+		uint32 root_count = 0;
+		for (uint32 i = begin; i < end; ++i)
+		{
+			ret_group_id_per_line[i] = groups.Find(i);
+			if (ret_group_id_per_line[i] == i)
+				++root_count;
+		}
+		first_group_per_block[begin / BLOCK_SIZE + 1] = root_count;
+	});
+	for (uint32 i = 0; i < block_count; ++i)
+		first_group_per_block[i + 1] += first_group_per_block[i];
+
+	// Pack group numbers. Root ids first, since a root can be in an earlier block than its members.
+	std::vector<uint32> group_id_per_root(segment_count);
+	psta::parallel_for_blocks(segment_count, BLOCK_SIZE, [&](uint32 begin, uint32 end)
+	{
+		uint32 group_id = first_group_per_block[begin / BLOCK_SIZE];
+		for (uint32 i = begin; i < end; ++i)
+			if (ret_group_id_per_line[i] == i)
+				group_id_per_root[i] = group_id++;
+	});
+	psta::parallel_for_blocks(segment_count, BLOCK_SIZE, [&](uint32 begin, uint32 end)
+	{
+		for (uint32 i = begin; i < end; ++i)
+			ret_group_id_per_line[i] = group_id_per_root[ret_group_id_per_line[i]];
+	});
 
-	return group_count;
+	return first_group_per_block.back();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,164 @@
+/*
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef PSTA_BENCHMARKS
+
+#include <limits>
+#include <queue>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include <pstalgo/Debug.h>
+#include <pstalgo/test/PrioQueueBenchmark.h>
+#include <pstalgo/utils/Perf.h>
+#include <pstalgo/utils/RadixHeap.h>
+
+namespace
+{
+	struct SEdge
+	{
+		unsigned int m_Target;
+		float        m_Length;
+	};
+
+	// Similar in size to the search states of the analyses
+	struct SState
+	{
+		unsigned int m_Node;
+		unsigned int m_PrevNode;
+		float        m_Dist;
+		float        m_OtherDists[4];
+
+		// Ties are settled in order of node and previous node, with either queue
+		inline bool operator<(const SState& rhs) const { return std::tie(rhs.m_Dist, rhs.m_Node, rhs.m_PrevNode) < std::tie(m_Dist, m_Node, m_PrevNode); }
+
+		struct GetKey { inline float operator()(const SState& s) const { return s.m_Dist; } };
+	};
+
+	class CGridNetwork
+	{
+	public:
+		// Edge lengths are integers 1..length_count if length_count > 0
+		CGridNetwork(unsigned int size, unsigned int length_count)
+			: m_NodeCount(size * size)
+			, m_FirstEdge(m_NodeCount + 1)
+		{
+			std::mt19937 rng(1234);
+			std::uniform_real_distribution<float> real_length_dist(1.0f, 100.0f);
+			std::uniform_int_distribution<unsigned int> int_length_dist(1, length_count ? length_count : 1);
+			auto length_dist = [&](std::mt19937& rng) { return length_count ? (float)int_length_dist(rng) : real_length_dist(rng); };
+			for (unsigned int y = 0; y < size; ++y)
+			{
+				for (unsigned int x = 0; x < size; ++x)
+				{
+					const unsigned int node = y * size + x;
+					m_FirstEdge[node] = (unsigned int)m_Edges.size();
+					if (x > 0)
+						m_Edges.push_back({ node - 1, length_dist(rng) });
+					if (x + 1 < size)
+						m_Edges.push_back({ node + 1, length_dist(rng) });
+					if (y > 0)
+						m_Edges.push_back({ node - size, length_dist(rng) });
+					if (y + 1 < size)
+						m_Edges.push_back({ node + size, length_dist(rng) });
+				}
+			}
+			m_FirstEdge[m_NodeCount] = (unsigned int)m_Edges.size();
+		}
+
+		// Fills 'ret_dists' with shortest distance from 'origin' to every node, and
+		// 'ret_prev_nodes' with the previous node of the path it was settled by,
+		// which depends on the order in which ties are popped
+		template <class TQueue>
+		void ShortestDistances(unsigned int origin, TQueue& queue, std::vector<float>& ret_dists, std::vector<unsigned int>& ret_prev_nodes) const
+		{
+			ret_dists.assign(m_NodeCount, std::numeric_limits<float>::infinity());
+			ret_prev_nodes.assign(m_NodeCount, origin);
+			SState origin_state = {};
+			origin_state.m_Node = origin;
+			origin_state.m_PrevNode = origin;
+			queue.push(origin_state);
+			while (!queue.empty())
+			{
+				const SState s = queue.top();
+				queue.pop();
+				if (s.m_Dist >= ret_dists[s.m_Node])
+					continue;
+				ret_dists[s.m_Node] = s.m_Dist;
+				ret_prev_nodes[s.m_Node] = s.m_PrevNode;
+				for (unsigned int i = m_FirstEdge[s.m_Node]; i < m_FirstEdge[s.m_Node + 1]; ++i)
+				{
+					const SEdge& e = m_Edges[i];
+					SState next = s;
+					next.m_Node = e.m_Target;
+					next.m_PrevNode = s.m_Node;
+					next.m_Dist = s.m_Dist + e.m_Length;
+					next.m_OtherDists[0] += 1;
+					if (next.m_Dist < ret_dists[e.m_Target])
+						queue.push(next);
+				}
+			}
+		}
+
+		unsigned int NodeCount() const { return m_NodeCount; }
+
+	private:
+		const unsigned int m_NodeCount;
+		std::vector<unsigned int> m_FirstEdge;
+		std::vector<SEdge> m_Edges;
+	};
+
+	template <class TQueue>
+	float TimeSearches(const CGridNetwork& network, unsigned int origin_count, std::vector<std::vector<float>>& ret_dists, std::vector<std::vector<unsigned int>>& ret_prev_nodes)
+	{
+		TQueue queue;
+		ret_dists.resize(origin_count);
+		ret_prev_nodes.resize(origin_count);
+		psta::CPerfTimer timer;
+		timer.Start();
+		for (unsigned int i = 0; i < origin_count; ++i)
+			network.ShortestDistances((unsigned int)(((unsigned long long)i * network.NodeCount()) / origin_count), queue, ret_dists[i], ret_prev_nodes[i]);
+		return psta::CPerfTimer::SecondsFromTicks(timer.ReadAndRestart());
+	}
+}
+
+PSTADllExport int PSTAPrioQueueBenchmark(const SPrioQueueBenchmarkDesc* desc, SPrioQueueBenchmarkRes* res)
+{
+	ASSERT(desc && res);
+
+	if (desc->VERSION != desc->m_Version || res->VERSION != res->m_Version)
+		return -1;
+
+	if (0 == desc->m_GridSize)
+		return -1;
+
+	const CGridNetwork network(desc->m_GridSize, desc->m_LengthCount);
+
+	std::vector<std::vector<float>> binary_heap_dists, radix_heap_dists;
+	std::vector<std::vector<unsigned int>> binary_heap_prev_nodes, radix_heap_prev_nodes;
+	res->m_BinaryHeapSeconds = TimeSearches<std::priority_queue<SState>>(network, desc->m_OriginCount, binary_heap_dists, binary_heap_prev_nodes);
+	res->m_RadixHeapSeconds = TimeSearches<psta::radix_heap<SState, SState::GetKey>>(network, desc->m_OriginCount, radix_heap_dists, radix_heap_prev_nodes);
+
+	return (binary_heap_dists == radix_heap_dists && binary_heap_prev_nodes == radix_heap_prev_nodes) ? 1 : 0;
+}
+
+#endif  // PSTA_BENCHMARKS
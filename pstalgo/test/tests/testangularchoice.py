@@ -70,6 +70,26 @@ class TestAngularChoice(unittest.TestCase):
 		self.assertEqual(choice, array.array('f', [36, 90, 108, 90, 36]))
 		pstalgo.FreeSegmentGraph(graph)
 
+	def test_ach_multiple_weights(self):
+		line_count = 5
+		line_length = 3
+		graph = CreateSegmentChainGraph(line_count, line_length)
+		lengths = array.array('f', [0])*line_count
+		pstalgo.GetSegmentGraphLengths(graph, lengths)
+		self.assertEqual(lengths, array.array('f', [line_length]*line_count))
+		# Length weighted and unweighted in one pass
+		choice = array.array('f', [0])*(line_count*2)
+		total_depth_weight = array.array('f', [0])*(line_count*2)
+		pstalgo.AngularChoice(
+			graph_handle = graph,
+			radius = Radii(),
+			weights = [lengths, None],
+			out_choice = choice,
+			out_total_depth_weight = total_depth_weight)
+		self.assertEqual(choice, array.array('f', [36, 90, 108, 90, 36, 0, 6, 8, 6, 0]))
+		self.assertEqual(total_depth_weight, array.array('f', [0]*(line_count*2)))
+		pstalgo.FreeSegmentGraph(graph)
+
 	def test_ach_normalize(self):
 		values = array.array('f', [1, 2, 3, 4, 5])
 		normalized = array.array('f', [0])*5
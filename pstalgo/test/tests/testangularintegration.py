@@ -55,6 +55,65 @@ class TestAngularIntegration(unittest.TestCase):
 		self.doTest(g, count, False, Radii(angular=100), [3]*count, [2]*count, None, None, None, None)
 		pstalgo.FreeSegmentGraph(g)
 
+	def test_aint_multiple_radii(self):
+		count = 5
+		length = 3
+		g = CreateSegmentChainGraph(count, length)
+		radii = [Radii(), Radii(walking=3), Radii(steps=2), Radii(straight=0)]
+		node_counts = array.array('I', [0])*(count*len(radii))
+		total_depths = array.array('f', [0])*(count*len(radii))
+		pstalgo.AngularIntegration(
+			graph_handle = g,
+			radius = radii,
+			out_node_counts = node_counts,
+			out_total_depths = total_depths)
+		self.assertEqual(node_counts, array.array('I', [count]*count + [2, 3, 3, 3, 2] + [3, 4, 5, 4, 3] + [1]*count))
+		self.assertTrue(IsArrayRoughlyEqual(total_depths[:count], [0]*count))
+		pstalgo.FreeSegmentGraph(g)
+
+	def test_aint_pivots(self):
+		count = 4
+		length = 3
+		g = CreateSegmentSquareGraph(length)
+		node_counts = array.array('I', [0])*count
+		total_depths = array.array('f', [0])*count
+		total_depth_lengths = array.array('f', [0])*count
+		variances = array.array('f', [1])*count
+		# Every segment as pivot gives the exact result
+		pivot_count = pstalgo.AngularIntegration(
+			graph_handle = g,
+			radius = Radii(),
+			weigh_by_length = True,
+			pivot_count = count,
+			out_node_counts = node_counts,
+			out_total_depths = total_depths,
+			out_total_depth_weights = total_depth_lengths,
+			out_total_depth_variances = variances)
+		self.assertEqual(pivot_count, count)
+		self.assertEqual(node_counts, array.array('I', [count]*count))
+		self.assertTrue(IsArrayRoughlyEqual(total_depths, [4]*count))
+		self.assertTrue(IsArrayRoughlyEqual(total_depth_lengths, [12]*count))
+		self.assertEqual(variances, array.array('f', [0]*count))
+		# Angular radius is the same in both directions
+		pstalgo.AngularIntegration(
+			graph_handle = g,
+			radius = Radii(angular=100),
+			weigh_by_length = False,
+			pivot_count = count,
+			out_node_counts = node_counts,
+			out_total_depths = total_depths)
+		self.assertEqual(node_counts, array.array('I', [3]*count))
+		self.assertTrue(IsArrayRoughlyEqual(total_depths, [2]*count))
+		# Other radii are not, and are rejected
+		with self.assertRaises(Exception):
+			pstalgo.AngularIntegration(
+				graph_handle = g,
+				radius = Radii(walking=4),
+				weigh_by_length = False,
+				pivot_count = count,
+				out_node_counts = node_counts)
+		pstalgo.FreeSegmentGraph(g)
+
 	def doTest(self, graph, line_count, weigh_by_length, radius, N, TD, TDW, aint_norm, aint_syntax_norm, aint_hillier_norm):
 		node_counts = array.array('I', [0])*line_count
 		total_depths = array.array('f', [0])*line_count
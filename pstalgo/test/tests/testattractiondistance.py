@@ -21,7 +21,7 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 
 import array, math, unittest
 import pstalgo
-from pstalgo import DistanceType, Radii, OriginType
+from pstalgo import DistanceType, Radii, OriginType, PolygonPointMode
 from .common import *
 from .graphs import *
 
@@ -59,6 +59,50 @@ class TestAttractionDistance(unittest.TestCase):
 		points_per_polygon     = array.array('I', [4])
 		polygon_point_interval = 0.5
 		self.doTest(g, OriginType.POINTS, DistanceType.WALKING, Radii(), attraction_points, [2.6, 5.6, 8.6], points_per_polygon, polygon_point_interval)
+		self.doTest(g, OriginType.POINTS, DistanceType.WALKING, Radii(), attraction_points, [2.6, 5.6, 8.6], points_per_polygon, polygon_point_mode=PolygonPointMode.ENTRY_POINTS)
+		pstalgo.FreeGraph(g)
+
+	def test_adi_polygon_entry_points(self):
+		line_coords  = array.array('d', [0, 0, 3, 0])
+		line_indices = array.array('I', [0, 1])
+		points       = array.array('d', [2.5, 1])
+		g = pstalgo.CreateGraph(line_coords, line_indices, None, points, None)
+		# Bottom edge runs parallel to the line and past both its ends, the entry point is right above the point
+		attraction_points  = array.array('d', [-1, 0.5, 4, 0.5, 4, 2, -1, 2])
+		points_per_polygon = array.array('I', [4])
+		self.doTest(g, OriginType.POINTS, DistanceType.WALKING, Radii(), attraction_points, [1.5], points_per_polygon, polygon_point_mode=PolygonPointMode.ENTRY_POINTS)
+		pstalgo.FreeGraph(g)
+
+	def test_adi_polygon_entry_points_along_line(self):
+		line_coords  = array.array('d', [0, 0, 100, 0])
+		line_indices = array.array('I', [0, 1])
+		points       = array.array('d', [40, -1])
+		g = pstalgo.CreateGraph(line_coords, line_indices, None, points, None)
+		# Closest approach to the line is at (0, 1), but walking along the edge
+		# towards the point is cheaper than walking along the line
+		attraction_points  = array.array('d', [0, 1, 50, 6, 0, 20])
+		points_per_polygon = array.array('I', [3])
+		self.doTest(g, OriginType.POINTS, DistanceType.WALKING, Radii(), attraction_points, [6], points_per_polygon, polygon_point_mode=PolygonPointMode.ENTRY_POINTS)
+		pstalgo.FreeGraph(g)
+
+	def test_adi_polygon_entry_points_vs_interval(self):
+		line_coords = array.array('d', [0, 0, 100, 0,  30, -20, 30, 40,  70, -20, 70, 40,  10, 50, 90, 10])
+		points      = array.array('d', [5, -3, 50, 2, 95, 8, 35, 30, 80, 35])
+		g = pstalgo.CreateGraph(line_coords, None, None, points, None)
+		# Skewed polygons, one crossed by lines and one in between them
+		attraction_points  = array.array('d', [12, 9, 61, 4, 87, 27, 41, 46,  38, 7, 55, 13, 47, 24])
+		points_per_polygon = array.array('I', [4, 3])
+		interval = 0.01
+		for origin_type in (OriginType.POINTS, OriginType.LINES, OriginType.JUNCTIONS):
+			for polygon in range(2):
+				polygon_points = attraction_points[:8] if 0 == polygon else attraction_points[8:]
+				polygon_counts = array.array('I', [points_per_polygon[polygon]])
+				sampled = self.minDists(g, origin_type, polygon_points, polygon_counts, polygon_point_interval=interval)
+				exact   = self.minDists(g, origin_type, polygon_points, polygon_counts, polygon_point_mode=PolygonPointMode.ENTRY_POINTS)
+				for s, e in zip(sampled, exact):
+					# Sampling can only miss the minimum, by at most the sample spacing
+					self.assertLessEqual(e, s + 0.005)
+					self.assertGreaterEqual(e, s - 2 * interval)
 		pstalgo.FreeGraph(g)
 
 	def test_adi_wave(self):
@@ -81,20 +125,56 @@ class TestAttractionDistance(unittest.TestCase):
 		self.doTest(g, OriginType.POINTS,    DistanceType.ANGULAR, Radii(steps=4,angular=121,walking=6.9), attraction_points, [-1])
 		pstalgo.FreeGraph(g)
 
-	def doTest(self, graph, origin_type, distance_type, radius, attraction_points, min_dists_check, points_per_polygon=None, polygon_point_interval=0, line_weights=None, weight_per_meter_for_point_edges=0):
-		min_dists = array.array('f', [0])*len(min_dists_check)
+	def test_adi_walking_hierarchy(self):
+		g = CreateTestGraph(5, 3)
+		pstalgo.CreateGraphWalkingHierarchy(g)
+		attraction_points = array.array('d', [-1, 0, 16, 0])
+		self.doTest(g, OriginType.POINTS,    DistanceType.WALKING, Radii(), attraction_points, [3.5, 6.5, 9.5, 6.5, 3.5])
+		self.doTest(g, OriginType.LINES,     DistanceType.WALKING, Radii(), attraction_points, [2.5, 5.5, 8.5, 5.5, 2.5])
+		self.doTest(g, OriginType.JUNCTIONS, DistanceType.WALKING, Radii(), attraction_points, [4, 7, 7, 4])
+		self.doTest(g, OriginType.POINTS,    DistanceType.WALKING, Radii(walking=4), attraction_points, [3.5, -1, -1, -1, 3.5])
+		pstalgo.FreeGraph(g)
+		g = CreateWaveGraph()
+		pstalgo.CreateGraphWalkingHierarchy(g)
+		attraction_points = array.array('d', [-1, 0])
+		self.doTest(g, OriginType.POINTS,    DistanceType.WALKING, Radii(), attraction_points, [7])
+		self.doTest(g, OriginType.LINES,     DistanceType.WALKING, Radii(), attraction_points, [1.5, 2.5, 3.5, 4.5, 5.5])
+		pstalgo.FreeGraph(g)
+
+	def doTest(self, graph, origin_type, distance_type, radius, attraction_points, min_dists_check, points_per_polygon=None, polygon_point_interval=0, polygon_point_mode=PolygonPointMode.INTERVAL, line_weights=None, weight_per_meter_for_point_edges=0):
+		# Both search queues give the same distances
+		for use_radix_heap in (False, True):
+			min_dists = array.array('f', [0])*len(min_dists_check)
+			pstalgo.AttractionDistance(
+				graph_handle = graph,
+				origin_type = origin_type,
+				distance_type = distance_type,
+				radius = radius,
+				attraction_points = attraction_points,
+				out_min_distances = min_dists,
+				points_per_polygon = points_per_polygon,
+				polygon_point_interval = polygon_point_interval,
+				polygon_point_mode = polygon_point_mode,
+				line_weights = line_weights,
+				weight_per_meter_for_point_edges = weight_per_meter_for_point_edges,
+				use_radix_heap = use_radix_heap)
+			self.assertTrue(IsArrayRoughlyEqual(min_dists, min_dists_check), str(min_dists) + " != " + str(min_dists_check))
+
+	def minDists(self, graph, origin_type, attraction_points, points_per_polygon, polygon_point_interval=0, polygon_point_mode=PolygonPointMode.INTERVAL):
+		info = pstalgo.GetGraphInfo(graph)
+		count = {OriginType.POINTS: info.m_PointCount, OriginType.LINES: info.m_LineCount, OriginType.JUNCTIONS: info.m_CrossingCount}[origin_type]
+		min_dists = array.array('f', [0])*count
 		pstalgo.AttractionDistance(
 			graph_handle = graph,
 			origin_type = origin_type,
-			distance_type = distance_type,
-			radius = radius,
+			distance_type = DistanceType.WALKING,
+			radius = Radii(),
 			attraction_points = attraction_points,
 			out_min_distances = min_dists,
 			points_per_polygon = points_per_polygon,
 			polygon_point_interval = polygon_point_interval,
-			line_weights = line_weights,
-			weight_per_meter_for_point_edges = weight_per_meter_for_point_edges)
-		self.assertTrue(IsArrayRoughlyEqual(min_dists, min_dists_check), str(min_dists) + " != " + str(min_dists_check))
+			polygon_point_mode = polygon_point_mode)
+		return min_dists
 
 def CreateTestGraph(line_count, line_length):
 	line_coords = []	
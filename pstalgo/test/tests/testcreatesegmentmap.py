@@ -34,4 +34,16 @@ class TestCreateSegmentMap(unittest.TestCase):
             2,
         ])
         (res, algo) = pstalgo.CreateSegmentMap(pstalgo.common.RoadNetworkType.AXIAL_OR_SEGMENT, coords, polys)  # , tail=50, progress_callback=self._pstalgo.CreateAnalysisDelegateCallbackWrapper(delegate))
-        pstalgo.Free(algo)
\ No newline at end of file
+        pstalgo.Free(algo)
+
+    def test_createsegmentmap_extrude(self):
+        # Grid of crossing lines, with dangling ends that get extruded to cut
+        coords = array.array('d')
+        polys = array.array('i')
+        for i in range(10):
+            coords.extend([i * 10 + 3, -0.5, i * 10 + 3, 100.5])
+            coords.extend([3.5, i * 10 + 7, 92.5, i * 10 + 7])
+            polys.extend([2, 2])
+        (res, algo) = pstalgo.CreateSegmentMap(pstalgo.common.RoadNetworkType.AXIAL_OR_SEGMENT, coords, polys, extrude=1)
+        self.assertEqual(res.m_SegmentCount, 2 * 10 * 9)
+        pstalgo.Free(algo)
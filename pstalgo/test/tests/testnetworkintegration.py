@@ -59,6 +59,54 @@ class TestNetowrkIntegration(unittest.TestCase):
 		self.runTests(graph, tests, line_count)
 		pstalgo.FreeGraph(graph)
 
+	def test_NInt_pivots(self):
+		line_count = 5
+		line_length = 3
+		graph = CreateChainGraph(line_count, line_length)
+		node_count = array.array('I', [0])*line_count
+		total_depth = array.array('f', [0])*line_count
+		variance = array.array('f', [1])*line_count
+		# Every line as pivot gives the exact result
+		pivot_count = pstalgo.NetworkIntegration(
+			graph_handle = graph,
+			radius = Radii(),
+			pivot_count = line_count,
+			out_line_node_count = node_count,
+			out_line_total_depth = total_depth,
+			out_line_total_depth_variance = variance)
+		self.assertEqual(pivot_count, line_count)
+		self.assertEqual(node_count, array.array('I', [line_count]*line_count))
+		self.assertEqual(total_depth, array.array('f', [10, 7, 6, 7, 10]))
+		self.assertEqual(variance, array.array('f', [0]*line_count))
+		# Fewer pivots are scaled up to all lines
+		pivot_count = pstalgo.NetworkIntegration(
+			graph_handle = graph,
+			radius = Radii(),
+			pivot_count = 3,
+			out_line_node_count = node_count,
+			out_line_total_depth = total_depth,
+			out_line_total_depth_variance = variance)
+		self.assertEqual(pivot_count, 3)
+		self.assertTrue(all(v > 0 for v in variance))
+		# Angular radius is the same in both directions
+		pivot_count = pstalgo.NetworkIntegration(
+			graph_handle = graph,
+			radius = Radii(angular=1),
+			pivot_count = line_count,
+			out_line_node_count = node_count,
+			out_line_total_depth = total_depth)
+		self.assertEqual(node_count, array.array('I', [line_count]*line_count))
+		self.assertEqual(total_depth, array.array('f', [10, 7, 6, 7, 10]))
+		# Other radii are not, and are rejected
+		for radius in [Radii(walking=3), Radii(steps=1), Radii(straight=line_length)]:
+			with self.assertRaises(Exception):
+				pstalgo.NetworkIntegration(
+					graph_handle = graph,
+					radius = radius,
+					pivot_count = line_count,
+					out_line_node_count = node_count)
+		pstalgo.FreeGraph(graph)
+
 	def runTests(self, graph, test_tuples, line_count):
 		integration = array.array('f', [0])*line_count
 		node_count = array.array('I', [0])*line_count
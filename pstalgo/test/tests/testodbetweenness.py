@@ -41,6 +41,28 @@ class TestODBetweenness(unittest.TestCase):
 			scores_check = [1, 1, 0])
 		pstalgo.FreeGraph(g)
 
+	def test_odb_closest_radius(self):
+		g = CreateTestGraph()
+		self.doTest(
+			graph_handle = g, 
+			origin_points = array.array('d', [-0.5, 0]), 
+			origin_weights = None,
+			destination_weights = None,
+			destination_mode = ODBDestinationMode.CLOSEST_DESTINATION_ONLY, 
+			distance_type = DistanceType.WALKING, 
+			radius=Radii(walking=2.4), 
+			scores_check = [0, 0, 0])
+		self.doTest(
+			graph_handle = g, 
+			origin_points = array.array('d', [-0.5, 0]), 
+			origin_weights = None,
+			destination_weights = array.array('f', [0, 1]),
+			destination_mode = ODBDestinationMode.CLOSEST_DESTINATION_ONLY, 
+			distance_type = DistanceType.WALKING, 
+			radius=Radii(walking=4.1), 
+			scores_check = [1, 1, 1])
+		pstalgo.FreeGraph(g)
+
 	def test_odb_all(self):
 		g = CreateTestGraph()
 		self.doTest(
@@ -102,19 +124,46 @@ class TestODBetweenness(unittest.TestCase):
 			scores_check = [10, 10, 2])
 		pstalgo.FreeGraph(g)
 
+	def test_odb_radix_heap_ties(self):
+		# A regular grid has lots of equally short paths, which both search
+		# queues have to settle in the same order to give the same scores
+		g = CreateGridGraph(8)
+		origin_points = array.array('d', [5, 0, 20, 35, 40, 40, 0, 75, 65, 10])
+		for distance_type, radius in ((DistanceType.WALKING, Radii()), (DistanceType.WALKING, Radii(walking=60, steps=6)), (DistanceType.ANGULAR, Radii()), (DistanceType.ANGULAR, Radii(walking=60))):
+			for destination_mode in (ODBDestinationMode.ALL_REACHABLE_DESTINATIONS, ODBDestinationMode.CLOSEST_DESTINATION_ONLY):
+				results = []
+				for use_radix_heap in (False, True):
+					scores = array.array('f', [0])*18
+					ODBetweenness(
+						graph_handle = g, 
+						origin_points = origin_points, 
+						origin_weights = None,
+						destination_mode = destination_mode, 
+						distance_type = distance_type, 
+						radius = radius, 
+						out_scores = scores,
+						use_radix_heap = use_radix_heap)
+					results.append(scores)
+				self.assertEqual(results[0], results[1])
+				self.assertGreater(sum(results[0]), 0)
+		pstalgo.FreeGraph(g)
+
 	def doTest(self, graph_handle, origin_points, origin_weights, destination_weights, destination_mode, distance_type, radius, scores_check):
-		scores = array.array('f', [0])*len(scores_check)
-		ODBetweenness(
-			graph_handle = graph_handle, 
-			origin_points = origin_points, 
-			origin_weights = origin_weights,
-			destination_weights = destination_weights,
-			destination_mode = destination_mode, 
-			distance_type = distance_type, 
-			radius = radius, 
-			progress_callback = None, 
-			out_scores = scores)
-		self.assertTrue(IsArrayRoughlyEqual(scores, scores_check), str(scores) + " != " + str(scores_check))
+		# Both search queues give the same scores
+		for use_radix_heap in (False, True):
+			scores = array.array('f', [0])*len(scores_check)
+			ODBetweenness(
+				graph_handle = graph_handle, 
+				origin_points = origin_points, 
+				origin_weights = origin_weights,
+				destination_weights = destination_weights,
+				destination_mode = destination_mode, 
+				distance_type = distance_type, 
+				radius = radius, 
+				progress_callback = None, 
+				out_scores = scores,
+				use_radix_heap = use_radix_heap)
+			self.assertTrue(IsArrayRoughlyEqual(scores, scores_check), str(scores) + " != " + str(scores_check))
 
 def CreateTestGraph():
 	line_count = 3
@@ -134,4 +183,19 @@ def CreateTestGraph():
 		line_coords = line_coords,
 		line_indices = line_indices,
 		points = points)
-	return graph_handle
\ No newline at end of file
+	return graph_handle
+
+def CreateGridGraph(size):
+	# (size+1) horizontal and vertical lines, 10 apart, with destinations at
+	# every other line crossing
+	line_coords = []
+	for i in range(size+1):
+		line_coords += [0, i*10, size*10, i*10]
+		line_coords += [i*10, 0, i*10, size*10]
+	points = []
+	for y in range(0, size+1, 2):
+		for x in range(0, size+1, 2):
+			points += [x*10, y*10]
+	return pstalgo.CreateGraph(
+		line_coords = array.array('d', line_coords),
+		points = array.array('d', points))
\ No newline at end of file
@@ -0,0 +1,36 @@
+"""
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+"""
+
+import unittest
+import pstalgo
+
+@unittest.skipUnless(pstalgo.PrioQueueBenchmarkAvailable(), "library built without PSTA_BENCHMARKS")
+class TestPrioQueueBenchmark(unittest.TestCase):
+
+    def test_radix_heap(self):
+        (identical, binary_heap_seconds, radix_heap_seconds) = pstalgo.PrioQueueBenchmark(grid_size=100, origin_count=50)
+        self.assertTrue(identical)
+
+    def test_radix_heap_ties(self):
+        # Unit and few distinct edge lengths give lots of equal keys
+        for length_count in (1, 3):
+            (identical, binary_heap_seconds, radix_heap_seconds) = pstalgo.PrioQueueBenchmark(grid_size=60, origin_count=20, length_count=length_count)
+            self.assertTrue(identical)
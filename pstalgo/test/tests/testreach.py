@@ -67,15 +67,69 @@ class TestReach(unittest.TestCase):
 
 		pstalgo.FreeGraph(graph)
 
-	def runTests(self, graph, test_tuples, line_count):
-		reached_count = array.array('I', [0])*line_count
-		reached_length = array.array('f', [0])*line_count
-		reached_area = array.array('f', [0])*line_count
+	def test_reach_from_points(self):
+		graph = CreateChainGraph(3, 3)
+
+		# First point is on first line, second is 2 away from the middle line.
+		# Line mid points are reached by walking distance.
+		points = array.array('d', [1, 0, 5, 2])
+
+		tests = [
+			(Radii(walking=1), [1, 0], [3, 0], [0, 0]),
+			(Radii(walking=3), [1, 1], [3, 3], [0, 3]),
+			(Radii(walking=5), [2, 2], [6, 6], [0, 6]),
+			(Radii(walking=7), [3, 3], [9, 9], [0, 9]),
+			(Radii(steps=0), [1, 1], [3, 3], [0, 3]),
+		]
+
+		self.runTests(graph, tests, 2, points)
+
+		pstalgo.FreeGraph(graph)
+
+	def test_reach_multiple_radii(self):
+		line_count = 3
+		line_length = 3
+		graph = CreateChainGraph(line_count, line_length)
+
+		# Each set of radii should give the same result as one radius at a time
+		radius_sets = [
+			[Radii(walking=1), Radii(walking=3), Radii()],
+			[Radii(steps=0), Radii(steps=1), Radii(steps=2)],
+			[Radii(straight=1), Radii(walking=3), Radii(angular=1)],
+		]
+
+		for radii in radius_sets:
+			text = "radii=%s"%str([r.toString() for r in radii])
+			reached_count = array.array('I', [0])*(line_count*len(radii))
+			reached_length = array.array('f', [0])*(line_count*len(radii))
+			pstalgo.Reach(
+				graph_handle = graph,
+				radius = radii,
+				out_reached_count = reached_count,
+				out_reached_length = reached_length)
+			single_count = array.array('I', [0])*line_count
+			single_length = array.array('f', [0])*line_count
+			for i, radius in enumerate(radii):
+				pstalgo.Reach(
+					graph_handle = graph,
+					radius = radius,
+					out_reached_count = single_count,
+					out_reached_length = single_length)
+				self.assertEqual(reached_count[i*line_count:(i+1)*line_count], single_count, text)
+				self.assertEqual(reached_length[i*line_count:(i+1)*line_count], single_length, text)
+
+		pstalgo.FreeGraph(graph)
+
+	def runTests(self, graph, test_tuples, origin_count, origin_points=None):
+		reached_count = array.array('I', [0])*origin_count
+		reached_length = array.array('f', [0])*origin_count
+		reached_area = array.array('f', [0])*origin_count
 		for t in test_tuples:
 			text = "limits=%s"%str(t[0].toString())
 			pstalgo.Reach(
 				graph_handle = graph,
 				radius = t[0],
+				origin_points = origin_points,
 				out_reached_count = reached_count if t[1] is not None else None,
 				out_reached_length = reached_length if t[2] is not None else None,
 				out_reached_area = reached_area if t[3] is not None else None)
@@ -20,9 +20,11 @@ along with PST. If not, see <http://www.gnu.org/licenses/>.
 """
 
 import array
+import random
 import unittest
 import pstalgo
 from pstalgo import DistanceType
+from .common import *
 
 class TestSegmentBetweenness(unittest.TestCase):
 
@@ -59,6 +61,96 @@ class TestSegmentBetweenness(unittest.TestCase):
 		pstalgo.FreeGraph(graph)
 		self.assertEqual(betweenness, array.array('f', [0, 1, 1, 2, 2, 0]))
 
+	def test_approximate(self):
+		graph = self.create_chain_graph(400)
+		exact = array.array('f', [0])*400
+		pstalgo.SegmentBetweenness(
+			graph_handle = graph,
+			distance_type = DistanceType.STEPS, 
+			radius = pstalgo.Radii(),
+			out_betweenness = exact)
+		# Sampling every origin gives the exact result
+		betweenness = array.array('f', [0])*400
+		error = array.array('f', [1])*400
+		sample_count = pstalgo.SegmentBetweenness(
+			graph_handle = graph,
+			distance_type = DistanceType.STEPS, 
+			radius = pstalgo.Radii(),
+			approximate = True,
+			target_error = 0,
+			out_betweenness = betweenness,
+			out_betweenness_error = error)
+		self.assertEqual(sample_count, 400)
+		self.assertEqual(betweenness, exact)
+		self.assertEqual(error, array.array('f', [0])*400)
+		# Stops sampling once within target error, and is repeatable for the same seed
+		results = []
+		for i in range(2):
+			betweenness = array.array('f', [0])*400
+			error = array.array('f', [0])*400
+			sample_count = pstalgo.SegmentBetweenness(
+				graph_handle = graph,
+				distance_type = DistanceType.STEPS, 
+				radius = pstalgo.Radii(),
+				approximate = True,
+				target_error = 0.1,
+				seed = 7,
+				out_betweenness = betweenness,
+				out_betweenness_error = error)
+			self.assertLess(sample_count, 400)
+			self.assertLessEqual(max(error), 0.1 * max(betweenness))
+			results.append((sample_count, betweenness))
+		self.assertEqual(results[0], results[1])
+		pstalgo.FreeGraph(graph)
+
+	def test_steps_same_as_heap(self):
+		# Steps with no other radius is a breadth first search on segment maps,
+		# and a huge walking radius forces the binary heap for comparison.
+		# Axial maps, with crossings in the middle of lines, always use the heap.
+		for graph, line_count in (self.create_random_axial_graph(70), self.create_grid_segment_graph(12)):
+			for radius in ({}, {'steps': 3}, {'straight': 400}):
+				results = []
+				for walking in (None, 1e9):
+					betweenness = array.array('f', [0])*line_count
+					node_counts = array.array('I', [0])*line_count
+					total_depths = array.array('f', [0])*line_count
+					pstalgo.SegmentBetweenness(
+						graph_handle = graph,
+						distance_type = DistanceType.STEPS, 
+						radius = pstalgo.Radii(walking=walking, **radius),
+						out_betweenness = betweenness,
+						out_node_count = node_counts,
+						out_total_depth = total_depths)
+					results.append((betweenness, node_counts, total_depths))
+				self.assertTrue(IsArrayRoughlyEqual(results[0][0], results[1][0]))
+				self.assertEqual(results[0][1], results[1][1])
+				self.assertEqual(results[0][2], results[1][2])
+			pstalgo.FreeGraph(graph)
+
+	def test_radix_heap_same_as_binary_heap(self):
+		# Both heaps settle equally short paths in the same order, which decides
+		# the radius tests of the other distance types. A regular grid has lots
+		# of them.
+		for graph, line_count in (self.create_random_axial_graph(70), self.create_grid_segment_graph(8, jitter=0)):
+			for distance_type in (DistanceType.WALKING, DistanceType.STEPS, DistanceType.ANGULAR, DistanceType.AXMETER):
+				for radius in ({}, {'walking': 600, 'angular': 300}, {'steps': 4, 'angular': 200}, {'straight': 400, 'axmeter': 3000}):
+					results = []
+					for use_radix_heap in (False, True):
+						betweenness = array.array('f', [0])*line_count
+						node_counts = array.array('I', [0])*line_count
+						total_depths = array.array('f', [0])*line_count
+						pstalgo.SegmentBetweenness(
+							graph_handle = graph,
+							distance_type = distance_type, 
+							radius = pstalgo.Radii(**radius),
+							out_betweenness = betweenness,
+							out_node_count = node_counts,
+							out_total_depth = total_depths,
+							use_radix_heap = use_radix_heap)
+						results.append((betweenness, node_counts, total_depths))
+					self.assertEqual(results[0], results[1])
+			pstalgo.FreeGraph(graph)
+
 	def create_chain_graph(self, line_count):
 		# --...--
 		line_coords = []	
@@ -91,4 +183,35 @@ class TestSegmentBetweenness(unittest.TestCase):
 		line_indices = array.array('I', [0, 1, 1, 2, 2, 4, 1, 3, 3, 4, 4, 5])
 		graph_handle = pstalgo.CreateGraph(line_coords, line_indices, None, None, None)
 		self.assertIsNotNone(graph_handle)
-		return graph_handle
\ No newline at end of file
+		return graph_handle
+
+	def create_random_axial_graph(self, line_count):
+		rnd = random.Random(1)
+		line_coords = []
+		for i in range(line_count*2):
+			line_coords.append(rnd.uniform(0, 1000))
+			line_coords.append(rnd.uniform(0, 1000))
+		line_indices = array.array('I', range(line_count*2))
+		graph_handle = pstalgo.CreateGraph(array.array('d', line_coords), line_indices, None, None, None)
+		self.assertIsNotNone(graph_handle)
+		return (graph_handle, line_count)
+
+	def create_grid_segment_graph(self, size, jitter=20):
+		# Jittered grid of (size+1)*(size+1) points, with segments between neighbours
+		rnd = random.Random(1)
+		line_coords = []
+		for y in range(size+1):
+			for x in range(size+1):
+				line_coords.append(x*100 + rnd.uniform(-jitter, jitter))
+				line_coords.append(y*100 + rnd.uniform(-jitter, jitter))
+		line_indices = []
+		for y in range(size+1):
+			for x in range(size+1):
+				i = y*(size+1) + x
+				if x < size:
+					line_indices += [i, i+1]
+				if y < size:
+					line_indices += [i, i+size+1]
+		graph_handle = pstalgo.CreateGraph(array.array('d', line_coords), array.array('I', line_indices), None, None, None)
+		self.assertIsNotNone(graph_handle)
+		return (graph_handle, len(line_indices)//2)
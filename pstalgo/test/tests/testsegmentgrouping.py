@@ -50,10 +50,35 @@ class TestSegmentGrouping(unittest.TestCase):
 		count = 12
 		g = CreateCrosshairSegmentGraph()
 		self.doTest(g, count, 89, False, [0,0,1,1,2,2,3,3,4,4,5,5],   [0,0,1,1,0,0,1,1,0,0,1,1])
-		self.doTest(g, count, 89, True,  [0,1,2,3,4,5,6,7,8,9,10,11], [0,1,2,1,0,1,0,2,0,1,2,3])
+		self.doTest(g, count, 89, True,  [0,1,2,3,4,5,6,7,8,9,10,11], [0,1,2,0,2,1,0,2,3,1,2,0])
 		self.doTest(g, count, 90, False, [0,0,0,0,0,0,0,0,1,1,2,2],   [0,0,0,0,0,0,0,0,1,1,2,2])
 		pstalgo.FreeSegmentGraph(g)
 
+	def test_sgrp_zigzag(self):
+		# Every segment is a group of its own, and the groups form one long chain.
+		# Neighbouring groups must get different colours, and a chain needs no
+		# more than three.
+		count = 20000
+		line_coords = array.array('d')
+		for i in range(count + 1):
+			line_coords.extend([i, i % 2])
+		line_indices = array.array('I')
+		for i in range(count):
+			line_indices.extend([i, i + 1])
+		g = pstalgo.CreateSegmentGraph(line_coords, line_indices, None)
+		group_arr = array.array('I', [0])*count
+		color_arr = array.array('I', [0])*count
+		pstalgo.SegmentGrouping(
+			segment_graph = g,
+			angle_threshold = 1,
+			split_at_junctions = False,
+			out_group_id_per_line = group_arr,
+			out_color_per_line = color_arr)
+		self.assertEqual(group_arr, array.array('I', range(count)))
+		self.assertLessEqual(max(color_arr), 2)
+		self.assertTrue(all(color_arr[i] != color_arr[i + 1] for i in range(count - 1)))
+		pstalgo.FreeSegmentGraph(g)
+
 	def test_sgrp_90plus(self):
 		line_coords = array.array('d', [0, 0, -1, 0, -1, 0.01])
 		line_indices = array.array('I', [0, 1, 2, 0])
@@ -0,0 +1,60 @@
+"""
+Copyright 2019 Meta Berghauser Pont
+
+This file is part of PST.
+
+PST is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+PST is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with PST. If not, see <http://www.gnu.org/licenses/>.
+"""
+
+import unittest
+import pstalgo
+from pstalgo import DistanceType
+from .graphs import *
+
+class TestShortestPath(unittest.TestCase):
+
+	def test_chain(self):
+		g = CreateChainGraph(3, 1)
+		(res, algo) = pstalgo.ShortestPath(g, (0.5, 0.1), (2.5, -0.1), DistanceType.STEPS)
+		self.assertEqual(res.m_Lines[:res.m_LineCount], [0, 1, 2])
+		self.assertEqual(res.m_PointCount, 6)
+		self.assertEqual(res.m_PointCoords[4:8], [1, 0, 2, 0])
+		self.assertEqual(res.m_StepDistances[:res.m_PointCount], [0, 0, 1, 2, 2, 2])
+		self.assertAlmostEqual(res.m_WalkingDistances[res.m_PointCount - 1], 2.2, 5)
+		self.assertEqual(res.m_AngularDistances[res.m_PointCount - 1], 0)
+		pstalgo.Free(algo)
+		pstalgo.FreeGraph(g)
+
+	def test_square(self):
+		g = CreateSquareGraph(1)
+		for distance_type in (DistanceType.WALKING, DistanceType.STEPS, DistanceType.ANGULAR):
+			(res, algo) = pstalgo.ShortestPath(g, (0.5, -0.1), (0.5, 1.1), distance_type)
+			self.assertEqual(res.m_LineCount, 3)
+			self.assertEqual(res.m_Lines[0], 0)
+			self.assertEqual(res.m_Lines[2], 2)
+			self.assertAlmostEqual(res.m_WalkingDistances[res.m_PointCount - 1], 2.2, 5)
+			self.assertAlmostEqual(res.m_AngularDistances[res.m_PointCount - 1], 180, 3)
+			self.assertEqual(res.m_StepDistances[res.m_PointCount - 1], 2)
+			pstalgo.Free(algo)
+		# Shortcut along same line
+		(res, algo) = pstalgo.ShortestPath(g, (0.2, 0.1), (0.8, 0.1), DistanceType.ANGULAR)
+		self.assertEqual(res.m_Lines[:res.m_LineCount], [0])
+		self.assertAlmostEqual(res.m_WalkingDistances[res.m_PointCount - 1], 0.8, 5)
+		pstalgo.Free(algo)
+		pstalgo.FreeGraph(g)
+
+if __name__ == '__main__':
+	unittest.main()
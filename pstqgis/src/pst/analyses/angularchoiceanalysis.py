@@ -50,13 +50,13 @@ class AngularChoiceAnalysis(BaseAnalysis):
 		def GenerateStatColumnName(stat, radii):
 			return GenColName(ColName.ANGULAR_CHOICE, radii = radii, extra = stat)
 
-		# Number of analyses
-		analysis_count = 0
-		if props['weight_none']:
-			analysis_count += 1
+		# Weightings, all calculated in one pass (True if weighted by length)
+		weightings = []
 		if props['weight_length']:
-			analysis_count += 1
-		assert(analysis_count > 0)
+			weightings.append(True)
+		if props['weight_none']:
+			weightings.append(False)
+		assert(len(weightings) > 0)
 
 		# Tasks
 		class Tasks(object):
@@ -65,7 +65,8 @@ class AngularChoiceAnalysis(BaseAnalysis):
 			WRITE_RESULTS = 3
 		progress = MultiTaskProgressDelegate(delegate)
 		progress.addTask(Tasks.BUILD_GRAPH, 1, None)
-		progress.addTask(Tasks.ANALYSIS, 5*analysis_count, None)
+		progress.addTask(Tasks.ANALYSIS, 3, "Performing analysis")
+		progress.addTask(Tasks.WRITE_RESULTS, len(weightings), None)
 
 		radii = RadiiFromSettings(pstalgo, self._props)
 
@@ -79,104 +80,64 @@ class AngularChoiceAnalysis(BaseAnalysis):
 			(graph, line_rows) = BuildSegmentGraph(self._model, pstalgo, stack_allocator, self._props['in_network'], progress)
 			line_count = line_rows.size()
 
-			# Allocate output arrays
+			# Allocate output arrays. Choice and total depth weight are
+			# calculated for every weighting, in one block per weighting.
+			weight_count = len(weightings)
+			all_scores     = Vector(ctypes.c_float, line_count*weight_count, stack_allocator, line_count*weight_count)
 			scores         = Vector(ctypes.c_float, line_count, stack_allocator, line_count)
 			scores_norm    = Vector(ctypes.c_float, line_count, stack_allocator, line_count) if props['norm_normalization'] else None
 			scores_std     = Vector(ctypes.c_float, line_count, stack_allocator, line_count) if props['norm_standard'] else None
 			scores_syntax  = Vector(ctypes.c_float, line_count, stack_allocator, line_count) if props['norm_syntax'] else None
 			total_counts   = Vector(ctypes.c_uint,  line_count, stack_allocator, line_count)
 			total_depths   = Vector(ctypes.c_float, line_count, stack_allocator, line_count)
-			total_depth_weights = Vector(ctypes.c_float, line_count, stack_allocator, line_count) if props['weight_length'] else None
+			all_total_depth_weights = Vector(ctypes.c_float, line_count*weight_count, stack_allocator, line_count*weight_count) if props['weight_length'] else None
+			total_depth_weights     = Vector(ctypes.c_float, line_count, stack_allocator, line_count) if props['weight_length'] else None
+			lengths        = Vector(ctypes.c_float, line_count, stack_allocator, line_count) if props['weight_length'] else None
+			if lengths is not None:
+				pstalgo.GetSegmentGraphLengths(graph, lengths)
 
+			# Analysis
 			progress.setCurrentTask(Tasks.ANALYSIS)
-			analysis_progress = TaskSplitProgressDelegate(analysis_count, "Performing analysis", progress)
-
-			N_TD_MD_outputted = False
-
-			if props['weight_length']:
-				# Analysis sub progress
-				analysis_sub_progress = MultiTaskProgressDelegate(analysis_progress)
-				analysis_sub_progress.addTask(Tasks.ANALYSIS, 3, "Calculating")
-				analysis_sub_progress.addTask(Tasks.WRITE_RESULTS, 1, "Writing line results")
-				# Analysis
-				analysis_sub_progress.setCurrentTask(Tasks.ANALYSIS)
-				pstalgo.AngularChoice(
-					graph_handle = graph,
-					radius = radii,
-					weigh_by_length = True,
-					angle_threshold = props['angle_threshold'],
-					angle_precision = props['angle_precision'],
-					progress_callback = pstalgo.CreateAnalysisDelegateCallbackWrapper(analysis_sub_progress),
-					out_choice = scores,
-					out_node_count = total_counts,
-					out_total_depth = total_depths,
-					out_total_depth_weight = total_depth_weights)
+			pstalgo.AngularChoice(
+				graph_handle = graph,
+				radius = radii,
+				weights = [lengths if length_weight_enabled else None for length_weight_enabled in weightings],
+				angle_threshold = props['angle_threshold'],
+				angle_precision = props['angle_precision'],
+				progress_callback = pstalgo.CreateAnalysisDelegateCallbackWrapper(progress),
+				out_choice = all_scores,
+				out_node_count = total_counts,
+				out_total_depth = total_depths,
+				out_total_depth_weight = all_total_depth_weights)
+
+			def CopyBlock(src, block_index, dst):
+				size_bytes = dst.size() * ctypes.sizeof(dst.elemtype())
+				ctypes.memmove(dst.ptr(), ctypes.cast(src.ptr(), ctypes.c_void_p).value + block_index * size_bytes, size_bytes)
+
+			progress.setCurrentTask(Tasks.WRITE_RESULTS)
+			write_progress = TaskSplitProgressDelegate(weight_count, "Writing line results", progress)
+
+			for weight_index, length_weight_enabled in enumerate(weightings):
+				CopyBlock(all_scores, weight_index, scores)
+				if total_depth_weights is not None:
+					CopyBlock(all_total_depth_weights, weight_index, total_depth_weights)
 				# Output
 				columns = []
 				if props['norm_none']:
-					columns.append((GenerateScoreColumnName(True, radii, ColName.NORM_NONE), 'float', scores.values()))
+					columns.append((GenerateScoreColumnName(length_weight_enabled, radii, ColName.NORM_NONE), 'float', scores.values()))
 				# Normalization
 				if scores_norm is not None:
 					pstalgo.AngularChoiceNormalize(scores, total_counts, scores.size(), scores_norm)
-					columns.append((GenerateScoreColumnName(True, radii, ColName.NORM_TURNER), 'float', scores_norm.values()))
+					columns.append((GenerateScoreColumnName(length_weight_enabled, radii, ColName.NORM_TURNER), 'float', scores_norm.values()))
 				# Standard normalization
 				if scores_std is not None:
 					pstalgo.StandardNormalize(scores, scores.size(), scores_std)
-					columns.append((GenerateScoreColumnName(True, radii, ColName.NORM_STANDARD), 'float', scores_std.values()))
+					columns.append((GenerateScoreColumnName(length_weight_enabled, radii, ColName.NORM_STANDARD), 'float', scores_std.values()))
 				# Syntax normalization
 				if scores_syntax is not None:
-					pstalgo.AngularChoiceSyntaxNormalize(scores, total_depth_weights, scores.size(), scores_syntax)
-					columns.append((GenerateScoreColumnName(True, radii, ColName.NORM_SYNTAX_NACH), 'float', scores_syntax.values()))
-				if not N_TD_MD_outputted:
-					# N
-					if props['output_N']:
-						columns.append((GenerateStatColumnName(ColName.EXTRA_NODE_COUNT, radii), 'integer',  total_counts.values()))
-					# TD
-					if props['output_TD']:
-						columns.append((GenerateStatColumnName(ColName.EXTRA_TOTAL_DEPTH, radii), 'float', total_depths.values()))
-					# MD
-					if props['output_MD']:
-						columns.append((GenerateStatColumnName(ColName.EXTRA_MEAN_DEPTH, radii), 'float', MeanDepthGen(total_depths, total_counts)))
-					N_TD_MD_outputted = True
-				# Write
-				analysis_sub_progress.setCurrentTask(Tasks.WRITE_RESULTS)
-				self._model.writeColumns(self._props['in_network'], line_rows, columns, analysis_sub_progress)
-				# Next task progress
-				analysis_progress.nextTask()
-
-			if props['weight_none']:
-				# Analysis sub progress
-				analysis_sub_progress = MultiTaskProgressDelegate(analysis_progress)
-				analysis_sub_progress.addTask(Tasks.ANALYSIS, 3, "Calculating")
-				analysis_sub_progress.addTask(Tasks.WRITE_RESULTS, 1, "Writing line results")
-				# Analysis
-				analysis_sub_progress.setCurrentTask(Tasks.ANALYSIS)
-				pstalgo.AngularChoice(
-					graph_handle = graph,
-					radius = RadiiFromSettings(pstalgo, self._props),
-					weigh_by_length = False,
-					progress_callback = pstalgo.CreateAnalysisDelegateCallbackWrapper(analysis_sub_progress),
-					out_choice = scores,
-					out_node_count = total_counts,
-					out_total_depth = total_depths)
-				# Output
-				columns = []
-				if props['weight_none']:
-					if props['norm_none']:
-						columns.append((GenerateScoreColumnName(False, radii, ColName.NORM_NONE), 'float', scores.values()))
-					# Normalization
-					if scores_norm is not None:
-						pstalgo.AngularChoiceNormalize(scores, total_counts, scores.size(), scores_norm)
-						columns.append((GenerateScoreColumnName(False, radii, ColName.NORM_TURNER), 'float', scores_norm.values()))
-					# Standard normalization
-					if scores_std is not None:
-						pstalgo.StandardNormalize(scores, scores.size(), scores_std)
-						columns.append((GenerateScoreColumnName(False, radii, ColName.NORM_STANDARD), 'float', scores_std.values()))
-					# Syntax normalization
-					if scores_syntax is not None:
-						pstalgo.AngularChoiceSyntaxNormalize(scores, total_depths, scores.size(), scores_syntax)
-						columns.append((GenerateScoreColumnName(False, radii, ColName.NORM_SYNTAX_NACH), 'float', scores_syntax.values()))
-				if not N_TD_MD_outputted:
+					pstalgo.AngularChoiceSyntaxNormalize(scores, total_depth_weights if length_weight_enabled else total_depths, scores.size(), scores_syntax)
+					columns.append((GenerateScoreColumnName(length_weight_enabled, radii, ColName.NORM_SYNTAX_NACH), 'float', scores_syntax.values()))
+				if 0 == weight_index:
 					# N
 					if props['output_N']:
 						columns.append((GenerateStatColumnName(ColName.EXTRA_NODE_COUNT, radii), 'integer',  total_counts.values()))
@@ -186,12 +147,10 @@ class AngularChoiceAnalysis(BaseAnalysis):
 					# MD
 					if props['output_MD']:
 						columns.append((GenerateStatColumnName(ColName.EXTRA_MEAN_DEPTH, radii), 'float', MeanDepthGen(total_depths, total_counts)))
-					N_TD_MD_outputted = True
 				# Write
-				analysis_sub_progress.setCurrentTask(Tasks.WRITE_RESULTS)
-				self._model.writeColumns(self._props['in_network'], line_rows, columns, analysis_sub_progress)
+				self._model.writeColumns(self._props['in_network'], line_rows, columns, write_progress)
 				# Next task progress
-				analysis_progress.nextTask()
+				write_progress.nextTask()
 
 		finally:
 			stack_allocator.restore(initial_alloc_state)